@@ -1,11 +1,11 @@
 #include "application.h"
 #include "handlers.h"
 #include "json_loader.h"
+#include "log.h"
 #include "model.h"
 #include "player.h"
 #include "type_declarations.h"
 #include <boost/json/object.hpp>
-#include <iomanip>
 
 namespace app {
     char to_uppercase(unsigned char c) {
@@ -16,40 +16,14 @@ namespace app {
         c = to_uppercase(c);
     }
 
-	Token PlayerTokens::GenerateToken() {
-        std::ostringstream ss;
-        ss << std::hex << std::setfill('0') << std::setw(16) << generator1_()
-        << std::setw(16) << generator2_();
-
-        std::string token = ss.str();
-
-        // Генерация символов a-f как в верхнем, так и в нижнем регистре
-        std::mt19937 gen(random_device_());
-        std::uniform_int_distribution<> dist(0, 1);
-
-        std::transform(token.cbegin(), token.cend(), token.begin(), [&dist, &gen](char c) {
-            if (std::isalpha(c) && dist(gen)) {
-                c = std::toupper(c);
-            }
-
-            return c;
-        });
-
-        return Token{token};
-    }
-
-    std::shared_ptr<Player::Player> PlayerTokens::FindPlayerByToken(const Token& token) const {
-        auto player = token_to_player_.find(token);
-        if (player != token_to_player_.end())
-            return player->second;
-
-        return nullptr;
+	Token Players::GenerateToken() {
+        return Token{generator1_(), generator2_()};
     }
 
     Token Application::AddPlayer(std::shared_ptr<model::Dog> dog, 
                                  std::shared_ptr<model::GameSession> session) {
         auto existing_player = 
-            FindExistingPlayer(dog->GetId(), session->GetMapId());
+            FindExistingPlayer(dog->GetId(), session->GetMapHandle());
 
         if (existing_player) {
             return HandleExistingPlayer(existing_player, session);
@@ -58,18 +32,11 @@ namespace app {
         return CreateNewPlayer(dog, session);
     }
 
-    Token Players::FindTokenByPlayer(std::shared_ptr<Player::Player> player) { 
-        return player_tokens_.FindTokenByPlayer(player);
-    }
-
-    Token Application::FindTokenByPlayer(std::shared_ptr<Player::Player> player) {
-        return players_.FindTokenByPlayer(player);
-    }
 
     std::shared_ptr<Player::Player> 
     Application::FindExistingPlayer(model::Dog::Id dog_id, 
-                                    model::Map::Id map_id) {
-        return players_.FindByDogAndMapId(dog_id, map_id);
+                                    model::Map::Handle map_handle) {
+        return players_.FindByDogAndMap(dog_id, map_handle);
     }
 
 
@@ -77,123 +44,391 @@ namespace app {
                                         std::shared_ptr<model::GameSession> new_session) {
         auto existing_session = player->GetGameSession();
 
-        if (existing_session->GetMapId() == new_session->GetMapId()) {
-            return players_.FindTokenByPlayer(player);
+        if (existing_session->GetMapHandle() == new_session->GetMapHandle()) {
+            return players_.FindToken(player->GetDogId(), new_session->GetMapHandle());
         }
 
         std::string dog_name = player->GetGameSession()->GetDogs().at(player->GetDogId())->GetName();
 
-        RemovePlayerFromSession(player, existing_session);
+        RemovePlayer(player->GetDogId(), existing_session);
         return CreateNewPlayer(std::make_shared<model::Dog>(dog_name), new_session);
     }
 
 
-    void Application::RemovePlayerFromSession(std::shared_ptr<Player::Player> player, 
-                                          std::shared_ptr<model::GameSession> session) {
-        session->RemoveDog(player->GetDogId());
-        players_.Remove(player->GetDogId(), session->GetMapId());
+    void Application::RemovePlayer(model::Dog::Id dog_id, std::shared_ptr<model::GameSession> session) {
+        DetachPlayer(dog_id, *session);
+
+        for (auto* listener : listeners_) {
+            listener->OnLeave(dog_id, *session);
+        }
+
+        ReclaimIfEmpty(*session);
+    }
+
+    void Application::ReplayLeave(model::Dog::Id dog_id, std::shared_ptr<model::GameSession> session) {
+        DetachPlayer(dog_id, *session);
+        ReclaimIfEmpty(*session);
+    }
+
+    void Application::DetachPlayer(model::Dog::Id dog_id, model::GameSession& session) {
+        idle_wheel_.Cancel(dog_id);
+        activities_.erase(dog_id);
+
+        session.RemoveDog(dog_id);
+        players_.Remove(dog_id, session.GetMapHandle());
+    }
+
+    // Опустевшая сессия больше не тикает и не получает трофеи
+    void Application::ReclaimIfEmpty(const model::GameSession& session) {
+        if (game_.GetSessionService().ReclaimIfEmpty(session.GetSessionId())) {
+            serialized_rosters_.erase(session.GetSessionId());
+            serialized_states_.erase(session.GetSessionId());
+        }
     }
 
     Token Application::CreateNewPlayer(std::shared_ptr<model::Dog> dog, 
                                    std::shared_ptr<model::GameSession> session) {
         dog->SetDefaultDogSpeed(session->GetMapDefaultSpeed());
-        session->AddDog(dog);
-        return players_.Add(dog, session);
+        try {
+            session->AddDog(dog);
+            Token token = players_.Add(dog, session);
+            TrackPlayer(*dog, session->GetMapHandle(), {});
+
+            for (auto* listener : listeners_) {
+                listener->OnJoin(*dog, *session, token.ToHex());
+            }
+
+            return token;
+        } catch (...) {
+            // Вход откатывается целиком: открытая для игрока сессия не должна остаться пустой
+            DetachPlayer(dog->GetId(), *session);
+            ReclaimIfEmpty(*session);
+            throw;
+        }
+    }
+
+    void Application::RestorePlayer(const Token& token, std::shared_ptr<model::Dog> dog, 
+                                    std::shared_ptr<model::GameSession> session, PlayerActivity activity) {
+        const model::Map::Handle map_handle = session->GetMapHandle();
+        players_.Restore(token, dog, std::move(session));
+        TrackPlayer(*dog, map_handle, activity);
+    }
+
+    PlayerActivity Application::GetPlayerActivity(model::Dog::Id dog_id) const {
+        auto activity = activities_.find(dog_id);
+        if (activity == activities_.end()) {
+            return {};
+        }
+
+        return PlayerActivity{game_time_ - activity->second.joined_at, 
+                              idle_wheel_.Remaining(dog_id).value_or(milliseconds{0})};
     }
 
     std::shared_ptr<Player::Player> Players::GetPlayerByToken(const Token& token) const {
-        return player_tokens_.FindPlayerByToken(token);
+        if (auto slot = token_to_slot_.Find(token)) {
+            return entries_[*slot].player;
+        }
+
+        return nullptr;
     }
 
-    std::shared_ptr<Player::Player> Players::FindByDogAndMapId(model::Dog::Id dog_id, 
-                                                           model::Map::Id map_id) {
-        auto it = players_.find({dog_id, *map_id});
-        return it != players_.end() ? it->second : nullptr;
+    const Players::Entry* Players::FindEntry(model::Dog::Id dog_id, model::Map::Handle map_handle) const {
+        auto it = key_to_slot_.find({dog_id, map_handle});
+        return it != key_to_slot_.end() ? &entries_[it->second] : nullptr;
     }
 
-    Token PlayerTokens::AddPlayer(std::shared_ptr<Player::Player> player) {
-        Token token = GenerateToken();
-        token_to_player_[token] = player;
+    std::shared_ptr<Player::Player> Players::FindByDogAndMap(model::Dog::Id dog_id, 
+                                                         model::Map::Handle map_handle) const {
+        const Entry* entry = FindEntry(dog_id, map_handle);
+        return entry ? entry->player : nullptr;
+    }
 
-        return token;
+    Token Players::FindToken(model::Dog::Id dog_id, model::Map::Handle map_handle) const {
+        const Entry* entry = FindEntry(dog_id, map_handle);
+        return entry ? entry->token : Token{};
+    }
+
+    void Players::Insert(const Token& token, std::shared_ptr<model::Dog> dog, 
+                         std::shared_ptr<model::GameSession> game_session) {
+        const PlayerKey key{dog->GetId(), game_session->GetMapHandle()};
+        const auto slot = static_cast<uint32_t>(entries_.size());
+
+        if (!token_to_slot_.Insert(token, slot)) {
+            throw std::invalid_argument("Duplicate player token");
+        }
+        if (!key_to_slot_.emplace(key, slot).second) {
+            token_to_slot_.Erase(token);
+            throw std::invalid_argument("Duplicate player " + std::to_string(key.first));
+        }
+
+        entries_.push_back(Entry{token, key, std::make_shared<Player::Player>(dog, game_session)});
+        known_tokens_.Insert(token);
+    }
+
+    void Players::Restore(const Token& token, std::shared_ptr<model::Dog> dog, 
+                          std::shared_ptr<model::GameSession> game_session) {
+        Insert(token, std::move(dog), std::move(game_session));
     }
 
     Token Players::Add(std::shared_ptr<model::Dog> dog, 
                        std::shared_ptr<model::GameSession> game_session) {
-        std::shared_ptr<Player::Player> player = std::make_shared<Player::Player>(dog, game_session);
-        Token token = player_tokens_.AddPlayer(player);
-        players_[{dog->GetId(), *(game_session->GetMapId())}] = 
-            std::make_shared<Player::Player>(dog, game_session);
-    
+        // Нулевой токен означает его отсутствие (см. FindToken)
+        Token token;
+        do {
+            token = GenerateToken();
+        } while (token == Token{} || token_to_slot_.Find(token));
+
+        Insert(token, std::move(dog), std::move(game_session));
         return token;
     }
 
-    void Players::Remove(model::Dog::Id dog_id, model::Map::Id map_id) {
-        auto it = players_.find({dog_id, *map_id});
-        if (it != players_.end()) {
-            players_.erase(it);
+    void Players::Remove(model::Dog::Id dog_id, model::Map::Handle map_handle) {
+        auto it = key_to_slot_.find({dog_id, map_handle});
+        if (it == key_to_slot_.end()) {
+            return;
+        }
+
+        const uint32_t slot = it->second;
+        key_to_slot_.erase(it);
+        token_to_slot_.Erase(entries_[slot].token);
+        known_tokens_.Erase(entries_[slot].token);
+
+        // Последняя запись занимает место удалённой, индексы переводятся на новый номер
+        if (slot + 1 != entries_.size()) {
+            entries_[slot] = std::move(entries_.back());
+            key_to_slot_[entries_[slot].key] = slot;
+            *token_to_slot_.Find(entries_[slot].token) = slot;
         }
+        entries_.pop_back();
     }
 
     Application::Application(model::Game& game) 
         : game_(game) {
     }
 
-    const std::vector<std::string> Application::GetPlayersList(const Token& token) const {
+    std::shared_ptr<Player::Player> Application::FindPlayer(const Token& token) const {
         auto player = players_.GetPlayerByToken(token);
-        if (!player) return {};
-
-        auto game_session = player->GetGameSession();
-        auto players_list = game_session->GetPlayersNames();
-
-        std::sort(players_list.begin(), players_list.end());
+        if (!player && cold_player_resolver_) {
+            cold_player_resolver_(token);
+            player = players_.GetPlayerByToken(token);
+        }
 
-        return players_list;
+        return player;
     }
 
-    void Application::SetApplicationListener(ApplicationListener& listener) {
-        listener_ = &listener;
+    void Application::AddApplicationListener(ApplicationListener& listener) {
+        listeners_.push_back(&listener);
     }
 
-    const std::string Application::GetSerializedPlayersList(const Token& token) const {
-        std::vector<std::string> names = GetPlayersList(token);
-        boost::json::object players_json;
-        
-        int index = 0;
-        for (const auto& player_name : names) {
-            players_json[std::to_string(index)] = boost::json::object{{"name", player_name}};
-            index++;
+    const http_handler::SharedBuffer& Application::GetSerializedPlayersList(const Token& token) const {
+        static const http_handler::SharedBuffer empty_list = http_handler::MakeSharedBuffer("{}");
+
+        auto player = FindPlayer(token);
+        if (!player) return empty_list;
+
+        const auto& game_session = player->GetGameSession();
+        const uint64_t version = game_session->GetRosterVersion();
+
+        auto [it, inserted] = serialized_rosters_.try_emplace(game_session->GetSessionId());
+        SerializedRoster& roster = it->second;
+        if (inserted || roster.version != version) {
+            boost::json::object players_json;
+
+            int index = 0;
+            for (const auto& player_name : game_session->GetRoster()) {
+                players_json[std::to_string(index)] = boost::json::object{{"name", player_name}};
+                index++;
+            }
+
+            roster.body = http_handler::MakeSharedBuffer(boost::json::serialize(players_json));
+            roster.version = version;
         }
 
-        return boost::json::serialize(players_json);
+        return roster.body;
     }
 
 
-    bool Application::HasPlayerToken(Token token) const {
-        auto player = players_.GetPlayerByToken(app::Token{token});
+    bool Application::HasSerializedBodies(model::GameSession::Id session_id) const {
+        return serialized_rosters_.contains(session_id) || serialized_states_.contains(session_id);
+    }
+
+    bool Application::HasPlayerToken(const Token& token) const {
+        auto player = FindPlayer(token);
 
         return player != nullptr;
     }
 
-    const std::string Application::GetSerializedGameState(const Token& token) const {
-        auto game_session = players_.GetPlayerByToken(token)->GetGameSession();
-        std::vector<model::State> states = game_session->GetPlayersUnitStates();
-        const model::GameSession::LostObjects 
-            lost_objects = game_session->GetLostObjects();
+    Application::SerializedGameState 
+    Application::GetSerializedGameState(const Token& token, http_handler::BodyEncoding encoding) const {
+        auto game_session = FindPlayer(token)->GetGameSession();
+        const uint64_t version = game_session->GetStateVersion();
+
+        SerializedState& state = serialized_states_[game_session->GetSessionId()];
+        // Восстановленная из холодного снимка сессия - новый объект со своим счётчиком версий
+        if (state.version != version || state.session.lock() != game_session) {
+            state.json.reset();
+            state.msgpack.reset();
+            state.version = version;
+            state.generation = ++last_state_generation_;
+            state.session = game_session;
+        }
+
+        const bool msgpack = encoding == http_handler::BodyEncoding::MSGPACK;
+        http_handler::SharedBuffer& body = msgpack ? state.msgpack : state.json;
+        if (!body) {
+            const std::vector<model::State> states = game_session->GetPlayersUnitStates();
+            const auto& lost_objects = game_session->GetLostObjects();
+            std::string serialized;
+            if (msgpack) {
+                json_loader::StateSerializer::WriteStatesMsgPack(serialized, states, lost_objects);
+            } else {
+                json_loader::StateSerializer::WriteStates(serialized, states, lost_objects);
+            }
+            body = http_handler::MakeSharedBuffer(std::move(serialized));
+        }
 
-        return json_loader::StateSerializer::SerializeStates(states, lost_objects);
+        return {body, game_session->GetSessionId(), state.generation};
     }
     
-    void Application::MovePlayer(const Token& token, std::string direction) {
-        auto player = players_.GetPlayerByToken(token);
-        player->MovePlayer(direction);
+    void Application::MovePlayer(const Token& token, model::Move move) {
+        auto player = FindPlayer(token);
+        ApplyMove(*player, move);
+
+        for (auto* listener : listeners_) {
+            listener->OnAction(player->GetDogId(), move);
+        }
+    }
+
+    void Application::ReplayMove(model::Dog::Id dog_id, model::Map::Handle map_handle, model::Move move) {
+        auto player = players_.FindByDogAndMap(dog_id, map_handle);
+        if (!player) {
+            throw std::runtime_error("Journal refers to unknown player: "s + std::to_string(dog_id));
+        }
+
+        ApplyMove(*player, move);
+    }
+
+    void Application::ApplyMove(Player::Player& player, model::Move move) {
+        player.MovePlayer(move);
+
+        if (move == model::Move::STOP) {
+            StartIdle(player.GetDogId());
+        } else {
+            idle_wheel_.Cancel(player.GetDogId());
+        }
     }
 
-    void Application::Tick(milliseconds delta_time) const {
+    void Application::Tick(milliseconds delta_time) {
         game_.GetEngine().Tick(delta_time);
 
-        if (listener_) {
-            listener_->OnTick(delta_time / 1000);
+        for (auto* listener : listeners_) {
+            listener->OnTick(delta_time);
         }
+
+        RetireIdlePlayers(delta_time);
     } 
+
+    void Application::Tick(milliseconds delta_time, 
+                           const model::SessionService::ParallelFor& parallel_for) {
+        game_.GetEngine().Tick(delta_time, parallel_for);
+
+        for (auto* listener : listeners_) {
+            listener->OnTick(delta_time);
+        }
+
+        RetireIdlePlayers(delta_time);
+    }
+
+    void Application::SetRetirement(milliseconds retirement_time, RecordsSink* records) {
+        retirement_time_ = retirement_time;
+        records_ = records;
+    }
+
+    std::vector<PlayerRecord> Application::GetRecords(size_t start, size_t max_items) const {
+        return records_source_ ? records_source_->GetRecords(start, max_items) : std::vector<PlayerRecord>{};
+    }
+
+    void Application::TrackPlayer(const model::Dog& dog, model::Map::Handle map_handle, PlayerActivity activity) {
+        if (!retirement_time_) {
+            return;
+        }
+
+        activities_[dog.GetId()] = Activity{map_handle, game_time_ - activity.play_time};
+        if (activity.idle_left > milliseconds{0}) {
+            idle_wheel_.Schedule(dog.GetId(), activity.idle_left);
+        } else if (const auto speed = dog.GetSpeed(); speed.x == 0 && speed.y == 0) {
+            // Новая собака стоит на месте, пока игрок не даст команду
+            StartIdle(dog.GetId());
+        }
+    }
+
+    void Application::StartIdle(model::Dog::Id dog_id) {
+        if (retirement_time_ && activities_.contains(dog_id) && !idle_wheel_.Contains(dog_id)) {
+            idle_wheel_.Schedule(dog_id, *retirement_time_);
+        }
+    }
+
+    void Application::AdvanceIdleTime(milliseconds delta_time) {
+        game_time_ += delta_time;
+
+        retired_.clear();
+        idle_wheel_.Advance(delta_time, retired_);
+    }
+
+    // Собаки, упёршиеся в край дороги на этом тике, начинают простаивать с его конца.
+    // Список забирается и без пенсии, иначе он рос бы бесконечно
+    void Application::StartIdleOfStoppedDogs() {
+        for (const auto& session : game_.GetSessionService().GetSessions()) {
+            for (auto dog_id : session->TakeStoppedDogs()) {
+                StartIdle(dog_id);
+            }
+        }
+    }
+
+    // Вызывается после слушателей тика: в журнал уход игрока попадает после тика, как и происходит в игре
+    void Application::RetireIdlePlayers(milliseconds delta_time) {
+        AdvanceIdleTime(delta_time);
+        for (auto dog_id : retired_) {
+            RetirePlayer(dog_id);
+        }
+
+        StartIdleOfStoppedDogs();
+    }
+
+    void Application::ReplayTick(milliseconds delta_time) {
+        game_.GetSessionService().Tick(delta_time);
+
+        AdvanceIdleTime(delta_time);
+        // Уход игрока записан в журнале следом за тиком. Если журнал оборвался раньше,
+        // игрок уйдёт на первом тике после восстановления
+        for (auto dog_id : retired_) {
+            idle_wheel_.Schedule(dog_id, milliseconds{0});
+        }
+
+        StartIdleOfStoppedDogs();
+    }
+
+    void Application::RetirePlayer(model::Dog::Id dog_id) {
+        auto activity = activities_.find(dog_id);
+        if (activity == activities_.end()) {
+            return;
+        }
+
+        auto player = players_.FindByDogAndMap(dog_id, activity->second.map_handle);
+        if (!player) {
+            activities_.erase(activity);
+            return;
+        }
+
+        auto session = player->GetGameSession();
+        const auto& dog = session->GetDogs().at(dog_id);
+        PlayerRecord record{dog->GetName(), dog->GetState().score, game_time_ - activity->second.joined_at};
+
+        RemovePlayer(dog_id, session);
+
+        PlayerRetiredLog(record.name, record.score, record.play_time.count());
+        if (records_) {
+            records_->Save(std::move(record));
+        }
+    }
 }
@@ -5,13 +5,19 @@
 #include "infrastructure.h"
 #include "player.h"
 #include "model.h"
+#include "records.h"
+#include "timing_wheel.h"
+#include "token.h"
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <random>
 #include <algorithm>
 #include <unordered_map>
+#include <vector>
 #include <iostream>
 #include <boost/functional/hash.hpp>
 #include <boost/json.hpp>
@@ -22,33 +28,57 @@ namespace app {
 
     using milliseconds = std::chrono::milliseconds;
 
-    namespace detail {
-        struct TokenTag {};
-    }
-    
-    using Token = util::Tagged<std::string, detail::TokenTag>;
-
-    class PlayerTokens {
+    // Реестр игроков: плотная таблица записей и два индекса по номеру записи -
+    // по токену и по паре (карта, собака). Удаление переносит последнюю запись на место удалённой
+    class Players {
     public:
-        PlayerTokens() = default;
+        Token Add(std::shared_ptr<model::Dog> dog, std::shared_ptr<model::GameSession> game_session);
+
+        // Регистрирует игрока под ранее выданным токеном
+        void Restore(const Token& token, std::shared_ptr<model::Dog> dog, 
+                     std::shared_ptr<model::GameSession> game_session);
+
+        std::shared_ptr<Player::Player> GetPlayerByToken(const Token& token) const;
 
-        Token AddPlayer(std::shared_ptr<Player::Player> player);
+        std::shared_ptr<Player::Player> FindByDogAndMap(model::Dog::Id dog_id, model::Map::Handle map_handle) const;
 
-        Token FindTokenByPlayer(std::shared_ptr<Player::Player> player) {
-            for (const auto& [token, stored_player] : token_to_player_) {
-                if (stored_player == player) {
-                    return token;
-                }
+        // Возвращает нулевой токен, если игрока нет
+        Token FindToken(model::Dog::Id dog_id, model::Map::Handle map_handle) const;
+
+        void Remove(model::Dog::Id dog_id, model::Map::Handle map_handle);
+
+        template <typename Fn>
+        void ForEachPlayer(Fn&& fn) const {
+            for (const auto& entry : entries_) {
+                fn(entry.token, *entry.player);
             }
+        }
+
+        size_t Size() const noexcept { return entries_.size(); }
 
-            return {};
-        } 
+        // Единственный метод реестра, который можно вызывать из любого потока
+        bool IsKnown(const Token& token) const { return known_tokens_.Contains(token); }
 
-        std::shared_ptr<Player::Player> FindPlayerByToken(const Token& token) const;
+        Token GenerateToken();
 
     private:
-        using TokenHasher = util::TaggedHasher<Token>;
-        std::unordered_map<Token, std::shared_ptr<Player::Player>, TokenHasher> token_to_player_;
+        using PlayerKey = std::pair<model::Dog::Id, model::Map::Handle>;
+
+        struct Entry {
+            Token token;
+            PlayerKey key;
+            std::shared_ptr<Player::Player> player;
+        };
+
+        void Insert(const Token& token, std::shared_ptr<model::Dog> dog, 
+                    std::shared_ptr<model::GameSession> game_session);
+
+        const Entry* FindEntry(model::Dog::Id dog_id, model::Map::Handle map_handle) const;
+
+        std::vector<Entry> entries_;
+        TokenTable token_to_slot_;
+        KnownTokens known_tokens_;
+        std::unordered_map<PlayerKey, uint32_t, boost::hash<PlayerKey>> key_to_slot_;
 
         std::random_device random_device_;
         std::mt19937_64 generator1_{[this] {
@@ -59,71 +89,170 @@ namespace app {
             std::uniform_int_distribution<std::mt19937_64::result_type> dist;
             return dist(random_device_);
         }()};
-
-        Token GenerateToken();
     };
 
-    class Players {
-    public:
-        Token Add(std::shared_ptr<model::Dog> dog, std::shared_ptr<model::GameSession> game_session);
-
-        std::shared_ptr<Player::Player> GetPlayerByToken(const Token& token) const;
-
-        std::shared_ptr<Player::Player> FindByDogAndMapId(model::Dog::Id dog_id, model::Map::Id map_id);
-
-        void Remove(model::Dog::Id dog_id, model::Map::Id map_id);
-
-        Token FindTokenByPlayer(std::shared_ptr<Player::Player> player);
-
-    private:
-        PlayerTokens player_tokens_;
-        std::unordered_map<std::pair<uint64_t, std::string>, 
-            std::shared_ptr<Player::Player>, boost::hash<std::pair<uint64_t, std::string>>> players_;
-
+    // Учёт времени игрока для пенсии: сколько он уже играет и сколько его собаке осталось
+    // простаивать до ухода на пенсию. Нулевой остаток - собака не простаивает
+    struct PlayerActivity {
+        milliseconds play_time{0};
+        milliseconds idle_left{0};
     };
 
     class Application {
     public:
         explicit Application(model::Game& game);
 
-        void SetApplicationListener(ApplicationListener& listener);
+        void AddApplicationListener(ApplicationListener& listener);
+
+        // Тело ответа кэшируется для каждой сессии и пересобирается только после входа или выхода игроков.
+        // Буфер не меняется: пересборка создаёт новый, а отправляемые ответы держат старый
+        const http_handler::SharedBuffer& GetSerializedPlayersList(const Token& token) const;
+        // Тело состояния сессии. Поколение меняется при каждой пересборке тела и никогда не повторяется,
+        // по нему кэшируются производные от тела, например сжатые тела
+        struct SerializedGameState {
+            const http_handler::SharedBuffer& body;
+            model::GameSession::Id session_id;
+            uint64_t generation;
+        };
+
+        // Тело строится один раз на версию состояния сессии и общее для всех её игроков
+        SerializedGameState GetSerializedGameState(const Token& token, 
+                                                   http_handler::BodyEncoding encoding = 
+                                                      http_handler::BodyEncoding::JSON) const;
 
-        const std::string GetSerializedPlayersList(const Token& token) const;
-        const std::string GetSerializedGameState(const Token& token) const;
+        // Построены ли для сессии тела списка игроков или состояния
+        bool HasSerializedBodies(model::GameSession::Id session_id) const;
 
-        bool HasPlayerToken(Token token) const;
+        bool HasPlayerToken(const Token& token) const;
 
         std::optional<http_handler::StringResponse> 
         MovePlayer(const Token& token,  http_handler::JsonResponseHandler json_response, 
-                   std::string direction = "");
+                   model::Move move = model::Move::STOP);
 
-        void MovePlayer(const Token& token, std::string direction = "");
+        void MovePlayer(const Token& token, model::Move move = model::Move::STOP);
 
         Token AddPlayer(std::shared_ptr<model::Dog> dog, 
                         std::shared_ptr<model::GameSession> session);
 
-        void Tick(milliseconds delta_time) const;
+        // Удаляет собаку игрока из сессии
+        void RemovePlayer(model::Dog::Id dog_id, std::shared_ptr<model::GameSession> session);
 
-    private:
+        // Возвращает в игру игрока из сохранённого состояния: собака уже находится в сессии.
+        // Отсчёт простоя продолжается с сохранённого остатка, а без него начинается, только если собака стоит
+        void RestorePlayer(const Token& token, std::shared_ptr<model::Dog> dog, 
+                           std::shared_ptr<model::GameSession> session, PlayerActivity activity = {});
 
-        const std::vector<std::string> GetPlayersList(const Token& token) const;
+        // Для снимка состояния. Без пенсии время игроков не учитывается и возвращается нулевым
+        PlayerActivity GetPlayerActivity(model::Dog::Id dog_id) const;
 
-        std::shared_ptr<Player::Player> 
-        FindExistingPlayer(model::Dog::Id dog_id, model::Map::Id map_id);
+        // Повтор журнала: команда, тик и уход игрока меняют игру так же, как в игре, но слушатели
+        // не вызываются, как и при входе через RestorePlayer. Игроки не уходят на пенсию сами -
+        // их уход записан в журнале отдельно
+        void ReplayMove(model::Dog::Id dog_id, model::Map::Handle map_handle, model::Move move);
+        void ReplayTick(milliseconds delta_time);
+        void ReplayLeave(model::Dog::Id dog_id, std::shared_ptr<model::GameSession> session);
+
+        const Players& GetPlayers() const noexcept { return players_; }
+
+        // Вызывается, если токен не найден: игрок может находиться в ещё не наполненной сессии,
+        // восстановленной из снимка. Резолвер должен наполнить эту сессию
+        using ColdPlayerResolver = std::function<void(const Token& token)>;
+
+        void SetColdPlayerResolver(ColdPlayerResolver resolver) {
+            cold_player_resolver_ = std::move(resolver);
+        }
 
-        void RemovePlayerFromSession(std::shared_ptr<Player::Player> player, 
-                                    std::shared_ptr<model::GameSession> session);
+        // Выдан ли токен игроку холодной сессии. Вызывается из любого потока
+        using ColdTokenChecker = std::function<bool(const Token& token)>;
+
+        // Задаётся до начала обработки запросов
+        void SetColdTokenChecker(ColdTokenChecker checker) {
+            cold_token_checker_ = std::move(checker);
+        }
+
+        // Выдан ли токен игроку, в том числе игроку холодной сессии. Можно вызывать из любого потока
+        bool IsKnownToken(const Token& token) const {
+            return players_.IsKnown(token) || (cold_token_checker_ && cold_token_checker_(token));
+        }
+
+        model::Game& GetGame() const noexcept { return game_; }
+
+        // Игрок, собака которого простояла retirement_time, уходит на пенсию: он удаляется из игры,
+        // а его итог передаётся в records. Игроки, вошедшие до вызова, не отслеживаются
+        void SetRetirement(milliseconds retirement_time, RecordsSink* records = nullptr);
+
+        // Таблица рекордов для API. Без источника она пуста
+        void SetRecordsSource(const RecordsSource* records) { records_source_ = records; }
+        std::vector<PlayerRecord> GetRecords(size_t start, size_t max_items) const;
+
+        void Tick(milliseconds delta_time);
+        void Tick(milliseconds delta_time, 
+                  const model::SessionService::ParallelFor& parallel_for);
+
+    private:
+
+        std::shared_ptr<Player::Player> 
+        FindExistingPlayer(model::Dog::Id dog_id, model::Map::Handle map_handle);
 
         Token HandleExistingPlayer(std::shared_ptr<Player::Player> player, 
                                    std::shared_ptr<model::GameSession> new_session);
 
         Token CreateNewPlayer(std::shared_ptr<model::Dog> dog, std::shared_ptr<model::GameSession> session);
 
-        Token FindTokenByPlayer(std::shared_ptr<Player::Player> player);
+        void DetachPlayer(model::Dog::Id dog_id, model::GameSession& session);
+        void ReclaimIfEmpty(const model::GameSession& session);
+
+        std::shared_ptr<Player::Player> FindPlayer(const Token& token) const;
 
+        void TrackPlayer(const model::Dog& dog, model::Map::Handle map_handle, PlayerActivity activity);
+        // Собака встала: начинается отсчёт простоя, если он ещё не идёт
+        void StartIdle(model::Dog::Id dog_id);
+        void ApplyMove(Player::Player& player, model::Move move);
+        // Сдвигает время простоя и дописывает в retired_ собак, простоявших retirement_time
+        void AdvanceIdleTime(milliseconds delta_time);
+        void StartIdleOfStoppedDogs();
+        void RetireIdlePlayers(milliseconds delta_time);
+        void RetirePlayer(model::Dog::Id dog_id);
 
 		model::Game& game_;
 		Players players_;
-        ApplicationListener* listener_ = nullptr;
+        std::vector<ApplicationListener*> listeners_;
+        ColdPlayerResolver cold_player_resolver_;
+        ColdTokenChecker cold_token_checker_;
+
+        struct SerializedRoster {
+            uint64_t version = 0;
+            http_handler::SharedBuffer body;
+        };
+        mutable std::unordered_map<model::GameSession::Id, SerializedRoster> serialized_rosters_;
+
+        // Тело не построено для текущей версии, пока буфер пуст. Новая версия получает новые буферы,
+        // старые живут, пока их отправляют
+        struct SerializedState {
+            std::weak_ptr<const model::GameSession> session;
+            uint64_t version = 0;
+            uint64_t generation = 0;
+            http_handler::SharedBuffer json;
+            http_handler::SharedBuffer msgpack;
+        };
+        mutable std::unordered_map<model::GameSession::Id, SerializedState> serialized_states_;
+        mutable uint64_t last_state_generation_ = 0;
+
+        struct Activity {
+            model::Map::Handle map_handle;
+            milliseconds joined_at;
+        };
+
+        // Таймер в колесе есть только у стоящих собак. Колесо сдвигается на каждом тике,
+        // поэтому стоимость тика не зависит от числа игроков. Простой отсчитывается шагами
+        // по IDLE_RESOLUTION: пенсия не требует точности до миллисекунды, а шагов становится меньше
+        static constexpr milliseconds IDLE_RESOLUTION{100};
+        std::optional<milliseconds> retirement_time_;
+        RecordsSink* records_ = nullptr;
+        const RecordsSource* records_source_ = nullptr;
+        milliseconds game_time_{0};
+        util::TimingWheel idle_wheel_{IDLE_RESOLUTION};
+        std::unordered_map<model::Dog::Id, Activity> activities_;
+        std::vector<util::TimingWheel::Key> retired_;
     };
 }
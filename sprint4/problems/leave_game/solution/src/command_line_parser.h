@@ -14,6 +14,20 @@ struct Args {
     unsigned int period = DEFAULT_TICK_PERIOD;
     std::string config;
     std::string www_root;
+    std::string record_journal;
+    std::string state_file;
+    unsigned int save_state_period = 0;
+    std::string wal_file;
+    std::string map_cache;
+    std::string records_file;
+    int gzip_level = 6;
+    size_t gzip_min_size = 1024;
+    size_t max_connections = 10'000;
+    unsigned int header_timeout = 10'000;
+    unsigned int body_timeout = 30'000;
+    unsigned int idle_timeout = 60'000;
+    size_t max_api_queue = 1024;
+    unsigned int stats_period = 60'000;
     bool random;
 };
 
@@ -29,12 +43,41 @@ struct Args {
     // -c [ --config-file ] file         set config file path
     // -w [ --www-root ] dir             set static files root
     // --randomize-spawn-points          spawn dogs at random positions
+    // --record-journal file             record game inputs for deterministic replay
+    // --state-file file                 save game state to file and restore it on start
+    // --save-state-period milliseconds  period of automatic game state saving
+    // --wal-file file                   write-ahead log for recovery between state saves
+    // --map-cache file                  compiled maps cache, rebuilt when config changes
+    // --records-file file               append-only file of retired players' records
+    // --gzip-level level                gzip level of API responses, 0 disables compression
+    // --gzip-min-size bytes             smallest API response body to compress
+    // --max-connections count           connections above the limit are closed right after accept
+    // --header-timeout milliseconds     time to receive headers of the first request
+    // --body-timeout milliseconds       time to receive a request body
+    // --idle-timeout milliseconds       time to wait for the next request on a keep-alive connection
+    // --max-api-queue count             API requests waiting for the game strand, others get 503
+    // --stats-period milliseconds       period of server stats logging, 0 - only on exit
     desc.add_options()                                                                                           //
         ("help,h", "produce help message")                                                                       //
         ("tick-period,t", po::value<unsigned int>(&args.period)->value_name("milliseconds"), "set tick period")  //
         ("config-file,c", po::value(&args.config)->value_name("file"), "set config file path")                   //
         ("www-root,w", po::value(&args.www_root)->value_name("dir"), "set static files root")                    //
-        ("randomize-spawn-points", po::value<bool>(&args.random), "spawn dogs at random positions");
+        ("randomize-spawn-points", po::value<bool>(&args.random), "spawn dogs at random positions")              //
+        ("record-journal", po::value(&args.record_journal)->value_name("file"), "record game inputs for replay")  //
+        ("state-file", po::value(&args.state_file)->value_name("file"), "set game state file path")              //
+        ("save-state-period", po::value(&args.save_state_period)->value_name("milliseconds"),
+         "set period of game state saving")                                                                     //
+        ("wal-file", po::value(&args.wal_file)->value_name("file"), "set write-ahead log path")                  //
+        ("map-cache", po::value(&args.map_cache)->value_name("file"), "set compiled maps cache path")            //
+        ("records-file", po::value(&args.records_file)->value_name("file"), "set retired players records path")  //
+        ("gzip-level", po::value(&args.gzip_level)->value_name("level"), "set gzip level (0-9, 0 - off)")         //
+        ("gzip-min-size", po::value(&args.gzip_min_size)->value_name("bytes"), "set min body size to compress")  //
+        ("max-connections", po::value(&args.max_connections)->value_name("count"), "set max open connections")  //
+        ("header-timeout", po::value(&args.header_timeout)->value_name("milliseconds"), "set header read timeout")  //
+        ("body-timeout", po::value(&args.body_timeout)->value_name("milliseconds"), "set body read timeout")       //
+        ("idle-timeout", po::value(&args.idle_timeout)->value_name("milliseconds"), "set keep-alive idle timeout") //
+        ("max-api-queue", po::value(&args.max_api_queue)->value_name("count"), "set max queued API requests")     //
+        ("stats-period", po::value(&args.stats_period)->value_name("milliseconds"), "set stats logging period");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -45,6 +88,14 @@ struct Args {
         return std::nullopt;
     }
 
+    if (args.gzip_level < 0 || args.gzip_level > 9) {
+        throw std::runtime_error("--gzip-level must be in range 0-9");
+    }
+
+    if (vm.contains("wal-file") && !vm.contains("state-file")) {
+        throw std::runtime_error("--wal-file requires --state-file");
+    }
+
     if (vm.contains("config-file") && vm.contains("www-root")) {
         return args;
     } else {
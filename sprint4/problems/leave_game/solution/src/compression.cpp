@@ -0,0 +1,140 @@
+#include "compression.h"
+#include "negotiation.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <ctime>
+#include <optional>
+
+namespace http_handler {
+
+    namespace io = boost::iostreams;
+
+    namespace {
+
+        uint64_t ThreadCpuTimeUs() {
+            timespec ts{};
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1'000'000 + static_cast<uint64_t>(ts.tv_nsec) / 1'000;
+        }
+
+    }  // namespace
+
+    std::string Gzip(std::string_view data, int level) {
+        std::string result;
+        result.reserve(data.size() / 4);
+        {
+            io::filtering_ostream out;
+            out.push(io::gzip_compressor(io::gzip_params(level)));
+            out.push(io::back_inserter(result));
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }  // Поток дописывает хвост gzip при закрытии
+
+        return result;
+    }
+
+    bool AcceptsGzip(std::string_view accept_encoding) {
+        // Явный вес gzip важнее веса "*", в каком бы порядке они ни шли
+        std::optional<double> gzip_quality;
+        std::optional<double> any_quality;
+        ForEachWeightedValue(accept_encoding, [&gzip_quality, &any_quality](const WeightedValue& coding) {
+            if (boost::iequals(coding.value, "gzip"sv)) {
+                gzip_quality = coding.quality;
+            } else if (coding.value == "*"sv) {
+                any_quality = coding.quality;
+            }
+        });
+
+        return gzip_quality.value_or(any_quality.value_or(0.)) > 0.;
+    }
+
+    ResponseCompressor::ResponseCompressor(CompressionSettings settings)
+        : settings_(settings) {
+    }
+
+    void ResponseCompressor::Compress(const StringRequest& req, StringResponse& response) {
+        if (ShouldCompress(req, response.base(), response.body().size())) {
+            SetCompressedBody(response, Gzip(response.body()));
+        }
+    }
+
+    void ResponseCompressor::Compress(const StringRequest& req, SharedResponse& response) {
+        if (ShouldCompress(req, response.base(), SharedStringBody::size(response.body()))) {
+            SetCompressedBody(response, MakeSharedBuffer(Gzip(*response.body())));
+        }
+    }
+
+    void ResponseCompressor::Compress(const StringRequest& req, SharedResponse& response, 
+                                      const CompressionKey& key, uint64_t version) {
+        if (!ShouldCompress(req, response.base(), SharedStringBody::size(response.body()))) {
+            return;
+        }
+
+        auto it = cache_.find(key);
+        if (it != cache_.end() && it->second.version == version) {
+            ++stats_.cache_hits;
+            SetCompressedBody(response, it->second.compressed);
+            return;
+        }
+
+        if (it == cache_.end()) {
+            if (cache_.size() >= CACHE_CAPACITY) {
+                cache_.erase(cache_order_.front());
+                cache_order_.pop_front();
+            }
+            cache_order_.push_back(key);
+            it = cache_.emplace(key, Entry{}).first;
+        }
+        it->second = Entry{version, MakeSharedBuffer(Gzip(*response.body()))};
+
+        SetCompressedBody(response, it->second.compressed);
+    }
+
+    bool ResponseCompressor::ShouldCompress(const StringRequest& req, const Fields& headers, 
+                                            size_t body_size) const {
+        if (settings_.level <= 0 || body_size < settings_.min_size 
+            || headers.find(http::field::content_encoding) != headers.end()) {
+            return false;
+        }
+
+        auto accept_encoding = req.base().find(http::field::accept_encoding);
+        return accept_encoding != req.base().end() && AcceptsGzip(accept_encoding->value());
+    }
+
+    std::string ResponseCompressor::Gzip(std::string_view body) {
+        const uint64_t start_us = ThreadCpuTimeUs();
+        std::string compressed = http_handler::Gzip(body, settings_.level);
+        stats_.cpu_us += ThreadCpuTimeUs() - start_us;
+        ++stats_.compressed;
+        stats_.input_bytes += body.size();
+        stats_.output_bytes += compressed.size();
+
+        return compressed;
+    }
+
+    void ResponseCompressor::SetCompressedBody(StringResponse& response, std::string body) {
+        response.body().assign(body);
+        SetGzipHeaders(response.base(), response.body().size());
+    }
+
+    void ResponseCompressor::SetCompressedBody(SharedResponse& response, SharedBuffer body) {
+        response.body() = std::move(body);
+        SetGzipHeaders(response.base(), SharedStringBody::size(response.body()));
+    }
+
+    void ResponseCompressor::SetGzipHeaders(Fields& headers, size_t body_size) {
+        headers.set(http::field::content_length, std::to_string(body_size));
+        headers.set(http::field::content_encoding, "gzip"sv);
+
+        auto vary = headers.find(http::field::vary);
+        if (vary == headers.end()) {
+            headers.set(http::field::vary, "Accept-Encoding"sv);
+        } else {
+            headers.set(http::field::vary, std::string(vary->value()) + ", Accept-Encoding");
+        }
+    }
+
+}  // namespace http_handler
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "sdk.h"
+#include "type_declarations.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http_handler {
+
+    struct CompressionSettings {
+        // Уровень gzip от 1 до 9, 0 отключает сжатие
+        int level = 6;
+        // Тела меньшего размера отправляются как есть
+        size_t min_size = 1024;
+    };
+
+    struct CompressionStats {
+        uint64_t compressed = 0;
+        uint64_t cache_hits = 0;
+        uint64_t input_bytes = 0;
+        uint64_t output_bytes = 0;
+        // Процессорное время, потраченное на сжатие
+        uint64_t cpu_us = 0;
+    };
+
+    std::string Gzip(std::string_view data, int level);
+
+    // Разбирает Accept-Encoding: gzip допустим, если он указан с ненулевым весом.
+    // Если gzip не указан явно, решает вес "*"
+    bool AcceptsGzip(std::string_view accept_encoding);
+
+    // Что содержит тело ответа. Сжатое тело кэшируется по ключу вместе с версией содержимого
+    struct CompressionKey {
+        enum class Kind : uint8_t { MAP, STATE };
+
+        Kind kind;
+        // Map::Handle для карты, id сессии для состояния
+        uint64_t id;
+        BodyEncoding encoding;
+
+        bool operator==(const CompressionKey&) const = default;
+    };
+
+    struct CompressionKeyHasher {
+        size_t operator()(const CompressionKey& key) const noexcept {
+            return std::hash<uint64_t>{}(key.id * 4 + static_cast<uint64_t>(key.kind) * 2 
+                                         + static_cast<uint64_t>(key.encoding));
+        }
+    };
+
+    // Сжимает тела ответов API. Тела, для которых известен ключ, сжимаются один раз на версию:
+    // неизменные карты - один раз за время работы, состояние сессии - один раз на версию состояния
+    // для всех её игроков. Вызывается только на стренде API
+    class ResponseCompressor {
+    public:
+        explicit ResponseCompressor(CompressionSettings settings = {});
+
+        // Сжимает тело без кэширования
+        void Compress(const StringRequest& req, StringResponse& response);
+        // Общий буфер не меняется: ответ получает новый буфер со сжатым телом
+        void Compress(const StringRequest& req, SharedResponse& response);
+        // Все ответы с одной версией тела получают один общий сжатый буфер
+        void Compress(const StringRequest& req, SharedResponse& response, 
+                      const CompressionKey& key, uint64_t version);
+
+        const CompressionStats& GetStats() const noexcept { return stats_; }
+
+    private:
+        static constexpr size_t CACHE_CAPACITY = 4096;
+
+        struct Entry {
+            uint64_t version = 0;
+            SharedBuffer compressed;
+        };
+
+        bool ShouldCompress(const StringRequest& req, const Fields& headers, size_t body_size) const;
+        std::string Gzip(std::string_view body);
+        static void SetCompressedBody(StringResponse& response, std::string body);
+        static void SetCompressedBody(SharedResponse& response, SharedBuffer body);
+        static void SetGzipHeaders(Fields& headers, size_t body_size);
+
+        CompressionSettings settings_;
+        std::unordered_map<CompressionKey, Entry, CompressionKeyHasher> cache_;
+        // Порядок добавления записей в кэш, первыми вытесняются самые старые
+        std::deque<CompressionKey> cache_order_;
+        CompressionStats stats_;
+    };
+
+}  // namespace http_handler
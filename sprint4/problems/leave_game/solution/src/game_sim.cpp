@@ -0,0 +1,280 @@
+#include "sdk.h"
+#include "application.h"
+#include "journal.h"
+#include "json_loader.h"
+#include "model.h"
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/program_options.hpp>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Headless-симулятор: грузит конфиг, создаёт синтетических игроков и гоняет
+ * model::GameEngine::Tick без HTTP настолько быстро, насколько это возможно.
+ * Нужен для оценки того, сколько собак и карт выдерживает один сервер.
+ * Умеет записывать журнал входных воздействий и воспроизводить журнал, записанный сервером.
+ */
+
+using namespace std::literals;
+namespace net = boost::asio;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct SimArgs {
+        std::string config;
+        unsigned players = 100;
+        unsigned seconds = 60;
+        unsigned period = 50;
+        unsigned threads = 1;
+        unsigned turn_period = 20;
+        std::string movement = "random"s;
+        unsigned seed = 42;
+        std::string record;
+        std::string replay;
+    };
+
+    [[nodiscard]] std::optional<SimArgs> ParseSimCommandLine(int argc, const char* const argv[]) {
+        namespace po = boost::program_options;
+
+        po::options_description desc{"All options"s};
+        SimArgs args;
+
+        desc.add_options()                                                                                             //
+            ("help,h", "produce help message")                                                                         //
+            ("config-file,c", po::value(&args.config)->value_name("file"), "set config file path")                     //
+            ("players,p", po::value(&args.players)->value_name("count"), "number of synthetic players")               //
+            ("seconds,s", po::value(&args.seconds)->value_name("seconds"), "simulated time")                          //
+            ("tick-period,t", po::value(&args.period)->value_name("milliseconds"), "simulated tick period")           //
+            ("threads,j", po::value(&args.threads)->value_name("count"), "tick independent sessions on thread pool")  //
+            ("turn-period", po::value(&args.turn_period)->value_name("ticks"), "ticks between direction changes")     //
+            ("movement,m", po::value(&args.movement)->value_name("random|scripted"), "players movement mode")         //
+            ("seed", po::value(&args.seed)->value_name("number"), "seed for random movement")                        //
+            ("record", po::value(&args.record)->value_name("file"), "record simulation journal")                       //
+            ("replay", po::value(&args.replay)->value_name("file"), "replay journal instead of synthetic players");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.contains("help"s)) {
+            std::cout << desc;
+            return std::nullopt;
+        }
+
+        if (!vm.contains("config-file"s)) {
+            throw std::runtime_error("Usage: game_sim --config-file <game-config-json> [options]");
+        }
+
+        if (args.movement != "random"s && args.movement != "scripted"s) {
+            throw std::runtime_error("Unknown movement mode: "s + args.movement);
+        }
+
+        if (args.period == 0 || args.turn_period == 0) {
+            throw std::runtime_error("Tick period and turn period must be positive");
+        }
+
+        return args;
+    }
+
+    // Синтетический игрок: токен и номер шага в сценарии движения
+    struct Bot {
+        app::Token token;
+        size_t step = 0;
+    };
+
+    const std::array<model::Move, 5> DIRECTIONS{model::Move::LEFT, model::Move::UP, model::Move::RIGHT, 
+                                                model::Move::DOWN, model::Move::STOP};
+
+    class MovementScript {
+    public:
+        MovementScript(bool random, unsigned seed)
+            : random_(random)
+            , generator_(seed) {
+        }
+
+        // Сценарий обходит направления по кругу, случайный режим выбирает любое из них
+        model::Move NextDirection(Bot& bot) {
+            if (random_) {
+                std::uniform_int_distribution<size_t> dist(0, DIRECTIONS.size() - 1);
+                return DIRECTIONS[dist(generator_)];
+            }
+
+            return DIRECTIONS[bot.step++ % (DIRECTIONS.size() - 1)];
+        }
+
+    private:
+        bool random_;
+        std::mt19937 generator_;
+    };
+
+    std::vector<Bot> SpawnBots(model::Game& game, app::Application& app, unsigned players) {
+        const auto& maps = game.GetMapService().GetMaps();
+        if (maps.empty()) {
+            throw std::runtime_error("Config has no maps");
+        }
+
+        std::vector<Bot> bots;
+        bots.reserve(players);
+        for (unsigned i = 0; i < players; ++i) {
+            // Игроки распределяются по картам равномерно
+            const auto& map = maps[i % maps.size()];
+            auto session = game.GetSessionService().FindGameSession(map.GetHandle());
+            auto dog = std::make_shared<model::Dog>("bot_"s + std::to_string(i));
+            bots.push_back({app.AddPlayer(dog, session)});
+        }
+
+        return bots;
+    }
+
+    long MaxRssKb() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        // В Linux ru_maxrss измеряется в килобайтах
+        return usage.ru_maxrss;
+    }
+
+    int Replay(const SimArgs& args) {
+        model::Game game = json_loader::LoadGame(args.config);
+        journal::Replayer replayer(game);
+
+        const journal::ReplayStats stats = replayer.Replay(args.replay);
+        const double seconds = std::chrono::duration<double>(stats.duration).count();
+
+        std::cout << "records:          " << stats.records << '\n'
+                  << "ticks:            " << stats.ticks << '\n'
+                  << "wall time:        " << seconds << " s" << '\n'
+                  << "ticks/second:     " << (seconds > 0 ? stats.ticks / seconds : 0) << '\n'
+                  << "state digest:     " << std::hex << journal::StateDigest(game) << std::dec << '\n'
+                  << "max RSS:          " << MaxRssKb() << " KiB" << std::endl;
+
+        return EXIT_SUCCESS;
+    }
+
+    double Percentile(std::vector<double> values, double fraction) {
+        if (values.empty()) {
+            return 0;
+        }
+
+        const size_t index = std::min(values.size() - 1,
+                                      static_cast<size_t>(fraction * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    SimArgs args;
+    try {
+        if (auto parsed = ParseSimCommandLine(argc, argv)) {
+            args = *parsed;
+        } else {
+            return EXIT_SUCCESS;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Parse arguments failure. " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        if (!args.replay.empty()) {
+            return Replay(args);
+        }
+
+        model::Game game = json_loader::LoadGame(args.config);
+        app::Application app(game);
+
+        std::unique_ptr<journal::Recorder> recorder;
+        if (!args.record.empty()) {
+            recorder = std::make_unique<journal::Recorder>(game, args.record);
+            app.AddApplicationListener(*recorder);
+        }
+
+        std::vector<Bot> bots = SpawnBots(game, app, args.players);
+        MovementScript script(args.movement == "random"s, args.seed);
+
+        net::thread_pool pool(std::max(1u, args.threads));
+        model::SessionService::ParallelFor parallel_for =
+            [&pool](size_t count, const std::function<void(size_t)>& fn) {
+                std::latch done(static_cast<std::ptrdiff_t>(count));
+                // Первое исключение из тика сессии пробрасывается после того,
+                // как отработают все задачи: иначе latch не дождался бы упавшей
+                std::mutex error_mutex;
+                std::exception_ptr error;
+                for (size_t i = 0; i < count; ++i) {
+                    net::post(pool, [&fn, &done, &error_mutex, &error, i] {
+                        try {
+                            fn(i);
+                        } catch (...) {
+                            std::lock_guard lock(error_mutex);
+                            if (!error) {
+                                error = std::current_exception();
+                            }
+                        }
+                        done.count_down();
+                    });
+                }
+                done.wait();
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            };
+
+        const std::chrono::milliseconds period{args.period};
+        const uint64_t ticks = static_cast<uint64_t>(args.seconds) * 1000 / args.period;
+
+        std::vector<double> tick_times_us;
+        tick_times_us.reserve(ticks);
+
+        const auto start = Clock::now();
+        for (uint64_t tick = 0; tick < ticks; ++tick) {
+            if (tick % args.turn_period == 0) {
+                for (auto& bot : bots) {
+                    app.MovePlayer(bot.token, script.NextDirection(bot));
+                }
+            }
+
+            const auto tick_start = Clock::now();
+            if (args.threads > 1) {
+                app.Tick(period, parallel_for);
+            } else {
+                app.Tick(period);
+            }
+            tick_times_us.push_back(
+                std::chrono::duration<double, std::micro>(Clock::now() - tick_start).count());
+        }
+        const double wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        pool.join();
+
+        std::cout << "players:          " << args.players << '\n'
+                  << "maps:             " << game.GetMapService().GetMaps().size() << '\n'
+                  << "threads:          " << std::max(1u, args.threads) << '\n'
+                  << "simulated:        " << args.seconds << " s (" << ticks << " ticks)" << '\n'
+                  << "wall time:        " << wall_seconds << " s" << '\n'
+                  << "ticks/second:     " << (wall_seconds > 0 ? ticks / wall_seconds : 0) << '\n'
+                  << "p50 tick time:    " << Percentile(tick_times_us, 0.50) << " us" << '\n'
+                  << "p99 tick time:    " << Percentile(tick_times_us, 0.99) << " us" << '\n'
+                  << "state digest:     " << std::hex << journal::StateDigest(game) << std::dec << '\n'
+                  << "max RSS:          " << MaxRssKb() << " KiB" << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << "Simulation failed: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -4,7 +4,8 @@ HTTPResponseMaker::HTTPResponseMaker(std::function<ResponseMaker> handler)
     : handler_(std::move(handler)) {
 }
 
-http_handler::StringResponse HTTPResponseMaker::Invoke(const http_handler::StringRequest& req, 
-                                                       JsonResponseHandler json_response) {
-    return handler_(req, json_response);
+http_handler::ResponseVariant HTTPResponseMaker::Invoke(const http_handler::StringRequest& req, 
+                                                        RouteParams params,
+                                                        JsonResponseHandler json_response) {
+    return handler_(req, params, json_response);
 }
\ No newline at end of file
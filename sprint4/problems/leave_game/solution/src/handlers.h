@@ -5,6 +5,7 @@
 
 #include <boost/beast/http.hpp>
 #include <functional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <any>
@@ -15,21 +16,26 @@ namespace http = beast::http;
 using JsonResponseHandler = 
         std::function<http_handler::StringResponse(http::status, std::string, std::string_view)>;
 
+// Значения параметров пути в порядке следования, ссылаются на цель запроса
+using RouteParams = std::span<const std::string_view>;
+
 class HandlerBase {
 public:
     virtual ~HandlerBase() = default;
-    virtual http_handler::StringResponse Invoke(const http_handler::StringRequest& req, 
+    virtual http_handler::ResponseVariant Invoke(const http_handler::StringRequest& req, 
+                                                 RouteParams params,
                                                  JsonResponseHandler json_response) = 0;
 };
 
 class HTTPResponseMaker : public HandlerBase {
-    using ResponseMaker = http_handler::StringResponse(const http_handler::StringRequest&, 
-                                                        JsonResponseHandler);
+    using ResponseMaker = http_handler::ResponseVariant(const http_handler::StringRequest&, 
+                                                        RouteParams, JsonResponseHandler);
 public:
     HTTPResponseMaker(std::function<ResponseMaker> handler);
 
-    http_handler::StringResponse Invoke(const http_handler::StringRequest& req, 
-                                                 JsonResponseHandler json_response) override;
+    http_handler::ResponseVariant Invoke(const http_handler::StringRequest& req, 
+                                         RouteParams params,
+                                         JsonResponseHandler json_response) override;
 
 private:
     std::function<ResponseMaker> handler_;
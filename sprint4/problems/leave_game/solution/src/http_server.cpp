@@ -3,62 +3,217 @@
 
 #include <boost/asio/dispatch.hpp>
 
+#include <algorithm>
+#include <cstdint>
+
 namespace http_server {
+
 //  SessionBase fucn members
 
     void ReportError(beast::error_code ec, std::string_view where) {
         ServerErrorLog(ec.value(), ec.what(), where);
 	}
 
+    bool ConnectionLimiter::TryAcquire() noexcept {
+        if (active_.fetch_add(1, std::memory_order_relaxed) >= limits_.max_connections) {
+            active_.fetch_sub(1, std::memory_order_relaxed);
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    void ConnectionLimiter::Release() noexcept {
+        active_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    ConnectionStats ConnectionLimiter::GetStats() const noexcept {
+        return {active_.load(std::memory_order_relaxed), 
+                rejected_.load(std::memory_order_relaxed), 
+                timeouts_.load(std::memory_order_relaxed)};
+    }
+
+    void* HandlerMemory::Allocate(std::size_t size) {
+        if (size <= BLOCK_SIZE) {
+            for (std::size_t i = 0; i < BLOCKS_COUNT; ++i) {
+                if (!in_use_[i].exchange(true, std::memory_order_acquire)) {
+                    return blocks_[i].data;
+                }
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void HandlerMemory::Deallocate(void* pointer) noexcept {
+        const auto address = reinterpret_cast<std::uintptr_t>(pointer);
+        const auto begin = reinterpret_cast<std::uintptr_t>(blocks_.data());
+        if (address >= begin && address < begin + sizeof(blocks_)) {
+            in_use_[(address - begin) / sizeof(Block)].store(false, std::memory_order_release);
+            return;
+        }
+        ::operator delete(pointer);
+    }
+
     void SessionBase::Run() {
-        // Вызываем метод Read, используя executor объекта stream_.
+        // Вызываем метод Start, используя executor объекта stream_.
         // Таким образом вся работа со stream_ будет выполняться, используя его executor
         net::dispatch(stream_.get_executor(),
-                    beast::bind_front_handler(&SessionBase::Read, GetSharedThis()));
+                    beast::bind_front_handler(&SessionBase::Start, GetSharedThis()));
     }
 
-    SessionBase::SessionBase(tcp::socket&& socket)
-        : stream_(std::move(socket)) {
+    SessionBase::SessionBase(tcp::socket&& socket, std::shared_ptr<ConnectionLimiter> limiter)
+        : stream_(std::move(socket))
+        , limiter_(std::move(limiter))
+        , watchdog_(stream_.get_executor()) {
+        // Первой со стека берётся арена 0
+        for (size_t i = 0; i < MAX_PIPELINED_REQUESTS; ++i) {
+            free_arenas_[i] = static_cast<uint8_t>(MAX_PIPELINED_REQUESTS - 1 - i);
+        }
+
+        sys::error_code ec;
+        const tcp::endpoint remote = stream_.socket().remote_endpoint(ec);
+        if (!ec) {
+            remote_address_ = remote.address();
+        }
+    }
+
+    SessionBase::~SessionBase() {
+        limiter_->Release();
+    }
+
+    bool SessionBase::BeginRead() {
+        if (reading_ || read_closed_ || closed_ 
+            || requests_read_ - responses_written_ >= MAX_PIPELINED_REQUESTS) {
+            return false;
+        }
+
+        reading_ = true;
+        // Запрос и ответ на него размещаются в свободной арене, место в конвейере гарантирует,
+        // что она есть
+        const uint8_t arena = free_arenas_[--free_arenas_count_];
+        request_arenas_[requests_read_ % MAX_PIPELINED_REQUESTS] = arena;
+        const http_handler::ArenaAllocator<char> allocator(&arenas_[arena]);
+        // Новый парсер для каждого запроса
+        parser_.emplace(std::piecewise_construct, std::make_tuple(allocator), std::make_tuple(allocator));
+        const ServerLimits& limits = limiter_->GetLimits();
+        SetReadDeadline(requests_read_ == 0 ? limits.header_timeout : limits.idle_timeout);
+        return true;
     }
 
-    void SessionBase::Read() {
+    void SessionBase::BeginReadBody() {
+        SetReadDeadline(limiter_->GetLimits().body_timeout);
+    }
+
+    bool SessionBase::FinishRead(beast::error_code ec) {
         using namespace std::literals;
-        // Очищаем запрос от прежнего значения (метод Read может быть вызван несколько раз)
-        request_ = {};
-        stream_.expires_after(30s);
-        // Считываем request_ из stream_, используя buffer_ для хранения считанных данных
-        http::async_read(stream_, buffer_, request_,
-                        // По окончании операции будет вызван метод OnRead
-                        beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis()));
+        reading_ = false;
+        StopWatchdogIfIdle();
+
+        if (ec && timed_out_) {
+            // Сокет уже закрыт сторожевым таймером
+            Stop();
+            return false;
+        }
+        if (ec == http::error::end_of_stream) {
+            // Нормальная ситуация - клиент закрыл соединение. Ответы на прочитанные запросы отправляются
+            read_closed_ = true;
+            CloseIfDone();
+            return false;
+        }
+        if (ec) {
+            Stop();
+            ReportError(ec, "read"sv);
+            return false;
+        }
+        if (closed_) {
+            return false;
+        }
+
+        HttpRequest request = parser_->release();
+        parser_.reset();
+        // После запроса с Connection: close следующие запросы не читаются
+        read_closed_ = !request.keep_alive();
+        detail::handling_session = this;
+        HandleRequest(requests_read_++, std::move(request));
+        detail::handling_session = nullptr;
+        return !read_closed_;
+    }
+
+    http_handler::ResponseVariant* SessionBase::BeginWrite() {
+        auto& response = responses_[responses_written_ % MAX_PIPELINED_REQUESTS];
+        if (closed_ || !response) {
+            // Ответ на более ранний запрос ещё не готов
+            return nullptr;
+        }
+
+        writing_ = true;
+        SetWriteDeadline(limiter_->GetLimits().body_timeout);
+        // Ответ остаётся в кольце до завершения записи
+        return &*response;
     }
 
-    void SessionBase::OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+    bool SessionBase::FinishWrite(bool close, beast::error_code ec) {
+        using namespace std::literals;
+        writing_ = false;
+        const size_t slot = responses_written_ % MAX_PIPELINED_REQUESTS;
+        responses_[slot].reset();
+        // Ответ уничтожен, арена его запроса возвращается на стек
+        arenas_[request_arenas_[slot]].Reset();
+        free_arenas_[free_arenas_count_++] = request_arenas_[slot];
+        ++responses_written_;
+        StopWatchdogIfIdle();
+
         if (ec) {
-            return ReportError(ec, "write"sv);
+            Stop();
+            ReportError(timed_out_ ? beast::error::timeout : ec, "write"sv);
+            return false;
         }
 
         if (close) {
             // Семантика ответа требует закрыть соединение
-            return Close();
+            Close();
+            return false;
         }
+        return !closed_;
+    }
 
-        // Считываем следующий запрос
-        Read();
+    void SessionBase::Deliver(uint64_t request_index, http_handler::ResponseVariant&& response) {
+        // Обработчики файлов и ошибок отвечают сразу, внутри HandleRequest на стренде сессии
+        if (detail::handling_session == this) {
+            return OnResponse(request_index, std::move(response));
+        }
+
+        // Ответы API приходят со стренда API, а сокет принадлежит стренду сессии
+        net::dispatch(stream_.get_executor(), MakeAllocHandler(handler_memory_,
+                      [self = GetSharedThis(), request_index, response = std::move(response)]() mutable {
+                          self->OnResponse(request_index, std::move(response));
+                      }));
     }
 
-    void SessionBase::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
-        using namespace std::literals;
-        if (ec == http::error::end_of_stream) {
-            // Нормальная ситуация - клиент закрыл соединение
-            return Close();
+    void SessionBase::OnResponse(uint64_t request_index, http_handler::ResponseVariant&& response) {
+        if (closed_) {
+            return;
         }
-        if (ec) {
-            return ReportError(ec, "read"sv);
+
+        responses_[request_index % MAX_PIPELINED_REQUESTS] = std::move(response);
+        if (request_index == responses_written_) {
+            OnResponseReady();
+        }
+    }
+
+    void SessionBase::CloseIfDone() {
+        if (read_closed_ && !writing_ && responses_written_ == requests_read_) {
+            Close();
         }
-        HandleRequest(std::move(request_));
     }
 
     void SessionBase::Close() {
+        using namespace std::literals;
+        if (closed_) {
+            return;
+        }
+        Stop();
+
         beast::error_code ec;
         stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
 
@@ -67,6 +222,220 @@ namespace http_server {
         }
     }
 
+    void SessionBase::Stop() {
+        closed_ = true;
+        StopWatchdogIfIdle();
+    }
+
+    void SessionBase::StopWatchdogIfIdle() {
+        // Начатые операции по-прежнему ограничены сроками, даже если соединение закрывается
+        if (closed_ && !reading_ && !writing_) {
+            watchdog_.cancel();
+        }
+    }
+
+    void SessionBase::SetReadDeadline(std::chrono::milliseconds timeout) {
+        read_deadline_ = std::chrono::steady_clock::now() + timeout;
+        WatchDeadline(read_deadline_);
+    }
+
+    void SessionBase::SetWriteDeadline(std::chrono::milliseconds timeout) {
+        write_deadline_ = std::chrono::steady_clock::now() + timeout;
+        WatchDeadline(write_deadline_);
+    }
+
+    void SessionBase::WatchDeadline(std::chrono::steady_clock::time_point deadline) {
+        if (!watchdog_waiting_) {
+            return WaitDeadline();
+        }
+        if (deadline < watchdog_.expiry()) {
+            // OnDeadline переставит таймер на более ранний срок
+            watchdog_.cancel();
+        }
+    }
+
+    void SessionBase::WaitDeadline() {
+        constexpr auto never = std::chrono::steady_clock::time_point::max();
+        const auto deadline = std::min(reading_ ? read_deadline_ : never, writing_ ? write_deadline_ : never);
+        if (deadline == never) {
+            // Срок задаст следующая операция
+            return;
+        }
+
+        watchdog_waiting_ = true;
+        watchdog_.expires_at(deadline);
+        watchdog_.async_wait(MakeAllocHandler(handler_memory_,
+                beast::bind_front_handler(&SessionBase::OnDeadline, GetSharedThis())));
+    }
+
+    void SessionBase::OnDeadline([[maybe_unused]] beast::error_code ec) {
+        watchdog_waiting_ = false;
+
+        const auto now = std::chrono::steady_clock::now();
+        if ((reading_ && read_deadline_ <= now) || (writing_ && write_deadline_ <= now)) {
+            // Закрытие сокета прерывает операции, и они завершатся с ошибкой
+            timed_out_ = true;
+            limiter_->OnTimeout();
+            beast::error_code ignored;
+            stream_.socket().close(ignored);
+            return;
+        }
+
+        WaitDeadline();
+    }
+
+//  CallbackSessionBase func members
+
+    void CallbackSessionBase::Start() {
+        Read();
+    }
+
+    void CallbackSessionBase::OnResponseReady() {
+        if (!IsWriting()) {
+            WriteNext();
+        }
+    }
+
+    void CallbackSessionBase::Read() {
+        if (!BeginRead()) {
+            // Чтение продолжит OnWrite, когда в конвейере освободится место
+            return;
+        }
+
+        // Считываем заголовки запроса из stream_, используя buffer_ для хранения считанных данных
+        http::async_read_header(stream_, buffer_, *parser_, MakeAllocHandler(handler_memory_,
+                        beast::bind_front_handler(&CallbackSessionBase::OnReadHeader, GetSharedCallbackSession())));
+    }
+
+    void CallbackSessionBase::OnReadHeader(beast::error_code ec, std::size_t bytes_read) {
+        if (ec || parser_->is_done()) {
+            // У запроса без тела (GET, HEAD) чтение тела завершилось бы сразу,
+            // но его обработчик всё равно ушёл бы в очередь executor-а
+            return OnRead(ec, bytes_read);
+        }
+
+        BeginReadBody();
+        // По окончании чтения тела будет вызван метод OnRead
+        http::async_read(stream_, buffer_, *parser_, MakeAllocHandler(handler_memory_,
+                        beast::bind_front_handler(&CallbackSessionBase::OnRead, GetSharedCallbackSession())));
+    }
+
+    void CallbackSessionBase::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+        if (FinishRead(ec)) {
+            Read();
+        }
+    }
+
+    void CallbackSessionBase::WriteNext() {
+        auto* response = BeginWrite();
+        if (!response) {
+            return;
+        }
+
+        std::visit([this](auto& message) {
+            http::async_write(stream_, message, MakeAllocHandler(handler_memory_,
+                    beast::bind_front_handler(&CallbackSessionBase::OnWrite, GetSharedCallbackSession(), 
+                                              message.need_eof())));
+        }, *response);
+    }
+
+    void CallbackSessionBase::OnWrite(bool close, beast::error_code ec, 
+                                      [[maybe_unused]] std::size_t bytes_written) {
+        if (!FinishWrite(close, ec)) {
+            return;
+        }
+
+        WriteNext();
+        // Считываем следующий запрос, если чтение ждало места в конвейере
+        Read();
+        CloseIfDone();
+    }
+
+//  CoroutineSessionBase func members
+
+    void SessionTask::promise_type::operator delete(void* frame, std::size_t) noexcept {
+        auto* memory = static_cast<HandlerMemory**>(frame) - 1;
+        (*memory)->Deallocate(memory);
+    }
+
+    void* SessionTask::AllocateFrame(HandlerMemory& memory, std::size_t size) {
+        // Перед кадром хранится память, в которую его нужно вернуть
+        static_assert(sizeof(HandlerMemory*) <= alignof(std::max_align_t));
+        auto* block = static_cast<std::byte*>(memory.Allocate(size + alignof(std::max_align_t)));
+        auto* frame = block + alignof(std::max_align_t);
+        *(reinterpret_cast<HandlerMemory**>(frame) - 1) = &memory;
+        return frame;
+    }
+
+    CoroutineSessionBase::CoroutineSessionBase(tcp::socket&& socket, std::shared_ptr<ConnectionLimiter> limiter)
+        : SessionBase(std::move(socket), std::move(limiter)) {
+    }
+
+    void CoroutineSessionBase::Start() {
+        ReadRequests();
+        WriteResponses();
+    }
+
+    void CoroutineSessionBase::OnResponseReady() {
+        response_ready_.Wake();
+    }
+
+    SessionTask CoroutineSessionBase::ReadRequests() {
+        while (!IsReadClosed()) {
+            if (!BeginRead()) {
+                // Конвейер заполнен, место освободит запись ответа
+                co_await pipeline_space_.Wait();
+                continue;
+            }
+
+            beast::error_code ec = co_await Operation([this](auto handler) {
+                http::async_read_header(stream_, buffer_, *parser_, std::move(handler));
+            });
+            // У запроса без тела чтение тела завершилось бы сразу, но через очередь executor-а
+            if (!ec && !parser_->is_done()) {
+                BeginReadBody();
+                ec = co_await Operation([this](auto handler) {
+                    http::async_read(stream_, buffer_, *parser_, std::move(handler));
+                });
+            }
+            if (!FinishRead(ec)) {
+                break;
+            }
+        }
+
+        // Запись решит, закрывать ли соединение
+        response_ready_.Wake();
+    }
+
+    SessionTask CoroutineSessionBase::WriteResponses() {
+        while (true) {
+            if (auto* response = BeginWrite()) {
+                const bool close = std::visit([](const auto& message) { 
+                    return message.need_eof(); 
+                }, *response);
+                const beast::error_code ec = co_await Operation([this, response](auto handler) {
+                    std::visit([this, &handler](auto& message) {
+                        http::async_write(stream_, message, std::move(handler));
+                    }, *response);
+                });
+                if (!FinishWrite(close, ec)) {
+                    break;
+                }
+
+                pipeline_space_.Wake();
+                continue;
+            }
+
+            CloseIfDone();
+            if (IsClosed()) {
+                break;
+            }
+            co_await response_ready_.Wait();
+        }
+
+        // Чтение, ждущее места в конвейере, завершится
+        pipeline_space_.Wake();
+    }
 
 //  Session func members
 
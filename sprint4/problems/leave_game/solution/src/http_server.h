@@ -4,13 +4,23 @@
 #include "log.h"
 #include "type_declarations.h"
 
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/http/serializer.hpp>
 #include <boost/system.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <utility>
 #include <variant>
 
 namespace http_server {
@@ -23,6 +33,141 @@ namespace http_server {
 
     void ReportError(beast::error_code ec, std::string_view what);
 
+    struct ServerLimits {
+        // Соединения сверх лимита закрываются сразу после принятия
+        size_t max_connections = 10'000;
+        // Ожидание заголовков первого запроса соединения
+        std::chrono::milliseconds header_timeout = 10s;
+        // Чтение тела запроса после получения заголовков
+        std::chrono::milliseconds body_timeout = 30s;
+        // Ожидание следующего запроса на keep-alive соединении вместе с его заголовками
+        std::chrono::milliseconds idle_timeout = 60s;
+    };
+
+    struct ConnectionStats {
+        uint64_t active = 0;
+        uint64_t rejected = 0;
+        uint64_t timeouts = 0;
+    };
+
+    // Учёт открытых соединений, общий для слушателя и всех сессий
+    class ConnectionLimiter {
+    public:
+        explicit ConnectionLimiter(ServerLimits limits = {}) : limits_(limits) {}
+
+        const ServerLimits& GetLimits() const noexcept { return limits_; }
+
+        // Возвращает false, если открыто максимальное число соединений
+        bool TryAcquire() noexcept;
+        void Release() noexcept;
+
+        void OnTimeout() noexcept { timeouts_.fetch_add(1, std::memory_order_relaxed); }
+
+        ConnectionStats GetStats() const noexcept;
+
+    private:
+        ServerLimits limits_;
+        std::atomic<size_t> active_{0};
+        std::atomic<uint64_t> rejected_{0};
+        std::atomic<uint64_t> timeouts_{0};
+    };
+
+    namespace detail {
+        // Сессия, обработчик запроса которой сейчас выполняется в этом потоке. Ответ, отправленный
+        // изнутри обработчика, уже находится на стренде сессии и не требует перехода на него
+        inline thread_local const void* handling_session = nullptr;
+    }
+
+    // Память под асинхронные операции сессии и передачу ответов со стренда API. Операции сессии
+    // идут по очереди, поэтому одновременно занято несколько блоков, и они переиспользуются
+    // от запроса к запросу. Крупные объекты и запросы сверх числа блоков размещаются в куче.
+    // Заголовки и тела запросов и ответов лежат в аренах сессии, а не здесь
+    class HandlerMemory {
+    public:
+        HandlerMemory() = default;
+        HandlerMemory(const HandlerMemory&) = delete;
+        HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+        void* Allocate(std::size_t size);
+        void Deallocate(void* pointer) noexcept;
+
+    private:
+        static constexpr std::size_t BLOCK_SIZE = 1024;
+        // Чтение, запись, передача ответа и ожидание сторожевого таймера
+        static constexpr std::size_t BLOCKS_COUNT = 5;
+
+        struct alignas(std::max_align_t) Block {
+            std::byte data[BLOCK_SIZE];
+        };
+
+        std::array<Block, BLOCKS_COUNT> blocks_;
+        // Ответ освобождается в потоке сессии, а следующий может выделяться на стренде API
+        std::array<std::atomic<bool>, BLOCKS_COUNT> in_use_{};
+    };
+
+    // Аллокатор, который Asio и Beast находят у обработчика через get_allocator
+    template <typename T>
+    class HandlerAllocator {
+    public:
+        using value_type = T;
+
+        explicit HandlerAllocator(HandlerMemory& memory) noexcept : memory_(&memory) {}
+
+        template <typename U>
+        HandlerAllocator(const HandlerAllocator<U>& other) noexcept : memory_(other.memory_) {}
+
+        T* allocate(std::size_t n) {
+            static_assert(alignof(T) <= alignof(std::max_align_t));
+            return static_cast<T*>(memory_->Allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T* pointer, std::size_t) noexcept {
+            memory_->Deallocate(pointer);
+        }
+
+        template <typename U>
+        bool operator==(const HandlerAllocator<U>& other) const noexcept {
+            return memory_ == other.memory_;
+        }
+
+    private:
+        template <typename>
+        friend class HandlerAllocator;
+
+        HandlerMemory* memory_;
+    };
+
+    template <typename Handler>
+    class AllocHandler {
+    public:
+        using allocator_type = HandlerAllocator<Handler>;
+
+        AllocHandler(HandlerMemory& memory, Handler handler)
+            : memory_(memory)
+            , handler_(std::move(handler)) {
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_type(memory_);
+        }
+
+        template <typename... Args>
+        void operator()(Args&&... args) {
+            handler_(std::forward<Args>(args)...);
+        }
+
+    private:
+        HandlerMemory& memory_;
+        Handler handler_;
+    };
+
+    template <typename Handler>
+    AllocHandler<std::decay_t<Handler>> MakeAllocHandler(HandlerMemory& memory, Handler&& handler) {
+        return AllocHandler<std::decay_t<Handler>>(memory, std::forward<Handler>(handler));
+    }
+
+    // Общая часть сессий: память обработчиков, арены запросов, кольцо конвейера и сторожевой
+    // таймер. Чтением и записью управляют наследники: цепочкой обработчиков или сопрограммами
     class SessionBase {
     public:
         // Запрещаем копирование и присваивание объектов SessionBase и его наследников
@@ -32,54 +177,327 @@ namespace http_server {
         void Run();
 
     protected:
-        explicit SessionBase(tcp::socket&& socket);
+        // Сессия занимает одно место в limiter и освобождает его при уничтожении
+        SessionBase(tcp::socket&& socket, std::shared_ptr<ConnectionLimiter> limiter);
+
+        using HttpRequest = http_handler::StringRequest;
+
+        // Передаёт ответ на запрос с номером request_index. Может вызываться из любого потока,
+        // ответы отправляются клиенту в порядке поступления запросов
+        void Deliver(uint64_t request_index, http_handler::ResponseVariant&& response);
+
+        // Адрес клиента, запомненный при принятии соединения
+        const net::ip::address& GetRemoteAddress() const noexcept { return remote_address_; }
 
-        template <typename Body, typename Fields>
-        void Write(http::response<Body, Fields>&& response);
+        ~SessionBase();
+
+        // Готовит чтение следующего запроса: арена, парсер и срок чтения заголовков.
+        // Возвращает false, если чтение уже идёт, читать больше нечего или конвейер заполнен
+        bool BeginRead();
+
+        void BeginReadBody();
+
+        // Передаёт прочитанный запрос обработчику. Возвращает false, если читать больше нечего
+        bool FinishRead(beast::error_code ec);
+
+        // Ответ, очередь которого подошла, или nullptr, если он ещё не готов
+        http_handler::ResponseVariant* BeginWrite();
+
+        // Освобождает место ответа в кольце. Возвращает false, если соединение закрыто
+        bool FinishWrite(bool close, beast::error_code ec);
+
+        // Соединение закрывается, когда клиент закончил передачу и все ответы отправлены
+        void CloseIfDone();
+
+        bool IsReadClosed() const noexcept { return read_closed_ || closed_; }
+
+        bool IsClosed() const noexcept { return closed_; }
+
+        bool IsWriting() const noexcept { return writing_; }
+
+        virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
 
-        using HttpRequest = http::request<http::string_body>;
+        // Объявлена первой, чтобы пережить всё, что в ней размещено
+        HandlerMemory handler_memory_;
 
-        ~SessionBase() = default;
-        
     private:
-        // tcp_stream содержит внутри себя сокет и добавляет поддержку таймаутов
+        // Конвейер HTTP/1.1: следующий запрос читается, пока предыдущие обрабатываются
+        // и отправляются. Ответы ждут своей очереди в кольце по номеру запроса
+        static constexpr size_t MAX_PIPELINED_REQUESTS = 8;
+
+        // Запрос и ответ на него занимают одну арену, пока ответ не записан. Свободные арены
+        // берутся со стека, поэтому без конвейера сессия обходится одной
+        std::array<http_handler::RequestArena, MAX_PIPELINED_REQUESTS> arenas_;
+        std::array<uint8_t, MAX_PIPELINED_REQUESTS> free_arenas_;
+        size_t free_arenas_count_ = MAX_PIPELINED_REQUESTS;
+        // Арена запроса по месту его ответа в кольце
+        std::array<uint8_t, MAX_PIPELINED_REQUESTS> request_arenas_{};
+
+    protected:
+        // Таймауты операций отслеживает сторожевой таймер сессии, а не tcp_stream:
+        // у таймера tcp_stream нет распределителя памяти, и каждая операция выделяла бы память в куче
         beast::tcp_stream stream_;
         beast::flat_buffer buffer_;
-        HttpRequest request_;
+        std::optional<http::request_parser<http_handler::StringBody, 
+                                           http_handler::ArenaAllocator<char>>> parser_;
+
+    private:
+        std::shared_ptr<ConnectionLimiter> limiter_;
+        net::ip::address remote_address_;
+
+        std::array<std::optional<http_handler::ResponseVariant>, MAX_PIPELINED_REQUESTS> responses_;
+        uint64_t requests_read_ = 0;
+        uint64_t responses_written_ = 0;
+        bool reading_ = false;
+        bool writing_ = false;
+        // Клиент закончил передачу или попросил закрыть соединение после ответа
+        bool read_closed_ = false;
+        bool closed_ = false;
+
+        // Сроки текущих операций чтения и записи. Таймер не переустанавливается на каждую
+        // операцию: сработав, он сверяется со сроками и ждёт дальше, если они отодвинулись
+        net::steady_timer watchdog_;
+        std::chrono::steady_clock::time_point read_deadline_;
+        std::chrono::steady_clock::time_point write_deadline_;
+        bool watchdog_waiting_ = false;
+        // Сокет закрыт сторожевым таймером, ошибка чтения означает таймаут
+        bool timed_out_ = false;
+
+        // Запускает чтение и запись на executor-е сокета
+        virtual void Start() = 0;
+
+        // Ответ, очередь которого подошла, положен в кольцо
+        virtual void OnResponseReady() = 0;
+
+        void OnResponse(uint64_t request_index, http_handler::ResponseVariant&& response);
+
+        void Close();
+
+        // Больше никаких операций с сокетом. Сторожевой таймер отменяется, когда завершатся начатые
+        void Stop();
+
+        // Ожидание таймера держит сессию, поэтому без операций его нужно отменить
+        void StopWatchdogIfIdle();
+
+        void SetReadDeadline(std::chrono::milliseconds timeout);
+
+        void SetWriteDeadline(std::chrono::milliseconds timeout);
+
+        void WatchDeadline(std::chrono::steady_clock::time_point deadline);
+
+        // Ждёт ближайшего срока идущих операций
+        void WaitDeadline();
+
+        void OnDeadline(beast::error_code ec);
+
+        // Обработку запроса делегируем подклассу
+        virtual void HandleRequest(uint64_t request_index, HttpRequest&& request) = 0;
+    };
+
+    // Сессия на цепочке обработчиков: каждая операция продолжается в обработчике завершения
+    // предыдущей. Заголовки и тело читаются отдельно, чтобы у каждого этапа был свой таймаут
+    class CallbackSessionBase : public SessionBase {
+    protected:
+        using SessionBase::SessionBase;
+
+    private:
+        std::shared_ptr<CallbackSessionBase> GetSharedCallbackSession() {
+            return std::static_pointer_cast<CallbackSessionBase>(GetSharedThis());
+        }
 
+        void Start() override;
+
+        void OnResponseReady() override;
+
+        // Чтение приостанавливается, пока конвейер заполнен, и продолжается из OnWrite
         void Read();
 
-        void OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written);
+        void OnReadHeader(beast::error_code ec, std::size_t bytes_read);
 
         void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read);
 
-        void Close();
+        void WriteNext();
 
-        // Обработку запроса делегируем подклассу
-        virtual void HandleRequest(HttpRequest&& request) = 0;
+        void OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written);
+    };
 
-        virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
+    template <typename RequestHandler>
+    class Session : public CallbackSessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
+    public:
+        template <typename Handler>
+        Session(tcp::socket&& socket, std::shared_ptr<ConnectionLimiter> limiter, Handler&& request_handler);
+
+    private:
+        RequestHandler request_handler_;
+
+        void HandleRequest(uint64_t request_index, HttpRequest&& request) override;
+
+        std::shared_ptr<SessionBase> GetSharedThis() override;
+    };
+
+    // Сопрограмма сессии, которую никто не ожидает. Кадр размещается в памяти сессии, которую
+    // сопрограмма-член получает первым параметром, и держит сессию до своего уничтожения.
+    // Исключение, как и у Session, выходит из io_context::run
+    class SessionTask {
+    public:
+        struct promise_type {
+            template <typename Session>
+            explicit promise_type(Session& session)
+                : session_(session.GetSharedThis()) {
+            }
+
+            template <typename Session>
+            static void* operator new(std::size_t size, Session& session) {
+                return AllocateFrame(session.frame_memory_, size);
+            }
+
+            static void operator delete(void* frame, std::size_t size) noexcept;
+
+            SessionTask get_return_object() noexcept { return {}; }
+
+            std::suspend_never initial_suspend() noexcept { return {}; }
+
+            // Кадр уничтожается раньше сессии: ссылку на неё держит не кадр, а этот объект
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+
+                void await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept {
+                    const std::shared_ptr<SessionBase> session = std::move(coroutine.promise().session_);
+                    coroutine.destroy();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            FinalAwaiter final_suspend() noexcept { return {}; }
+
+            void return_void() noexcept {}
+
+            void unhandled_exception() { throw; }
+
+            std::shared_ptr<SessionBase> session_;
+        };
+
+    private:
+        static void* AllocateFrame(HandlerMemory& memory, std::size_t size);
+    };
+
+    // Асинхронная операция, которую ожидает сопрограмма сессии. Обработчик завершения размещается
+    // в памяти сессии и возобновляет сопрограмму на executor-е сокета
+    template <typename Initiation>
+    class SessionOperation {
+    public:
+        SessionOperation(HandlerMemory& memory, Initiation initiation)
+            : memory_(memory)
+            , initiation_(std::move(initiation)) {
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            initiation_(MakeAllocHandler(memory_, [this, coroutine](beast::error_code ec, std::size_t) {
+                ec_ = ec;
+                coroutine.resume();
+            }));
+        }
+
+        beast::error_code await_resume() const noexcept { return ec_; }
+
+    private:
+        HandlerMemory& memory_;
+        Initiation initiation_;
+        beast::error_code ec_;
+    };
+
+    // Точка, в которой сопрограмма сессии ждёт, пока её не разбудит другая
+    class SessionSignal {
+    public:
+        auto Wait() noexcept {
+            struct Awaiter {
+                SessionSignal& signal;
+
+                bool await_ready() const noexcept { return false; }
+
+                void await_suspend(std::coroutine_handle<> coroutine) noexcept {
+                    signal.waiting_ = coroutine;
+                }
+
+                void await_resume() const noexcept {}
+            };
+            return Awaiter{*this};
+        }
+
+        // Ожидающая сопрограмма продолжается сразу, до возврата из Wake
+        void Wake() {
+            if (auto coroutine = std::exchange(waiting_, nullptr)) {
+                coroutine.resume();
+            }
+        }
+
+    private:
+        std::coroutine_handle<> waiting_;
+    };
+
+    // Та же сессия на сопрограммах: чтение и запись - два цикла, которые ждут друг друга,
+    // когда конвейер заполнен или ответ ещё не готов. Кадры циклов создаются один раз
+    // на соединение в памяти сессии, операции Asio используют память обработчиков, как и Session
+    class CoroutineSessionBase : public SessionBase {
+    protected:
+        CoroutineSessionBase(tcp::socket&& socket, std::shared_ptr<ConnectionLimiter> limiter);
+
+    private:
+        friend class SessionTask;
+
+        HandlerMemory frame_memory_;
+        // Писатель ждёт ответа, очередь которого подошла, а читатель - места в конвейере
+        SessionSignal response_ready_;
+        SessionSignal pipeline_space_;
+
+        void Start() override;
+
+        void OnResponseReady() override;
+
+        SessionTask ReadRequests();
+
+        SessionTask WriteResponses();
+
+        template <typename Initiation>
+        SessionOperation<Initiation> Operation(Initiation initiation) {
+            return {handler_memory_, std::move(initiation)};
+        }
     };
 
     template <typename RequestHandler>
-    class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
+    class CoroutineSession : public CoroutineSessionBase, 
+                             public std::enable_shared_from_this<CoroutineSession<RequestHandler>> {
     public:
         template <typename Handler>
-        Session(tcp::socket&& socket, Handler&& request_handler);
+        CoroutineSession(tcp::socket&& socket, std::shared_ptr<ConnectionLimiter> limiter, 
+                         Handler&& request_handler);
 
     private:
         RequestHandler request_handler_;
 
-        void HandleRequest(HttpRequest&& request) override;
+        void HandleRequest(uint64_t request_index, HttpRequest&& request) override;
 
         std::shared_ptr<SessionBase> GetSharedThis() override;
     };
 
+    // Сессии на сопрограммах включаются опцией сборки GAME_SERVER_COROUTINE_SESSION
+#ifdef GAME_SERVER_COROUTINE_SESSION
+    template <typename RequestHandler>
+    using ServerSession = CoroutineSession<RequestHandler>;
+#else
+    template <typename RequestHandler>
+    using ServerSession = Session<RequestHandler>;
+#endif
+
     template <typename RequestHandler>
     class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
     public:
         template <typename Handler>
-        Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler);
+        Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler,
+                 std::shared_ptr<ConnectionLimiter> limiter);
 
         void Run();
 
@@ -87,6 +505,7 @@ namespace http_server {
         net::io_context& ioc_;
         tcp::acceptor acceptor_;
         RequestHandler request_handler_;
+        std::shared_ptr<ConnectionLimiter> limiter_;
 
         void DoAccept();
 
@@ -97,45 +516,36 @@ namespace http_server {
     };
 
     template <typename RequestHandler>
-    void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+    void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler,
+                   std::shared_ptr<ConnectionLimiter> limiter = std::make_shared<ConnectionLimiter>()) {
         // При помощи decay_t исключим ссылки из типа RequestHandler,
         // чтобы Listener хранил RequestHandler по значению
         using MyListener = Listener<std::decay_t<RequestHandler>>;
 
-        std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+        std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), 
+                                     std::move(limiter))->Run();
     }
 
 }  // namespace http_server
 
 // for template function realisations 
 namespace http_server {
-    template <typename Body, typename Fields>
-    void SessionBase::Write(http::response<Body, Fields>&& response) {
-        // Запись выполняется асинхронно, поэтому response перемещаем в область кучи
-        
-        auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
-
-        auto self = GetSharedThis();
-        http::async_write(stream_, *safe_response,
-                        [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
-                            self->OnWrite(safe_response->need_eof(), ec, bytes_written);
-                        });
-    }
-
     template<typename RequestHandler>
     template <typename Handler>
-    Session<RequestHandler>::Session(tcp::socket&& socket, Handler&& request_handler)
-        : SessionBase(std::move(socket))
+    Session<RequestHandler>::Session(tcp::socket&& socket, std::shared_ptr<ConnectionLimiter> limiter, 
+                                     Handler&& request_handler)
+        : CallbackSessionBase(std::move(socket), std::move(limiter))
         , request_handler_(std::forward<Handler>(request_handler)) {
     }
 
     template <typename RequestHandler>
-    void Session<RequestHandler>::HandleRequest(HttpRequest&& request) {
+    void Session<RequestHandler>::HandleRequest(uint64_t request_index, HttpRequest&& request) {
         // Захватываем умный указатель на текущий объект Session в лямбде,
         // чтобы продлить время жизни сессии до вызова лямбды.
         // Используется generic-лямбда функция, способная принять response произвольного типа
-        request_handler_(std::move(request), [self = this->shared_from_this()](auto&& response) {
-                        self->Write(std::move(response));
+        request_handler_(std::move(request), GetRemoteAddress(), 
+                         [self = this->shared_from_this(), request_index](auto&& response) {
+                        self->Deliver(request_index, http_handler::ResponseVariant{std::move(response)});
         });
     }
 
@@ -144,6 +554,28 @@ namespace http_server {
         return this->shared_from_this();
     }
 
+    template <typename RequestHandler>
+    template <typename Handler>
+    CoroutineSession<RequestHandler>::CoroutineSession(tcp::socket&& socket, 
+                                                       std::shared_ptr<ConnectionLimiter> limiter,
+                                                       Handler&& request_handler)
+        : CoroutineSessionBase(std::move(socket), std::move(limiter))
+        , request_handler_(std::forward<Handler>(request_handler)) {
+    }
+
+    template <typename RequestHandler>
+    void CoroutineSession<RequestHandler>::HandleRequest(uint64_t request_index, HttpRequest&& request) {
+        request_handler_(std::move(request), GetRemoteAddress(), 
+                         [self = this->shared_from_this(), request_index](auto&& response) {
+                        self->Deliver(request_index, http_handler::ResponseVariant{std::move(response)});
+        });
+    }
+
+    template <typename RequestHandler>
+    std::shared_ptr<SessionBase> CoroutineSession<RequestHandler>::GetSharedThis() {
+        return this->shared_from_this();
+    }
+
     template <typename RequestHandler>
     void Listener<RequestHandler>::Run() {
         DoAccept();
@@ -178,8 +610,13 @@ namespace http_server {
 
         // std::cout << "Новое подключение принято: " << socket.remote_endpoint() << std::endl;
 
-        // Асинхронно обрабатываем сессию
-        AsyncRunSession(std::move(socket));
+        // Сверх лимита соединение закрывается, не занимая ресурсов сервера
+        if (limiter_->TryAcquire()) {
+            AsyncRunSession(std::move(socket));
+        } else {
+            sys::error_code close_ec;
+            socket.close(close_ec);
+        }
 
         // Принимаем новое соединение
         DoAccept();
@@ -187,16 +624,18 @@ namespace http_server {
 
     template <typename RequestHandler>
     void Listener<RequestHandler>::AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+        std::make_shared<ServerSession<RequestHandler>>(std::move(socket), limiter_, request_handler_)->Run();
     }
 
     template <typename RequestHandler>
     template <typename Handler>
-    Listener<RequestHandler>::Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler)
+    Listener<RequestHandler>::Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler,
+                                       std::shared_ptr<ConnectionLimiter> limiter)
         : ioc_(ioc)
         // Обработчики асинхронных операций acceptor_ будут вызываться в своём strand
         , acceptor_(net::make_strand(ioc))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , limiter_(std::move(limiter)) {
         // Открываем acceptor, используя протокол (IPv4 или IPv6), указанный в endpoint
         acceptor_.open(endpoint.protocol());
 
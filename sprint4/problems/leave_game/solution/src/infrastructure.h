@@ -1,14 +1,27 @@
+#pragma once
+
+#include "model.h"
+
 #include <chrono>
 #include <ratio>
+#include <string_view>
 
 class ApplicationListener {
 public:
-    virtual void OnTick(std::chrono::milliseconds delta) = 0;
-};
+    virtual ~ApplicationListener() = default;
 
-class SerializingListener : public ApplicationListener {
-public:
-    SerializingListener();
+    // Игрок вошёл в игру: собака уже добавлена в сессию и стоит на точке появления
+    virtual void OnJoin([[maybe_unused]] const model::Dog& dog,
+                        [[maybe_unused]] const model::GameSession& session,
+                        [[maybe_unused]] std::string_view token) {}
 
-    void OnTick(std::chrono::milliseconds delta) override;
-};
\ No newline at end of file
+    // Собака игрока удалена из сессии
+    virtual void OnLeave([[maybe_unused]] model::Dog::Id dog_id,
+                         [[maybe_unused]] const model::GameSession& session) {}
+
+    // К собаке применено действие игрока
+    virtual void OnAction([[maybe_unused]] model::Dog::Id dog_id,
+                          [[maybe_unused]] model::Move move) {}
+
+    virtual void OnTick(std::chrono::milliseconds delta) = 0;
+};
@@ -0,0 +1,469 @@
+#include "journal.h"
+#include "util.h"
+
+#include <bit>
+#include <stdexcept>
+
+namespace journal {
+    using namespace std::literals;
+
+    namespace {
+        // Записи буферизуются и сбрасываются в файл крупными блоками
+        constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+        constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+        constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+        void HashBytes(uint64_t& hash, const void* data, size_t size) {
+            const auto* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; ++i) {
+                hash ^= bytes[i];
+                hash *= FNV_PRIME;
+            }
+        }
+
+        template <typename T>
+        void HashValue(uint64_t& hash, const T& value) {
+            HashBytes(hash, &value, sizeof(value));
+        }
+    }
+
+    namespace {
+        void PutByte(std::string& out, uint8_t byte) {
+            out.push_back(static_cast<char>(byte));
+        }
+
+        void PutVarint(std::string& out, uint64_t value) {
+            while (value >= 0x80) {
+                PutByte(out, static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            PutByte(out, static_cast<uint8_t>(value));
+        }
+
+        void PutDouble(std::string& out, double value) {
+            const auto bits = std::bit_cast<uint64_t>(value);
+            for (int i = 0; i < 8; ++i) {
+                PutByte(out, static_cast<uint8_t>(bits >> (i * 8)));
+            }
+        }
+
+        void PutString(std::string& out, std::string_view str) {
+            PutVarint(out, str.size());
+            out.append(str);
+        }
+    }
+
+    std::string EncodeHeader() {
+        std::string header(MAGIC);
+        PutByte(header, VERSION);
+        return header;
+    }
+
+    void EncodeRecord(const Record& record, std::string& out) {
+        std::visit([&out](const auto& rec) {
+            using T = std::decay_t<decltype(rec)>;
+
+            if constexpr (std::is_same_v<T, JoinRecord>) {
+                PutByte(out, static_cast<uint8_t>(RecordType::JOIN));
+                PutString(out, rec.map_id);
+                PutVarint(out, rec.session_id.value_or(0));
+                PutVarint(out, rec.dog_id);
+                PutString(out, rec.name);
+                PutDouble(out, rec.position.x);
+                PutDouble(out, rec.position.y);
+                PutString(out, rec.token);
+            } else if constexpr (std::is_same_v<T, ActionRecord>) {
+                PutByte(out, static_cast<uint8_t>(RecordType::ACTION));
+                PutVarint(out, rec.dog_id);
+                PutString(out, rec.direction);
+            } else if constexpr (std::is_same_v<T, TickRecord>) {
+                PutByte(out, static_cast<uint8_t>(RecordType::TICK));
+                PutVarint(out, static_cast<uint64_t>(rec.delta.count()));
+            } else if constexpr (std::is_same_v<T, LootSpawnRecord>) {
+                PutByte(out, static_cast<uint8_t>(RecordType::LOOT_SPAWN));
+                PutString(out, rec.map_id);
+                PutVarint(out, rec.session_id.value_or(0));
+                PutVarint(out, static_cast<uint64_t>(rec.count));
+                PutVarint(out, rec.seed);
+            } else if constexpr (std::is_same_v<T, LeaveRecord>) {
+                PutByte(out, static_cast<uint8_t>(RecordType::LEAVE));
+                PutVarint(out, rec.dog_id);
+            } else if constexpr (std::is_same_v<T, MaterializeRecord>) {
+                PutByte(out, static_cast<uint8_t>(RecordType::MATERIALIZE));
+                PutVarint(out, rec.session_id);
+            }
+        }, record);
+    }
+
+    JournalWriter::JournalWriter(const fs::path& path)
+        : out_(path, std::ios::out | std::ios::binary | std::ios::trunc) {
+        if (!out_) {
+            throw std::runtime_error("Failed to open journal for writing: "s + path.string());
+        }
+
+        buffer_.reserve(FLUSH_THRESHOLD * 2);
+        buffer_.append(EncodeHeader());
+    }
+
+    JournalWriter::~JournalWriter() {
+        try {
+            Flush();
+        } catch (...) {
+        }
+    }
+
+    void JournalWriter::Write(const Record& record) {
+        EncodeRecord(record, buffer_);
+
+        if (buffer_.size() >= FLUSH_THRESHOLD) {
+            Flush();
+        }
+    }
+
+    void JournalWriter::Flush() {
+        if (buffer_.empty()) {
+            return;
+        }
+
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        out_.flush();
+        buffer_.clear();
+
+        if (!out_) {
+            throw std::runtime_error("Failed to write journal");
+        }
+    }
+
+    JournalReader::JournalReader(const fs::path& path)
+        : JournalReader(util::ReadFromFileIntoString(path)) {
+    }
+
+    JournalReader::JournalReader(std::string data)
+        : data_(std::move(data)) {
+        if (data_.size() < MAGIC.size() + 1 || std::string_view(data_).substr(0, MAGIC.size()) != MAGIC) {
+            throw std::runtime_error("Not a game journal");
+        }
+
+        pos_ = MAGIC.size();
+        version_ = GetByte();
+        if (version_ < MIN_VERSION || version_ > VERSION) {
+            throw std::runtime_error("Unsupported journal version");
+        }
+    }
+
+    bool JournalReader::HasHeader(std::string_view data) {
+        if (data.size() < MAGIC.size() + 1 || data.substr(0, MAGIC.size()) != MAGIC) {
+            return false;
+        }
+
+        const auto version = static_cast<uint8_t>(data[MAGIC.size()]);
+        return version >= MIN_VERSION && version <= VERSION;
+    }
+
+    std::optional<Record> JournalReader::Next() {
+        if (pos_ >= data_.size()) {
+            return std::nullopt;
+        }
+
+        switch (static_cast<RecordType>(GetByte())) {
+            case RecordType::JOIN: {
+                JoinRecord rec;
+                rec.map_id = GetString();
+                if (version_ >= 3) {
+                    rec.session_id = GetVarint();
+                }
+                rec.dog_id = GetVarint();
+                rec.name = GetString();
+                rec.position.x = GetDouble();
+                rec.position.y = GetDouble();
+                rec.token = GetString();
+                return rec;
+            }
+            case RecordType::ACTION: {
+                ActionRecord rec;
+                rec.dog_id = GetVarint();
+                rec.direction = GetString();
+                return rec;
+            }
+            case RecordType::TICK:
+                return TickRecord{std::chrono::milliseconds(GetVarint())};
+            case RecordType::LOOT_SPAWN: {
+                LootSpawnRecord rec;
+                rec.map_id = GetString();
+                if (version_ >= 3) {
+                    rec.session_id = GetVarint();
+                }
+                rec.count = static_cast<int>(GetVarint());
+                rec.seed = GetVarint();
+                return rec;
+            }
+            case RecordType::LEAVE:
+                return LeaveRecord{GetVarint()};
+            case RecordType::MATERIALIZE:
+                if (version_ >= 4) {
+                    return MaterializeRecord{GetVarint()};
+                }
+                break;
+        }
+
+        throw std::runtime_error("Corrupted journal: unknown record type");
+    }
+
+    uint8_t JournalReader::GetByte() {
+        if (pos_ >= data_.size()) {
+            throw std::runtime_error("Corrupted journal: unexpected end of data");
+        }
+        return static_cast<uint8_t>(data_[pos_++]);
+    }
+
+    uint64_t JournalReader::GetVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t byte = GetByte();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+
+        throw std::runtime_error("Corrupted journal: varint is too long");
+    }
+
+    double JournalReader::GetDouble() {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; ++i) {
+            bits |= static_cast<uint64_t>(GetByte()) << (i * 8);
+        }
+        return std::bit_cast<double>(bits);
+    }
+
+    std::string JournalReader::GetString() {
+        const uint64_t size = GetVarint();
+        if (size > data_.size() - pos_) {
+            throw std::runtime_error("Corrupted journal: string is out of bounds");
+        }
+
+        std::string result = data_.substr(pos_, size);
+        pos_ += size;
+        return result;
+    }
+
+    Recorder::Recorder(model::Game& game, const fs::path& path)
+        : writer_(path) {
+        game.GetLootService().AddSpawnListener(
+            [this](const model::GameSession& session, int count, uint64_t seed) {
+                pending_spawns_.push_back({*session.GetMapId(), session.GetSessionId(), count, seed});
+            });
+        game.GetSessionService().AddMaterializeListener(
+            [this](const model::GameSession& session) {
+                OnMaterialize(session);
+            });
+    }
+
+    void Recorder::OnMaterialize(const model::GameSession& session) {
+        writer_.Write(MaterializeRecord{session.GetSessionId()});
+    }
+
+    void Recorder::OnJoin(const model::Dog& dog, const model::GameSession& session, std::string_view token) {
+        writer_.Write(JoinRecord{*session.GetMapId(), session.GetSessionId(), dog.GetId(), dog.GetName(), 
+                                 dog.GetPosition(), std::string(token)});
+    }
+
+    void Recorder::OnLeave(model::Dog::Id dog_id, [[maybe_unused]] const model::GameSession& session) {
+        writer_.Write(LeaveRecord{dog_id});
+    }
+
+    void Recorder::OnAction(model::Dog::Id dog_id, model::Move move) {
+        writer_.Write(ActionRecord{dog_id, std::string(model::MoveToString(move))});
+    }
+
+    void Recorder::OnTick(std::chrono::milliseconds delta) {
+        writer_.Write(TickRecord{delta});
+
+        for (const auto& spawn : pending_spawns_) {
+            writer_.Write(spawn);
+        }
+        pending_spawns_.clear();
+
+        writer_.Flush();
+    }
+
+    Replayer::Replayer(model::Game& game)
+        : game_(game) {
+    }
+
+    Replayer::Replayer(app::Application& app)
+        : game_(app.GetGame())
+        , app_(&app) {
+        // Ненаполненные сессии пусты, их собаки добавятся по записи MATERIALIZE
+        for (const auto& session : game_.GetSessionService().GetSessions()) {
+            AddSessionDogs(session);
+        }
+    }
+
+    void Replayer::AddSessionDogs(const std::shared_ptr<model::GameSession>& session) {
+        for (const auto& dog : session->GetDogsInOrder()) {
+            dogs_[dog->GetId()] = ReplayedDog{dog, session};
+        }
+    }
+
+    ReplayStats Replayer::Replay(const fs::path& path) {
+        JournalReader reader(path);
+        return Replay(reader);
+    }
+
+    ReplayStats Replayer::Replay(JournalReader& reader) {
+        using Clock = std::chrono::steady_clock;
+
+        ReplayStats stats;
+
+        const auto start = Clock::now();
+        while (auto record = reader.Next()) {
+            std::visit([this, &stats](const auto& rec) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(rec)>, TickRecord>) {
+                    ++stats.ticks;
+                }
+                Apply(rec);
+            }, *record);
+            ++stats.records;
+        }
+        stats.duration = Clock::now() - start;
+
+        return stats;
+    }
+
+    std::shared_ptr<model::GameSession> 
+    Replayer::GetSession(const std::string& map_id, std::optional<model::GameSession::Id> session_id) {
+        auto& session_service = game_.GetSessionService();
+        const model::Map::Id id{map_id};
+        if (!game_.GetMapService().FindMap(id)) {
+            throw std::runtime_error("Journal refers to unknown map: "s + map_id);
+        }
+
+        if (!session_id) {
+            return session_service.FindGameSession(id);
+        }
+
+        if (auto session = session_service.FindGameSessionBySessionId(*session_id)) {
+            return session;
+        }
+
+        // Новые сессии после воспроизведения не должны получить уже занятые идентификаторы
+        if (model::GameSession::GetNextId() <= *session_id) {
+            model::GameSession::SetNextId(*session_id + 1);
+        }
+        return session_service.RestoreGameSession(id, *session_id);
+    }
+
+    void Replayer::Apply(const JoinRecord& record) {
+        auto session = GetSession(record.map_id, record.session_id);
+
+        auto dog = std::make_shared<model::Dog>(record.dog_id, record.name);
+        dog->SetDefaultDogSpeed(session->GetMapDefaultSpeed());
+        session->AddDog(dog, record.position);
+
+        // Новые собаки после воспроизведения не должны получить уже занятые идентификаторы
+        if (model::Dog::GetNextId() <= record.dog_id) {
+            model::Dog::SetNextId(record.dog_id + 1);
+        }
+
+        if (app_) {
+            app_->RestorePlayer(app::Token::Parse(record.token), dog, session);
+        }
+
+        dogs_[record.dog_id] = ReplayedDog{std::move(dog), std::move(session)};
+    }
+
+    void Replayer::Apply(const ActionRecord& record) {
+        const auto move = model::ParseMove(record.direction);
+        if (!move) {
+            throw std::runtime_error("Journal contains invalid move: "s + record.direction);
+        }
+
+        const ReplayedDog& replayed = GetDog(record.dog_id);
+        // Команда меняет и отсчёт простоя, поэтому в приложение она идёт через его учёт
+        if (app_) {
+            app_->ReplayMove(record.dog_id, replayed.session->GetMapHandle(), *move);
+        } else {
+            replayed.dog->SetDogDirSpeed(*move);
+        }
+    }
+
+    void Replayer::Apply(const LeaveRecord& record) {
+        const ReplayedDog& replayed = GetDog(record.dog_id);
+        if (app_) {
+            app_->ReplayLeave(record.dog_id, replayed.session);
+        } else {
+            replayed.session->RemoveDog(record.dog_id);
+            game_.GetSessionService().ReclaimIfEmpty(replayed.session->GetSessionId());
+        }
+
+        dogs_.erase(record.dog_id);
+    }
+
+    const Replayer::ReplayedDog& Replayer::GetDog(model::Dog::Id dog_id) const {
+        auto it = dogs_.find(dog_id);
+        if (it == dogs_.end()) {
+            throw std::runtime_error("Journal refers to unknown dog: "s + std::to_string(dog_id));
+        }
+
+        return it->second;
+    }
+
+    void Replayer::Apply(const TickRecord& record) {
+        // Трофеи не генерируются заново, а берутся из следующих за тиком записей LOOT_SPAWN
+        if (app_) {
+            app_->ReplayTick(record.delta);
+        } else {
+            game_.GetSessionService().Tick(record.delta);
+        }
+    }
+
+    void Replayer::Apply(const LootSpawnRecord& record) {
+        auto session = GetSession(record.map_id, record.session_id);
+        const int loot_types_count =
+            game_.GetLootService().GetLootTypesCount(session->GetMapHandle());
+
+        session->GenerateLoot(record.count, loot_types_count, record.seed);
+    }
+
+    void Replayer::Apply(const MaterializeRecord& record) {
+        auto& session_service = game_.GetSessionService();
+        if (!session_service.IsColdSession(record.session_id)) {
+            throw std::runtime_error("Journal materializes unknown session: "s + std::to_string(record.session_id));
+        }
+
+        AddSessionDogs(session_service.FindGameSessionBySessionId(record.session_id));
+    }
+
+    uint64_t StateDigest(model::Game& game) {
+        uint64_t hash = FNV_OFFSET;
+
+        for (const auto& session : game.GetSessionService().GetSessions()) {
+            const model::Map::Id& map_id = session->GetMapId();
+            HashBytes(hash, (*map_id).data(), (*map_id).size());
+
+            for (const auto& state : session->GetPlayersUnitStates()) {
+                HashValue(hash, state.position.x);
+                HashValue(hash, state.position.y);
+                HashValue(hash, state.speed.x);
+                HashValue(hash, state.speed.y);
+                HashValue(hash, state.direction);
+                HashValue(hash, state.score);
+                for (const auto& [loot_id, loot_type] : state.bag) {
+                    HashValue(hash, loot_type);
+                }
+            }
+
+            for (const auto& loot : session->GetLostObjects()) {
+                HashValue(hash, loot.type);
+                HashValue(hash, loot.position.x);
+                HashValue(hash, loot.position.y);
+            }
+        }
+
+        return hash;
+    }
+
+}  // namespace journal
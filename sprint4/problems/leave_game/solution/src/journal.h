@@ -0,0 +1,200 @@
+#pragma once
+
+#include "sdk.h"
+#include "application.h"
+#include "infrastructure.h"
+#include "model.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+/*
+ * Журнал входных воздействий на модель игры.
+ * Recorder пишет в журнал каждое применённое изменение (вход и выход игрока, действие, тик,
+ * появление трофеев вместе с seed генератора), Replayer детерминированно
+ * проигрывает журнал на свежей model::Game с максимальной скоростью
+ * или поверх восстановленного снимка (см. write_ahead_log.h).
+ *
+ * Формат: заголовок MAGIC + VERSION, далее записи подряд. Запись начинается с байта RecordType,
+ * целые числа кодируются varint (LEB128), координаты - 8 байтами IEEE 754 (little-endian),
+ * строки - varint-длиной и байтами. JOIN и LOOT_SPAWN после карты содержат идентификатор сессии.
+ * MATERIALIZE отмечает момент, когда сессия, загруженная из снимка лениво, была наполнена:
+ * до этого она заморожена, и воспроизведение должно наполнить её в том же месте журнала.
+ */
+namespace journal {
+
+    namespace fs = std::filesystem;
+
+    constexpr std::string_view MAGIC = "GSJ";
+    // С версии 3 вход игрока и появление трофеев указывают сессию: у карты их может быть несколько.
+    // Журналы версии 2 по-прежнему читаются, их записи относятся к сессии карты для нового игрока.
+    // В версии 4 добавлена запись MATERIALIZE
+    constexpr uint8_t VERSION = 4;
+    constexpr uint8_t MIN_VERSION = 2;
+
+    enum class RecordType : uint8_t {
+        JOIN = 1,
+        ACTION = 2,
+        TICK = 3,
+        LOOT_SPAWN = 4,
+        LEAVE = 5,
+        MATERIALIZE = 6,
+    };
+
+    struct JoinRecord {
+        std::string map_id;
+        std::optional<model::GameSession::Id> session_id;
+        model::Dog::Id dog_id = 0;
+        std::string name;
+        model::Pos position{0, 0};
+        std::string token;
+    };
+
+    struct ActionRecord {
+        model::Dog::Id dog_id = 0;
+        std::string direction;
+    };
+
+    struct TickRecord {
+        std::chrono::milliseconds delta{0};
+    };
+
+    struct LootSpawnRecord {
+        std::string map_id;
+        std::optional<model::GameSession::Id> session_id;
+        int count = 0;
+        uint64_t seed = 0;
+    };
+
+    struct LeaveRecord {
+        model::Dog::Id dog_id = 0;
+    };
+
+    struct MaterializeRecord {
+        model::GameSession::Id session_id = 0;
+    };
+
+    using Record = std::variant<JoinRecord, ActionRecord, TickRecord, LootSpawnRecord, LeaveRecord,
+                                MaterializeRecord>;
+
+    // Дописывает закодированную запись в конец out
+    void EncodeRecord(const Record& record, std::string& out);
+
+    // Заголовок журнала, с которого начинается каждый файл
+    std::string EncodeHeader();
+
+    class JournalWriter {
+    public:
+        explicit JournalWriter(const fs::path& path);
+        ~JournalWriter();
+
+        JournalWriter(const JournalWriter&) = delete;
+        JournalWriter& operator=(const JournalWriter&) = delete;
+
+        void Write(const Record& record);
+
+        // Переносит накопленные записи в файл
+        void Flush();
+
+    private:
+        std::ofstream out_;
+        std::string buffer_;
+    };
+
+    class JournalReader {
+    public:
+        // Журнал целиком читается в память, чтобы разбор не упирался в потоковый ввод
+        explicit JournalReader(const fs::path& path);
+        explicit JournalReader(std::string data);
+
+        // Проверяет, что data начинается с заголовка журнала поддерживаемой версии
+        static bool HasHeader(std::string_view data);
+
+        std::optional<Record> Next();
+
+    private:
+        uint8_t GetByte();
+        uint64_t GetVarint();
+        double GetDouble();
+        std::string GetString();
+
+        std::string data_;
+        size_t pos_ = 0;
+        uint8_t version_ = VERSION;
+    };
+
+    class Recorder : public ApplicationListener {
+    public:
+        Recorder(model::Game& game, const fs::path& path);
+
+        void OnJoin(const model::Dog& dog, const model::GameSession& session, 
+                    std::string_view token) override;
+        void OnLeave(model::Dog::Id dog_id, const model::GameSession& session) override;
+        void OnAction(model::Dog::Id dog_id, model::Move move) override;
+        void OnTick(std::chrono::milliseconds delta) override;
+
+        void OnMaterialize(const model::GameSession& session);
+
+    private:
+        JournalWriter writer_;
+        // Трофеи появляются внутри тика, а в журнал попадают после записи самого тика
+        std::vector<LootSpawnRecord> pending_spawns_;
+    };
+
+    struct ReplayStats {
+        uint64_t records = 0;
+        uint64_t ticks = 0;
+        std::chrono::nanoseconds duration{0};
+    };
+
+    class Replayer {
+    public:
+        explicit Replayer(model::Game& game);
+        // Воспроизводит журнал с регистрацией игроков в приложении под записанными токенами.
+        // Собаки, уже находящиеся в наполненных сессиях снимка, тоже учитываются. Ненаполненные
+        // сессии остаются нетронутыми до записи MATERIALIZE
+        explicit Replayer(app::Application& app);
+
+        ReplayStats Replay(const fs::path& path);
+        ReplayStats Replay(JournalReader& reader);
+
+    private:
+        struct ReplayedDog {
+            std::shared_ptr<model::Dog> dog;
+            std::shared_ptr<model::GameSession> session;
+        };
+
+        void Apply(const JoinRecord& record);
+        void Apply(const ActionRecord& record);
+        void Apply(const TickRecord& record);
+        void Apply(const LootSpawnRecord& record);
+        void Apply(const LeaveRecord& record);
+        void Apply(const MaterializeRecord& record);
+
+        void AddSessionDogs(const std::shared_ptr<model::GameSession>& session);
+
+        // Сессия с идентификатором из журнала создаётся, если её ещё нет
+        std::shared_ptr<model::GameSession> 
+        GetSession(const std::string& map_id, std::optional<model::GameSession::Id> session_id);
+        const ReplayedDog& GetDog(model::Dog::Id dog_id) const;
+
+        model::Game& game_;
+        app::Application* app_ = nullptr;
+        // Собаки воспроизводятся с записанными идентификаторами
+        std::unordered_map<model::Dog::Id, ReplayedDog> dogs_;
+    };
+
+    // Хэш наблюдаемого состояния всех сессий. Не зависит от идентификаторов собак и трофеев,
+    // поэтому совпадает у записанной и воспроизведённой игры
+    uint64_t StateDigest(model::Game& game);
+
+}  // namespace journal
@@ -1,12 +1,20 @@
 #include "json_loader.h"
+#include "map_cache.h"
 #include "model.h"
+#include "msgpack.h"
 #include "util.h"
 #include "loot_generator.h"
 
 #include <boost/json/array.hpp>
+#include <boost/json/monotonic_resource.hpp>
 #include <boost/json/object.hpp>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
 #include <fstream>
 #include <sstream>
+#include <stdexcept>
 #include <cassert>
 #include <iostream>
 
@@ -34,6 +42,7 @@ namespace json_loader {
         constexpr const char* DIR = "dir";
         constexpr const char* CONFIG_DEFAULT_SPEED = "defaultDogSpeed";
         constexpr const char* MAP_DEFAULT_SPEED = "dogSpeed";
+        constexpr const char* MAX_PLAYERS_PER_SESSION = "maxPlayersPerSession";
 
         constexpr const char* LOOT_TYPES = "lootTypes";
         constexpr const char* LOOT_GENERATOR_CONFIG = "lootGeneratorConfig";
@@ -44,6 +53,14 @@ namespace json_loader {
         constexpr const char* ROTATION = "rotation";
         constexpr const char* COLOR = "color";
         constexpr const char* SCALE = "scale";
+
+        constexpr const char* RATE_LIMITS = "rateLimits";
+        constexpr const char* DEFAULT_LIMIT = "default";
+        constexpr const char* ROUTES = "routes";
+        constexpr const char* RATE = "rate";
+        constexpr const char* BURST = "burst";
+
+        constexpr const char* DOG_RETIREMENT_TIME = "dogRetirementTime";
     }
 
     namespace json = boost::json;
@@ -51,7 +68,7 @@ namespace json_loader {
 
     std::vector<model::Map> MapParser::Parse(const json::value& jsonVal) {
         std::vector<model::Map> maps;
-        auto mapsArray = jsonVal.at(json_keys::MAPS).as_array();
+        const auto& mapsArray = jsonVal.at(json_keys::MAPS).as_array();
         maps.reserve(mapsArray.size());
 
         std::transform(mapsArray.cbegin(), mapsArray.cend(), std::back_inserter(maps),
@@ -65,13 +82,12 @@ namespace json_loader {
 
     model::CommonData::MapLootTypes ParseLootTypes(const json::value& obj) {
         model::CommonData::MapLootTypes result;
-        json::array maps = obj.at(json_keys::MAPS).as_array();
+        const json::array& maps = obj.at(json_keys::MAPS).as_array();
         for (const json::value& map : maps) {
-            json::object obj = map.as_object();
-            if (obj.if_contains(json_keys::LOOT_TYPES)) {
-                model::Map::Id id = model::Map::Id{obj["id"].as_string().data()};
-                result[id] = 
-                    std::make_shared<boost::json::array>(obj[json_keys::LOOT_TYPES].as_array());
+            const json::object& obj = map.as_object();
+            if (auto loot_types = obj.if_contains(json_keys::LOOT_TYPES)) {
+                model::Map::Id id = model::Map::Id{obj.at(json_keys::ID).as_string().c_str()};
+                result[id] = std::make_shared<boost::json::array>(loot_types->as_array());
             }
         }
 
@@ -101,70 +117,54 @@ namespace json_loader {
             map.SetBagCapacity(val->as_int64());
         }
 
-        if (obj.contains(json_keys::ROADS)) {
-            auto roads = ParseRoads(obj.at(json_keys::ROADS).as_array());
-            for (const auto& road : roads) {
-                map.AddRoad(road);
-            }
-        }
+        static const json::array empty;
+        const auto* roads = obj.if_contains(json_keys::ROADS);
+        const auto* buildings = obj.if_contains(json_keys::BUILDINGS);
+        const auto* offices = obj.if_contains(json_keys::OFFICES);
 
-        if (obj.contains(json_keys::BUILDINGS)) {
-            auto buildings = ParseBuildings(obj.at(json_keys::BUILDINGS).as_array());
-            for (const auto& building : buildings) {
-                map.AddBuilding(building);
-            }
-        }
+        const json::array& roadsArray = roads ? roads->as_array() : empty;
+        const json::array& buildingsArray = buildings ? buildings->as_array() : empty;
+        const json::array& officesArray = offices ? offices->as_array() : empty;
 
-        if (obj.contains(json_keys::OFFICES)) {
-            auto offices = ParseOffices(obj.at(json_keys::OFFICES).as_array());
-            for (const auto& office : offices) {
-                map.AddOffice(office);
-            }
-        }
+        map.Reserve(roadsArray.size(), buildingsArray.size(), officesArray.size());
+        ParseRoads(roadsArray, map);
+        ParseBuildings(buildingsArray, map);
+        ParseOffices(officesArray, map);
 
         return map;
     }
 
-    std::vector<model::Road> MapParser::ParseRoads(const json::array& roadsArray) {
-        std::vector<model::Road> roads;
+    void MapParser::ParseRoads(const json::array& roadsArray, model::Map& map) {
         for (const auto& item : roadsArray) {
             const auto& obj = item.as_object();
             model::Point start{obj.at(json_keys::X0).as_int64(), obj.at(json_keys::Y0).as_int64()};
-            if (obj.contains(json_keys::X1)) {
-                roads.emplace_back(model::Road::HORIZONTAL, start, obj.at(json_keys::X1).as_int64());
+            if (auto x1 = obj.if_contains(json_keys::X1)) {
+                map.AddRoad(model::Road{model::Road::HORIZONTAL, start, x1->as_int64()});
             } else {
-                roads.emplace_back(model::Road::VERTICAL, start, obj.at(json_keys::Y1).as_int64());
+                map.AddRoad(model::Road{model::Road::VERTICAL, start, obj.at(json_keys::Y1).as_int64()});
             }
         }
-
-        return roads;
     }
 
-    std::vector<model::Building> MapParser::ParseBuildings(const json::array& buildingsArray) {
-        std::vector<model::Building> buildings;
+    void MapParser::ParseBuildings(const json::array& buildingsArray, model::Map& map) {
         for (const auto& item : buildingsArray) {
             const auto& obj = item.as_object();
             model::Rectangle bounds{{obj.at(json_keys::X).as_int64(), obj.at(json_keys::Y).as_int64()},
                                     {obj.at(json_keys::WIDTH).as_int64(), 
                                      obj.at(json_keys::HEIGHT).as_int64()}};
-            buildings.emplace_back(bounds);
+            map.AddBuilding(model::Building{bounds});
         }
-
-        return buildings;
     }
 
-    std::vector<model::Office> MapParser::ParseOffices(const json::array& officesArray) {
-        std::vector<model::Office> offices;
+    void MapParser::ParseOffices(const json::array& officesArray, model::Map& map) {
         for (const auto& item : officesArray) {
             const auto& obj = item.as_object();
             model::Office::Id id{obj.at(json_keys::ID).as_string().c_str()};
             model::Point position{obj.at(json_keys::X).as_int64(), obj.at(json_keys::Y).as_int64()};
             model::Offset offset{obj.at(json_keys::OFFSET_X).as_int64(), 
                                  obj.at(json_keys::OFFSET_Y).as_int64()};
-            offices.emplace_back(std::move(id), position, offset);
+            map.AddOffice(model::Office{std::move(id), position, offset});
         }
-
-        return offices;
     }
 
     std::string MapSerializer::SerializeMaps(const std::vector<model::Map>& maps) {
@@ -260,86 +260,180 @@ namespace json_loader {
     }
 
 
-    std::string StateSerializer::SerializeStates(const std::vector<model::State>& states,
-                                                 const model::GameSession::LostObjects& lost_objects) {
-        boost::json::object states_json;
-        boost::json::object lost_objects_json;
-
-        for (const auto& state : states) {
-            states_json[std::to_string(state.id)]  = 
-                json_loader::StateSerializer::SerializeSingleState(state);
-            // std::cout << json::serialize(states_json[std::to_string(state.id)]) << std::endl;
+    // Округляет координату до 9 знаков после запятой
+    double RoundCoordinate(double value) {
+        std::array<char, 512> buffer;
+        auto [end, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value, 
+                                       std::chars_format::fixed, 9);
+        if (ec != std::errc{}) {
+            return value;
         }
 
-        int i = 0;
-        for (const auto& obj : lost_objects) {
-            lost_objects_json[std::to_string(i++)]  = 
-                json_loader::StateSerializer::SerializeSingleLostObject(obj);
-            // std::cout << json::serialize(states_json[std::to_string(state.id)]) << std::endl;
+        double rounded = value;
+        std::from_chars(buffer.data(), end, rounded);
+        return rounded;
+    }
+
+    // Число в формате json::serialize: кратчайшая мантисса, 'E' и экспонента без '+' и ведущих нулей
+    void AppendDouble(std::string& out, double value) {
+        if (!std::isfinite(value)) {
+            out += json::serialize(json::value(value));
+            return;
         }
 
-        boost::json::object result = {
-            {"players", std::move(states_json)},
-            {"lostObjects", std::move(lost_objects_json)}
-        };
+        std::array<char, 32> buffer;
+        auto [end, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value, 
+                                       std::chars_format::scientific);
+        const std::string_view str(buffer.data(), end - buffer.data());
+        const size_t exp_pos = str.find('e');
 
-        return json::serialize(result);
-    }
+        out.append(str.substr(0, exp_pos));
+        out.push_back('E');
 
-    double format_number(double value, int precision = 9) {
-        std::ostringstream oss;
-        oss << std::fixed << std::setprecision(precision) << value;
+        std::string_view exponent = str.substr(exp_pos + 1);
+        if (exponent.front() == '-') {
+            out.push_back('-');
+        }
+        exponent.remove_prefix(1);
+        while (exponent.size() > 1 && exponent.front() == '0') {
+            exponent.remove_prefix(1);
+        }
+        out.append(exponent);
+    }
 
-        return std::stod(oss.str());
+    template <typename Integer>
+    void AppendInteger(std::string& out, Integer value) {
+        std::array<char, 24> buffer;
+        auto [end, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        out.append(buffer.data(), end);
     }
 
-    json::object StateSerializer::SerializeSingleState(const model::State& state) {
-        json::object state_obj;
-        state_obj["pos"] = SerializePoint(state.position);
-        state_obj["speed"] = SerializeSpeed(state.speed);
-        state_obj["dir"] = SerializeDirection(state.direction);
-        state_obj["score"] = state.score;
+    std::string StateSerializer::SerializeStates(const std::vector<model::State>& states,
+                                                 const model::GameSession::LostObjects& lost_objects) {
+        // Примерный размер записи собаки без рюкзака и записи потерянного предмета
+        constexpr size_t STATE_SIZE_HINT = 160;
+        constexpr size_t LOST_OBJECT_SIZE_HINT = 64;
+
+        std::string result;
+        result.reserve(32 + states.size() * STATE_SIZE_HINT + lost_objects.size() * LOST_OBJECT_SIZE_HINT);
+        WriteStates(result, states, lost_objects);
+
+        return result;
+    }
 
-        json::array bag_json;
-        for (const auto& item : state.bag) {
-            json::object item_json;
-            item_json["id"] = item.first;
-            item_json["type"] = item.second;
-            bag_json.push_back(item_json);
+    void StateSerializer::WriteStates(std::string& out, const std::vector<model::State>& states,
+                                      const model::GameSession::LostObjects& lost_objects) {
+        out += R"({"players":{)";
+        for (size_t i = 0; i < states.size(); ++i) {
+            if (i != 0) out.push_back(',');
+            out.push_back('"');
+            AppendInteger(out, states[i].id);
+            out += "\":";
+            WriteSingleState(out, states[i]);
         }
-        state_obj["bag"] = std::move(bag_json);
 
-        return state_obj;
+        out += R"(},"lostObjects":{)";
+        for (size_t i = 0; i < lost_objects.size(); ++i) {
+            if (i != 0) out.push_back(',');
+            out.push_back('"');
+            AppendInteger(out, i);
+            out += "\":";
+            WriteSingleLostObject(out, lost_objects[i]);
+        }
+        out += "}}";
     }
 
+    std::string StateSerializer::SerializeStatesMsgPack(const std::vector<model::State>& states,
+                                                        const model::GameSession::LostObjects& lost_objects) {
+        // Собака без рюкзака занимает около 40 байт, потерянный предмет - 18
+        std::string result;
+        result.reserve(16 + states.size() * 40 + lost_objects.size() * 18);
+        WriteStatesMsgPack(result, states, lost_objects);
 
+        return result;
+    }
 
-    json::object StateSerializer::SerializeSingleLostObject(const model::GameSession::LostObject lost_object) {
-        json::object lost_obj;
+    void StateSerializer::WriteStatesMsgPack(std::string& out, const std::vector<model::State>& states,
+                                             const model::GameSession::LostObjects& lost_objects) {
+        msgpack::Writer writer(out);
+        writer.ArrayHeader(2);
+
+        writer.ArrayHeader(static_cast<uint32_t>(states.size()));
+        for (const auto& state : states) {
+            writer.ArrayHeader(8);
+            writer.Uint(state.id);
+            writer.Float(static_cast<float>(state.position.x));
+            writer.Float(static_cast<float>(state.position.y));
+            writer.Float(static_cast<float>(state.speed.x));
+            writer.Float(static_cast<float>(state.speed.y));
+            writer.String(SerializeDirection(state.direction));
+            writer.Int(state.score);
+
+            writer.ArrayHeader(static_cast<uint32_t>(state.bag.size()));
+            for (const auto& [id, type] : state.bag) {
+                writer.ArrayHeader(2);
+                writer.Int(id);
+                writer.Int(type);
+            }
+        }
 
-        lost_obj[json_keys::TYPE] = lost_object.type;
-        lost_obj[json_keys::POS] = SerializePoint(lost_object.position);
+        writer.ArrayHeader(static_cast<uint32_t>(lost_objects.size()));
+        for (const auto& lost_object : lost_objects) {
+            writer.ArrayHeader(3);
+            writer.Uint(lost_object.type);
+            writer.Float(static_cast<float>(lost_object.position.x));
+            writer.Float(static_cast<float>(lost_object.position.y));
+        }
+    }
 
-        return lost_obj;
+    void StateSerializer::WriteSingleState(std::string& out, const model::State& state) {
+        out += R"({"pos":)";
+        WritePoint(out, state.position);
+        out += R"(,"speed":)";
+        WriteSpeed(out, state.speed);
+        out += R"(,"dir":")";
+        out += SerializeDirection(state.direction);
+        out += R"(","score":)";
+        AppendInteger(out, state.score);
+
+        out += R"(,"bag":[)";
+        for (size_t i = 0; i < state.bag.size(); ++i) {
+            if (i != 0) out.push_back(',');
+            out += R"({"id":)";
+            AppendInteger(out, state.bag[i].first);
+            out += R"(,"type":)";
+            AppendInteger(out, state.bag[i].second);
+            out.push_back('}');
+        }
+        out += "]}";
     }
 
-    json::array StateSerializer::SerializePoint(const model::Pos& point) {
-        json::array point_arr;
-        point_arr.push_back(format_number(point.x));
-        point_arr.push_back(format_number(point.y));
+    void StateSerializer::WriteSingleLostObject(std::string& out, 
+                                                const model::GameSession::LostObject& lost_object) {
+        out += R"({"type":)";
+        AppendInteger(out, lost_object.type);
+        out += R"(,"pos":)";
+        WritePoint(out, lost_object.position);
+        out.push_back('}');
+    }
 
-        return point_arr;
+    void StateSerializer::WritePoint(std::string& out, const model::Pos& point) {
+        out.push_back('[');
+        AppendDouble(out, RoundCoordinate(point.x));
+        out.push_back(',');
+        AppendDouble(out, RoundCoordinate(point.y));
+        out.push_back(']');
     }
 
-    json::array StateSerializer::SerializeSpeed(const model::Speed& speed) {
-        json::array speed_arr;
-        speed_arr.push_back(speed.x);
-        speed_arr.push_back(speed.y);
-        
-        return speed_arr;
+    void StateSerializer::WriteSpeed(std::string& out, const model::Speed& speed) {
+        out.push_back('[');
+        AppendDouble(out, speed.x);
+        out.push_back(',');
+        AppendDouble(out, speed.y);
+        out.push_back(']');
     }
 
-    std::string StateSerializer::SerializeDirection(model::Direction direction) {
+    std::string_view StateSerializer::SerializeDirection(model::Direction direction) {
         switch (direction) {
             case model::Direction::NORTH:
                 return "U";
@@ -378,34 +472,135 @@ namespace json_loader {
         return result;
     }   */ 
 
-    model::Game LoadGame(const std::filesystem::path& file_path) {
-        // Загрузить модель игры из файла
-        model::Game game;
+    namespace {
 
-        json::value config = ParseConfigFile(util::ReadFromFileIntoString(file_path));
+        http_handler::RateLimit ParseRateLimit(const json::value& value) {
+            const json::object& obj = value.as_object();
+            http_handler::RateLimit limit{obj.at(json_keys::RATE).to_number<double>(),
+                                          obj.at(json_keys::BURST).to_number<double>()};
+            if (!(limit.rate > 0.) || !(limit.burst >= 1.)) {
+                throw std::invalid_argument("Rate limit must have rate > 0 and burst >= 1");
+            }
+            return limit;
+        }
 
-        if (auto val = config.as_object().if_contains(json_keys::CONFIG_DEFAULT_SPEED)) {
-            game.SetDefaultDogSpeed((*val).as_double());
+        http_handler::RateLimitConfig ParseRateLimits(const json::object& obj) {
+            http_handler::RateLimitConfig result;
+            if (auto val = obj.if_contains(json_keys::DEFAULT_LIMIT)) {
+                result.default_limit = ParseRateLimit(*val);
+            }
+            if (auto val = obj.if_contains(json_keys::ROUTES)) {
+                for (const auto& [path, limit] : val->as_object()) {
+                    result.routes.emplace_back(std::string(path), ParseRateLimit(limit));
+                }
+            }
+
+            return result;
+        }
+
+        std::chrono::milliseconds ParseDogRetirementTime(const json::value& value) {
+            const double seconds = value.to_number<double>();
+            if (!(seconds > 0.)) {
+                throw std::invalid_argument("dogRetirementTime must be positive");
+            }
+            return std::chrono::milliseconds(std::llround(seconds * 1000.));
+        }
+
+    }  // namespace
+
+    GameConfig ParseGameConfig(std::string_view config) {
+        // Дерево нужно только на время разбора, поэтому память под него берётся из одного пула
+        json::monotonic_resource resource;
+        json::value value;
+        try {
+            value = json::parse(config, &resource);
+        } catch (const boost::system::system_error& e) {
+            std::cerr << "JSON parsing error: " << e.what() << "\n";
+            throw;
         }
 
-        if (auto val = config.as_object().if_contains(json_keys::LOOT_GENERATOR_CONFIG)) {
-            auto obj = config.as_object()[json_keys::LOOT_GENERATOR_CONFIG].as_object();
+        const json::object& root = value.as_object();
+        GameConfig result;
+
+        if (auto val = root.if_contains(json_keys::CONFIG_DEFAULT_SPEED)) {
+            result.default_dog_speed = val->as_double();
+        }
 
-            double period = obj[json_keys::PERIOD].as_double();
-            double probability = obj[json_keys::PROBABILITY].as_double();
+        if (auto val = root.if_contains(json_keys::LOOT_GENERATOR_CONFIG)) {
+            result.loot_generator = ParseLootGeneratorConfig(val->as_object());
+        }
 
-            game.GetLootService().ConfigureLootGenerator(period, probability);
+        if (auto val = root.if_contains(json_keys::MAX_PLAYERS_PER_SESSION)) {
+            result.max_players_per_session = static_cast<size_t>(std::max<int64_t>(0, val->as_int64()));
         }
 
-        for (auto& map : MapParser::Parse(config)) {
+        if (auto val = root.if_contains(json_keys::RATE_LIMITS)) {
+            result.rate_limits = ParseRateLimits(val->as_object());
+        }
+
+        if (auto val = root.if_contains(json_keys::DOG_RETIREMENT_TIME)) {
+            result.dog_retirement_time = ParseDogRetirementTime(*val);
+        }
+
+        const json::array& maps = root.at(json_keys::MAPS).as_array();
+        result.maps.reserve(maps.size());
+        for (const json::value& map_value : maps) {
+            const json::object& obj = map_value.as_object();
+            const model::Map& map = result.maps.emplace_back(MapParser::ParseSingleMap(obj));
+
+            if (auto loot_types = obj.if_contains(json_keys::LOOT_TYPES)) {
+                // Копия размещается в обычной памяти: пул освобождается вместе с деревом
+                result.loot_types[map.GetId()] =
+                    std::make_shared<json::array>(loot_types->as_array(), json::storage_ptr{});
+            }
+        }
+
+        return result;
+    }
+
+    void ApplyGameConfig(model::Game& game, GameConfig config) {
+        if (config.default_dog_speed) {
+            game.SetDefaultDogSpeed(*config.default_dog_speed);
+        }
+
+        if (config.loot_generator) {
+            game.GetLootService().ConfigureLootGenerator(config.loot_generator->period,
+                                                         config.loot_generator->probability);
+        }
+
+        game.GetSessionService().SetMaxPlayersPerSession(config.max_players_per_session);
+
+        for (auto& map : config.maps) {
             if (!map.IsDefaultDogSpeedValueConfigured()) {
                 map.SetDefaultDogSpeed(game.GetDefaultDogSpeed());
             }
             game.GetMapService().AddMap(std::move(map));
         }
 
-        model::CommonData::MapLootTypes loot_types = json_loader::ParseLootTypes(config);
-        game.GetLootService().ConfigureLootTypes(loot_types);
+        game.GetLootService().ConfigureLootTypes(std::move(config.loot_types));
+    }
+
+    GameConfig LoadGameConfig(const std::filesystem::path& file_path, const std::filesystem::path& map_cache) {
+        const std::string config = util::ReadFromFileIntoString(file_path);
+        if (map_cache.empty()) {
+            return ParseGameConfig(config);
+        }
+
+        const uint64_t config_hash = serialization::ConfigHash(config);
+        if (auto cached = serialization::LoadMapCache(map_cache, config_hash)) {
+            return std::move(*cached);
+        }
+
+        GameConfig parsed = ParseGameConfig(config);
+        serialization::SaveMapCache(parsed, map_cache, config_hash);
+
+        return parsed;
+    }
+
+    model::Game LoadGame(const std::filesystem::path& file_path, const std::filesystem::path& map_cache) {
+        // Загрузить модель игры из файла
+        model::Game game;
+        ApplyGameConfig(game, LoadGameConfig(file_path, map_cache));
 
         return game;
     }
@@ -4,8 +4,12 @@
 #include "model.h"
 #include "json_loader.h"
 #include "extra_data.h"
+#include "rate_limiter.h"
 
+#include <chrono>
 #include <filesystem>
+#include <optional>
+#include <string_view>
 #include <boost/json.hpp>
 
 namespace json_loader {
@@ -22,13 +26,13 @@ namespace json_loader {
     class MapParser {
     public:
         static std::vector<model::Map> Parse(const json::value& jsonVal);
+        static model::Map ParseSingleMap(const json::object& obj);
 
     private:
-        static model::Map ParseSingleMap(const json::object& obj);
-        
-        static std::vector<model::Road> ParseRoads(const json::array& roadsArray);
-        static std::vector<model::Building> ParseBuildings(const json::array& buildingsArray);
-        static std::vector<model::Office> ParseOffices(const json::array& officesArray);
+        // Объекты добавляются прямо в карту, место под них резервируется заранее
+        static void ParseRoads(const json::array& roadsArray, model::Map& map);
+        static void ParseBuildings(const json::array& buildingsArray, model::Map& map);
+        static void ParseOffices(const json::array& officesArray, model::Map& map);
     };
 
     class MapSerializer {
@@ -44,21 +48,66 @@ namespace json_loader {
         static json::array SerializeOffices(const std::vector<model::Office>& offices);
     };
 
+    // Состояние пишется прямо в строку, без промежуточных json::object. Вывод побайтно совпадает
+    // с json::serialize: вещественные числа - кратчайшая мантисса с экспонентой ("1.5E0")
     class StateSerializer {
     public:
         static std::string SerializeStates(const std::vector<model::State>& states,
                                            const model::GameSession::LostObjects& lost_objects);
-        static json::object SerializeSingleState(const model::State& state);
-        static json::object SerializeSingleLostObject(const model::GameSession::LostObject lost_object);
+
+        // Дописывает JSON состояния в конец out
+        static void WriteStates(std::string& out, const std::vector<model::State>& states,
+                                const model::GameSession::LostObjects& lost_objects);
+
+        // Компактное представление в MessagePack, массивы вместо словарей:
+        //   [players, lostObjects]
+        //   player = [id, x, y, speedX, speedY, dir, score, [[itemId, itemType], ...]]
+        //   lostObject = [type, x, y]
+        // Координаты и скорости - float32, dir - строка как в JSON
+        static std::string SerializeStatesMsgPack(const std::vector<model::State>& states,
+                                                  const model::GameSession::LostObjects& lost_objects);
+        static void WriteStatesMsgPack(std::string& out, const std::vector<model::State>& states,
+                                       const model::GameSession::LostObjects& lost_objects);
 
     private:
-        static json::array SerializePoint(const model::Pos& point);
-        static json::array SerializeSpeed(const model::Speed& speed);
-        static std::string SerializeDirection(model::Direction direction);
+        static void WriteSingleState(std::string& out, const model::State& state);
+        static void WriteSingleLostObject(std::string& out, 
+                                          const model::GameSession::LostObject& lost_object);
+        static void WritePoint(std::string& out, const model::Pos& point);
+        static void WriteSpeed(std::string& out, const model::Speed& speed);
+        static std::string_view SerializeDirection(model::Direction direction);
     };
 
     json::value ParseConfigFile(std::string s);
 
-    model::Game LoadGame(const std::filesystem::path& file_path);
+    // Без ключа "dogRetirementTime" - 60 секунд, пенсия при этом остаётся включённой
+    inline constexpr std::chrono::milliseconds DEFAULT_DOG_RETIREMENT_TIME{60'000};
+
+    // Содержимое конфигурации в том виде, в котором оно попадает в модель игры.
+    // Его же сохраняет и читает кэш карт (см. map_cache.h)
+    struct GameConfig {
+        std::optional<double> default_dog_speed;
+        std::optional<loot_gen::LootGeneratorConfig> loot_generator;
+        // "maxPlayersPerSession", 0 - все игроки карты в одной сессии
+        size_t max_players_per_session = 0;
+        // "rateLimits", лимиты частоты запросов к API
+        http_handler::RateLimitConfig rate_limits;
+        // "dogRetirementTime" в секундах: время простоя собаки до выхода игрока на пенсию
+        std::chrono::milliseconds dog_retirement_time = DEFAULT_DOG_RETIREMENT_TIME;
+        std::vector<model::Map> maps;
+        model::CommonData::MapLootTypes loot_types;
+    };
+
+    // Разбирает конфигурацию за один проход по картам
+    GameConfig ParseGameConfig(std::string_view config);
+
+    void ApplyGameConfig(model::Game& game, GameConfig config);
+
+    // Если задан map_cache, конфигурация берётся из кэша, собранного для того же файла,
+    // а при его отсутствии или устаревании кэш пересобирается
+    GameConfig LoadGameConfig(const std::filesystem::path& file_path, 
+                              const std::filesystem::path& map_cache = {});
+
+    model::Game LoadGame(const std::filesystem::path& file_path, const std::filesystem::path& map_cache = {});
 
 }  // namespace json_loader
\ No newline at end of file
@@ -52,4 +52,51 @@ void ServerErrorLog(unsigned err_code, std::string_view message, std::string_vie
     data["where"] = std::string(place);
 
     BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, data) << "error";
-}
\ No newline at end of file
+}
+void StateSavedLog(std::string_view file, int64_t capture_us, int64_t write_ms, uint64_t bytes, uint64_t skipped) {
+    boost::json::object data;
+
+    data["file"] = std::string(file);
+    data["capture_us"] = capture_us;
+    data["write_ms"] = write_ms;
+    data["bytes"] = bytes;
+    data["skipped_ticks"] = skipped;
+
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, data) << "state saved";
+}
+
+void PlayerRetiredLog(std::string_view name, int score, int64_t play_time_ms) {
+    boost::json::object data;
+
+    data["name"] = std::string(name);
+    data["score"] = score;
+    data["play_time_ms"] = play_time_ms;
+
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, data) << "player retired";
+}
+
+void CompressionStatsLog(uint64_t compressed, uint64_t cache_hits, uint64_t input_bytes, 
+                         uint64_t output_bytes, uint64_t cpu_us) {
+    boost::json::object data;
+
+    data["compressed"] = compressed;
+    data["cache_hits"] = cache_hits;
+    data["input_bytes"] = input_bytes;
+    data["output_bytes"] = output_bytes;
+    data["cpu_us"] = cpu_us;
+
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, data) << "compression stats";
+}
+
+void ServerStatsLog(uint64_t active_connections, uint64_t rejected_connections, uint64_t timeouts, 
+                    uint64_t shed_requests, uint64_t rate_limited_requests) {
+    boost::json::object data;
+
+    data["active_connections"] = active_connections;
+    data["rejected_connections"] = rejected_connections;
+    data["timeouts"] = timeouts;
+    data["shed_requests"] = shed_requests;
+    data["rate_limited_requests"] = rate_limited_requests;
+
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, data) << "server stats";
+}
@@ -22,3 +22,17 @@ void JsonFormatter(logging::record_view const& rec, logging::formatting_ostream&
 void ServerStartLog(unsigned port, boost::asio::ip::address ip);
 void ServerStopLog(unsigned err_code, std::string_view ex);
 void ServerErrorLog(unsigned err_code, std::string_view message, std::string_view place);
+
+// Метрики сохранения снимка: время копирования состояния на тике и время записи на диск
+void StateSavedLog(std::string_view file, int64_t capture_us, int64_t write_ms, uint64_t bytes, uint64_t skipped);
+
+// Игрок ушёл на пенсию после простоя собаки
+void PlayerRetiredLog(std::string_view name, int score, int64_t play_time_ms);
+
+// Метрики перегрузки: открытые и отклонённые соединения, таймауты чтения, запросы, получившие 503 и 429
+void ServerStatsLog(uint64_t active_connections, uint64_t rejected_connections, uint64_t timeouts, 
+                    uint64_t shed_requests, uint64_t rate_limited_requests);
+
+// Метрики сжатия ответов: число сжатых тел и попаданий в кэш, объём до и после, процессорное время
+void CompressionStatsLog(uint64_t compressed, uint64_t cache_hits, uint64_t input_bytes, 
+                         uint64_t output_bytes, uint64_t cpu_us);
@@ -9,6 +9,10 @@
 #include "request_handler.h"
 #include "ticker.h"
 #include "extra_data.h"
+#include "journal.h"
+#include "records_store.h"
+#include "serializing_listener.h"
+#include "write_ahead_log.h"
 
 #include <boost/asio/io_context.hpp>
 #include <chrono>
@@ -68,13 +72,50 @@ int main(int argc, const char* argv[]) {
         std::chrono::milliseconds tick_time = std::chrono::milliseconds(static_cast<int>(arg.period));
 
         // 1. Загружаем карту из файла и строим модель игры
-        model::Game game = json_loader::LoadGame(arg.config);
+        json_loader::GameConfig config = json_loader::LoadGameConfig(arg.config, arg.map_cache);
+        http_handler::RateLimitConfig rate_limits = std::move(config.rate_limits);
+        const std::chrono::milliseconds dog_retirement_time = config.dog_retirement_time;
+        model::Game game;
+        json_loader::ApplyGameConfig(game, std::move(config));
 
         game.SetDefaultTickTime(static_cast<double>(tick_time.count()) / 1000.0);
 
         // model::GameSession::SetDefaultTickTime(tick_time);
         app::Application app(game);
 
+        // Игроки, собаки которых долго стоят на месте, уходят на пенсию, а их итоги попадают в таблицу рекордов
+        app::RecordsStore records(arg.records_file);
+        app.SetRetirement(dog_retirement_time, &records);
+        app.SetRecordsSource(&records);
+
+        // Запись входных воздействий для детерминированного воспроизведения
+        std::unique_ptr<journal::Recorder> recorder;
+        if (!arg.record_journal.empty()) {
+            recorder = std::make_unique<journal::Recorder>(game, arg.record_journal);
+            app.AddApplicationListener(*recorder);
+        }
+
+        // Восстановление состояния из бинарного снимка и его периодическое сохранение
+        std::unique_ptr<journal::WriteAheadLog> wal;
+        std::unique_ptr<serialization::SerializingListener> serializing_listener;
+        if (!arg.state_file.empty()) {
+            serializing_listener = std::make_unique<serialization::SerializingListener>(
+                app, arg.state_file, std::chrono::milliseconds(arg.save_state_period));
+
+            // Восстановление: снимок и изменения из журнала упреждающей записи после него
+            if (!arg.wal_file.empty()) {
+                wal = std::make_unique<journal::WriteAheadLog>(game, arg.wal_file);
+                serializing_listener->SetWriteAheadLog(*wal);
+            }
+            serializing_listener->LoadStateFromFile();
+
+            // Журнал регистрируется первым: тик должен попасть в него раньше, чем будет снят снимок
+            if (wal) {
+                app.AddApplicationListener(*wal);
+            }
+            app.AddApplicationListener(*serializing_listener);
+        }
+
         // 2. Инициализируем io_context
         const unsigned num_threads = std::thread::hardware_concurrency();
         net::io_context ioc(num_threads);
@@ -91,15 +132,25 @@ int main(int argc, const char* argv[]) {
 
         // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры
         auto handler = 
-            std::make_shared<http_handler::RequestHandler>(game, strand, arg.www_root, app);
+            std::make_shared<http_handler::RequestHandler>(
+                game, strand, arg.www_root, app, 
+                http_handler::CompressionSettings{arg.gzip_level, arg.gzip_min_size},
+                http_handler::ApiQueueSettings{arg.max_api_queue},
+                std::move(rate_limits));
         http_handler::LoggingRequestHandler logging_handler(handler);
 
         // 5. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
         const auto address = net::ip::make_address("0.0.0.0");
         constexpr net::ip::port_type port = 8080;
-        http_server::ServeHttp(ioc, {address, port}, [&logging_handler](auto&& req, auto&& send) {
-            logging_handler(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send));
-        });
+        auto connection_limiter = std::make_shared<http_server::ConnectionLimiter>(http_server::ServerLimits{
+            arg.max_connections,
+            std::chrono::milliseconds(arg.header_timeout),
+            std::chrono::milliseconds(arg.body_timeout),
+            std::chrono::milliseconds(arg.idle_timeout)});
+        http_server::ServeHttp(ioc, {address, port}, 
+                               [&logging_handler](auto&& req, const auto& remote, auto&& send) {
+            logging_handler(std::forward<decltype(req)>(req), remote, std::forward<decltype(send)>(send));
+        }, connection_limiter);
 
         // Cообщает тестам о том, что сервер запущен и готов обрабатывать запросы
         ServerStartLog(port, address);
@@ -107,17 +158,51 @@ int main(int argc, const char* argv[]) {
         auto ms = std::chrono::milliseconds(static_cast<int>(arg.period));
         auto ticker = 
             std::make_shared<game_time::Ticker>(strand, ms,
-            [&game](std::chrono::milliseconds delta) { 
-                game.GetEngine().Tick(delta); 
+            [&app, &ioc](std::chrono::milliseconds delta) { 
+                try {
+                    app.Tick(delta); 
+                } catch (const std::exception& e) {
+                    // Например, журнал перестал попадать на диск: сервер останавливается и сохраняет снимок
+                    ServerErrorLog(0, e.what(), "tick");
+                    ioc.stop();
+                }
             }
         );
         ticker->Start();
 
+        // Метрики сжатия можно читать только на стренде API, поэтому все метрики пишет тикер на нём
+        auto log_stats = [&handler, &connection_limiter] {
+            const auto connections = connection_limiter->GetStats();
+            ServerStatsLog(connections.active, connections.rejected, connections.timeouts, 
+                           handler->GetShedRequests(), handler->GetRateLimitedRequests());
+
+            const auto& compression = handler->GetCompressionStats();
+            CompressionStatsLog(compression.compressed, compression.cache_hits, compression.input_bytes,
+                                compression.output_bytes, compression.cpu_us);
+        };
+        std::shared_ptr<game_time::Ticker> stats_ticker;
+        if (arg.stats_period > 0) {
+            stats_ticker = std::make_shared<game_time::Ticker>(strand, std::chrono::milliseconds(arg.stats_period),
+                [&log_stats](std::chrono::milliseconds) {
+                    log_stats();
+                });
+            stats_ticker->Start();
+        }
+
         // 6. Запускаем обработку асинхронных операций
         RunWorkers(std::max(1u, num_threads), [&ioc] {
             ioc.run(); 
         });
 
+        if (serializing_listener) {
+            serializing_listener->SaveStateToFile();
+        }
+
+        log_stats();
+
+        // Итоги, не попавшие на диск, завершают сервер с ошибкой
+        records.Sync();
+
     } catch (const std::exception& ex) {
         ServerStopLog(EXIT_FAILURE, ex.what());
 
@@ -0,0 +1,246 @@
+#include "map_cache.h"
+#include "model_serialization.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace serialization {
+    using namespace std::literals;
+
+    namespace {
+        constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+        constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+        void WriteMap(OutputArchive& ar, const model::Map& map) {
+            ar & *map.GetId() & map.GetName() & map.GetDefaultDogSpeed()
+               & static_cast<int64_t>(map.GetBagCapacity());
+
+            const auto& roads = map.GetRoads();
+            const auto& buildings = map.GetBuildings();
+            const auto& offices = map.GetOffices();
+            ar & static_cast<uint64_t>(roads.size()) & static_cast<uint64_t>(buildings.size())
+               & static_cast<uint64_t>(offices.size());
+
+            for (const auto& road : roads) {
+                const bool horizontal = road.IsHorizontal();
+                ar & horizontal & road.GetStart().x & road.GetStart().y
+                   & (horizontal ? road.GetEnd().x : road.GetEnd().y);
+            }
+
+            for (const auto& building : buildings) {
+                const auto& bounds = building.GetBounds();
+                ar & bounds.position.x & bounds.position.y & bounds.size.width & bounds.size.height;
+            }
+
+            for (const auto& office : offices) {
+                ar & *office.GetId() & office.GetPosition().x & office.GetPosition().y
+                   & office.GetOffset().dx & office.GetOffset().dy;
+            }
+        }
+
+        model::Map ReadMap(InputArchive& ar) {
+            std::string id;
+            std::string name;
+            double default_speed = 0;
+            int64_t bag_capacity = 0;
+            ar & id & name & default_speed & bag_capacity;
+
+            model::Map map(model::Map::Id{std::move(id)}, std::move(name));
+            map.SetDefaultDogSpeed(static_cast<int64_t>(default_speed));
+            map.SetBagCapacity(static_cast<int>(bag_capacity));
+
+            const uint64_t roads_count = ar.ReadSize();
+            const uint64_t buildings_count = ar.ReadSize();
+            const uint64_t offices_count = ar.ReadSize();
+            map.Reserve(roads_count, buildings_count, offices_count);
+
+            for (uint64_t i = 0; i < roads_count; ++i) {
+                bool horizontal = false;
+                model::Point start{};
+                model::Coord end = 0;
+                ar & horizontal & start.x & start.y & end;
+
+                if (horizontal) {
+                    map.AddRoad(model::Road{model::Road::HORIZONTAL, start, end});
+                } else {
+                    map.AddRoad(model::Road{model::Road::VERTICAL, start, end});
+                }
+            }
+
+            for (uint64_t i = 0; i < buildings_count; ++i) {
+                model::Rectangle bounds{};
+                ar & bounds.position.x & bounds.position.y & bounds.size.width & bounds.size.height;
+                map.AddBuilding(model::Building{bounds});
+            }
+
+            for (uint64_t i = 0; i < offices_count; ++i) {
+                std::string office_id;
+                model::Point position{};
+                model::Offset offset{};
+                ar & office_id & position.x & position.y & offset.dx & offset.dy;
+                map.AddOffice(model::Office{model::Office::Id{std::move(office_id)}, position, offset});
+            }
+
+            return map;
+        }
+
+        void WriteRateLimits(OutputArchive& ar, const http_handler::RateLimitConfig& limits) {
+            const auto default_limit = limits.default_limit.value_or(http_handler::RateLimit{});
+            ar & limits.default_limit.has_value() & default_limit.rate & default_limit.burst;
+
+            ar & static_cast<uint64_t>(limits.routes.size());
+            for (const auto& [path, limit] : limits.routes) {
+                ar & path & limit.rate & limit.burst;
+            }
+        }
+
+        http_handler::RateLimitConfig ReadRateLimits(InputArchive& ar) {
+            http_handler::RateLimitConfig limits;
+
+            bool has_default_limit = false;
+            http_handler::RateLimit default_limit;
+            ar & has_default_limit & default_limit.rate & default_limit.burst;
+            if (has_default_limit) {
+                limits.default_limit = default_limit;
+            }
+
+            const uint64_t routes_count = ar.ReadSize();
+            limits.routes.reserve(routes_count);
+            for (uint64_t i = 0; i < routes_count; ++i) {
+                std::string path;
+                http_handler::RateLimit limit;
+                ar & path & limit.rate & limit.burst;
+                limits.routes.emplace_back(std::move(path), limit);
+            }
+
+            return limits;
+        }
+    }
+
+    uint64_t ConfigHash(std::string_view config) {
+        uint64_t hash = FNV_OFFSET;
+        for (unsigned char c : config) {
+            hash ^= c;
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    std::optional<json_loader::GameConfig> LoadMapCache(const fs::path& path, uint64_t config_hash) {
+        if (!fs::exists(path)) {
+            return std::nullopt;
+        }
+
+        try {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("Failed to open map cache for reading");
+            }
+
+            InputArchive ar(in);
+
+            std::string magic;
+            uint32_t version = 0;
+            uint64_t hash = 0;
+            ar & magic & version & hash;
+            if (magic != MAP_CACHE_MAGIC || version != MAP_CACHE_VERSION || hash != config_hash) {
+                std::cout << "Map cache " << path << " is outdated, rebuilding" << std::endl;
+                return std::nullopt;
+            }
+
+            json_loader::GameConfig config;
+
+            bool has_default_speed = false;
+            double default_speed = 0;
+            ar & has_default_speed & default_speed;
+            if (has_default_speed) {
+                config.default_dog_speed = default_speed;
+            }
+
+            bool has_loot_generator = false;
+            loot_gen::LootGeneratorConfig loot_generator;
+            ar & has_loot_generator & loot_generator.period & loot_generator.probability;
+            if (has_loot_generator) {
+                config.loot_generator = loot_generator;
+            }
+
+            uint64_t max_players_per_session = 0;
+            ar & max_players_per_session;
+            config.max_players_per_session = static_cast<size_t>(max_players_per_session);
+            config.rate_limits = ReadRateLimits(ar);
+
+            int64_t dog_retirement_ms = 0;
+            ar & dog_retirement_ms;
+            config.dog_retirement_time = std::chrono::milliseconds(dog_retirement_ms);
+
+            const uint64_t maps_count = ar.ReadSize();
+            config.maps.reserve(maps_count);
+            for (uint64_t i = 0; i < maps_count; ++i) {
+                config.maps.push_back(ReadMap(ar));
+            }
+
+            const uint64_t loot_types_count = ar.ReadSize();
+            for (uint64_t i = 0; i < loot_types_count; ++i) {
+                std::string map_id;
+                std::string loot_types;
+                ar & map_id & loot_types;
+                config.loot_types[model::Map::Id{std::move(map_id)}] =
+                    std::make_shared<boost::json::array>(boost::json::parse(loot_types).as_array());
+            }
+
+            ar.Finish();
+
+            return config;
+        } catch (const std::exception& e) {
+            std::cerr << "Error loading map cache: " << e.what() << ", rebuilding" << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    void SaveMapCache(const json_loader::GameConfig& config, const fs::path& path, uint64_t config_hash) {
+        try {
+            fs::path temp_file = path;
+            temp_file += ".tmp";
+
+            std::ofstream out(temp_file, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                throw std::runtime_error("Failed to open temporary map cache for writing");
+            }
+
+            OutputArchive ar(out);
+            ar & std::string(MAP_CACHE_MAGIC) & MAP_CACHE_VERSION & config_hash;
+
+            ar & config.default_dog_speed.has_value() & config.default_dog_speed.value_or(0.0);
+
+            const auto loot_generator = config.loot_generator.value_or(loot_gen::LootGeneratorConfig{});
+            ar & config.loot_generator.has_value() & loot_generator.period & loot_generator.probability;
+            ar & static_cast<uint64_t>(config.max_players_per_session);
+            WriteRateLimits(ar, config.rate_limits);
+            ar & static_cast<int64_t>(config.dog_retirement_time.count());
+
+            ar & static_cast<uint64_t>(config.maps.size());
+            for (const auto& map : config.maps) {
+                WriteMap(ar, map);
+            }
+
+            ar & static_cast<uint64_t>(config.loot_types.size());
+            for (const auto& [map_id, loot_types] : config.loot_types) {
+                ar & *map_id & boost::json::serialize(*loot_types);
+            }
+
+            ar.Finish();
+            out.close();
+            if (!out) {
+                throw std::runtime_error("Failed to close temporary map cache");
+            }
+
+            fs::rename(temp_file, path);
+        } catch (const std::exception& e) {
+            std::cerr << "Error saving map cache: " << e.what() << std::endl;
+        }
+    }
+
+}  // namespace serialization
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "sdk.h"
+#include "json_loader.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+/*
+ * Бинарный кэш разобранной конфигурации игры.
+ *
+ * Формат: MAGIC, VERSION, хэш файла конфигурации, скорость, настройки генератора трофеев, вместимость сессий,
+ * лимиты частоты запросов, время ухода на пенсию в миллисекундах, карты (дороги, здания и офисы записями фиксированной длины), типы трофеев карт
+ * и CRC32 всего предшествующего содержимого (см. OutputArchive в model_serialization.h).
+ * Кэш годен, пока хэш совпадает с хэшем текущего файла конфигурации, иначе он пересобирается.
+ * Типы трофеев хранятся JSON-строками: сервер отдаёт их клиентам как есть.
+ */
+namespace serialization {
+
+    namespace fs = std::filesystem;
+
+    constexpr std::string_view MAP_CACHE_MAGIC = "GSMC";
+    constexpr uint32_t MAP_CACHE_VERSION = 4;
+
+    // FNV-1a от содержимого файла конфигурации
+    uint64_t ConfigHash(std::string_view config);
+
+    // Возвращает nullopt, если кэша нет, он собран для другой конфигурации или повреждён
+    std::optional<json_loader::GameConfig> LoadMapCache(const fs::path& path, uint64_t config_hash);
+
+    // Ошибки записи не прерывают запуск: без кэша конфигурация просто разбирается заново
+    void SaveMapCache(const json_loader::GameConfig& config, const fs::path& path, uint64_t config_hash);
+
+}  // namespace serialization
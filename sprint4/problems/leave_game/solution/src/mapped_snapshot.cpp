@@ -0,0 +1,460 @@
+#include "mapped_snapshot.h"
+
+#include <boost/crc.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace serialization {
+    using namespace std::literals;
+
+    namespace {
+        template <typename T>
+        constexpr bool IsMappable = std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T>
+                                    && sizeof(T) % 8 == 0;
+
+        static_assert(IsMappable<MappedHeader>);
+        static_assert(IsMappable<MappedSession>);
+        static_assert(IsMappable<MappedDog>);
+        static_assert(IsMappable<MappedBagItem>);
+        static_assert(IsMappable<MappedLostObject>);
+        static_assert(IsMappable<MappedPlayer>);
+        static_assert(IsMappable<MappedTokenIndex>);
+        static_assert(sizeof(MappedLostObject) == 32 && offsetof(MappedLostObject, position) == 16);
+
+        template <typename T>
+        void AppendRecords(std::string& out, const T* records, size_t count) {
+            out.append(reinterpret_cast<const char*>(records), count * sizeof(T));
+        }
+
+        void PadTo8(std::string& out) {
+            out.resize((out.size() + 7) / 8 * 8, '\0');
+        }
+
+        uint32_t HeaderChecksum(MappedHeader header, std::string_view sessions,
+                                std::string_view tokens, std::string_view strings) {
+            header.checksum = 0;
+
+            boost::crc_32_type crc;
+            crc.process_bytes(&header, sizeof(header));
+            crc.process_bytes(sessions.data(), sessions.size());
+            crc.process_bytes(tokens.data(), tokens.size());
+            crc.process_bytes(strings.data(), strings.size());
+            return crc.checksum();
+        }
+
+        uint32_t BlockChecksum(std::string_view block) {
+            boost::crc_32_type crc;
+            crc.process_bytes(block.data(), block.size());
+            return crc.checksum();
+        }
+
+        bool TokenLess(const MappedTokenIndex& lhs, const MappedTokenIndex& rhs) {
+            return std::tie(lhs.token_hi, lhs.token_lo) < std::tie(rhs.token_hi, rhs.token_lo);
+        }
+
+        [[noreturn]] void Corrupted(std::string_view what) {
+            throw std::runtime_error("Corrupted mapped state snapshot: "s + std::string(what));
+        }
+
+        // Таблицы блока сессии. Размер блока уже сверен с числом записей при открытии снимка
+        struct BlockView {
+            const MappedDog* dogs;
+            const MappedBagItem* bag;
+            const MappedLostObject* lost_objects;
+            const MappedPlayer* players;
+            std::string_view names;
+        };
+
+        uint64_t RecordsSize(const MappedSession& entry) {
+            return entry.dog_count * sizeof(MappedDog)
+                 + entry.bag_item_count * sizeof(MappedBagItem)
+                 + entry.lost_object_count * sizeof(MappedLostObject)
+                 + entry.player_count * sizeof(MappedPlayer);
+        }
+
+        BlockView ViewBlock(const MappedSession& entry, std::string_view block) {
+            BlockView view{};
+            view.dogs = reinterpret_cast<const MappedDog*>(block.data());
+            view.bag = reinterpret_cast<const MappedBagItem*>(view.dogs + entry.dog_count);
+            view.lost_objects = reinterpret_cast<const MappedLostObject*>(view.bag + entry.bag_item_count);
+            view.players = reinterpret_cast<const MappedPlayer*>(view.lost_objects + entry.lost_object_count);
+            view.names = block.substr(RecordsSize(entry));
+            return view;
+        }
+    }
+
+    void WriteMappedState(const GameStateRepr& state, std::ostream& out) {
+        MappedHeader header{};
+        std::memcpy(header.magic, MAPPED_SNAPSHOT_MAGIC.data(), sizeof(header.magic));
+        header.version = MAPPED_SNAPSHOT_VERSION;
+        header.next_dog_id = state.counters.next_dog_id;
+        header.next_session_id = state.counters.next_session_id;
+        header.next_lost_object_id = state.counters.next_lost_object_id;
+        header.wal_generation = state.wal_generation;
+        header.session_count = state.sessions.size();
+
+        std::string strings;
+        auto add_string = [](std::string& out, std::string_view str) {
+            const uint64_t offset = out.size();
+            out.append(str);
+            return offset;
+        };
+
+        // Игроки раскладываются по блокам своих сессий
+        std::unordered_map<model::GameSession::Id, size_t> session_index;
+        for (size_t i = 0; i < state.sessions.size(); ++i) {
+            session_index[state.sessions[i].session_id] = i;
+        }
+
+        std::vector<std::vector<MappedPlayer>> players(state.sessions.size());
+        std::vector<MappedTokenIndex> tokens;
+        tokens.reserve(state.players.size());
+        for (const auto& player : state.players) {
+            auto it = session_index.find(player.session_id);
+            if (it == session_index.end()) {
+                throw std::runtime_error("Player refers to unknown session");
+            }
+            players[it->second].push_back(MappedPlayer{player.token.hi, player.token.lo, player.dog_id, 
+                                                       player.activity.play_time.count(), 
+                                                       player.activity.idle_left.count()});
+            tokens.push_back(MappedTokenIndex{player.token.hi, player.token.lo, it->second});
+        }
+
+        std::vector<MappedSession> sessions(state.sessions.size());
+        // Блоки наполненных сессий собираются заново, ненаполненных - ссылаются на исходный снимок
+        std::vector<std::string> built_blocks(state.sessions.size());
+        std::vector<std::string_view> blocks(state.sessions.size());
+        for (size_t i = 0; i < state.sessions.size(); ++i) {
+            const SessionRepr& session = state.sessions[i];
+            MappedSession& entry = sessions[i];
+
+            if (session.cold) {
+                const auto index = state.cold_source ? state.cold_source->FindSession(session.session_id)
+                                                     : std::nullopt;
+                if (!index) {
+                    throw std::runtime_error("Cold session is missing in the source snapshot");
+                }
+
+                entry = state.cold_source->GetSession(*index);
+                blocks[i] = state.cold_source->GetBlock(*index);
+
+                const auto view = ViewBlock(entry, blocks[i]);
+                for (uint64_t j = 0; j < entry.player_count; ++j) {
+                    tokens.push_back(MappedTokenIndex{view.players[j].token_hi, view.players[j].token_lo, i});
+                }
+            } else {
+                std::vector<MappedDog> dogs;
+                std::vector<MappedBagItem> bag;
+                std::string names;
+                dogs.reserve(session.dogs.size());
+                for (const DogRepr& repr : session.dogs) {
+                    MappedDog& dog = dogs.emplace_back();
+                    dog.id = repr.GetId();
+                    dog.name_offset = add_string(names, repr.GetName());
+                    dog.name_size = static_cast<uint32_t>(repr.GetName().size());
+                    dog.direction = static_cast<uint32_t>(repr.GetDirection());
+                    dog.x = repr.GetPosition().x;
+                    dog.y = repr.GetPosition().y;
+                    dog.speed_x = repr.GetSpeed().x;
+                    dog.speed_y = repr.GetSpeed().y;
+                    dog.default_speed = repr.GetDefaultSpeed();
+                    dog.score = repr.GetScore();
+                    dog.bag_capacity = static_cast<uint32_t>(repr.GetBagCapacity());
+                    dog.bag_size = static_cast<uint32_t>(repr.GetBag().size());
+                    dog.bag_begin = bag.size();
+                    for (const auto& [loot_id, loot_type] : repr.GetBag()) {
+                        bag.push_back(MappedBagItem{loot_id, loot_type});
+                    }
+                }
+                PadTo8(names);
+
+                std::string& block = built_blocks[i];
+                AppendRecords(block, dogs.data(), dogs.size());
+                AppendRecords(block, bag.data(), bag.size());
+                AppendRecords(block, session.lost_objects.data(), session.lost_objects.size());
+                AppendRecords(block, players[i].data(), players[i].size());
+                block.append(names);
+                blocks[i] = block;
+
+                entry.session_id = session.session_id;
+                entry.dog_count = dogs.size();
+                entry.bag_item_count = bag.size();
+                entry.lost_object_count = session.lost_objects.size();
+                entry.player_count = players[i].size();
+                entry.names_size = names.size();
+                entry.block_size = block.size();
+                entry.checksum = BlockChecksum(block);
+            }
+
+            entry.map_id_offset = add_string(strings, session.map_id);
+            entry.map_id_size = static_cast<uint32_t>(session.map_id.size());
+        }
+        PadTo8(strings);
+        std::sort(tokens.begin(), tokens.end(), TokenLess);
+
+        header.sessions_offset = sizeof(MappedHeader);
+        header.token_count = tokens.size();
+        header.tokens_offset = header.sessions_offset + sessions.size() * sizeof(MappedSession);
+        header.strings_offset = header.tokens_offset + tokens.size() * sizeof(MappedTokenIndex);
+        header.strings_size = strings.size();
+
+        uint64_t offset = header.strings_offset + strings.size();
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            sessions[i].block_offset = offset;
+            offset += blocks[i].size();
+        }
+        header.file_size = offset;
+
+        const std::string_view sessions_bytes(reinterpret_cast<const char*>(sessions.data()),
+                                              sessions.size() * sizeof(MappedSession));
+        const std::string_view tokens_bytes(reinterpret_cast<const char*>(tokens.data()),
+                                            tokens.size() * sizeof(MappedTokenIndex));
+        header.checksum = HeaderChecksum(header, sessions_bytes, tokens_bytes, strings);
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(sessions_bytes.data(), static_cast<std::streamsize>(sessions_bytes.size()));
+        out.write(tokens_bytes.data(), static_cast<std::streamsize>(tokens_bytes.size()));
+        out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+        for (const auto& block : blocks) {
+            out.write(block.data(), static_cast<std::streamsize>(block.size()));
+        }
+        out.flush();
+
+        if (!out) {
+            throw std::runtime_error("Failed to write mapped state snapshot");
+        }
+    }
+
+    bool MappedSnapshot::IsMappedSnapshot(const fs::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[MAPPED_SNAPSHOT_MAGIC.size()] = {};
+        in.read(magic, sizeof(magic));
+
+        return in && std::string_view(magic, sizeof(magic)) == MAPPED_SNAPSHOT_MAGIC;
+    }
+
+    std::shared_ptr<MappedSnapshot> MappedSnapshot::Open(const fs::path& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to open "s + path.string());
+        }
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(MappedHeader)) {
+            ::close(fd);
+            Corrupted("file is too small");
+        }
+
+        const size_t size = static_cast<size_t>(st.st_size);
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        const int error = errno;
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "Failed to map "s + path.string());
+        }
+
+        // Проверка выполняется уже после того, как отображение перешло под управление объекта
+        std::shared_ptr<MappedSnapshot> snapshot(new MappedSnapshot(static_cast<const char*>(data), size));
+        snapshot->Validate();
+        return snapshot;
+    }
+
+    MappedSnapshot::MappedSnapshot(const char* data, size_t size)
+        : data_(data)
+        , size_(size) {
+    }
+
+    MappedSnapshot::~MappedSnapshot() {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+
+    template <typename T>
+    const T* MappedSnapshot::TableAt(uint64_t offset, uint64_t count) const {
+        if (offset % alignof(T) != 0 || offset > size_ || count > (size_ - offset) / sizeof(T)) {
+            Corrupted("table is out of bounds");
+        }
+        return reinterpret_cast<const T*>(data_ + offset);
+    }
+
+    void MappedSnapshot::Validate() {
+        header_ = TableAt<MappedHeader>(0, 1);
+        const MappedHeader& header = *header_;
+
+        if (std::string_view(header.magic, sizeof(header.magic)) != MAPPED_SNAPSHOT_MAGIC) {
+            Corrupted("bad magic");
+        }
+        if (header.version != MAPPED_SNAPSHOT_VERSION) {
+            throw std::runtime_error("Unsupported mapped state snapshot version: "s + std::to_string(header.version));
+        }
+        if (header.file_size != size_) {
+            Corrupted("file size mismatch");
+        }
+
+        sessions_ = TableAt<MappedSession>(header.sessions_offset, header.session_count);
+        tokens_ = TableAt<MappedTokenIndex>(header.tokens_offset, header.token_count);
+        TableAt<char>(header.strings_offset, header.strings_size);
+
+        const std::string_view sessions_bytes(reinterpret_cast<const char*>(sessions_),
+                                              header.session_count * sizeof(MappedSession));
+        const std::string_view tokens_bytes(reinterpret_cast<const char*>(tokens_),
+                                            header.token_count * sizeof(MappedTokenIndex));
+        const std::string_view strings(data_ + header.strings_offset, header.strings_size);
+        if (HeaderChecksum(header, sessions_bytes, tokens_bytes, strings) != header.checksum) {
+            Corrupted("checksum mismatch");
+        }
+
+        session_index_.reserve(header.session_count);
+        for (uint64_t i = 0; i < header.session_count; ++i) {
+            const MappedSession& entry = sessions_[i];
+            GetString(entry.map_id_offset, entry.map_id_size);
+
+            if (entry.names_size % 8 != 0 || entry.block_size != RecordsSize(entry) + entry.names_size) {
+                Corrupted("session block size mismatch");
+            }
+            TableAt<MappedDog>(entry.block_offset, 0);
+            TableAt<char>(entry.block_offset, entry.block_size);
+
+            if (!session_index_.emplace(entry.session_id, i).second) {
+                Corrupted("duplicate session");
+            }
+        }
+
+        for (uint64_t i = 0; i < header.token_count; ++i) {
+            if (tokens_[i].session_index >= header.session_count) {
+                Corrupted("token refers to unknown session");
+            }
+        }
+    }
+
+    std::string_view MappedSnapshot::GetString(uint64_t offset, uint64_t size) const {
+        const MappedHeader& header = *header_;
+        if (offset > header.strings_size || size > header.strings_size - offset) {
+            Corrupted("string is out of bounds");
+        }
+        return {data_ + header.strings_offset + offset, size};
+    }
+
+    std::string_view MappedSnapshot::GetBlock(size_t index) const {
+        const MappedSession& entry = sessions_[index];
+        return {data_ + entry.block_offset, entry.block_size};
+    }
+
+    std::optional<size_t> MappedSnapshot::FindSession(model::GameSession::Id session_id) const {
+        auto it = session_index_.find(session_id);
+        if (it == session_index_.end()) {
+            return std::nullopt;
+        }
+
+        return it->second;
+    }
+
+    std::optional<size_t> MappedSnapshot::FindSessionByToken(const app::Token& token) const {
+        const MappedTokenIndex key{token.hi, token.lo, 0};
+
+        const MappedTokenIndex* end = tokens_ + header_->token_count;
+        const MappedTokenIndex* it = std::lower_bound(tokens_, end, key, TokenLess);
+        if (it == end || it->token_hi != token.hi || it->token_lo != token.lo) {
+            return std::nullopt;
+        }
+
+        return static_cast<size_t>(it->session_index);
+    }
+
+    void MappedSnapshot::Materialize(size_t index, app::Application& app,
+                                     const std::shared_ptr<model::GameSession>& session) const {
+        const MappedSession& entry = sessions_[index];
+        const std::string_view block = GetBlock(index);
+        if (BlockChecksum(block) != entry.checksum) {
+            Corrupted("session block checksum mismatch");
+        }
+
+        const auto [dogs, bag, lost_objects, players, names] = ViewBlock(entry, block);
+
+        for (uint64_t i = 0; i < entry.dog_count; ++i) {
+            const MappedDog& mapped = dogs[i];
+            if (mapped.direction > static_cast<uint32_t>(model::Direction::DEFAULT)
+                || mapped.bag_size > mapped.bag_capacity
+                || mapped.bag_begin > entry.bag_item_count
+                || mapped.bag_size > entry.bag_item_count - mapped.bag_begin
+                || mapped.name_offset > names.size()
+                || mapped.name_size > names.size() - mapped.name_offset) {
+                Corrupted("invalid dog "s + std::to_string(mapped.id));
+            }
+
+            auto dog = std::make_shared<model::Dog>(mapped.id, names.substr(mapped.name_offset, mapped.name_size));
+            dog->SetDefaultDogSpeed(mapped.default_speed);
+            dog->SetBagCapacity(mapped.bag_capacity);
+            dog->SetSpeed(mapped.speed_x, mapped.speed_y);
+            dog->SetDirection(static_cast<model::Direction>(mapped.direction));
+            dog->AddScore(static_cast<int>(mapped.score));
+            for (uint64_t j = mapped.bag_begin; j < mapped.bag_begin + mapped.bag_size; ++j) {
+                dog->AddToBag(bag[j].loot_id, bag[j].loot_type);
+            }
+
+            session->AddDog(dog, model::Pos{mapped.x, mapped.y});
+        }
+
+        session->AddLostObjects({lost_objects, entry.lost_object_count});
+
+        const auto& session_dogs = session->GetDogs();
+        for (uint64_t i = 0; i < entry.player_count; ++i) {
+            auto dog = session_dogs.find(players[i].dog_id);
+            if (dog == session_dogs.end()) {
+                Corrupted("unknown dog of player");
+            }
+
+            const app::PlayerActivity activity{std::chrono::milliseconds{players[i].play_time_ms}, 
+                                               std::chrono::milliseconds{players[i].idle_left_ms}};
+            app.RestorePlayer(app::Token{players[i].token_hi, players[i].token_lo}, dog->second, session, activity);
+        }
+    }
+
+    uint64_t LoadMappedState(app::Application& app, std::shared_ptr<const MappedSnapshot> snapshot) {
+        const MappedHeader& header = snapshot->GetHeader();
+        auto& session_service = app.GetGame().GetSessionService();
+
+        for (size_t i = 0; i < header.session_count; ++i) {
+            const MappedSession& entry = snapshot->GetSession(i);
+            const auto map_id = snapshot->GetString(entry.map_id_offset, entry.map_id_size);
+
+            session_service.RestoreGameSession(model::Map::Id{std::string(map_id)}, entry.session_id);
+            session_service.SetColdSession(entry.session_id,
+                [snapshot, &app, i](const std::shared_ptr<model::GameSession>& session) {
+                    snapshot->Materialize(i, app, session);
+                });
+        }
+
+        // Первое обращение игрока из холодной сессии наполняет её
+        app.SetColdPlayerResolver([snapshot, &session_service](const app::Token& token) {
+            if (auto index = snapshot->FindSessionByToken(token)) {
+                session_service.FindGameSessionBySessionId(snapshot->GetSession(*index).session_id);
+            }
+        });
+        // Снимок не меняется, поэтому его индекс токенов можно читать из любого потока.
+        // Токены игроков, ушедших после наполнения сессии, тоже остаются известными
+        app.SetColdTokenChecker([snapshot](const app::Token& token) {
+            return snapshot->FindSessionByToken(token).has_value();
+        });
+
+        model::Dog::SetNextId(header.next_dog_id);
+        model::GameSession::SetNextId(header.next_session_id);
+        model::GameSession::SetNextLostObjectId(header.next_lost_object_id);
+
+        return header.wal_generation;
+    }
+
+}  // namespace serialization
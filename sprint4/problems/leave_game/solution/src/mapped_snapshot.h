@@ -0,0 +1,161 @@
+#pragma once
+
+#include "sdk.h"
+#include "application.h"
+#include "model.h"
+#include "model_serialization.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+
+/*
+ * Снимок состояния, который читается через mmap без разбора.
+ *
+ * Все числа - в порядке байт платформы, все таблицы выровнены на 8 байт:
+ *   MappedHeader
+ *   MappedSession[session_count]       - таблица сессий
+ *   MappedTokenIndex[token_count]      - все токены, отсортированные для двоичного поиска
+ *   строки (id карт), на которые ссылаются записи сессий по смещению и длине
+ *   блоки сессий: MappedDog[], MappedBagItem[], MappedLostObject[], MappedPlayer[], имена собак
+ *
+ * При открытии проверяются заголовок, границы таблиц и CRC32 заголовка, таблиц и строк.
+ * Блок сессии защищён своей CRC32 и проверяется при наполнении сессии. Наполнение ленивое:
+ * сессии регистрируются пустыми и заполняются при первом обращении к ним или к их игрокам.
+ * Блок ни на что вне себя не ссылается, поэтому блоки так и не наполненных сессий
+ * переносятся в следующий снимок байт в байт.
+ */
+namespace serialization {
+
+    namespace fs = std::filesystem;
+
+    constexpr std::string_view MAPPED_SNAPSHOT_MAGIC{"GSSNMAP\0", 8};
+    // Версия 2: токены хранятся двумя 64-битными числами, как app::Token.
+    // Версия 3: имена собак хранятся в блоке своей сессии.
+    // Версия 4: у игрока хранятся время в игре и остаток простоя до пенсии
+    constexpr uint32_t MAPPED_SNAPSHOT_VERSION = 4;
+
+    struct MappedHeader {
+        char magic[8];
+        uint32_t version;
+        // CRC32 заголовка (с нулём в этом поле), таблицы сессий, индекса токенов и строк
+        uint32_t checksum;
+        uint64_t file_size;
+        uint64_t next_dog_id;
+        uint64_t next_session_id;
+        uint64_t next_lost_object_id;
+        uint64_t wal_generation;
+        uint64_t session_count;
+        uint64_t sessions_offset;
+        uint64_t token_count;
+        uint64_t tokens_offset;
+        uint64_t strings_offset;
+        uint64_t strings_size;
+    };
+
+    struct MappedSession {
+        uint64_t session_id;
+        uint64_t map_id_offset;
+        uint32_t map_id_size;
+        uint32_t checksum;
+        uint64_t block_offset;
+        uint64_t block_size;
+        uint64_t dog_count;
+        uint64_t bag_item_count;
+        uint64_t lost_object_count;
+        uint64_t player_count;
+        // Размер области имён в конце блока, кратный 8
+        uint64_t names_size;
+    };
+
+    struct MappedDog {
+        uint64_t id;
+        // Смещение от начала области имён блока
+        uint64_t name_offset;
+        uint32_t name_size;
+        uint32_t direction;
+        double x, y;
+        double speed_x, speed_y;
+        double default_speed;
+        int64_t score;
+        uint32_t bag_capacity;
+        uint32_t bag_size;
+        // Индекс первого предмета рюкзака в MappedBagItem[] сессии
+        uint64_t bag_begin;
+    };
+
+    struct MappedBagItem {
+        int32_t loot_id;
+        int32_t loot_type;
+    };
+
+    // Совпадает по раскладке с model::GameSession::LostObject и копируется в сессию целиком
+    using MappedLostObject = model::GameSession::LostObject;
+
+    struct MappedPlayer {
+        uint64_t token_hi;
+        uint64_t token_lo;
+        uint64_t dog_id;
+        int64_t play_time_ms;
+        int64_t idle_left_ms;
+    };
+
+    struct MappedTokenIndex {
+        uint64_t token_hi;
+        uint64_t token_lo;
+        uint64_t session_index;
+    };
+
+    // Блоки ненаполненных сессий берутся из state.cold_source
+    void WriteMappedState(const GameStateRepr& state, std::ostream& out);
+
+    class MappedSnapshot {
+    public:
+        // Отображает файл в память и проверяет заголовок и таблицы
+        static std::shared_ptr<MappedSnapshot> Open(const fs::path& path);
+
+        // Проверяет, записан ли файл в этом формате
+        static bool IsMappedSnapshot(const fs::path& path);
+
+        ~MappedSnapshot();
+
+        MappedSnapshot(const MappedSnapshot&) = delete;
+        MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+        const MappedHeader& GetHeader() const noexcept { return *header_; }
+        const MappedSession& GetSession(size_t index) const { return sessions_[index]; }
+        std::string_view GetString(uint64_t offset, uint64_t size) const;
+        std::string_view GetBlock(size_t index) const;
+
+        std::optional<size_t> FindSession(model::GameSession::Id session_id) const;
+        std::optional<size_t> FindSessionByToken(const app::Token& token) const;
+
+        // Проверяет блок сессии и переносит его содержимое в session и в приложение
+        void Materialize(size_t index, app::Application& app,
+                         const std::shared_ptr<model::GameSession>& session) const;
+
+    private:
+        MappedSnapshot(const char* data, size_t size);
+
+        void Validate();
+
+        template <typename T>
+        const T* TableAt(uint64_t offset, uint64_t count) const;
+
+        const char* data_;
+        size_t size_;
+        const MappedHeader* header_ = nullptr;
+        const MappedSession* sessions_ = nullptr;
+        const MappedTokenIndex* tokens_ = nullptr;
+        std::unordered_map<model::GameSession::Id, size_t> session_index_;
+    };
+
+    // Регистрирует сессии снимка пустыми, с отложенным наполнением.
+    // Возвращает поколение журнала упреждающей записи, с которого нужно продолжить восстановление
+    uint64_t LoadMappedState(app::Application& app, std::shared_ptr<const MappedSnapshot> snapshot);
+
+}  // namespace serialization
@@ -83,6 +83,13 @@ using namespace std::literals;
         buildings_.emplace_back(building);
     }
 
+    void Map::Reserve(size_t roads, size_t buildings, size_t offices) {
+        roads_.reserve(roads);
+        buildings_.reserve(buildings);
+        offices_.reserve(offices);
+        warehouse_id_to_index_.reserve(offices);
+    }
+
     void Map::AddOffice(Office office) {
         if (warehouse_id_to_index_.contains(office.GetId())) {
             throw std::invalid_argument("Duplicate warehouse");
@@ -105,6 +112,10 @@ using namespace std::literals;
         state_.id = general_id_++;
     };
 
+    Dog::Dog(Id id, std::string_view name) : name_(std::string(name)) {
+        state_.id = id;
+    }
+
     const Dog::Id Dog::GetId() const {
         return state_.id;
     }
@@ -142,55 +153,104 @@ using namespace std::literals;
         state_.speed = {0, 0};
     }
 
-    void Dog::SetDogDirSpeed(std::string dir) {
-        if (dir == "") {
-            SetSpeed(0, 0);
-        } else if (dir == "L") {
-            SetSpeed(-default_dog_speed_, 0);
-            state_.direction = Direction::WEST;
-        } else if (dir == "R") {
-            SetSpeed(default_dog_speed_, 0);
-            state_.direction = Direction::EAST;
-        } else if (dir == "U") {
-            SetSpeed(0, -default_dog_speed_);
-            state_.direction = Direction::NORTH;
-        } else if (dir == "D") {
-            SetSpeed(0, default_dog_speed_);
-            state_.direction = Direction::SOUTH;
-        } else {
-            assert(false);
+    std::optional<Move> ParseMove(std::string_view move) noexcept {
+        if (move.empty()) return Move::STOP;
+        if (move.size() != 1) return std::nullopt;
+
+        switch (move.front()) {
+            case 'L': return Move::LEFT;
+            case 'R': return Move::RIGHT;
+            case 'U': return Move::UP;
+            case 'D': return Move::DOWN;
+            default: return std::nullopt;
         }
+    }
 
-        return;
-        
+    std::string_view MoveToString(Move move) noexcept {
+        switch (move) {
+            case Move::LEFT: return "L";
+            case Move::RIGHT: return "R";
+            case Move::UP: return "U";
+            case Move::DOWN: return "D";
+            case Move::STOP: break;
+        }
+        return "";
+    }
+
+    void Dog::SetDogDirSpeed(Move move) {
+        switch (move) {
+            case Move::STOP:
+                SetSpeed(0, 0);
+                break;
+            case Move::LEFT:
+                SetSpeed(-default_dog_speed_, 0);
+                state_.direction = Direction::WEST;
+                break;
+            case Move::RIGHT:
+                SetSpeed(default_dog_speed_, 0);
+                state_.direction = Direction::EAST;
+                break;
+            case Move::UP:
+                SetSpeed(0, -default_dog_speed_);
+                state_.direction = Direction::NORTH;
+                break;
+            case Move::DOWN:
+                SetSpeed(0, default_dog_speed_);
+                state_.direction = Direction::SOUTH;
+                break;
+        }
     }
 
     const State& Dog::GetState() const noexcept {
         return state_;
     }
 
-    std::shared_ptr<GameSession> SessionService::CreateGameSession(Map::Id map_id) {
-        auto& map = common_data_.maps_[common_data_.map_id_to_index_[map_id]];
+    std::shared_ptr<GameSession> SessionService::CreateGameSession(Map::Handle map_handle) {
+        const auto& map = common_data_.maps_.at(map_handle);
+
+        // Создаём GameSession с lootId_to_value_
+        return RegisterGameSession(std::make_shared<GameSession>(map, MakeLootValues(map_handle)));
+    }
+
+    std::shared_ptr<GameSession> 
+    SessionService::RestoreGameSession(const Map::Id& map_id, GameSession::Id session_id) {
+        auto map_it = common_data_.map_id_to_handle_.find(map_id);
+        if (map_it == common_data_.map_id_to_handle_.end()) {
+            throw std::invalid_argument("Map with id "s + *map_id + " not found"s);
+        }
+
+        if (common_data_.game_sessions_id_to_index_.count(session_id)) {
+            throw std::invalid_argument("Game session "s + std::to_string(session_id) + " already exists"s);
+        }
 
+        const auto& map = common_data_.maps_[map_it->second];
+        return RegisterGameSession(
+            std::make_shared<GameSession>(map, MakeLootValues(map_it->second), session_id));
+    }
+
+    std::unordered_map<int, int> SessionService::MakeLootValues(Map::Handle map_handle) const {
         // Наполняем lootId_to_value_
         std::unordered_map<int, int> loot_values;
-        auto it = common_data_.mapId_to_lootTypes_.find(map_id);
         int item_type = 0;
-        if (it != common_data_.mapId_to_lootTypes_.end()) {
-            const auto& loot_array = *it->second;
+        if (const auto& loot_types = common_data_.map_loot_types_.at(map_handle)) {
+            const auto& loot_array = *loot_types;
             for (const auto& item : loot_array) {
                 int value = item.at("value").as_int64();
                 loot_values[item_type++] = value;
             }
         }
 
-        // Создаём GameSession с lootId_to_value_
-        auto result = std::make_shared<GameSession>(map, std::move(loot_values));
+        return loot_values;
+    }
+
+    std::shared_ptr<GameSession> 
+    SessionService::RegisterGameSession(std::shared_ptr<GameSession> result) {
+        const Map::Handle map_handle = result->GetMapHandle();
 
         int index = common_data_.sessions_.size();
         common_data_.sessions_.push_back(result);
         common_data_.game_sessions_id_to_index_[result->GetSessionId()] = index;
-        common_data_.mapId_to_session_index_[map_id] = result->GetSessionId();
+        common_data_.map_sessions_[map_handle].push_back(result->GetSessionId());
 
         return result;
     }
@@ -203,24 +263,45 @@ using namespace std::literals;
         InitializeRegions(map_, regions_);
     }
 
+    GameSession::GameSession(const Map& map, std::unordered_map<int, int> loot_values, Id id)
+        : map_(map)
+        , id_(id)
+        , bag_capacity_(map.GetBagCapacity())
+        , lootId_to_value_(std::move(loot_values)) {
+        InitializeRegions(map_, regions_);
+    }
 
-    Map::Id GameSession::GetMapId() const {
+
+    const Map::Id& GameSession::GetMapId() const noexcept {
         return map_.GetId();
     }
 
+    Map::Handle GameSession::GetMapHandle() const noexcept {
+        return map_.GetHandle();
+    }
+
     double GameSession::GetMapDefaultSpeed() const {
         return map_.GetDefaultDogSpeed();
     }
 
     GameSession::Id GameSession::GetSessionId() const {
-        return general_id_;
+        return id_;
     }
 
     void GameSession::AddDog(std::shared_ptr<Dog> dog) {
         if (dogs_.count(dog->GetId()) == 0) {
-            dog->SetRandomPosition(GenerateRandomRoadPosition());
+            AddDog(dog, GenerateRandomRoadPosition());
+        }
+    }
+
+    void GameSession::AddDog(std::shared_ptr<Dog> dog, Pos position) {
+        if (dogs_.count(dog->GetId()) == 0) {
+            dog->SetRandomPosition(position);
             dogs_.insert({dog->GetId(), dog});
             dogs_vector_.push_back(dog);
+            roster_.insert(dog->GetName());
+            ++roster_version_;
+            ++state_version_;
         }
     }
 
@@ -261,6 +342,7 @@ using namespace std::literals;
             Pos max_pos = AdjustPositionToMaxRegion(dog);
             dog->MoveDog(max_pos);
             dog->StopDog();
+            stopped_dogs_.push_back(id);
         }
     }
 
@@ -317,6 +399,7 @@ using namespace std::literals;
 
     void GameSession::StopPlayer(Dog::Id id) {
         dogs_[id]->StopDog();
+        ++state_version_;
     }
 
     std::vector<collision_detector::Gatherer> GameSession::GetGatherers(double delta_time) const {
@@ -454,12 +537,19 @@ using namespace std::literals;
 
         // 6. Двигаем игроков на оставшееся время
         MoveRemainingPlayers(delta_time, events);
+
+        ++state_version_;
     }
 
     void GameSession::RemoveDog(Dog::Id id) {
-        if (dogs_.count(id) == 0) return; // Собака уже удалена
+        auto dog = dogs_.find(id);
+        if (dog == dogs_.end()) return; // Собака уже удалена
 
-        dogs_.erase(id);
+        roster_.erase(roster_.find(dog->second->GetName()));
+        ++roster_version_;
+        ++state_version_;
+
+        dogs_.erase(dog);
         auto it = std::remove_if(dogs_vector_.begin(), dogs_vector_.end(),
                                 [id](const auto& dog) { return dog->GetId() == id; });
         dogs_vector_.erase(it, dogs_vector_.end());
@@ -519,37 +609,33 @@ using namespace std::literals;
     }
 
     Pos GameSession::GenerateRandomRoadPosition() {
+        return GenerateRandomRoadPosition(random_engine_);
+    }
+
+    Pos GameSession::GenerateRandomRoadPosition(RandomEngine& engine) {
         Pos pos;
         int size = regions_.size();
-        int random_road_index = GenerateRandomInt(0, size - 1);
+        int random_road_index = GenerateRandomInt(0, size - 1, engine);
         auto road = GetElementByIndex(regions_, random_road_index).second;
 
-        pos.x = GenerateRandomDouble(road.min_x, road.max_x);
-        pos.y = GenerateRandomDouble(road.min_y, road.max_y);
+        pos.x = GenerateRandomDouble(road.min_x, road.max_x, engine);
+        pos.y = GenerateRandomDouble(road.min_y, road.max_y, engine);
 
         return pos;
     }
 
-    double GameSession::GenerateRandomDouble(double from, double to) {
-        std::random_device rd;
-
-        std::mt19937 gen(rd());
-
+    double GameSession::GenerateRandomDouble(double from, double to, RandomEngine& engine) {
         // Определение распределения для чисел с плавающей запятой в интервале [from, to]
         std::uniform_real_distribution<double> dis(from, to);
 
-        return dis(gen);
+        return dis(engine);
     }
 
-    int GameSession::GenerateRandomInt(int from, int to) {
-        std::random_device rd;
-
-        std::mt19937 gen(rd());
-
-        // Определение распределения для чисел с плавающей запятой в интервале [from, to]
+    int GameSession::GenerateRandomInt(int from, int to, RandomEngine& engine) {
+        // Определение распределения для целых чисел в интервале [from, to]
         std::uniform_int_distribution<int> dis(from, to);
 
-        return dis(gen);
+        return dis(engine);
     }
 
     uint64_t GameSession::GetLootCount() {
@@ -557,25 +643,50 @@ using namespace std::literals;
     }
 
     void GameSession::GenerateLoot(int count, int loot_types_count) {
+        GenerateLoot(count, loot_types_count, random_engine_());
+    }
+
+    void GameSession::GenerateLoot(int count, int loot_types_count, uint64_t seed) {
+        if (loot_types_count <= 0) {
+            return;
+        }
+
+        RandomEngine engine{seed};
+        std::uniform_int_distribution<uint64_t> type_dist(0, loot_types_count - 1);
+
         while (loots_.size() < dogs_.size() && count > 0) {
+            const uint64_t type = type_dist(engine);
             loots_.push_back(
                 LostObject{.id = lost_object_id_++, 
-                             .type = static_cast<uint64_t>(rand() % loot_types_count), 
-                             .position = GenerateRandomRoadPosition()}
+                           .type = type, 
+                           .position = GenerateRandomRoadPosition(engine)}
                 );
             --count;
+            ++state_version_;
         }
     }
 
     void MapService::AddMap(Map map) {
-        const size_t index = common_data_.maps_.size();
-        if (auto [it, inserted] = common_data_.map_id_to_index_.emplace(map.GetId(), index); !inserted) {
+        const auto handle = static_cast<Map::Handle>(common_data_.maps_.size());
+        if (auto [it, inserted] = common_data_.map_id_to_handle_.emplace(map.GetId(), handle); !inserted) {
             throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
         } else {
             try {
-               common_data_. maps_.emplace_back(std::move(map));
+                map.SetHandle(handle);
+                common_data_.maps_.emplace_back(std::move(map));
+                common_data_.map_sessions_.emplace_back();
+                common_data_.map_loot_types_.emplace_back();
             } catch (...) {
-                common_data_.map_id_to_index_.erase(it);
+                // Откатываем таблицы, которые успели вырасти
+                auto rollback = [handle](auto& table) {
+                    if (table.size() > handle) {
+                        table.pop_back();
+                    }
+                };
+                rollback(common_data_.maps_);
+                rollback(common_data_.map_sessions_);
+                rollback(common_data_.map_loot_types_);
+                common_data_.map_id_to_handle_.erase(it);
                 throw;
             }
         }
@@ -594,7 +705,14 @@ using namespace std::literals;
     }
 
     void LootService::ConfigureLootTypes(CommonData::MapLootTypes loot_types) {
-        common_data_.mapId_to_lootTypes_ = std::move(loot_types);
+        // Карты к этому моменту уже добавлены и получили свои номера
+        for (auto& [map_id, types] : loot_types) {
+            auto it = common_data_.map_id_to_handle_.find(map_id);
+            if (it == common_data_.map_id_to_handle_.end()) {
+                throw std::invalid_argument("Loot types refer to unknown map "s + *map_id);
+            }
+            common_data_.map_loot_types_[it->second] = std::move(types);
+        }
     }
 
     void LootService::ConfigureLootGenerator(double period, double probability) {
@@ -607,14 +725,69 @@ using namespace std::literals;
         return default_dog_speed_;
     }
 
-    std::shared_ptr<GameSession> SessionService::FindGameSession(Map::Id map_id) {
-        // if (!FindMap(map_id)) { return nullptr;}
+    std::shared_ptr<GameSession> SessionService::FindGameSession(const Map::Id& map_id) {
+        auto it = common_data_.map_id_to_handle_.find(map_id);
+        if (it == common_data_.map_id_to_handle_.end()) {
+            return nullptr;
+        }
 
-        if (common_data_.mapId_to_session_index_.count(map_id)) {
-            return FindGameSessionBySessionId(common_data_.mapId_to_session_index_[map_id]);
+        return FindGameSession(it->second);
+    }
+
+    std::shared_ptr<GameSession> SessionService::FindGameSession(Map::Handle map_handle) {
+        const auto& session_ids = common_data_.map_sessions_.at(map_handle);
+
+        // Ненаполненные сессии выглядят пустыми, поэтому наполняются до выбора
+        if (!common_data_.cold_sessions_.empty()) {
+            for (auto session_id : std::vector<GameSession::Id>(session_ids)) {
+                Materialize(session_id);
+            }
+        }
+
+        std::shared_ptr<GameSession> least_loaded;
+        for (auto session_id : session_ids) {
+            const auto session = common_data_.sessions_[common_data_.game_sessions_id_to_index_.at(session_id)];
+            if (!least_loaded || session->GetDogs().size() < least_loaded->GetDogs().size()) {
+                least_loaded = session;
+            }
+        }
+
+        if (least_loaded && 
+            (max_players_per_session_ == 0 || least_loaded->GetDogs().size() < max_players_per_session_)) {
+            return least_loaded;
         }
 
-        return CreateGameSession(map_id);
+        return CreateGameSession(map_handle);
+    }
+
+    bool SessionService::ReclaimIfEmpty(GameSession::Id session_id) {
+        // Без ограничения карта играется в одной сессии, и её трофеи дожидаются следующих игроков
+        if (max_players_per_session_ == 0) {
+            return false;
+        }
+
+        auto it = common_data_.game_sessions_id_to_index_.find(session_id);
+        if (it == common_data_.game_sessions_id_to_index_.end() || IsColdSession(session_id)) {
+            return false;
+        }
+
+        const size_t index = it->second;
+        auto& sessions = common_data_.sessions_;
+        if (!sessions[index]->GetDogs().empty()) {
+            return false;
+        }
+
+        std::erase(common_data_.map_sessions_[sessions[index]->GetMapHandle()], session_id);
+        common_data_.game_sessions_id_to_index_.erase(it);
+
+        // Последняя сессия занимает место удалённой
+        if (index + 1 != sessions.size()) {
+            sessions[index] = std::move(sessions.back());
+            common_data_.game_sessions_id_to_index_[sessions[index]->GetSessionId()] = index;
+        }
+        sessions.pop_back();
+
+        return true;
     }
 
     void SessionService::Tick(std::chrono::milliseconds delta_time) {
@@ -625,6 +798,15 @@ using namespace std::literals;
         }
     }
 
+    void SessionService::Tick(std::chrono::milliseconds delta_time, const ParallelFor& parallel_for) {
+        const double delta = static_cast<double>(delta_time.count()) / 1000.0;
+        const auto& sessions = common_data_.sessions_;
+
+        parallel_for(sessions.size(), [&sessions, delta](size_t index) {
+            sessions[index]->Tick(delta);
+        });
+    }
+
     SessionService::SessionService(CommonData& data) 
         : common_data_(data) {    
     }
@@ -635,24 +817,58 @@ using namespace std::literals;
             std::chrono::milliseconds(static_cast<int>(delta_time));
 
         for (const auto& session : common_data_.sessions_) {
+            if (common_data_.cold_sessions_.contains(session->GetSessionId())) {
+                continue;
+            }
+
             unsigned loot_count = session->GetLootCount();
-            int loot_types_count = 
-                common_data_.mapId_to_lootTypes_[session->GetMapId()]->size();
-            session->GenerateLoot(loot_gen_.Generate(interval, loot_count, dogs_count), loot_types_count);
+            int loot_types_count = GetLootTypesCount(session->GetMapHandle());
+            int count = loot_gen_.Generate(interval, loot_count, dogs_count);
+            if (count == 0) {
+                continue;
+            }
+
+            const uint64_t seed = seed_generator_();
+            session->GenerateLoot(count, loot_types_count, seed);
+
+            for (const auto& listener : spawn_listeners_) {
+                listener(*session, count, seed);
+            }
         }
     }
 
+    int LootService::GetLootTypesCount(Map::Handle map_handle) const {
+        const auto& loot_types = common_data_.map_loot_types_.at(map_handle);
+        if (!loot_types) {
+            return 0;
+        }
+
+        return static_cast<int>(loot_types->size());
+    }
+
     MapService::MapService(CommonData& data) : common_data_(data) {}
 
     const Map* MapService::FindMap(const Map::Id& id) const noexcept {
-        if (auto it = common_data_.map_id_to_index_.find(id); it != common_data_.map_id_to_index_.end()) {
-            return &common_data_.maps_.at(it->second);
+        if (auto handle = FindMapHandle(id)) {
+            return &common_data_.maps_[*handle];
         }
         
         return nullptr;
     }
 
+    std::optional<Map::Handle> MapService::FindMapHandle(const Map::Id& id) const noexcept {
+        if (auto it = common_data_.map_id_to_handle_.find(id); it != common_data_.map_id_to_handle_.end()) {
+            return it->second;
+        }
+
+        return std::nullopt;
+    }
+
     std::shared_ptr<GameSession> SessionService::FindGameSessionBySessionId(GameSession::Id session_id) {
+        if (!common_data_.cold_sessions_.empty()) {
+            Materialize(session_id);
+        }
+
         if (common_data_.game_sessions_id_to_index_.count(session_id)) {
             return common_data_.sessions_[common_data_.game_sessions_id_to_index_[session_id]];
         }
@@ -660,4 +876,41 @@ using namespace std::literals;
         return nullptr;
     }
 
+    void SessionService::SetColdSession(GameSession::Id session_id, SessionMaterializer materializer) {
+        common_data_.cold_sessions_[session_id] = std::move(materializer);
+    }
+
+    void SessionService::Materialize(GameSession::Id session_id) {
+        auto& cold_sessions = common_data_.cold_sessions_;
+        auto it = cold_sessions.find(session_id);
+        if (it == cold_sessions.end()) {
+            return;
+        }
+
+        // Запись удаляется заранее, чтобы поиск сессии изнутри наполнения не зациклился
+        SessionMaterializer materializer = std::move(it->second);
+        cold_sessions.erase(it);
+
+        const auto session = common_data_.sessions_[common_data_.game_sessions_id_to_index_.at(session_id)];
+        materializer(session);
+
+        for (const auto& listener : materialize_listeners_) {
+            listener(*session);
+        }
+    }
+
+    bool SessionService::MaterializeNext() {
+        if (common_data_.cold_sessions_.empty()) {
+            return false;
+        }
+
+        Materialize(common_data_.cold_sessions_.begin()->first);
+        return true;
+    }
+
+    void SessionService::MaterializeAll() {
+        while (MaterializeNext()) {
+        }
+    }
+
 }  // namespace model
@@ -10,15 +10,20 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
 #include <random>
+#include <set>
+#include <span>
 #include <vector>
 #include <chrono>
 #include <optional>
 #include <numeric>
+#include <utility>
 
 const double EPSILON = 1e-9;
 
@@ -43,6 +48,13 @@ namespace model {
     
     enum class Direction {NORTH, SOUTH, WEST, EAST, DEFAULT};
 
+    // Команда игрока: остановиться или двигаться в одном из четырёх направлений
+    enum class Move {STOP, LEFT, RIGHT, UP, DOWN};
+
+    // Обозначения команд в API: "", "L", "R", "U", "D"
+    std::optional<Move> ParseMove(std::string_view move) noexcept;
+    std::string_view MoveToString(Move move) noexcept;
+
     struct Pos {
         double x, y;
 
@@ -174,6 +186,9 @@ namespace model {
     class Map {
     public:
         using Id = util::Tagged<std::string, Map>;
+        // Плотный номер карты, выдаётся при добавлении в MapService. Строковый Id нужен
+        // только на границе с HTTP и файлами, внутренние таблицы индексируются номером
+        using Handle = uint32_t;
         using Roads = std::vector<Road>;
         using Buildings = std::vector<Building>;
         using Offices = std::vector<Office>;
@@ -185,6 +200,8 @@ namespace model {
         double GetDefaultDogSpeed() const;
 
         const Id& GetId() const noexcept;
+        Handle GetHandle() const noexcept { return handle_; }
+        void SetHandle(Handle handle) noexcept { handle_ = handle; }
         const std::string& GetName() const noexcept;
         const Buildings& GetBuildings() const noexcept;
         const Roads& GetRoads() const noexcept;
@@ -200,10 +217,13 @@ namespace model {
         void AddBuilding(const Building& building);
         void AddOffice(Office office);
 
+        void Reserve(size_t roads, size_t buildings, size_t offices);
+
     private:
         using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
 
         Id id_;
+        Handle handle_ = 0;
         std::string name_;
         Roads roads_;
         Buildings buildings_;
@@ -221,6 +241,8 @@ namespace model {
         using Id = uint64_t;
 
         Dog(std::string_view name);
+        // Восстанавливает собаку с известным идентификатором, не трогая счётчик
+        Dog(Id id, std::string_view name);
 
         const Id GetId() const;
         const std::string& GetName() const;
@@ -247,11 +269,20 @@ namespace model {
             bag_capacity_ = capacity;
         }
 
+        size_t GetBagCapacity() const { return bag_capacity_; }
+
+        void SetDirection(Direction direction) { state_.direction = direction; }
+
+        double GetDefaultDogSpeed() const { return default_dog_speed_; }
+
+        static Id GetNextId() { return general_id_; }
+        static void SetNextId(Id id) { general_id_ = id; }
+
         void AddScore(int score) { state_.score += score; }
 
         void SetDefaultDogSpeed(double speed);
         void SetSpeed(double x, double y);
-        void SetDogDirSpeed(std::string dir);
+        void SetDogDirSpeed(Move move);
 
         void StopDog();
 
@@ -281,23 +312,56 @@ namespace model {
         using Id = uint64_t;
         using Dogs = std::unordered_map<Dog::Id, std::shared_ptr<Dog>>;
         using LostObjects = std::vector<LostObject>;
+        // Имена собак сессии в алфавитном порядке
+        using Roster = std::multiset<std::string>;
+        using RandomEngine = std::mt19937_64;
     public:
         GameSession(const Map& map, std::unordered_map<int, int> loot_values);
+        GameSession(const Map& map, std::unordered_map<int, int> loot_values, Id id);
 
-        Map::Id GetMapId() const;
+        const Map::Id& GetMapId() const noexcept;
+        Map::Handle GetMapHandle() const noexcept;
         Id GetSessionId() const;
         double GetMapDefaultSpeed() const;
         const Dogs& GetDogs() const;
+        // Собаки в порядке добавления в сессию
+        const std::vector<std::shared_ptr<Dog>>& GetDogsInOrder() const noexcept { return dogs_vector_; }
         const std::vector<std::string> GetPlayersNames() const;
+        // Обновляется при добавлении и удалении собак, версия меняется вместе с ним
+        const Roster& GetRoster() const noexcept { return roster_; }
+        uint64_t GetRosterVersion() const noexcept { return roster_version_; }
+        // Меняется при каждом изменении состояния, которое видят игроки: тике, входе, выходе,
+        // команде собаке и появлении трофеев
+        uint64_t GetStateVersion() const noexcept { return state_version_; }
+        void BumpStateVersion() noexcept { ++state_version_; }
         const std::vector<State> GetPlayersUnitStates() const;
         const LostObjects& GetLostObjects() const {return loots_; }
 
+        void AddLostObject(const LostObject& loot) {
+            loots_.push_back(loot);
+            ++state_version_;
+        }
+
+        void AddLostObjects(std::span<const LostObject> loots) {
+            loots_.insert(loots_.end(), loots.begin(), loots.end());
+            ++state_version_;
+        }
+
+        static Id GetNextId() { return general_id_; }
+        static void SetNextId(Id id) { general_id_ = id; }
+
+        static uint64_t GetNextLostObjectId() { return lost_object_id_; }
+        static void SetNextLostObjectId(uint64_t id) { lost_object_id_ = id; }
+
         int GetLootValue(int loot_type) const;
 
         uint64_t GetLootCount();
         void GenerateLoot(int count, int loot_types_count);
+        // Тип и положение трофеев полностью определяются seed, что позволяет воспроизводить их появление
+        void GenerateLoot(int count, int loot_types_count, uint64_t seed);
 
         Pos GenerateRandomRoadPosition();
+        Pos GenerateRandomRoadPosition(RandomEngine& engine);
 
         std::vector<collision_detector::Gatherer>
         GetGatherers(double delta_time) const;
@@ -305,6 +369,7 @@ namespace model {
         GetItems() const;
 
         void AddDog(std::shared_ptr<Dog> dog);
+        void AddDog(std::shared_ptr<Dog> dog, Pos position);
 
         bool HasDog(Dog::Id id);
 
@@ -315,6 +380,9 @@ namespace model {
         void Tick(double delta_time);
 
         void RemoveDog(Dog::Id id);
+
+        // Собаки, остановившиеся на краю дороги с прошлого вызова. Остановки по команде игрока сюда не попадают
+        std::vector<Dog::Id> TakeStoppedDogs() { return std::exchange(stopped_dogs_, {}); }
     
     private:
 
@@ -347,9 +415,9 @@ namespace model {
         
         void RemoveCollectedLoot(const std::unordered_set<size_t>& collected_loot_ids);
 
-        double GenerateRandomDouble(double from, double to);
+        double GenerateRandomDouble(double from, double to, RandomEngine& engine);
 
-        int GenerateRandomInt(int from, int to);
+        int GenerateRandomInt(int from, int to, RandomEngine& engine);
 
         Pos MoveOnMaxDistance(const Pos& current, const Pos& possible, double current_max);
 
@@ -368,6 +436,10 @@ namespace model {
         Dogs dogs_;
         const Map& map_;
         std::vector<std::shared_ptr<Dog>> dogs_vector_;
+        std::vector<Dog::Id> stopped_dogs_;
+        Roster roster_;
+        uint64_t roster_version_ = 0;
+        uint64_t state_version_ = 0;
         std::unordered_map<int, Region> regions_;
 
         std::unordered_map<int, int> lootId_to_value_;
@@ -376,6 +448,8 @@ namespace model {
 
         size_t bag_capacity_;
 
+        RandomEngine random_engine_{std::random_device{}()};
+
         static inline Id general_id_{0};
         static inline uint64_t lost_object_id_{0};
     };
@@ -383,10 +457,12 @@ namespace model {
     struct CommonData {
         using Maps = std::vector<Map>;
         using MapIdHasher = util::TaggedHasher<Map::Id>;
-        using MapIdToIndex = std::unordered_map<Map::Id, size_t, MapIdHasher>;
-        using MapIdToGameSessions = 
-            std::unordered_map<Map::Id, GameSession::Id, MapIdHasher>;
-        // using MapIdToLootTypesCount = std::unordered_map<Map::Id, int, util::TaggedHasher<Map::Id>>;
+        using MapIdToHandle = std::unordered_map<Map::Id, Map::Handle, MapIdHasher>;
+        // Таблицы ниже индексируются Map::Handle
+        // Сессии каждой карты в порядке создания
+        using MapSessions = std::vector<std::vector<GameSession::Id>>;
+        using LootTypes = std::vector<std::shared_ptr<boost::json::array>>;
+        // Типы трофеев в том виде, в каком они приходят из конфигурации
         using MapLootTypes =
             std::unordered_map<model::Map::Id, 
                               std::shared_ptr<boost::json::array>,
@@ -395,16 +471,21 @@ namespace model {
         using GameSessions = std::vector<std::shared_ptr<GameSession>>;
         using GameSessionIdToIndex = 
             std::unordered_map<GameSession::Id, size_t>;
+        // Наполняет сессию, восстановленную из снимка без собак и трофеев
+        using SessionMaterializer = std::function<void(const std::shared_ptr<GameSession>& session)>;
+        using ColdSessions = std::unordered_map<GameSession::Id, SessionMaterializer>;
 
         
         GameSessions sessions_;
         GameSessionIdToIndex game_sessions_id_to_index_;
+        // Ещё не наполненные сессии (см. SessionService::SetColdSession)
+        ColdSessions cold_sessions_;
 
-        MapLootTypes mapId_to_lootTypes_;
-        MapIdToGameSessions mapId_to_session_index_;
+        LootTypes map_loot_types_;
+        MapSessions map_sessions_;
 
         Maps maps_;
-        MapIdToIndex map_id_to_index_;
+        MapIdToHandle map_id_to_handle_;
     };
 
     class MapService {
@@ -417,6 +498,7 @@ namespace model {
         void AddMap(model::Map map);
         
         const model::Map* FindMap(const model::Map::Id& id) const noexcept;
+        std::optional<Map::Handle> FindMapHandle(const model::Map::Id& id) const noexcept;
         const Maps& GetMaps() const noexcept;
 
     private:
@@ -427,26 +509,86 @@ namespace model {
     class SessionService {
     public:
         using GameSessions = std::vector<std::shared_ptr<GameSession>>;
+        using SessionMaterializer = CommonData::SessionMaterializer;
+        // Вызывается после наполнения сессии
+        using MaterializeListener = std::function<void(const GameSession& session)>;
+        // Вызывает fn(i) для каждого i из [0, count), возможно параллельно.
+        // Сессии независимы друг от друга, поэтому их можно тикать в разных потоках
+        using ParallelFor = std::function<void(size_t count, const std::function<void(size_t)>& fn)>;
 
         SessionService(CommonData& data);
 
         std::shared_ptr<model::GameSession> 
-        CreateGameSession(model::Map::Id map_id);
+        CreateGameSession(model::Map::Handle map_handle);
+
+        // Создаёт сессию с заданным идентификатором при восстановлении состояния
+        std::shared_ptr<model::GameSession> 
+        RestoreGameSession(const model::Map::Id& map_id, GameSession::Id session_id);
         
+        // Сессия для нового игрока: наименее заполненная из сессий карты со свободным местом.
+        // Если мест нет, открывается новая сессия. Возвращает nullptr, если карты с таким идентификатором нет
         std::shared_ptr<model::GameSession> 
-        FindGameSession(model::Map::Id map_id);
+        FindGameSession(const model::Map::Id& map_id);
+
+        std::shared_ptr<model::GameSession> 
+        FindGameSession(model::Map::Handle map_handle);
+
+        // Не больше стольких игроков в одной сессии, 0 - без ограничения
+        void SetMaxPlayersPerSession(size_t max_players) noexcept { max_players_per_session_ = max_players; }
+        size_t GetMaxPlayersPerSession() const noexcept { return max_players_per_session_; }
+
+        // Удаляет сессию, из которой ушли все собаки, вместе с её трофеями.
+        // Без ограничения вместимости единственная сессия карты не удаляется.
+        // Возвращает false, если сессия не удалена
+        bool ReclaimIfEmpty(GameSession::Id session_id);
 
         std::shared_ptr<GameSession> 
         FindGameSessionBySessionId(GameSession::Id session_id);
 
+        // Среди сессий могут быть ещё не наполненные (см. SetColdSession)
+        const GameSessions& GetSessions() const noexcept {
+            return common_data_.sessions_;
+        }
+
+        // Содержимое сессии загружается при первом поиске сессии. До этого сессия пуста
+        // и заморожена: время в ней не идёт и трофеи в ней не появляются
+        void SetColdSession(GameSession::Id session_id, SessionMaterializer materializer);
+
+        // Проверяет, не наполняя сессию
+        bool IsColdSession(GameSession::Id session_id) const {
+            return common_data_.cold_sessions_.contains(session_id);
+        }
+
+        void AddMaterializeListener(MaterializeListener listener) {
+            materialize_listeners_.push_back(std::move(listener));
+        }
+
+        // Наполняет одну из ещё не наполненных сессий. Возвращает false, если таких не осталось
+        bool MaterializeNext();
+        void MaterializeAll();
+
         void Tick(std::chrono::milliseconds delta_time);
+        void Tick(std::chrono::milliseconds delta_time, const ParallelFor& parallel_for);
 
     private:
+        std::unordered_map<int, int> MakeLootValues(model::Map::Handle map_handle) const;
+
+        std::shared_ptr<model::GameSession> 
+        RegisterGameSession(std::shared_ptr<model::GameSession> session);
+
+        void Materialize(GameSession::Id session_id);
+
         CommonData& common_data_;
+        std::vector<MaterializeListener> materialize_listeners_;
+        size_t max_players_per_session_ = 0;
     };
 
     class LootService {
     public:
+        // Вызывается для каждой сессии, в которой были сгенерированы трофеи
+        using SpawnListener = 
+            std::function<void(const GameSession& session, int count, uint64_t seed)>;
+
         explicit LootService(CommonData& data) : common_data_(data) {}
 
         void GenerateLoot(double delta_time);
@@ -455,12 +597,21 @@ namespace model {
 
         void ConfigureLootGenerator(double period, double probability);
 
-        const CommonData::MapLootTypes& GetLootTypes() {
-            return common_data_.mapId_to_lootTypes_;
+        // Возвращает nullptr, если для карты типы трофеев не заданы
+        const std::shared_ptr<boost::json::array>& GetLootTypes(Map::Handle map_handle) const {
+            return common_data_.map_loot_types_.at(map_handle);
+        }
+
+        int GetLootTypesCount(Map::Handle map_handle) const;
+
+        void AddSpawnListener(SpawnListener listener) {
+            spawn_listeners_.push_back(std::move(listener));
         }
 
     private:
         CommonData& common_data_;
+        std::vector<SpawnListener> spawn_listeners_;
+        std::mt19937_64 seed_generator_{std::random_device{}()};
 
         loot_gen::LootGeneratorConfig loot_config_;
         loot_gen::LootGenerator loot_gen_{0ms, 0};
@@ -478,6 +629,12 @@ namespace model {
             loot_service_.GenerateLoot(delta_time.count());
         }
 
+        void Tick(std::chrono::milliseconds delta_time, 
+                  const SessionService::ParallelFor& parallel_for) {
+            session_service_.Tick(delta_time, parallel_for);
+            loot_service_.GenerateLoot(delta_time.count());
+        }
+
     private:
         SessionService& session_service_;
         LootService& loot_service_;
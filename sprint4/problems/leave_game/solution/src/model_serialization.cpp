@@ -0,0 +1,391 @@
+#include "model_serialization.h"
+
+#include <boost/json.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace serialization {
+    using namespace std::literals;
+
+    namespace {
+        // Данные пишутся и читаются блоками такого размера
+        constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+        // Защита от порчи файла: строки в снимке короткие, а массивы не больше числа игроков
+        constexpr uint64_t MAX_STRING_SIZE = 64 * 1024;
+        constexpr uint64_t MAX_ARRAY_SIZE = uint64_t{1} << 32;
+
+        namespace json = boost::json;
+
+        model::Pos ParseJsonPoint(const json::value& value) {
+            const auto& point = value.as_array();
+            if (point.size() != 2) {
+                throw std::runtime_error("Corrupted JSON state: point must have two coordinates");
+            }
+            return {json::value_to<double>(point[0]), json::value_to<double>(point[1])};
+        }
+
+        // Направления записаны так же, как в ответах API
+        model::Direction ParseJsonDirection(std::string_view dir) {
+            if (dir == "U"sv) {
+                return model::Direction::NORTH;
+            }
+            if (dir == "D"sv) {
+                return model::Direction::SOUTH;
+            }
+            if (dir == "L"sv) {
+                return model::Direction::WEST;
+            }
+            if (dir == "R"sv) {
+                return model::Direction::EAST;
+            }
+            if (dir.empty()) {
+                return model::Direction::DEFAULT;
+            }
+            throw std::runtime_error("Corrupted JSON state: unknown direction "s + std::string(dir));
+        }
+
+        std::shared_ptr<model::Dog> RestoreJsonDog(const json::object& obj, const model::GameSession& session) {
+            const auto id = json::value_to<model::Dog::Id>(obj.at("id"));
+            auto dog = std::make_shared<model::Dog>(id, json::value_to<std::string>(obj.at("name")));
+
+            const auto* default_speed = obj.if_contains("defaultSpeed");
+            dog->SetDefaultDogSpeed(default_speed ? json::value_to<double>(*default_speed)
+                                                  : session.GetMapDefaultSpeed());
+            if (const auto* capacity = obj.if_contains("bagCapacity")) {
+                dog->SetBagCapacity(json::value_to<size_t>(*capacity));
+            }
+
+            const auto speed = ParseJsonPoint(obj.at("speed"));
+            dog->SetSpeed(speed.x, speed.y);
+            dog->SetDirection(ParseJsonDirection(obj.at("dir").as_string()));
+            dog->AddScore(json::value_to<int>(obj.at("score")));
+
+            const auto& bag = obj.at("bag").as_array();
+            if (bag.size() > dog->GetBagCapacity()) {
+                throw std::runtime_error("Corrupted JSON state: bag of dog "s + std::to_string(id) + " overflows"s);
+            }
+            for (const auto& item : bag) {
+                const auto& loot = item.as_object();
+                dog->AddToBag(json::value_to<int>(loot.at("id")), json::value_to<int>(loot.at("type")));
+            }
+
+            return dog;
+        }
+    }
+
+    OutputArchive::OutputArchive(std::ostream& out)
+        : out_(out) {
+        buffer_.reserve(BUFFER_SIZE);
+    }
+
+    void OutputArchive::Write(const void* data, size_t size) {
+        crc_.process_bytes(data, size);
+        buffer_.append(static_cast<const char*>(data), size);
+
+        if (buffer_.size() >= BUFFER_SIZE) {
+            Flush();
+        }
+    }
+
+    void OutputArchive::Flush() {
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+
+        if (!out_) {
+            throw std::runtime_error("Failed to write state snapshot");
+        }
+    }
+
+    void OutputArchive::Finish() {
+        const uint32_t checksum = crc_.checksum();
+        buffer_.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+        Flush();
+        out_.flush();
+    }
+
+    InputArchive::InputArchive(std::istream& in)
+        : in_(in) {
+        buffer_.reserve(BUFFER_SIZE);
+    }
+
+    bool InputArchive::Fill() {
+        buffer_.resize(BUFFER_SIZE);
+        in_.read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.resize(static_cast<size_t>(in_.gcount()));
+        pos_ = 0;
+
+        return !buffer_.empty();
+    }
+
+    void InputArchive::Read(void* data, size_t size) {
+        auto* out = static_cast<char*>(data);
+        while (size > 0) {
+            if (pos_ == buffer_.size() && !Fill()) {
+                throw std::runtime_error("Corrupted state snapshot: unexpected end of data");
+            }
+
+            const size_t chunk = std::min(size, buffer_.size() - pos_);
+            std::memcpy(out, buffer_.data() + pos_, chunk);
+            crc_.process_bytes(out, chunk);
+
+            pos_ += chunk;
+            out += chunk;
+            size -= chunk;
+        }
+    }
+
+    uint64_t InputArchive::ReadSize() {
+        uint64_t size = 0;
+        *this & size;
+        if (size > MAX_ARRAY_SIZE) {
+            throw std::runtime_error("Corrupted state snapshot: array is too large");
+        }
+        return size;
+    }
+
+    InputArchive& InputArchive::operator&(std::string& str) {
+        uint64_t size = 0;
+        *this & size;
+        if (size > MAX_STRING_SIZE) {
+            throw std::runtime_error("Corrupted state snapshot: string is too long");
+        }
+
+        str.resize(size);
+        Read(str.data(), size);
+        return *this;
+    }
+
+    void InputArchive::Finish() {
+        const uint32_t expected = crc_.checksum();
+
+        uint32_t checksum = 0;
+        Read(&checksum, sizeof(checksum));
+        if (checksum != expected) {
+            throw std::runtime_error("Corrupted state snapshot: checksum mismatch");
+        }
+
+        if (pos_ != buffer_.size() || Fill()) {
+            throw std::runtime_error("Corrupted state snapshot: trailing data");
+        }
+    }
+
+    std::shared_ptr<model::Dog> DogRepr::Restore() const {
+        if (direction_ > model::Direction::DEFAULT || bag_.size() > bag_capacity_) {
+            throw std::runtime_error("Corrupted state snapshot: invalid dog "s + std::to_string(id_));
+        }
+
+        auto dog = std::make_shared<model::Dog>(id_, name_);
+        dog->SetDefaultDogSpeed(default_speed_);
+        dog->SetBagCapacity(bag_capacity_);
+        dog->MoveDog(pos_);
+        dog->SetSpeed(speed_.x, speed_.y);
+        dog->SetDirection(direction_);
+        dog->AddScore(score_);
+        for (const auto& [loot_id, loot_type] : bag_) {
+            dog->AddToBag(loot_id, loot_type);
+        }
+
+        return dog;
+    }
+
+    GameStateRepr CaptureState(const app::Application& app) {
+        GameStateRepr state;
+        state.counters = IdCountersRepr{model::Dog::GetNextId(),
+                                        model::GameSession::GetNextId(),
+                                        model::GameSession::GetNextLostObjectId()};
+
+        const auto& session_service = app.GetGame().GetSessionService();
+        const auto& sessions = session_service.GetSessions();
+        state.sessions.reserve(sessions.size());
+        for (const auto& session : sessions) {
+            auto& repr = state.sessions.emplace_back();
+            repr.map_id = *session->GetMapId();
+            repr.session_id = session->GetSessionId();
+            if (session_service.IsColdSession(repr.session_id)) {
+                repr.cold = true;
+                continue;
+            }
+
+            // Порядок собак важен: в нём они обходятся при сборе трофеев
+            const auto& dogs = session->GetDogsInOrder();
+            repr.dogs.reserve(dogs.size());
+            for (const auto& dog : dogs) {
+                repr.dogs.emplace_back(*dog);
+            }
+
+            repr.lost_objects = session->GetLostObjects();
+        }
+
+        const auto& players = app.GetPlayers();
+        state.players.reserve(players.Size());
+        players.ForEachPlayer([&app, &state](const app::Token& token, const Player::Player& player) {
+            state.players.push_back(PlayerRepr{token, player.GetGameSession()->GetSessionId(), 
+                                               player.GetDogId(), app.GetPlayerActivity(player.GetDogId())});
+        });
+
+        return state;
+    }
+
+    void WriteState(const GameStateRepr& state, std::ostream& out) {
+        for (const auto& session : state.sessions) {
+            if (session.cold) {
+                throw std::logic_error("Cold sessions can only be written to a mapped snapshot");
+            }
+        }
+
+        OutputArchive ar(out);
+        ar & std::string(SNAPSHOT_MAGIC) & SNAPSHOT_VERSION & state;
+        ar.Finish();
+    }
+
+    void SaveState(app::Application& app, std::ostream& out) {
+        app.GetGame().GetSessionService().MaterializeAll();
+        WriteState(CaptureState(app), out);
+    }
+
+    uint64_t LoadState(app::Application& app, std::istream& in) {
+        InputArchive ar(in);
+
+        std::string magic;
+        uint32_t version = 0;
+        ar & magic & version;
+        if (magic != SNAPSHOT_MAGIC) {
+            throw std::runtime_error("Not a game state snapshot");
+        }
+        if (version != SNAPSHOT_VERSION) {
+            throw std::runtime_error("Unsupported state snapshot version: "s + std::to_string(version));
+        }
+
+        IdCountersRepr counters;
+        uint64_t wal_generation = 0;
+        ar & counters & wal_generation;
+
+        auto& session_service = app.GetGame().GetSessionService();
+
+        const uint64_t sessions_count = ar.ReadSize();
+        for (uint64_t i = 0; i < sessions_count; ++i) {
+            std::string map_id;
+            model::GameSession::Id session_id = 0;
+            ar & map_id & session_id;
+
+            auto session = session_service.RestoreGameSession(model::Map::Id{map_id}, session_id);
+
+            const uint64_t dogs_count = ar.ReadSize();
+            for (uint64_t j = 0; j < dogs_count; ++j) {
+                DogRepr repr;
+                ar & repr;
+                session->AddDog(repr.Restore(), repr.GetPosition());
+            }
+
+            model::GameSession::LostObjects lost_objects;
+            ar & lost_objects;
+            for (const auto& loot : lost_objects) {
+                session->AddLostObject(loot);
+            }
+        }
+
+        const uint64_t players_count = ar.ReadSize();
+        for (uint64_t i = 0; i < players_count; ++i) {
+            PlayerRepr repr;
+            ar & repr;
+
+            auto session = session_service.FindGameSessionBySessionId(repr.session_id);
+            if (!session) {
+                throw std::runtime_error("Corrupted state snapshot: unknown session of player");
+            }
+
+            const auto& dogs = session->GetDogs();
+            auto dog = dogs.find(repr.dog_id);
+            if (dog == dogs.end()) {
+                throw std::runtime_error("Corrupted state snapshot: unknown dog of player");
+            }
+
+            app.RestorePlayer(repr.token, dog->second, session, repr.activity);
+        }
+
+        ar.Finish();
+
+        model::Dog::SetNextId(counters.next_dog_id);
+        model::GameSession::SetNextId(counters.next_session_id);
+        model::GameSession::SetNextLostObjectId(counters.next_lost_object_id);
+
+        return wal_generation;
+    }
+
+    bool IsJsonState(const fs::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        char c = 0;
+        while (in.get(c)) {
+            if (!std::isspace(static_cast<unsigned char>(c))) {
+                return c == '{';
+            }
+        }
+        return false;
+    }
+
+    uint64_t LoadJsonState(app::Application& app, std::istream& in) {
+        const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        const auto state = json::parse(text).as_object();
+        auto& session_service = app.GetGame().GetSessionService();
+
+        // Счётчики в этом формате не сохранялись: новые идентификаторы выдаются после самых больших
+        model::Dog::Id next_dog_id = model::Dog::GetNextId();
+        model::GameSession::Id next_session_id = model::GameSession::GetNextId();
+        uint64_t next_lost_object_id = model::GameSession::GetNextLostObjectId();
+
+        for (const auto& session_value : state.at("sessions").as_array()) {
+            const auto& session_obj = session_value.as_object();
+            const auto session_id = json::value_to<model::GameSession::Id>(session_obj.at("id"));
+            auto session = session_service.RestoreGameSession(
+                model::Map::Id{json::value_to<std::string>(session_obj.at("mapId"))}, session_id);
+            next_session_id = std::max(next_session_id, session_id + 1);
+
+            for (const auto& dog_value : session_obj.at("dogs").as_array()) {
+                const auto& dog_obj = dog_value.as_object();
+                auto dog = RestoreJsonDog(dog_obj, *session);
+                next_dog_id = std::max(next_dog_id, dog->GetId() + 1);
+                session->AddDog(dog, ParseJsonPoint(dog_obj.at("pos")));
+            }
+
+            for (const auto& loot_value : session_obj.at("lostObjects").as_array()) {
+                const auto& loot = loot_value.as_object();
+                const auto loot_id = json::value_to<uint64_t>(loot.at("id"));
+                session->AddLostObject(model::GameSession::LostObject{
+                    loot_id, json::value_to<uint64_t>(loot.at("type")), ParseJsonPoint(loot.at("pos"))});
+                next_lost_object_id = std::max(next_lost_object_id, loot_id + 1);
+            }
+        }
+
+        for (const auto& player_value : state.at("players").as_array()) {
+            const auto& player = player_value.as_object();
+
+            auto session = session_service.FindGameSessionBySessionId(
+                json::value_to<model::GameSession::Id>(player.at("sessionId")));
+            if (!session) {
+                throw std::runtime_error("Corrupted JSON state: unknown session of player");
+            }
+
+            const auto& dogs = session->GetDogs();
+            auto dog = dogs.find(json::value_to<model::Dog::Id>(player.at("dogId")));
+            if (dog == dogs.end()) {
+                throw std::runtime_error("Corrupted JSON state: unknown dog of player");
+            }
+
+            app.RestorePlayer(app::Token::Parse(player.at("token").as_string()), dog->second, session, {});
+        }
+
+        model::Dog::SetNextId(next_dog_id);
+        model::GameSession::SetNextId(next_session_id);
+        model::GameSession::SetNextLostObjectId(next_lost_object_id);
+
+        return 0;
+    }
+
+}  // namespace serialization
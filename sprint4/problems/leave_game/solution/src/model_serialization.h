@@ -0,0 +1,306 @@
+#pragma once
+
+#include "sdk.h"
+#include "application.h"
+#include "model.h"
+
+#include <boost/crc.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Бинарный снимок состояния игры.
+ *
+ * Формат: MAGIC, VERSION, счётчики идентификаторов, поколение журнала упреждающей записи, сессии (собаки с рюкзаками и потерянные
+ * предметы), игроки с токенами и в конце CRC32 всего предшествующего содержимого.
+ * Числа записываются как есть, в порядке байт платформы (аналогично boost binary archive),
+ * строки и массивы - 64-битной длиной и элементами.
+ * Снимок пишется и читается потоком через буфер. Для фонового сохранения состояние сначала
+ * копируется в GameStateRepr (быстро, под стрендом игры), а кодируется и пишется на диск уже вне его.
+ */
+namespace serialization {
+
+    namespace fs = std::filesystem;
+
+    class MappedSnapshot;
+
+    constexpr std::string_view SNAPSHOT_MAGIC = "GSSN";
+    constexpr uint32_t SNAPSHOT_VERSION = 3;
+
+    class OutputArchive {
+    public:
+        explicit OutputArchive(std::ostream& out);
+
+        OutputArchive(const OutputArchive&) = delete;
+        OutputArchive& operator=(const OutputArchive&) = delete;
+
+        template <typename T>
+        OutputArchive& operator&(const T& value) {
+            if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+                Write(&value, sizeof(value));
+            } else {
+                serialize(*this, const_cast<T&>(value));
+            }
+            return *this;
+        }
+
+        OutputArchive& operator&(const std::string& str) {
+            *this & static_cast<uint64_t>(str.size());
+            Write(str.data(), str.size());
+            return *this;
+        }
+
+        template <typename T>
+        OutputArchive& operator&(const std::vector<T>& values) {
+            *this & static_cast<uint64_t>(values.size());
+            for (const auto& value : values) {
+                *this & value;
+            }
+            return *this;
+        }
+
+        template <typename First, typename Second>
+        OutputArchive& operator&(const std::pair<First, Second>& pair) {
+            return *this & pair.first & pair.second;
+        }
+
+        // Дописывает контрольную сумму и сбрасывает буфер в поток
+        void Finish();
+
+    private:
+        void Write(const void* data, size_t size);
+        void Flush();
+
+        std::ostream& out_;
+        std::string buffer_;
+        boost::crc_32_type crc_;
+    };
+
+    class InputArchive {
+    public:
+        explicit InputArchive(std::istream& in);
+
+        InputArchive(const InputArchive&) = delete;
+        InputArchive& operator=(const InputArchive&) = delete;
+
+        template <typename T>
+        InputArchive& operator&(T& value) {
+            if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+                Read(&value, sizeof(value));
+            } else {
+                serialize(*this, value);
+            }
+            return *this;
+        }
+
+        InputArchive& operator&(std::string& str);
+
+        template <typename T>
+        InputArchive& operator&(std::vector<T>& values) {
+            const uint64_t size = ReadSize();
+            values.clear();
+            values.reserve(size);
+            for (uint64_t i = 0; i < size; ++i) {
+                *this & values.emplace_back();
+            }
+            return *this;
+        }
+
+        template <typename First, typename Second>
+        InputArchive& operator&(std::pair<First, Second>& pair) {
+            return *this & pair.first & pair.second;
+        }
+
+        uint64_t ReadSize();
+
+        // Сверяет контрольную сумму с прочитанным содержимым
+        void Finish();
+
+    private:
+        void Read(void* data, size_t size);
+        bool Fill();
+
+        std::istream& in_;
+        std::string buffer_;
+        size_t pos_ = 0;
+        boost::crc_32_type crc_;
+    };
+
+}  // namespace serialization
+
+namespace model {
+
+    template <typename Archive>
+    void serialize(Archive& ar, Pos& pos) {
+        ar & pos.x & pos.y;
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, Speed& speed) {
+        ar & speed.x & speed.y;
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, GameSession::LostObject& loot) {
+        ar & loot.id & loot.type & loot.position;
+    }
+
+}  // namespace model
+
+namespace serialization {
+
+    // DogRepr (DogRepresentation) - сериализованное представление класса Dog
+    class DogRepr {
+    public:
+        DogRepr() = default;
+
+        explicit DogRepr(const model::Dog& dog)
+            : id_(dog.GetId())
+            , name_(dog.GetName())
+            , pos_(dog.GetPosition())
+            , speed_(dog.GetSpeed())
+            , direction_(dog.GetDirection())
+            , bag_(dog.GetBag())
+            , score_(dog.GetState().score)
+            , bag_capacity_(dog.GetBagCapacity())
+            , default_speed_(dog.GetDefaultDogSpeed()) {
+        }
+
+        [[nodiscard]] std::shared_ptr<model::Dog> Restore() const;
+
+        model::Dog::Id GetId() const noexcept { return id_; }
+        const std::string& GetName() const noexcept { return name_; }
+        const model::Pos& GetPosition() const noexcept { return pos_; }
+        const model::Speed& GetSpeed() const noexcept { return speed_; }
+        model::Direction GetDirection() const noexcept { return direction_; }
+        const std::vector<std::pair<int, int>>& GetBag() const noexcept { return bag_; }
+        int GetScore() const noexcept { return score_; }
+        uint64_t GetBagCapacity() const noexcept { return bag_capacity_; }
+        double GetDefaultSpeed() const noexcept { return default_speed_; }
+
+        template <typename Archive>
+        friend void serialize(Archive& ar, DogRepr& repr) {
+            ar & repr.id_ & repr.name_ & repr.pos_ & repr.speed_ & repr.direction_
+               & repr.bag_ & repr.score_ & repr.bag_capacity_ & repr.default_speed_;
+        }
+
+    private:
+        model::Dog::Id id_ = 0;
+        std::string name_;
+        model::Pos pos_{0, 0};
+        model::Speed speed_{0, 0};
+        model::Direction direction_ = model::Direction::DEFAULT;
+        std::vector<std::pair<int, int>> bag_;
+        int score_ = 0;
+        uint64_t bag_capacity_ = 0;
+        double default_speed_ = 0;
+    };
+
+    // Игрок сохраняется токеном, ссылкой на свою собаку в сессии и учётом времени для пенсии.
+    // Токен копируется на тике как есть, в шестнадцатеричный вид он переводится только при записи
+    struct PlayerRepr {
+        app::Token token;
+        model::GameSession::Id session_id = 0;
+        model::Dog::Id dog_id = 0;
+        app::PlayerActivity activity;
+
+        template <typename Archive>
+        friend void serialize(Archive& ar, PlayerRepr& repr) {
+            std::string hex;
+            if constexpr (std::is_same_v<Archive, OutputArchive>) {
+                hex = repr.token.ToHex();
+            }
+            ar & hex;
+            if constexpr (std::is_same_v<Archive, InputArchive>) {
+                repr.token = app::Token::Parse(hex);
+            }
+            ar & repr.session_id & repr.dog_id;
+
+            int64_t play_time = repr.activity.play_time.count();
+            int64_t idle_left = repr.activity.idle_left.count();
+            ar & play_time & idle_left;
+            repr.activity = app::PlayerActivity{std::chrono::milliseconds{play_time}, 
+                                                std::chrono::milliseconds{idle_left}};
+        }
+    };
+
+    // Значения статических счётчиков, из которых выдаются новые идентификаторы
+    struct IdCountersRepr {
+        model::Dog::Id next_dog_id = 0;
+        model::GameSession::Id next_session_id = 0;
+        uint64_t next_lost_object_id = 0;
+
+        template <typename Archive>
+        friend void serialize(Archive& ar, IdCountersRepr& repr) {
+            ar & repr.next_dog_id & repr.next_session_id & repr.next_lost_object_id;
+        }
+    };
+
+    // Сессия вместе с собаками в порядке их добавления и потерянными предметами
+    struct SessionRepr {
+        std::string map_id;
+        model::GameSession::Id session_id = 0;
+        std::vector<DogRepr> dogs;
+        model::GameSession::LostObjects lost_objects;
+        // Сессия ещё не наполнена из снимка, её содержимое берётся из GameStateRepr::cold_source
+        bool cold = false;
+
+        template <typename Archive>
+        friend void serialize(Archive& ar, SessionRepr& repr) {
+            ar & repr.map_id & repr.session_id & repr.dogs & repr.lost_objects;
+        }
+    };
+
+    // Копия всего сохраняемого состояния, не связанная с живой моделью
+    struct GameStateRepr {
+        IdCountersRepr counters;
+        // Первый сегмент журнала упреждающей записи, не вошедший в снимок
+        uint64_t wal_generation = 0;
+        std::vector<SessionRepr> sessions;
+        std::vector<PlayerRepr> players;
+        // Снимок, из которого загружены ненаполненные сессии. Нужен только формату для mmap
+        std::shared_ptr<const MappedSnapshot> cold_source;
+
+        template <typename Archive>
+        friend void serialize(Archive& ar, GameStateRepr& repr) {
+            ar & repr.counters & repr.wal_generation & repr.sessions & repr.players;
+        }
+    };
+
+    // Должна вызываться там же, где изменяется модель (на стренде игры).
+    // Ненаполненные сессии не наполняются, а только отмечаются
+    [[nodiscard]] GameStateRepr CaptureState(const app::Application& app);
+
+    // Может вызываться из любого потока. Ненаполненные сессии в этом формате не пишутся
+    void WriteState(const GameStateRepr& state, std::ostream& out);
+
+    // Перед сохранением наполняет все сессии
+    void SaveState(app::Application& app, std::ostream& out);
+
+    // Состояние загружается в только что созданную игру, в которой ещё нет сессий и игроков.
+    // Возвращает поколение журнала упреждающей записи, с которого нужно продолжить восстановление
+    uint64_t LoadState(app::Application& app, std::istream& in);
+
+    // Состояние в JSON, которое писали серверы до появления бинарного снимка.
+    // Такой файл загружается при старте, а следующее сохранение уже пишет бинарный снимок.
+    // Формат (имена полей как в ответах API):
+    //   {"sessions": [{"mapId", "id", "lostObjects": [{"id", "type", "pos": [x, y]}],
+    //                  "dogs": [{"id", "name", "pos": [x, y], "speed": [x, y], "dir", "score",
+    //                            "bag": [{"id", "type"}], "bagCapacity"?, "defaultSpeed"?}]}],
+    //    "players": [{"token", "sessionId", "dogId"}]}
+    [[nodiscard]] bool IsJsonState(const fs::path& path);
+
+    // Загружает состояние в формате JSON в только что созданную игру.
+    // Журнал упреждающей записи такие серверы не вели, восстановление продолжается с поколения 0
+    uint64_t LoadJsonState(app::Application& app, std::istream& in);
+
+}  // namespace serialization
@@ -0,0 +1,138 @@
+#include "msgpack.h"
+
+#include <bit>
+#include <limits>
+
+namespace msgpack {
+
+    template <typename T>
+    void Writer::BigEndian(uint8_t tag, T value) {
+        out_.push_back(static_cast<char>(tag));
+        for (int shift = static_cast<int>(sizeof(T) - 1) * 8; shift >= 0; shift -= 8) {
+            out_.push_back(static_cast<char>((value >> shift) & 0xff));
+        }
+    }
+
+    void Writer::Nil() {
+        out_.push_back(static_cast<char>(0xc0));
+    }
+
+    void Writer::Bool(bool value) {
+        out_.push_back(static_cast<char>(value ? 0xc3 : 0xc2));
+    }
+
+    void Writer::Uint(uint64_t value) {
+        if (value < 0x80) {
+            out_.push_back(static_cast<char>(value));
+        } else if (value <= std::numeric_limits<uint8_t>::max()) {
+            BigEndian(0xcc, static_cast<uint8_t>(value));
+        } else if (value <= std::numeric_limits<uint16_t>::max()) {
+            BigEndian(0xcd, static_cast<uint16_t>(value));
+        } else if (value <= std::numeric_limits<uint32_t>::max()) {
+            BigEndian(0xce, static_cast<uint32_t>(value));
+        } else {
+            BigEndian(0xcf, value);
+        }
+    }
+
+    void Writer::Int(int64_t value) {
+        if (value >= 0) {
+            Uint(static_cast<uint64_t>(value));
+        } else if (value >= -32) {
+            out_.push_back(static_cast<char>(value));
+        } else if (value >= std::numeric_limits<int8_t>::min()) {
+            BigEndian(0xd0, static_cast<uint8_t>(value));
+        } else if (value >= std::numeric_limits<int16_t>::min()) {
+            BigEndian(0xd1, static_cast<uint16_t>(value));
+        } else if (value >= std::numeric_limits<int32_t>::min()) {
+            BigEndian(0xd2, static_cast<uint32_t>(value));
+        } else {
+            BigEndian(0xd3, static_cast<uint64_t>(value));
+        }
+    }
+
+    void Writer::Float(float value) {
+        BigEndian(0xca, std::bit_cast<uint32_t>(value));
+    }
+
+    void Writer::Double(double value) {
+        BigEndian(0xcb, std::bit_cast<uint64_t>(value));
+    }
+
+    void Writer::String(std::string_view value) {
+        const size_t size = value.size();
+        if (size < 32) {
+            out_.push_back(static_cast<char>(0xa0 | size));
+        } else if (size <= std::numeric_limits<uint8_t>::max()) {
+            BigEndian(0xd9, static_cast<uint8_t>(size));
+        } else if (size <= std::numeric_limits<uint16_t>::max()) {
+            BigEndian(0xda, static_cast<uint16_t>(size));
+        } else {
+            BigEndian(0xdb, static_cast<uint32_t>(size));
+        }
+        out_.append(value);
+    }
+
+    void Writer::ArrayHeader(uint32_t size) {
+        if (size < 16) {
+            out_.push_back(static_cast<char>(0x90 | size));
+        } else if (size <= std::numeric_limits<uint16_t>::max()) {
+            BigEndian(0xdc, static_cast<uint16_t>(size));
+        } else {
+            BigEndian(0xdd, size);
+        }
+    }
+
+    void Writer::MapHeader(uint32_t size) {
+        if (size < 16) {
+            out_.push_back(static_cast<char>(0x80 | size));
+        } else if (size <= std::numeric_limits<uint16_t>::max()) {
+            BigEndian(0xde, static_cast<uint16_t>(size));
+        } else {
+            BigEndian(0xdf, size);
+        }
+    }
+
+    void Writer::Value(const boost::json::value& value) {
+        switch (value.kind()) {
+            case boost::json::kind::null:
+                Nil();
+                break;
+            case boost::json::kind::bool_:
+                Bool(value.get_bool());
+                break;
+            case boost::json::kind::int64:
+                Int(value.get_int64());
+                break;
+            case boost::json::kind::uint64:
+                Uint(value.get_uint64());
+                break;
+            case boost::json::kind::double_:
+                Double(value.get_double());
+                break;
+            case boost::json::kind::string: {
+                const auto& str = value.get_string();
+                String({str.data(), str.size()});
+                break;
+            }
+            case boost::json::kind::array: {
+                const auto& arr = value.get_array();
+                ArrayHeader(static_cast<uint32_t>(arr.size()));
+                for (const auto& item : arr) {
+                    Value(item);
+                }
+                break;
+            }
+            case boost::json::kind::object: {
+                const auto& obj = value.get_object();
+                MapHeader(static_cast<uint32_t>(obj.size()));
+                for (const auto& [key, item] : obj) {
+                    String({key.data(), key.size()});
+                    Value(item);
+                }
+                break;
+            }
+        }
+    }
+
+}  // namespace msgpack
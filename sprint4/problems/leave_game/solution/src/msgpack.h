@@ -0,0 +1,45 @@
+#pragma once
+
+#include "sdk.h"
+
+#include <boost/json.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * Запись значений в формате MessagePack (https://msgpack.org/).
+ *
+ * Каждое значение кодируется самым коротким подходящим типом: целые - fixint/uint8..64/int8..64,
+ * строки - fixstr/str8..32, заголовки массивов и словарей - fix/16/32. Многобайтные числа
+ * записываются в порядке big-endian, как требует спецификация.
+ */
+namespace msgpack {
+
+    class Writer {
+    public:
+        // Значения дописываются в конец out
+        explicit Writer(std::string& out) : out_(out) {}
+
+        void Nil();
+        void Bool(bool value);
+        void Int(int64_t value);
+        void Uint(uint64_t value);
+        void Float(float value);
+        void Double(double value);
+        void String(std::string_view value);
+        void ArrayHeader(uint32_t size);
+        void MapHeader(uint32_t size);
+
+        // Произвольное значение JSON с сохранением структуры
+        void Value(const boost::json::value& value);
+
+    private:
+        template <typename T>
+        void BigEndian(uint8_t tag, T value);
+
+        std::string& out_;
+    };
+
+}  // namespace msgpack
@@ -0,0 +1,90 @@
+#include "negotiation.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <algorithm>
+#include <charconv>
+
+namespace http_handler {
+
+    namespace {
+
+        std::string_view Trim(std::string_view str) {
+            const auto begin = str.find_first_not_of(" \t");
+            if (begin == std::string_view::npos) {
+                return {};
+            }
+            const auto end = str.find_last_not_of(" \t");
+            return str.substr(begin, end - begin + 1);
+        }
+
+        // Вес варианта берётся из самого точного подходящего диапазона: тип целиком, тип/*, */*
+        struct MediaRangeMatch {
+            int precision = -1;
+            double quality = 0.;
+
+            void Update(int range_precision, double range_quality) {
+                if (range_precision > precision) {
+                    precision = range_precision;
+                    quality = range_quality;
+                }
+            }
+        };
+
+        // Насколько точно диапазон из Accept описывает тип: 2 - совпадает, 1 - тип/*, 0 - */*, -1 - не подходит
+        int MatchMediaRange(std::string_view range, std::string_view media_type) {
+            if (boost::iequals(range, media_type)) {
+                return 2;
+            }
+            if (range == "*/*"sv) {
+                return 0;
+            }
+            const auto slash_pos = media_type.find('/');
+            if (range.ends_with("/*"sv) && boost::iequals(range.substr(0, range.size() - 1),
+                                                          media_type.substr(0, slash_pos + 1))) {
+                return 1;
+            }
+            return -1;
+        }
+
+    }  // namespace
+
+    WeightedValue ParseWeightedValue(std::string_view item) {
+        auto delim_pos = item.find(';');
+        WeightedValue result{Trim(item.substr(0, delim_pos))};
+
+        while (delim_pos != std::string_view::npos) {
+            item.remove_prefix(delim_pos + 1);
+            delim_pos = item.find(';');
+            const std::string_view param = Trim(item.substr(0, delim_pos));
+
+            if (param.size() >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                // Нечисловой вес не запрещает вариант
+                const std::string_view value = param.substr(2);
+                double quality = 1.;
+                if (std::from_chars(value.data(), value.data() + value.size(), quality).ec == std::errc{}) {
+                    result.quality = std::clamp(quality, 0., 1.);
+                }
+                break;
+            }
+        }
+
+        return result;
+    }
+
+    BodyEncoding NegotiateEncoding(std::string_view accept) {
+        constexpr std::string_view APP_JSON = "application/json"sv;
+        constexpr std::string_view APP_MSGPACK = "application/msgpack"sv;
+
+        MediaRangeMatch json;
+        MediaRangeMatch msgpack;
+        ForEachWeightedValue(accept, [&json, &msgpack](const WeightedValue& range) {
+            json.Update(MatchMediaRange(range.value, APP_JSON), range.quality);
+            msgpack.Update(MatchMediaRange(range.value, APP_MSGPACK), range.quality);
+        });
+
+        const bool explicit_msgpack = msgpack.precision == 2 && msgpack.quality > 0.;
+        return explicit_msgpack && msgpack.quality >= json.quality ? BodyEncoding::MSGPACK : BodyEncoding::JSON;
+    }
+
+}  // namespace http_handler
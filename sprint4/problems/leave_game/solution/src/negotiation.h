@@ -0,0 +1,37 @@
+#pragma once
+
+#include "type_declarations.h"
+
+#include <string_view>
+
+namespace http_handler {
+
+    // Элемент списка из заголовков Accept и Accept-Encoding: значение без параметров и его вес q
+    struct WeightedValue {
+        std::string_view value;
+        // От 0 до 1, без параметра q - 1. Значение 0 запрещает вариант
+        double quality = 1.;
+    };
+
+    // Разбирает элемент вида "gzip;q=0.5" или "application/json; charset=utf-8; q=0.9"
+    WeightedValue ParseWeightedValue(std::string_view item);
+
+    // Вызывает fn(WeightedValue) для каждого непустого элемента списка через запятую
+    template <typename Fn>
+    void ForEachWeightedValue(std::string_view header, Fn&& fn) {
+        while (!header.empty()) {
+            const auto delim_pos = header.find(',');
+            const WeightedValue item = ParseWeightedValue(header.substr(0, delim_pos));
+            header.remove_prefix(delim_pos == std::string_view::npos ? header.size() : delim_pos + 1);
+
+            if (!item.value.empty()) {
+                fn(item);
+            }
+        }
+    }
+
+    // Представление тела по значению Accept. MessagePack выбирается, только если клиент явно указал
+    // application/msgpack с ненулевым весом не меньше, чем вес JSON (в том числе через application/* и */*)
+    BodyEncoding NegotiateEncoding(std::string_view accept);
+
+}  // namespace http_handler
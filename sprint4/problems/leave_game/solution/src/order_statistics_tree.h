@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+    // B+-дерево с размерами поддеревьев во внутренних узлах. Значения лежат в листьях,
+    // связанных в список, поэтому выборка k значений начиная с позиции start занимает O(log n + k).
+    // Less должен задавать строгий порядок без равных значений
+    template <typename T, typename Less>
+    class OrderStatisticsTree {
+    public:
+        explicit OrderStatisticsTree(Less less = {})
+            : less_(std::move(less)) {
+        }
+
+        OrderStatisticsTree(const OrderStatisticsTree&) = delete;
+        OrderStatisticsTree& operator=(const OrderStatisticsTree&) = delete;
+
+        size_t Size() const noexcept { return size_; }
+
+        void Insert(T value) {
+            if (auto sibling = InsertInto(*root_, std::move(value))) {
+                auto root = std::make_unique<Node>();
+                root->firsts = {First(*root_), First(*sibling)};
+                root->sizes = {Count(*root_), Count(*sibling)};
+                root->children.push_back(std::move(root_));
+                root->children.push_back(std::move(sibling));
+                root_ = std::move(root);
+            }
+            ++size_;
+        }
+
+        // Строит дерево заново из значений, уже упорядоченных по Less. Листья заполняются целиком
+        void Assign(std::vector<T> sorted) {
+            size_ = sorted.size();
+
+            std::vector<std::unique_ptr<Node>> level;
+            for (size_t pos = 0; pos < sorted.size(); pos += MAX_ITEMS) {
+                auto leaf = std::make_unique<Node>();
+                const size_t end = std::min(sorted.size(), pos + MAX_ITEMS);
+                leaf->items.assign(std::make_move_iterator(sorted.begin() + pos),
+                                   std::make_move_iterator(sorted.begin() + end));
+                if (!level.empty()) {
+                    level.back()->next = leaf.get();
+                }
+                level.push_back(std::move(leaf));
+            }
+
+            while (level.size() > 1) {
+                std::vector<std::unique_ptr<Node>> parents;
+                for (size_t pos = 0; pos < level.size(); pos += MAX_ITEMS) {
+                    auto parent = std::make_unique<Node>();
+                    const size_t end = std::min(level.size(), pos + MAX_ITEMS);
+                    for (size_t i = pos; i < end; ++i) {
+                        parent->firsts.push_back(First(*level[i]));
+                        parent->sizes.push_back(Count(*level[i]));
+                        parent->children.push_back(std::move(level[i]));
+                    }
+                    parents.push_back(std::move(parent));
+                }
+                level = std::move(parents);
+            }
+
+            root_ = level.empty() ? std::make_unique<Node>() : std::move(level.front());
+        }
+
+        // Вызывает fn для значений на позициях [start, start + count) в порядке возрастания
+        template <typename Fn>
+        void ForEach(size_t start, size_t count, Fn&& fn) const {
+            if (start >= size_) {
+                return;
+            }
+
+            const Node* node = root_.get();
+            while (!node->IsLeaf()) {
+                size_t child = 0;
+                while (start >= node->sizes[child]) {
+                    start -= node->sizes[child++];
+                }
+                node = node->children[child].get();
+            }
+
+            for (; node && count > 0; node = node->next, start = 0) {
+                for (size_t i = start; i < node->items.size() && count > 0; ++i, --count) {
+                    fn(node->items[i]);
+                }
+            }
+        }
+
+    private:
+        static constexpr size_t MAX_ITEMS = 64;
+
+        struct Node {
+            // Лист
+            std::vector<T> items;
+            Node* next = nullptr;
+            // Внутренний узел: наименьшее значение и размер каждого поддерева
+            std::vector<T> firsts;
+            std::vector<size_t> sizes;
+            std::vector<std::unique_ptr<Node>> children;
+
+            bool IsLeaf() const noexcept { return children.empty(); }
+        };
+
+        static const T& First(const Node& node) {
+            return node.IsLeaf() ? node.items.front() : node.firsts.front();
+        }
+
+        static size_t Count(const Node& node) {
+            return node.IsLeaf() ? node.items.size()
+                                 : std::accumulate(node.sizes.begin(), node.sizes.end(), size_t{0});
+        }
+
+        // Возвращает правую половину узла, если он переполнился
+        std::unique_ptr<Node> InsertInto(Node& node, T value) {
+            if (node.IsLeaf()) {
+                auto pos = std::upper_bound(node.items.begin(), node.items.end(), value, less_);
+                node.items.insert(pos, std::move(value));
+                if (node.items.size() <= MAX_ITEMS) {
+                    return nullptr;
+                }
+
+                auto sibling = std::make_unique<Node>();
+                const auto middle = node.items.begin() + node.items.size() / 2;
+                sibling->items.assign(std::make_move_iterator(middle), std::make_move_iterator(node.items.end()));
+                node.items.erase(middle, node.items.end());
+                sibling->next = node.next;
+                node.next = sibling.get();
+                return sibling;
+            }
+
+            // Последнее поддерево, наименьшее значение которого не больше вставляемого
+            const size_t child = std::max<size_t>(
+                1, std::upper_bound(node.firsts.begin() + 1, node.firsts.end(), value, less_) - node.firsts.begin()) - 1;
+            if (child == 0 && less_(value, node.firsts.front())) {
+                node.firsts.front() = value;
+            }
+            ++node.sizes[child];
+
+            auto sibling = InsertInto(*node.children[child], std::move(value));
+            if (!sibling) {
+                return nullptr;
+            }
+
+            const size_t sibling_size = Count(*sibling);
+            node.sizes[child] -= sibling_size;
+            node.firsts.insert(node.firsts.begin() + child + 1, First(*sibling));
+            node.sizes.insert(node.sizes.begin() + child + 1, sibling_size);
+            node.children.insert(node.children.begin() + child + 1, std::move(sibling));
+            if (node.children.size() <= MAX_ITEMS) {
+                return nullptr;
+            }
+
+            auto right = std::make_unique<Node>();
+            const size_t middle = node.children.size() / 2;
+            right->firsts.assign(node.firsts.begin() + middle, node.firsts.end());
+            right->sizes.assign(node.sizes.begin() + middle, node.sizes.end());
+            right->children.assign(std::make_move_iterator(node.children.begin() + middle),
+                                   std::make_move_iterator(node.children.end()));
+            node.firsts.resize(middle);
+            node.sizes.resize(middle);
+            node.children.resize(middle);
+            return right;
+        }
+
+        Less less_;
+        std::unique_ptr<Node> root_ = std::make_unique<Node>();
+        size_t size_ = 0;
+    };
+
+}  // namespace util
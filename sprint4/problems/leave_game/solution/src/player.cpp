@@ -8,12 +8,13 @@ namespace Player {
         game_session->AddDog(dog_);
     }
 
-    model::Dog::Id Player::GetDogId() {
+    model::Dog::Id Player::GetDogId() const {
         return dog_->GetId();
     }
 
-    void Player::MovePlayer(std::string direction) {
-        dog_->SetDogDirSpeed(direction);
+    void Player::MovePlayer(model::Move move) {
+        dog_->SetDogDirSpeed(move);
+        game_session_->BumpStateVersion();
     }
 
     const std::shared_ptr<model::GameSession> Player::GetGameSession() const {
@@ -20,9 +20,9 @@ namespace Player {
     public:
         Player() = delete;
         Player(std::shared_ptr<model::Dog> dog, std::shared_ptr<model::GameSession> game_session);
-        model::Dog::Id GetDogId();
+        model::Dog::Id GetDogId() const;
 
-        void MovePlayer(std::string direction = "");
+        void MovePlayer(model::Move move = model::Move::STOP);
 
         const std::shared_ptr<model::GameSession> GetGameSession() const;
 
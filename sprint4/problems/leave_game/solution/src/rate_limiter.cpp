@@ -0,0 +1,118 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace http_handler {
+
+    RateLimiter::RateLimiter(RateLimitConfig config)
+        : config_(std::move(config)) {
+    }
+
+    std::optional<size_t> RateLimiter::FindLimit(std::string_view path) const noexcept {
+        for (size_t i = 0; i < config_.routes.size(); ++i) {
+            if (config_.routes[i].first == path) {
+                return i;
+            }
+        }
+
+        if (config_.default_limit) {
+            return config_.routes.size();
+        }
+        return std::nullopt;
+    }
+
+    const RateLimit& RateLimiter::GetLimit(size_t index) const noexcept {
+        return index < config_.routes.size() ? config_.routes[index].second : *config_.default_limit;
+    }
+
+    void RateLimiter::Refill(Bucket& bucket, Clock::time_point now) const {
+        const RateLimit& limit = GetLimit(bucket.limit_index);
+        const std::chrono::duration<double> elapsed = now - bucket.updated;
+        if (elapsed.count() > 0.) {
+            bucket.tokens = std::min(limit.burst, bucket.tokens + elapsed.count() * limit.rate);
+            bucket.updated = now;
+        }
+    }
+
+    void RateLimiter::Evict(Shard& shard, Clock::time_point now) const {
+        for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+            Refill(it->second, now);
+            if (it->second.tokens >= GetLimit(it->second.limit_index).burst) {
+                it = shard.buckets.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::chrono::seconds RateLimiter::Check(std::string_view path, std::string_view client,
+                                            Clock::time_point now) {
+        path = path.substr(0, path.find('?'));
+        const auto limit_index = FindLimit(path);
+        if (!limit_index) {
+            return std::chrono::seconds{0};
+        }
+
+        // Лимит по умолчанию общий для всех путей без собственного лимита
+        const uint64_t key = std::hash<std::string_view>{}(client) * 31 + *limit_index;
+        Shard& shard = shards_[(key >> 7) % SHARDS_COUNT];
+        const RateLimit& limit = GetLimit(*limit_index);
+
+        std::lock_guard lock{shard.mutex};
+        auto it = shard.buckets.find(key);
+        if (it == shard.buckets.end()) {
+            if (shard.buckets.size() >= MAX_SHARD_BUCKETS) {
+                // Проход по шарду не чаще раза в секунду, даже если вёдра не успевают наполниться
+                if (now - shard.evicted >= std::chrono::seconds{1}) {
+                    Evict(shard, now);
+                    shard.evicted = now;
+                }
+                // Клиент вытесненного ведра получит полное ведро, зато таблица не растёт
+                if (shard.buckets.size() >= MAX_SHARD_BUCKETS) {
+                    shard.buckets.erase(shard.buckets.begin());
+                }
+            }
+            it = shard.buckets.emplace(key, Bucket{limit.burst, now, *limit_index}).first;
+        } else {
+            Refill(it->second, now);
+        }
+        Bucket& bucket = it->second;
+
+        if (bucket.tokens >= 1.) {
+            bucket.tokens -= 1.;
+            return std::chrono::seconds{0};
+        }
+
+        ++shard.limited;
+        const double wait = (1. - bucket.tokens) / limit.rate;
+        return std::chrono::seconds{std::max<int64_t>(1, static_cast<int64_t>(std::ceil(wait)))};
+    }
+
+    std::chrono::seconds RateLimiter::Check(std::string_view path, const app::Token& token,
+                                            Clock::time_point now) {
+        std::array<char, app::Token::HEX_SIZE> hex;
+        token.WriteHex(hex.data());
+        return Check(path, std::string_view(hex.data(), hex.size()), now);
+    }
+
+    uint64_t RateLimiter::GetLimitedRequests() const noexcept {
+        uint64_t result = 0;
+        for (const Shard& shard : shards_) {
+            std::lock_guard lock{shard.mutex};
+            result += shard.limited;
+        }
+        return result;
+    }
+
+    size_t RateLimiter::GetBucketsCount() const noexcept {
+        size_t result = 0;
+        for (const Shard& shard : shards_) {
+            std::lock_guard lock{shard.mutex};
+            result += shard.buckets.size();
+        }
+        return result;
+    }
+
+}  // namespace http_handler
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "token.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace http_handler {
+
+    struct RateLimit {
+        // Пополнение ведра в запросах в секунду, больше нуля
+        double rate = 1.;
+        // Ёмкость ведра: сколько запросов можно сделать подряд после паузы, не меньше 1
+        double burst = 1.;
+    };
+
+    // Секция "rateLimits" конфигурации. Без неё запросы не ограничиваются
+    struct RateLimitConfig {
+        // Применяется к путям API, для которых нет собственного лимита
+        std::optional<RateLimit> default_limit;
+        // Путь запроса без параметров -> лимит
+        std::vector<std::pair<std::string, RateLimit>> routes;
+
+        bool IsEmpty() const noexcept {
+            return !default_limit && routes.empty();
+        }
+    };
+
+    // Token bucket на каждую пару (клиент, путь). Клиент - токен игрока или адрес соединения.
+    // Таблица вёдер разбита на шарды со своими мьютексами, поэтому проверка выполняется
+    // в потоке соединения до отправки запроса на стренд API
+    class RateLimiter {
+        static constexpr size_t SHARDS_COUNT = 64;
+        // Жёсткий предел числа вёдер в шарде. При его достижении шард удаляет вёдра,
+        // которые успели наполниться, а если таких нет - произвольное ведро
+        static constexpr size_t MAX_SHARD_BUCKETS = 8192;
+
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit RateLimiter(RateLimitConfig config = {});
+
+        RateLimiter(const RateLimiter&) = delete;
+        RateLimiter& operator=(const RateLimiter&) = delete;
+
+        // Параметры запроса после '?' в path не учитываются.
+        // Возвращает 0, если запрос разрешён, иначе - через сколько секунд (не меньше 1)
+        // в ведре появится следующий запрос
+        std::chrono::seconds Check(std::string_view path, std::string_view client,
+                                   Clock::time_point now = Clock::now());
+
+        // Клиент - токен игрока. Ключом служит его каноническая запись строчными цифрами,
+        // поэтому одно и то же значение в разном регистре попадает в одно ведро
+        std::chrono::seconds Check(std::string_view path, const app::Token& token,
+                                   Clock::time_point now = Clock::now());
+
+        bool IsEnabled() const noexcept { return !config_.IsEmpty(); }
+
+        uint64_t GetLimitedRequests() const noexcept;
+
+        size_t GetBucketsCount() const noexcept;
+
+        // Не больше стольких вёдер во всей таблице
+        static constexpr size_t MAX_BUCKETS = SHARDS_COUNT * MAX_SHARD_BUCKETS;
+
+    private:
+
+        struct Bucket {
+            double tokens = 0.;
+            Clock::time_point updated;
+            size_t limit_index = 0;
+        };
+
+        struct alignas(64) Shard {
+            mutable std::mutex mutex;
+            // Ключ - хэш клиента и пути, редкие совпадения лишь объединяют два ведра
+            std::unordered_map<uint64_t, Bucket> buckets;
+            uint64_t limited = 0;
+            Clock::time_point evicted;
+        };
+
+        // Индекс лимита пути в config_.routes или routes.size() для лимита по умолчанию
+        std::optional<size_t> FindLimit(std::string_view path) const noexcept;
+        const RateLimit& GetLimit(size_t index) const noexcept;
+
+        void Refill(Bucket& bucket, Clock::time_point now) const;
+        void Evict(Shard& shard, Clock::time_point now) const;
+
+        RateLimitConfig config_;
+        std::array<Shard, SHARDS_COUNT> shards_;
+    };
+
+}  // namespace http_handler
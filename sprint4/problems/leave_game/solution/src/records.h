@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace app {
+
+    // Итог игрока, ушедшего на пенсию
+    struct PlayerRecord {
+        std::string name;
+        int score = 0;
+        std::chrono::milliseconds play_time{0};
+    };
+
+    // Получатель итогов игроков. Вызывается на стренде игры, поэтому не должен блокировать тик
+    class RecordsSink {
+    public:
+        virtual ~RecordsSink() = default;
+
+        virtual void Save(PlayerRecord record) = 0;
+    };
+
+    // Таблица рекордов: по убыванию счёта, затем по возрастанию времени в игре и по имени
+    class RecordsSource {
+    public:
+        virtual ~RecordsSource() = default;
+
+        virtual std::vector<PlayerRecord> GetRecords(size_t start, size_t max_items) const = 0;
+    };
+
+}  // namespace app
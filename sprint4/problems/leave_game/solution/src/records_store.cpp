@@ -0,0 +1,265 @@
+#include "records_store.h"
+#include "log.h"
+#include "util.h"
+
+#include <boost/crc.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+namespace app {
+    using namespace std::literals;
+
+    namespace {
+        constexpr std::string_view HEADER = "GSRECORDS\x01"sv;
+        // Длина и контрольная сумма кадра
+        constexpr size_t FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);
+        // Счёт, время в игре и длина имени
+        constexpr size_t RECORD_HEADER_SIZE = sizeof(int32_t) + sizeof(int64_t) + sizeof(uint32_t);
+
+        void PutUint(std::string& out, uint64_t value, size_t bytes) {
+            for (size_t i = 0; i < bytes; ++i) {
+                out.push_back(static_cast<char>(value >> (i * 8)));
+            }
+        }
+
+        uint64_t GetUint(std::string_view data, size_t pos, size_t bytes) {
+            uint64_t value = 0;
+            for (size_t i = 0; i < bytes; ++i) {
+                value |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos + i])) << (i * 8);
+            }
+            return value;
+        }
+
+        uint32_t Checksum(std::string_view data) {
+            boost::crc_32_type crc;
+            crc.process_bytes(data.data(), data.size());
+            return crc.checksum();
+        }
+
+        void WriteAll(int fd, std::string_view data) {
+            while (!data.empty()) {
+                const ssize_t written = ::write(fd, data.data(), data.size());
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::system_error(errno, std::generic_category(), "Failed to write records");
+                }
+                data.remove_prefix(static_cast<size_t>(written));
+            }
+        }
+
+        void EncodeRecord(std::string& out, const PlayerRecord& record) {
+            PutUint(out, static_cast<uint32_t>(record.score), sizeof(int32_t));
+            PutUint(out, static_cast<uint64_t>(record.play_time.count()), sizeof(int64_t));
+            PutUint(out, record.name.size(), sizeof(uint32_t));
+            out.append(record.name);
+        }
+    }
+
+    bool RecordsStore::Order::operator()(const RankKey& lhs, const RankKey& rhs) const {
+        if (lhs.score != rhs.score) {
+            return lhs.score > rhs.score;
+        }
+        if (lhs.play_time_ms != rhs.play_time_ms) {
+            return lhs.play_time_ms < rhs.play_time_ms;
+        }
+        const auto lhs_name = store->GetName(store->entries_[lhs.id]);
+        if (const int cmp = lhs_name.compare(store->GetName(store->entries_[rhs.id])); cmp != 0) {
+            return cmp < 0;
+        }
+        return lhs.id < rhs.id;
+    }
+
+    RecordsStore::RecordsStore(fs::path file)
+        : file_(std::move(file)) {
+        if (file_.empty()) {
+            return;
+        }
+
+        Load();
+        writer_ = std::jthread([this](std::stop_token stop) { WriteLoop(stop); });
+    }
+
+    RecordsStore::RankKey RecordsStore::Add(int32_t score, int64_t play_time_ms, std::string_view name) {
+        const auto id = static_cast<uint32_t>(entries_.size());
+        entries_.push_back(Entry{play_time_ms, names_.size(), score, static_cast<uint32_t>(name.size())});
+        names_.append(name);
+        return RankKey{play_time_ms, score, id};
+    }
+
+    void RecordsStore::Save(PlayerRecord record) {
+        index_.Insert(Add(record.score, record.play_time.count(), record.name));
+
+        if (!writer_.joinable()) {
+            return;
+        }
+
+        bool was_empty = false;
+        {
+            std::lock_guard lock(mutex_);
+            // После ошибки записи итоги остаются только в памяти
+            if (error_) {
+                return;
+            }
+            was_empty = pending_.empty();
+            EncodeRecord(pending_, record);
+            ++submitted_;
+        }
+        // Непустой пакет фоновый поток заберёт и без пробуждения
+        if (was_empty) {
+            cv_.notify_all();
+        }
+    }
+
+    std::vector<PlayerRecord> RecordsStore::GetRecords(size_t start, size_t max_items) const {
+        std::vector<PlayerRecord> records;
+        records.reserve(std::min(max_items, entries_.size() - std::min(start, entries_.size())));
+
+        index_.ForEach(start, max_items, [this, &records](const RankKey& key) {
+            const Entry& entry = entries_[key.id];
+            records.push_back(PlayerRecord{std::string(GetName(entry)), entry.score,
+                                           std::chrono::milliseconds(entry.play_time_ms)});
+        });
+
+        return records;
+    }
+
+    void RecordsStore::Sync() {
+        std::unique_lock lock(mutex_);
+        const uint64_t target = submitted_;
+        cv_.wait(lock, [this, target] { return written_ >= target || error_; });
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+    void RecordsStore::Load() {
+        std::string data;
+        if (fs::exists(file_)) {
+            data = util::ReadFromFileIntoString(file_);
+        }
+        // Короче заголовка бывает только файл, оборванный при создании
+        if (data.substr(0, HEADER.size()) != HEADER.substr(0, data.size())) {
+            throw std::runtime_error("Not a records file: "s + file_.string());
+        }
+
+        // Кадры читаются до первого оборванного или повреждённого
+        size_t pos = std::min(data.size(), HEADER.size());
+        const std::string_view view = data;
+        while (view.size() - pos >= FRAME_HEADER_SIZE) {
+            const auto size = static_cast<size_t>(GetUint(view, pos, sizeof(uint32_t)));
+            const auto checksum = static_cast<uint32_t>(GetUint(view, pos + sizeof(uint32_t), sizeof(uint32_t)));
+            if (view.size() - pos - FRAME_HEADER_SIZE < size) {
+                break;
+            }
+
+            const auto payload = view.substr(pos + FRAME_HEADER_SIZE, size);
+            if (Checksum(payload) != checksum) {
+                break;
+            }
+
+            for (size_t offset = 0; payload.size() - offset >= RECORD_HEADER_SIZE;) {
+                const auto score = static_cast<int32_t>(GetUint(payload, offset, sizeof(int32_t)));
+                const auto play_time = static_cast<int64_t>(GetUint(payload, offset + 4, sizeof(int64_t)));
+                const auto name_size = static_cast<size_t>(GetUint(payload, offset + 12, sizeof(uint32_t)));
+                offset += RECORD_HEADER_SIZE;
+                if (payload.size() - offset < name_size) {
+                    break;
+                }
+
+                Add(score, play_time, payload.substr(offset, name_size));
+                offset += name_size;
+            }
+            pos += FRAME_HEADER_SIZE + size;
+        }
+
+        if (pos < data.size()) {
+            fs::resize_file(file_, pos);
+        }
+
+        fd_ = ::open(file_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to open "s + file_.string());
+        }
+        if (data.size() < HEADER.size()) {
+            // Файл без заголовка пуст или оборван на заголовке
+            if (::ftruncate(fd_, 0) != 0) {
+                throw std::system_error(errno, std::generic_category(), "Failed to truncate "s + file_.string());
+            }
+            WriteAll(fd_, HEADER);
+        }
+
+        // Таблица рекордов строится одной сортировкой, а не вставками по одному
+        std::vector<RankKey> order;
+        order.reserve(entries_.size());
+        for (uint32_t id = 0; id < entries_.size(); ++id) {
+            order.push_back(RankKey{entries_[id].play_time_ms, entries_[id].score, id});
+        }
+        std::sort(order.begin(), order.end(), Order{this});
+        index_.Assign(std::move(order));
+    }
+
+    void RecordsStore::WriteLoop(std::stop_token stop) {
+        std::string batch;
+        std::string frame;
+        while (true) {
+            uint64_t target = 0;
+            {
+                std::unique_lock lock(mutex_);
+                // При остановке пакет дописывается до конца
+                cv_.wait(lock, stop, [this] { return !pending_.empty(); });
+                if (pending_.empty()) {
+                    break;
+                }
+                batch.swap(pending_);
+                pending_.clear();
+                target = submitted_;
+            }
+
+            frame.clear();
+            PutUint(frame, batch.size(), sizeof(uint32_t));
+            PutUint(frame, Checksum(batch), sizeof(uint32_t));
+            frame.append(batch);
+
+            std::exception_ptr error;
+            try {
+                WriteAll(fd_, frame);
+                if (::fdatasync(fd_) != 0) {
+                    throw std::system_error(errno, std::generic_category(), "Failed to sync records");
+                }
+            } catch (const std::system_error& e) {
+                ServerErrorLog(e.code().value(), e.what(), "records");
+                error = std::current_exception();
+            } catch (const std::exception& e) {
+                ServerErrorLog(0, e.what(), "records");
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard lock(mutex_);
+                // Итоги пакета не на диске: written_ не сдвигается, а Sync выбрасывает ошибку
+                if (error) {
+                    error_ = error;
+                    pending_.clear();
+                } else {
+                    written_ = target;
+                }
+            }
+            cv_.notify_all();
+
+            if (error) {
+                break;
+            }
+        }
+
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+}  // namespace app
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "order_statistics_tree.h"
+#include "records.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * Хранилище итогов ушедших на пенсию игроков.
+ *
+ * Итоги лежат в памяти плоской таблицей, имена - в общем буфере, а порядок таблицы рекордов
+ * поддерживает B+-дерево номеров записей с размерами поддеревьев (order_statistics_tree.h).
+ * Страница таблицы выбирается за O(log n + k) без пересортировки.
+ *
+ * Файл итогов только дописывается: заголовок, затем кадры [длина u32][CRC32 u32][итоги],
+ * итог - [счёт i32][время в игре, мс i64][длина имени u32][имя]. Итоги, сохранённые на стренде игры,
+ * копятся в пакет, который фоновый поток дописывает одним write и одним fdatasync.
+ * Оборванный при сбое последний кадр при загрузке отбрасывается и срезается с файла.
+ */
+namespace app {
+
+    namespace fs = std::filesystem;
+
+    class RecordsStore : public RecordsSink, public RecordsSource {
+    public:
+        // Без файла итоги хранятся только в памяти
+        explicit RecordsStore(fs::path file = {});
+
+        RecordsStore(const RecordsStore&) = delete;
+        RecordsStore& operator=(const RecordsStore&) = delete;
+
+        void Save(PlayerRecord record) override;
+
+        std::vector<PlayerRecord> GetRecords(size_t start, size_t max_items) const override;
+
+        size_t Size() const noexcept { return entries_.size(); }
+
+        // Дожидается, пока все сохранённые итоги окажутся на диске.
+        // Если файл перестал записываться, выбрасывает ошибку записи
+        void Sync();
+
+    private:
+        struct Entry {
+            int64_t play_time_ms;
+            uint64_t name_offset;
+            int32_t score;
+            uint32_t name_size;
+        };
+
+        // Ключ таблицы рекордов. Счёт и время лежат прямо в дереве, к имени сравнение
+        // обращается только при их совпадении
+        struct RankKey {
+            int64_t play_time_ms;
+            int32_t score;
+            uint32_t id;
+        };
+
+        // Порядок таблицы рекордов, при полном совпадении раньше идёт более ранний итог
+        struct Order {
+            const RecordsStore* store;
+
+            bool operator()(const RankKey& lhs, const RankKey& rhs) const;
+        };
+
+        std::string_view GetName(const Entry& entry) const {
+            return std::string_view(names_).substr(entry.name_offset, entry.name_size);
+        }
+
+        RankKey Add(int32_t score, int64_t play_time_ms, std::string_view name);
+
+        void Load();
+        void WriteLoop(std::stop_token stop);
+
+        // Используются только на стренде игры
+        std::vector<Entry> entries_;
+        std::string names_;
+        util::OrderStatisticsTree<RankKey, Order> index_{Order{this}};
+
+        fs::path file_;
+        int fd_ = -1;
+
+        std::mutex mutex_;
+        std::condition_variable_any cv_;
+        std::string pending_;
+        uint64_t submitted_ = 0;
+        uint64_t written_ = 0;
+        std::exception_ptr error_;
+
+        // Объявлен последним: поток останавливается и присоединяется до разрушения остальных полей
+        std::jthread writer_;
+    };
+
+}  // namespace app
@@ -0,0 +1,50 @@
+#include "request_arena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace http_handler {
+
+    namespace {
+
+        size_t AlignUp(size_t value, size_t alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+    }  // namespace
+
+    void* RequestArena::do_allocate(size_t bytes, size_t alignment) {
+        const size_t offset = AlignUp(used_, alignment);
+        required_ = AlignUp(required_, alignment) + bytes;
+        if (block_ && offset + bytes <= block_size_) {
+            used_ = offset + bytes;
+            return block_.get() + offset;
+        }
+
+        // new[] выравнивает только до __STDCPP_DEFAULT_NEW_ALIGNMENT__, запас покрывает остальное
+        const size_t padding = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? alignment : 0;
+        std::unique_ptr<std::byte[]> chunk(new std::byte[bytes + padding]);
+        void* ptr = chunk.get();
+        overflow_.push_back(std::move(chunk));
+        size_t space = bytes + padding;
+        return std::align(alignment, bytes, ptr, space);
+    }
+
+    void RequestArena::Reset() noexcept {
+        if (!overflow_.empty()) {
+            overflow_.clear();
+            // Блок освобождается заранее, чтобы старый и новый не занимали память одновременно
+            block_.reset();
+            block_size_ = 0;
+            const size_t size = std::max(AlignUp(required_, alignof(std::max_align_t)), MIN_BLOCK_SIZE);
+            // Без блока арена продолжит брать память из кучи и попробует снова при следующем Reset
+            block_.reset(new (std::nothrow) std::byte[size]);
+            if (block_) {
+                block_size_ = size;
+            }
+        }
+        used_ = 0;
+        required_ = 0;
+    }
+
+}  // namespace http_handler
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+namespace http_handler {
+
+    // Память заголовков и строковых тел одного запроса и ответа на него. Выделение сдвигает
+    // указатель в блоке, освобождение ничего не делает, Reset после отправки ответа отдаёт
+    // всё сразу. Не поместившееся в блок берётся из кучи отдельно, а Reset увеличивает блок,
+    // поэтому после первых запросов арена работает без обращений к куче. Не потокобезопасна:
+    // запросом и ответом в каждый момент владеет кто-то один - сессия или стренд API
+    class RequestArena : public std::pmr::memory_resource {
+    public:
+        RequestArena() = default;
+        RequestArena(const RequestArena&) = delete;
+        RequestArena& operator=(const RequestArena&) = delete;
+
+        // Всё выделенное из арены становится недействительным
+        void Reset() noexcept;
+
+        size_t Capacity() const noexcept { return block_size_; }
+
+    private:
+        static constexpr size_t MIN_BLOCK_SIZE = 1024;
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void*, size_t, size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        std::unique_ptr<std::byte[]> block_;
+        size_t block_size_ = 0;
+        size_t used_ = 0;
+        std::vector<std::unique_ptr<std::byte[]>> overflow_;
+        // Сколько понадобилось бы блоку, чтобы вместить всё выделенное с прошлого Reset
+        size_t required_ = 0;
+    };
+
+    // Аллокатор полей и тел сообщений Beast поверх арены. В отличие от
+    // std::pmr::polymorphic_allocator допускает присваивание, которого требует
+    // http::basic_fields. По умолчанию память берётся из кучи, так что сообщения
+    // без арены ведут себя как с std::allocator
+    template <typename T>
+    class ArenaAllocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        ArenaAllocator() noexcept = default;
+
+        explicit ArenaAllocator(std::pmr::memory_resource* resource) noexcept
+            : resource_(resource) {
+        }
+
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+            : resource_(other.resource()) {
+        }
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* p, size_t n) noexcept {
+            resource_->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        std::pmr::memory_resource* resource() const noexcept {
+            return resource_;
+        }
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U>& other) const noexcept {
+            return resource_ == other.resource();
+        }
+
+    private:
+        std::pmr::memory_resource* resource_ = std::pmr::new_delete_resource();
+    };
+
+}  // namespace http_handler
@@ -3,22 +3,23 @@
 // #include "boost/beast/core/string_type.hpp"
 
 #include "extra_data.h"
+#include "msgpack.h"
 
+#include <charconv>
 #include <chrono>
 #include <cstdint>
 #include <exception>
 #include <memory>
 #include <system_error>
 #include <variant>
-#include <regex>
 #include <optional>
 
 namespace http_handler {
 
     // Запрос, тело которого представлено в виде строки
-    using StringRequest = http::request<http::string_body>;
+    using StringRequest = http::request<StringBody, Fields>;
     // Ответ, тело которого представлено в виде строки-fdiagnostics-color=always
-    using StringResponse = http::response<http::string_body>;
+    using StringResponse = http::response<StringBody, Fields>;
 
     bool IsAllowedReqMethod(beast::http::verb method) {
         return method == http::verb::get || method != http::verb::head;
@@ -79,29 +80,47 @@ namespace http_handler {
     }
 
     StringResponse ErrorHandler::MakeNotAllowedResponse(const JsonResponseHandler& json_response,
-                                                     std::vector<std::string> allowed_methods,
+                                                     std::string_view allowed_methods,
                                                      std::string_view error_code,
                                                      std::string_view error_msg) {
         std::string response_body = error_code.empty() 
             ? SerializeErrorResponseBody("invalidMethod", "Invalid method") 
             : SerializeErrorResponseBody(error_code, error_msg);
 
-        std::string allowed_methods_str;
-        bool flag = true;
-        for (const auto& method : allowed_methods) {
-            if (!flag) { allowed_methods_str += ", "; }
-            
-            flag = false;
-            allowed_methods_str += method;
-        }
-
         StringResponse result = json_response(http::status::method_not_allowed, response_body, 
                                               ContentType::APP_JSON);
-        result.set(http::field::allow, allowed_methods_str);
+        result.set(http::field::allow, allowed_methods);
         
         return result;
     }
 
+    StringResponse ErrorHandler::MakeServiceUnavailableResponse(const JsonResponseHandler& json_response,
+                                                                std::chrono::seconds retry_after) {
+        std::string response_body = SerializeErrorResponseBody("serverBusy", "Server is overloaded");
+
+        StringResponse result = json_response(http::status::service_unavailable, response_body, 
+                                              ContentType::APP_JSON);
+        result.set(http::field::retry_after, std::to_string(retry_after.count()));
+
+        return result;
+    }
+
+    StringResponse ErrorHandler::MakeTooManyRequestsResponse(const JsonResponseHandler& json_response,
+                                                             std::chrono::seconds retry_after) {
+        std::string response_body = SerializeErrorResponseBody("tooManyRequests", "Too many requests");
+
+        StringResponse result = json_response(http::status::too_many_requests, response_body, 
+                                              ContentType::APP_JSON);
+        result.set(http::field::retry_after, std::to_string(retry_after.count()));
+
+        return result;
+    }
+
+    StringResponse ErrorHandler::MakeInternalServerErrorResponse(const JsonResponseHandler& json_response) {
+        std::string response_body = SerializeErrorResponseBody("internalError", "Internal server error");
+        return json_response(http::status::internal_server_error, response_body, ContentType::APP_JSON);
+    }
+
     StringResponse ErrorHandler::MakeUnauthorizedResponse(const JsonResponseHandler& json_response,
                                                           std::string_view error_code,
                                                           std::string_view error_msg) {
@@ -116,31 +135,74 @@ namespace http_handler {
                                             bool keep_alive,
                                             std::string_view content_type) {
         response.set(http::field::content_type, content_type);
-        response.body() = std::move(std::string(body));
+        response.body().assign(body);
         response.content_length(body.size());
         response.keep_alive(keep_alive);
     }
 
     StringResponse HttpResponse::MakeStringResponse(http::status status, std::string body_sv,
                                                     unsigned http_version, bool keep_alive,
-                                                    std::string_view content_type) {
-        StringResponse response(status, http_version);
+                                                    std::string_view content_type,
+                                                    const ArenaAllocator<char>& allocator) {
+        StringResponse response(status, http_version, allocator, allocator);
         MakeResponse(response, body_sv, keep_alive, content_type);
         return response;
     }
 
+    SharedResponse HttpResponse::MakeSharedResponse(http::status status, SharedBuffer body,
+                                                    unsigned http_version, bool keep_alive,
+                                                    std::string_view content_type,
+                                                    const ArenaAllocator<char>& allocator) {
+        SharedResponse response(status, http_version, std::move(body), allocator);
+        response.set(http::field::content_type, content_type);
+        response.content_length(SharedStringBody::size(response.body()));
+        response.keep_alive(keep_alive);
+        return response;
+    }
+
     RequestHandler::RequestHandler(model::Game& game, Strand& api_strand, fs::path path, 
-                                   app::Application& app)
+                                   app::Application& app, CompressionSettings compression,
+                                   ApiQueueSettings api_queue, RateLimitConfig rate_limits)
         : game_{game}
         , api_strand_(api_strand)
         , root_dir_(path)
-        , app_(app) {
+        , app_(app)
+        , rate_limiter_(std::move(rate_limits))
+        , api_handler_(game_, root_dir_, app_, compression, &rate_limiter_)
+        , api_queue_(api_queue) {
     }
 
+    std::chrono::seconds RequestHandler::CheckRateLimit(const StringRequest& req, 
+                                                        const net::ip::address& remote) {
+        if (!rate_limiter_.IsEnabled()) {
+            return std::chrono::seconds{0};
+        }
+
+        // Ведро привязано к токену, только если он выдан игроку. Иначе запросы учитываются по адресу
+        // клиента: подставляя каждый раз новый токен, нельзя ни обойти лимит, ни заполнить таблицу вёдер
+        auto authorization = req.base().find(http::field::authorization);
+        if (authorization != req.base().end()) {
+            const std::string_view hex = util::ExtractToken(authorization->value());
+            // Ключ - сам токен, а не присланная строка: FromHex принимает цифры в любом регистре
+            if (auto token = app::Token::FromHex(hex); token && app_.IsKnownToken(*token)) {
+                return rate_limiter_.Check(req.target(), *token);
+            }
+        }
+        return rate_limiter_.Check(req.target(), remote.to_string());
+    }
 
 
-    StringResponse ApiRequestHandler::RouteRequest(const StringRequest& req) {
-        return router_->Route(req);
+
+    ResponseVariant ApiRequestHandler::RouteRequest(const StringRequest& req) {
+        ResponseVariant response = router_->Route(req);
+        // Карты и состояние сжимаются с кэшем там, где строится тело, и сюда приходят уже сжатыми
+        if (auto* string_response = std::get_if<StringResponse>(&response)) {
+            compressor_.Compress(req, *string_response);
+        } else if (auto* shared_response = std::get_if<SharedResponse>(&response)) {
+            compressor_.Compress(req, *shared_response);
+        }
+
+        return response;
     }
 
     void ApiRequestHandler::SetupEndPoits() {
@@ -164,49 +226,57 @@ namespace http_handler {
 
         router_->AddRoute({"GET", "HEAD"}, "/api/v1/maps", 
             std::make_unique<HTTPResponseMaker>(
-            [this](const StringRequest& req, const JsonResponseHandler& json_response) -> StringResponse {
-                url::UrlParser parser(std::string(req.target()));
-                auto path_components = parser.GetComponents();
+            [this](const StringRequest& req, RouteParams, const JsonResponseHandler& json_response) -> StringResponse {
                 return this->GetMapsRequest(json_response);
             }
         ));
 
         router_->AddRoute({"GET", "HEAD"}, "/api/v1/maps/:", 
             std::make_unique<HTTPResponseMaker>(
-            [this](const StringRequest& req, const JsonResponseHandler& json_response) -> StringResponse {
-                url::UrlParser parser(std::string(req.target()));
-                auto map_id = parser.GetLastComponent();
-                return this->GetMapDetailsRequest(json_response, map_id);
+            [this](const StringRequest& req, RouteParams params, const JsonResponseHandler& json_response) -> ResponseVariant {
+                return this->GetMapDetailsRequest(req, json_response, params[0], NegotiateEncoding(req));
             }
         ));
 
         router_->AddRoute({"POST"}, "/api/v1/game/join", 
             std::make_shared<HTTPResponseMaker>(
-            [this](const StringRequest& req, const JsonResponseHandler& json_response) -> StringResponse {
+            [this](const StringRequest& req, RouteParams, const JsonResponseHandler& json_response) -> StringResponse {
                 return this->JoinGame(req, json_response);
             }));
 
         router_->AddRoute({"GET", "HEAD"}, "/api/v1/game/players", 
             std::make_shared<HTTPResponseMaker>(
-            [this ](const StringRequest& req, const JsonResponseHandler& json_response) -> StringResponse {
+            [this](const StringRequest& req, RouteParams, const JsonResponseHandler& json_response) -> ResponseVariant {
                 return this->GetPlayersRequest(req, json_response);
             }));
 
         router_->AddRoute({"GET", "HEAD"}, "/api/v1/game/state", 
             std::make_shared<HTTPResponseMaker>(
-            [this](const StringRequest& req, const JsonResponseHandler& json_response) -> StringResponse {
+            [this](const StringRequest& req, RouteParams, const JsonResponseHandler& json_response) -> ResponseVariant {
                 return this->GetGameState(req, json_response);
             }));
             
         router_->AddRoute({"POST"}, "/api/v1/game/player/action", 
             std::make_shared<HTTPResponseMaker>(
-            [this](const StringRequest& req, const JsonResponseHandler& json_response) -> StringResponse {
+            [this](const StringRequest& req, RouteParams, const JsonResponseHandler& json_response) -> StringResponse {
                 return this->MoveUnit(req, json_response);
             }));
 
+        router_->AddRoute({"POST"}, "/api/v1/game/player/actions", 
+            std::make_shared<HTTPResponseMaker>(
+            [this](const StringRequest& req, RouteParams, const JsonResponseHandler& json_response) -> StringResponse {
+                return this->MoveUnits(req, json_response);
+            }));
+
+        router_->AddRoute({"GET", "HEAD"}, "/api/v1/game/records", 
+            std::make_shared<HTTPResponseMaker>(
+            [this](const StringRequest& req, RouteParams, const JsonResponseHandler& json_response) -> StringResponse {
+                return this->GetRecordsRequest(req, json_response);
+            }));
+
         router_->AddRoute({"POST"}, "/api/v1/game/tick", 
             std::make_shared<HTTPResponseMaker>(
-            [this](const StringRequest& req, const JsonResponseHandler& json_response) -> StringResponse {
+            [this](const StringRequest& req, RouteParams, const JsonResponseHandler& json_response) -> StringResponse {
                 return this->TickRequest(req, json_response);
             }));
     }
@@ -217,76 +287,127 @@ namespace http_handler {
         return json_response(http::status::ok, std::move(maps), ContentType::APP_JSON);
     }
 
-    StringResponse ApiRequestHandler::GetMapDetailsRequest(const JsonResponseHandler& json_response,
-                                                           std::string_view map_id) const {
+    BodyEncoding NegotiateEncoding(const StringRequest& req) {
+        auto accept = req.base().find(http::field::accept);
+        return accept != req.base().end() ? NegotiateEncoding(accept->value()) : BodyEncoding::JSON;
+    }
+
+    ResponseVariant ApiRequestHandler::GetMapDetailsRequest(const StringRequest& req,
+                                                            const JsonResponseHandler& json_response,
+                                                            std::string_view map_id,
+                                                            BodyEncoding encoding) const {
         const model::Map::Id id{std::string(map_id)};
         auto map_ptr = game_.GetMapService().FindMap(id);
         
         if (map_ptr) {
-            auto map_json = json_loader::MapSerializer::SerializeSingleMap(*map_ptr);
-            json::array loot_types = *game_.GetLootService().GetLootTypes().at(map_ptr->GetId());
-            map_json["lootTypes"] = std::move(loot_types);
-            std::string serialized_map = boost::json::serialize(std::move(map_json));
+            const model::Map::Handle handle = map_ptr->GetHandle();
+            auto [it, inserted] = map_bodies_.try_emplace(MapBodyKey{handle, encoding});
+            if (inserted) {
+                auto map_json = json_loader::MapSerializer::SerializeSingleMap(*map_ptr);
+                if (const auto& loot_types = game_.GetLootService().GetLootTypes(handle)) {
+                    map_json["lootTypes"] = *loot_types;
+                }
 
-            return json_response(http::status::ok, std::move(serialized_map), ContentType::APP_JSON);
+                std::string body;
+                if (encoding == BodyEncoding::MSGPACK) {
+                    msgpack::Writer(body).Value(map_json);
+                } else {
+                    body = boost::json::serialize(map_json);
+                }
+                it->second = MakeSharedBuffer(std::move(body));
+            }
+
+            SharedResponse response = HttpResponse::MakeSharedResponse(
+                http::status::ok, it->second, req.version(), req.keep_alive(),
+                encoding == BodyEncoding::MSGPACK ? ContentType::APP_MSGPACK : ContentType::APP_JSON,
+                req.get_allocator());
+            response.set(http::field::vary, "Accept"sv);
+            compressor_.Compress(req, response, {CompressionKey::Kind::MAP, handle, encoding}, 0);
+
+            return response;
         }
 
         return ErrorHandler::MakeNotFoundResponse(json_response, "mapNotFound", "Map not found");
     }
 
-    std::optional<StringResponse> 
-    ApiRequestHandler::ParseJoinRequest(const StringRequest& req, 
-                                        const JsonResponseHandler& json_response,
-                                        json::object& obj) const {
-        std::string body = req.body().c_str();
+    RequestJsonParser::RequestJsonParser()
+        : resource_(buffer_.data(), buffer_.size()) {
+    }
+
+    const json::value* RequestJsonParser::Parse(std::string_view body) {
+        // Предыдущее значение размещено в resource_, поэтому уничтожается до его очистки
+        value_.reset();
+        resource_.release();
+        parser_.reset(json::storage_ptr(&resource_));
 
         json::error_code ec;
-        auto value = json::parse(body, ec);
-    
+        parser_.write(body.data(), body.size(), ec);
         if (ec) {
-            // std::cout << ec.what() << std::endl;
+            return nullptr;
+        }
+
+        value_.emplace(parser_.release());
+        return &*value_;
+    }
+
+    // Возвращает строковое поле объекта без копирования
+    std::optional<std::string_view> FindStringField(const json::object& object, const char* key) {
+        const json::value* field = object.if_contains(key);
+        if (!field || !field->is_string()) {
+            return std::nullopt;
+        }
+
+        const json::string& str = field->get_string();
+        return std::string_view(str.data(), str.size());
+    }
+
+    std::optional<StringResponse> 
+    ApiRequestHandler::ParseJoinRequest(const StringRequest& req, 
+                                        const JsonResponseHandler& json_response,
+                                        JoinRequest& join) {
+        const json::value* value = json_parser_.Parse(req.body());
+        if (!value || !value->is_object()) {
             return ErrorHandler::MakeBadRequestResponse(json_response, 
                                                         "invalidArgument", 
                                                         "Join game request parse error");
         }
-        obj = value.as_object();
 
+        auto user_name = FindStringField(value->get_object(), "userName");
+        if (!user_name || user_name->empty()) {
+            return ErrorHandler::MakeBadRequestResponse(json_response, "invalidArgument",
+                                                       "Invalid name");
+        }
+        auto map_id = FindStringField(value->get_object(), "mapId");
+        if (!map_id) {
+            return ErrorHandler::MakeBadRequestResponse(json_response, "invalidArgument",
+                                                       "Invalid mapId");
+        }
+
+        join = JoinRequest{*user_name, *map_id};
         return std::nullopt;
     }
 
     StringResponse ApiRequestHandler::JoinGame(const StringRequest& req, 
                                                const JsonResponseHandler& json_response) {
-        json::object object;  // modify by ParseJoinRequest
-        if (auto optional = ParseJoinRequest(req, json_response, object)) { 
+        JoinRequest join;
+        if (auto optional = ParseJoinRequest(req, json_response, join)) { 
             return optional.value(); 
         }
         
-        if (!object.count("userName")) {
-            return ErrorHandler::MakeBadRequestResponse(json_response, "invalidArgument",
-                                                       "Invalid name");
-        }
-        if (!object.count("mapId")) {
-            return ErrorHandler::MakeBadRequestResponse(json_response, "invalidArgument",
-                                                       "Invalid mapId");
-        }
-        
-        std::string map_id = object.at("mapId").as_string().c_str();
-        std::string user_name = object.at("userName").as_string().c_str();
-        auto session = game_.GetSessionService().FindGameSession(model::Map::Id{map_id.data()});
-        if (user_name.size() == 0) {
-            return ErrorHandler::MakeBadRequestResponse(json_response, "invalidArgument", 
-                                                        "Invalid name");
-        }
+        // Запрос проверен целиком до поиска сессии: для заполненной карты поиск открывает новую сессию
+        auto& session_service = game_.GetSessionService();
+        auto session = session_service.FindGameSession(model::Map::Id{std::string(join.map_id)});
         if (session == nullptr) {
             return ErrorHandler::MakeNotFoundResponse(json_response, "mapNotFound", "Map not found");
         }
 
-        std::shared_ptr<model::Dog> dog = std::make_shared<model::Dog>(user_name);
+        std::shared_ptr<model::Dog> dog = std::make_shared<model::Dog>(std::string(join.user_name));
 
-        app::Token token = app_.AddPlayer(dog, session);
+        // При ошибке AddPlayer сам откатывает вход и удаляет опустевшую сессию
+        const app::Token token = app_.AddPlayer(dog, session);
 
         json::value value = {
-            { SpecialStrings::AUTH_TOKEN.data(), *token },
+            { SpecialStrings::AUTH_TOKEN.data(), token.ToHex() },
             { SpecialStrings::PLAYER_ID.data(),  dog->GetId() }
         };
 
@@ -295,141 +416,96 @@ namespace http_handler {
         return json_response(http::status::ok, std::move(val), ContentType::APP_JSON.data());
     }
 
-    bool ApiRequestHandler::IsValidAuthToken(std::string& token) const {
-        const std::regex token_pattern("^[0-9a-fA-F]{32}$");
-        return std::regex_match(token, token_pattern);
+    std::optional<app::Token> ApiRequestHandler::ParseAuthToken(const StringRequest& req) const {
+        auto header = req.base().find(http::field::authorization);
+        if (header == req.base().end()) {
+            return std::nullopt;
+        }
+
+        return app::Token::FromHex(util::ExtractToken(header->value()));
     }
 
     std::optional<StringResponse> 
     ApiRequestHandler::TokenHandler(const StringRequest& req, 
                                     const JsonResponseHandler& json_response) const {
-        std::string auth_header;
-
-        auto auth_error = [&json_response]() {
-            return ErrorHandler::MakeUnauthorizedResponse(json_response, "invalidToken", 
-                                                          "Authorization header is missing");
-        };
-
-        if (!req.base().count(http::field::authorization)) {
-            return auth_error();
-        }
-
-        auth_header = std::string(req.base().at(http::field::authorization));
-        std::string token = util::ExtractToken(auth_header);
-        
-        if (token.empty() || !IsValidAuthToken(token)) {
-            return auth_error();
-        }
-
-        return std::nullopt;
+        app::Token token;
+        return TokenHandler(req, json_response, token);
     }
 
     std::optional<StringResponse> 
     ApiRequestHandler::TokenHandler(const StringRequest& req, 
                                     const JsonResponseHandler& json_response,
-                                    std::string& token) const {
-        std::string auth_header;
-
-        auto auth_error = [&json_response]() {
+                                    app::Token& token) const {
+        auto parsed = ParseAuthToken(req);
+        if (!parsed) {
             return ErrorHandler::MakeUnauthorizedResponse(json_response, "invalidToken", 
                                                           "Authorization header is missing");
-        };
-
-        if (!req.base().count(http::field::authorization)) {
-            return auth_error();
-        }
-
-        auth_header = std::string(req.base().at(http::field::authorization));
-        token = util::ExtractToken(auth_header);
-        
-        if (token.empty() || !IsValidAuthToken(token)) {
-            return auth_error();
         }
 
+        token = *parsed;
         return std::nullopt;
     }
 
     std::optional<StringResponse> 
     ApiRequestHandler::ParseContentType(const StringRequest& req,
                                         const JsonResponseHandler& json_response) const {
-        std::string content_header;
-
-        auto content_type_error = [&json_response]() {
+        auto content_header = req.base().find(http::field::content_type);
+        if (content_header == req.base().end() || content_header->value() != ContentType::APP_JSON) {
             return ErrorHandler::MakeBadRequestResponse(json_response, "invalidArgument", 
                                                         "Invalid content type");
-        };
-
-        if (req.base().count(http::field::content_type) == 0) {
-            return content_type_error();
-        }
-
-        content_header = std::string(req.base().at(http::field::content_type));
-
-        if (content_header != "application/json") {
-            return content_type_error();
         }
 
         return std::nullopt;
 
     }
 
-    StringResponse ApiRequestHandler::GetPlayersRequest(const StringRequest& req, 
-                                                        const JsonResponseHandler& json_response) const {
-        std::string token;
+    ResponseVariant ApiRequestHandler::GetPlayersRequest(const StringRequest& req, 
+                                                         const JsonResponseHandler& json_response) const {
+        app::Token token;
         if (auto optional = TokenHandler(req, json_response, token)) {
             return optional.value();
         }
         
-        if (!app_.HasPlayerToken(app::Token{token})) {
+        if (!app_.HasPlayerToken(token)) {
             return ErrorHandler::MakeUnauthorizedResponse(json_response, "unknownToken", 
                                                           "Player token has not been found");
         }
 
-        std::string response_body = app_.GetSerializedPlayersList(app::Token{token});
-        return json_response(http::status::ok, std::move(response_body), ContentType::APP_JSON);
+        return HttpResponse::MakeSharedResponse(http::status::ok, app_.GetSerializedPlayersList(token), 
+                                                req.version(), req.keep_alive(), ContentType::APP_JSON,
+                                                req.get_allocator());
     }
 
     std::optional<StringResponse> 
     ApiRequestHandler::ParseMoveJson(const JsonResponseHandler& json_response, 
-                                     std::string data,
-                                     std::string& direction) const {
-        std::string dir;
-        try {
-            json::value move_request = json::parse(data);
-            dir = move_request.at("move").as_string().data();
-        } catch (...) {
-            return ErrorHandler::MakeBadRequestResponse(json_response,
-                                                        "invalidArgument",
-                                                        "Failed to parse action");
+                                     std::string_view data,
+                                     model::Move& move) {
+        std::optional<model::Move> parsed;
+        const json::value* move_request = json_parser_.Parse(data);
+        if (move_request && move_request->is_object()) {
+            if (auto dir = FindStringField(move_request->get_object(), "move")) {
+                parsed = model::ParseMove(*dir);
+            }
         }
 
-        if (dir == "") {
-            direction = "";
-        } else if (dir == "L") {
-            direction = "L";
-        } else if (dir == "R") {
-            direction = "R";
-        } else if (dir == "U") {
-            direction = "U";
-        } else if (dir == "D") {
-            direction = "D";
-        } else {
+        if (!parsed) {
             return ErrorHandler::MakeBadRequestResponse(json_response,
                                                         "invalidArgument",
                                                         "Failed to parse action");
         }
 
+        move = *parsed;
         return std::nullopt;
     }
 
     StringResponse ApiRequestHandler::MoveUnit(const StringRequest& req, 
                                               const JsonResponseHandler& json_response) {
-        std::string token;
+        app::Token token;
         if (auto optional = TokenHandler(req, json_response, token)) {
             return optional.value();
         }
 
-        if (!app_.HasPlayerToken(app::Token{token})) {
+        if (!app_.HasPlayerToken(token)) {
             return ErrorHandler::MakeUnauthorizedResponse(json_response, "unknownToken", 
                                                           "Player token has not been found");
         }
@@ -438,31 +514,116 @@ namespace http_handler {
             return optional_parse_error.value();
         }
         
-        std::string direction = "";
-        if (auto optional_parse_error = ParseMoveJson(json_response, req.body().data(), direction)) {
+        model::Move move = model::Move::STOP;
+        if (auto optional_parse_error = ParseMoveJson(json_response, req.body(), move)) {
             return optional_parse_error.value();
-        } // modify direction value if Move Json was valid!
+        } // modify move value if Move Json was valid!
 
-        app_.MovePlayer(app::Token{token}, direction);
+        app_.MovePlayer(token, move);
 
         std::string response_body = "{}";
         return json_response(http::status::ok, response_body, ContentType::APP_JSON);
     }
 
-    StringResponse ApiRequestHandler::GetGameState(const StringRequest& req,
-                                    const JsonResponseHandler& json_response) const {
-        std::string token;
+    std::optional<StringResponse> 
+    ApiRequestHandler::ParseBatchJson(const JsonResponseHandler& json_response, std::string_view data) {
+        batch_actions_.clear();
+
+        const json::value* batch = json_parser_.Parse(data);
+        if (!batch || !batch->is_array() || batch->get_array().size() > MAX_BATCH_ACTIONS) {
+            return ErrorHandler::MakeBadRequestResponse(json_response, "invalidArgument",
+                                                        "Failed to parse actions");
+        }
+
+        for (const json::value& item : batch->get_array()) {
+            std::optional<app::Token> token;
+            std::optional<model::Move> move;
+            if (item.is_object()) {
+                if (auto hex = FindStringField(item.get_object(), "token")) {
+                    token = app::Token::FromHex(*hex);
+                }
+                if (auto dir = FindStringField(item.get_object(), "move")) {
+                    move = model::ParseMove(*dir);
+                }
+            }
+
+            if (!token || !move) {
+                return ErrorHandler::MakeBadRequestResponse(json_response, "invalidArgument",
+                                                            "Failed to parse actions");
+            }
+            batch_actions_.emplace_back(*token, *move);
+        }
+
+        return std::nullopt;
+    }
+
+    StringResponse ApiRequestHandler::MoveUnits(const StringRequest& req, 
+                                               const JsonResponseHandler& json_response) {
+        // Пакет отправляет игрок со своим токеном в Authorization: по этому токену сам запрос
+        // проходит ограничение частоты до стренда, а его действия - здесь, каждое по своему токену
+        app::Token sender;
+        if (auto optional = TokenHandler(req, json_response, sender)) {
+            return optional.value();
+        }
+        if (!app_.HasPlayerToken(sender)) {
+            return ErrorHandler::MakeUnauthorizedResponse(json_response, "unknownToken", 
+                                                          "Player token has not been found");
+        }
+
+        if (auto optional_parse_error = ParseContentType(req, json_response)) {
+            return optional_parse_error.value();
+        }
+
+        if (auto optional_parse_error = ParseBatchJson(json_response, req.body())) {
+            return optional_parse_error.value();
+        }
+
+        for (const auto& [token, move] : batch_actions_) {
+            if (token != sender) {
+                return ErrorHandler::MakeUnauthorizedResponse(json_response, "invalidToken", 
+                                                              "Action token does not match the sender");
+            }
+        }
+
+        if (rate_limiter_ && rate_limiter_->IsEnabled()) {
+            for (const auto& [token, move] : batch_actions_) {
+                if (const auto retry_after = rate_limiter_->Check(ACTION_PATH, token); retry_after.count() > 0) {
+                    return ErrorHandler::MakeTooManyRequestsResponse(json_response, retry_after);
+                }
+            }
+        }
+
+        for (const auto& [token, move] : batch_actions_) {
+            app_.MovePlayer(token, move);
+        }
+
+        std::string response_body = "{}";
+        return json_response(http::status::ok, response_body, ContentType::APP_JSON);
+    }
+
+    ResponseVariant ApiRequestHandler::GetGameState(const StringRequest& req,
+                                                    const JsonResponseHandler& json_response) const {
+        app::Token token;
         if (auto optional = TokenHandler(req, json_response, token)) {
             return optional.value();
         }
 
-        if (!app_.HasPlayerToken(app::Token{token})) {
+        if (!app_.HasPlayerToken(token)) {
             return ErrorHandler::MakeUnauthorizedResponse(json_response, "unknownToken", 
                                                           "Player token has not been found");
         }
 
-        auto response_body = app_.GetSerializedGameState(app::Token{token});
-        return json_response(http::status::ok, std::move(response_body), ContentType::APP_JSON);
+        const BodyEncoding encoding = NegotiateEncoding(req);
+        const auto state = app_.GetSerializedGameState(token, encoding);
+        SharedResponse response = HttpResponse::MakeSharedResponse(
+            http::status::ok, state.body, req.version(), req.keep_alive(),
+            encoding == BodyEncoding::MSGPACK ? ContentType::APP_MSGPACK : ContentType::APP_JSON,
+            req.get_allocator());
+        response.set(http::field::vary, "Accept"sv);
+        compressor_.Compress(req, response, {CompressionKey::Kind::STATE, state.session_id, encoding}, 
+                             state.generation);
+
+        return response;
     }
 
     bool IsDigit(char c) {
@@ -479,17 +640,20 @@ namespace http_handler {
 
     std::optional<StringResponse> 
     ApiRequestHandler::ParseTickJson(const JsonResponseHandler& json_response, 
-                                     std::string data,
-                                     uint64_t& milliseconds) const {
-        uint64_t value;
-        try {
-
-            boost::json::value jv = boost::json::parse(data);
-            value = json::value_to<uint64_t>(jv.at("timeDelta"));
-            if (value == 0) { 
-                jv.as_string();
-            }
-        } catch (...) {
+                                     std::string_view data,
+                                     uint64_t& milliseconds) {
+        const json::value* tick_request = json_parser_.Parse(data);
+        const json::value* time_delta = tick_request && tick_request->is_object()
+            ? tick_request->get_object().if_contains("timeDelta")
+            : nullptr;
+
+        json::error_code ec;
+        uint64_t value = 0;
+        if (time_delta) {
+            value = time_delta->to_number<uint64_t>(ec);
+        }
+
+        if (!time_delta || ec || value == 0) {
             return ErrorHandler::MakeBadRequestResponse(json_response,
                                                         "invalidArgument",
                                                         "Failed to parse tick request JSON");
@@ -501,13 +665,13 @@ namespace http_handler {
     }
 
     StringResponse ApiRequestHandler::TickRequest(const StringRequest& req, 
-                                                  const JsonResponseHandler& json_response) const {
+                                                  const JsonResponseHandler& json_response) {
         if (auto optional = ParseContentType(req, json_response)) {
             return optional.value();
         }
 
         uint64_t milliseconds;
-        if (auto optional = ParseTickJson(json_response, req.body().data(), milliseconds)) {
+        if (auto optional = ParseTickJson(json_response, req.body(), milliseconds)) {
             return optional.value();
         }
 
@@ -518,6 +682,37 @@ namespace http_handler {
         return json_response(http::status::ok, response_body, ContentType::APP_JSON);
     }
 
+    StringResponse ApiRequestHandler::GetRecordsRequest(const StringRequest& req,
+                                                        const JsonResponseHandler& json_response) const {
+        size_t start = 0;
+        size_t max_items = MAX_RECORDS_ITEMS;
+
+        auto parse_param = [&req](std::string_view name, size_t& value) {
+            const auto param = util::FindQueryParam(req.target(), name);
+            if (!param) {
+                return true;
+            }
+            const auto [ptr, ec] = std::from_chars(param->data(), param->data() + param->size(), value);
+            return ec == std::errc{} && ptr == param->data() + param->size();
+        };
+
+        if (!parse_param("start", start) || !parse_param("maxItems", max_items) || 
+            max_items > MAX_RECORDS_ITEMS) {
+            return ErrorHandler::MakeBadRequestResponse(json_response, "invalidArgument", 
+                                                        "Invalid records page");
+        }
+
+        json::array records_json;
+        for (const auto& record : app_.GetRecords(start, max_items)) {
+            records_json.push_back(json::object{
+                {"name", record.name},
+                {"score", record.score},
+                {"playTime", std::chrono::duration<double>(record.play_time).count()}});
+        }
+
+        return json_response(http::status::ok, json::serialize(records_json), ContentType::APP_JSON);
+    }
+
     EmptyResponse RequestHandler::CopyResponseWithoutBody(const ResponseVariant& response) const {
         EmptyResponse new_response;
 
@@ -548,7 +743,7 @@ namespace http_handler {
 
         if (IsSubPath(abs_path, base_path)) {
             if (fs::exists(abs_path)) {
-                return util::ReadStaticFile(abs_path);
+                return util::ReadStaticFile(abs_path, request.get_allocator());
             }
 
             return json_response(http::status::not_found, 
@@ -565,8 +760,11 @@ namespace http_handler {
     }
 
     ApiRequestHandler::ApiRequestHandler(model::Game& game, fs::path path, 
-                                         app::Application& app) 
+                                         app::Application& app, CompressionSettings compression,
+                                         RateLimiter* rate_limiter) 
         : game_(game), root_dir_(path), app_(app)
+        , compressor_(compression)
+        , rate_limiter_(rate_limiter)
         , router_(std::make_unique<router::Router>()) {
             SetupEndPoits();
     }
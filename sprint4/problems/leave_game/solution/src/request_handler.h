@@ -3,6 +3,9 @@
 #include "sdk.h"
 
 #include "application.h"
+#include "compression.h"
+#include "negotiation.h"
+#include "rate_limiter.h"
 #include "util.h"
 #include "model.h"
 #include "extra_data.h"
@@ -14,9 +17,15 @@
 #include "handlers.h"
 
 #include <boost/json/serialize.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <filesystem>
 #include <ctime>
 #include <variant>
@@ -41,21 +50,26 @@ namespace http_handler {
     fs::path ProcessingAbsPath(std::string_view base, std::string_view rel);
     
     // Запрос, тело которого представлено в виде строки
-    using StringRequest = http::request<http::string_body>;
+    using StringRequest = http::request<StringBody, Fields>;
     // Ответ, тело которого представлено в виде строки
-    using StringResponse = http::response<http::string_body>;
-    using FileResponse = http::response<http::file_body>;
-    using EmptyResponse = http::response<http::empty_body>;
+    using StringResponse = http::response<StringBody, Fields>;
+    using FileResponse = http::response<http::file_body, Fields>;
+    using EmptyResponse = http::response<http::empty_body, Fields>;
+    using SharedResponse = http::response<SharedStringBody, Fields>;
 
-    using ResponseVariant = std::variant<EmptyResponse, StringResponse, FileResponse>;
+    using ResponseVariant = std::variant<EmptyResponse, StringResponse, FileResponse, SharedResponse>;
 
     struct ContentType {
         ContentType() = delete;
         constexpr static std::string_view TEXT_HTML = "text/html"sv;
         constexpr static std::string_view TEXT_PLAIN = "text/plain"sv;
         constexpr static std::string_view APP_JSON = "application/json"sv;
+        constexpr static std::string_view APP_MSGPACK = "application/msgpack"sv;
     };
 
+    // MessagePack выбирается, только если клиент явно указал его в Accept с весом не меньше, чем у JSON
+    BodyEncoding NegotiateEncoding(const StringRequest& req);
+
     struct SpecialStrings {
         SpecialStrings() = delete;
 
@@ -79,12 +93,17 @@ namespace http_handler {
                                                    std::string_view error_code = "",
                                                    std::string_view error_msg = "");
         static StringResponse MakeNotAllowedResponse(const JsonResponseHandler& json_response,
-                                                     std::vector<std::string> allowed_methods,
+                                                     std::string_view allowed_methods,
                                                      std::string_view error_code = "",
                                                      std::string_view error_msg = "");
         static StringResponse MakeUnauthorizedResponse(const JsonResponseHandler& json_response,
                                                      std::string_view error_code = "",
                                                      std::string_view error_msg = "");
+        static StringResponse MakeServiceUnavailableResponse(const JsonResponseHandler& json_response,
+                                                             std::chrono::seconds retry_after);
+        static StringResponse MakeTooManyRequestsResponse(const JsonResponseHandler& json_response,
+                                                          std::chrono::seconds retry_after);
+        static StringResponse MakeInternalServerErrorResponse(const JsonResponseHandler& json_response);
     };
 
     class HttpResponse {
@@ -92,34 +111,81 @@ namespace http_handler {
         static void MakeResponse(StringResponse& response, std::string body, bool keep_alive,
                                  std::string_view content_type = ContentType::TEXT_HTML);
 
+        // Заголовки и тело размещаются аллокатором запроса, то есть в его арене
         static StringResponse MakeStringResponse(http::status status, std::string body_sv,
                                                  unsigned http_version, bool keep_alive,
                                                  std::string_view content_type = 
-                                                    ContentType::TEXT_HTML);
+                                                    ContentType::TEXT_HTML,
+                                                 const ArenaAllocator<char>& allocator = {});
+
+        // Тело не копируется: ответ держит общий буфер до конца записи
+        static SharedResponse MakeSharedResponse(http::status status, SharedBuffer body,
+                                                 unsigned http_version, bool keep_alive,
+                                                 std::string_view content_type,
+                                                 const ArenaAllocator<char>& allocator = {});
+    };
+
+    // Разбирает JSON из тел запросов API. Запросы API выполняются по очереди на одном стренде,
+    // поэтому парсер и память под разобранное значение переиспользуются от запроса к запросу
+    class RequestJsonParser {
+    public:
+        RequestJsonParser();
+
+        RequestJsonParser(const RequestJsonParser&) = delete;
+        RequestJsonParser& operator=(const RequestJsonParser&) = delete;
+
+        // Возвращает nullptr, если тело не является JSON. Значение действительно до следующего вызова
+        const json::value* Parse(std::string_view body);
+
+    private:
+        std::array<unsigned char, 4096> buffer_;
+        json::monotonic_resource resource_;
+        json::parser parser_;
+        std::optional<json::value> value_;
     };
 
     class ApiRequestHandler {
     public:
+        // Если задан rate_limiter, им ограничиваются и действия из пакетов (см. MoveUnits)
         ApiRequestHandler(model::Game& game, fs::path path, 
-                          app::Application& app);
+                          app::Application& app, CompressionSettings compression = {},
+                          RateLimiter* rate_limiter = nullptr);
+
+        // Ответ сжимается, если клиент указал gzip в Accept-Encoding
+        ResponseVariant RouteRequest(const StringRequest& req);
 
-        StringResponse RouteRequest(const StringRequest& req);
+        const CompressionStats& GetCompressionStats() const noexcept {
+            return compressor_.GetStats();
+        }
 
         StringResponse JoinGame(const StringRequest& req,
                                 const JsonResponseHandler& json_response);
 
         StringResponse MoveUnit(const StringRequest& req, const JsonResponseHandler& json_response);
 
+        // Несколько действий одним запросом: [{"token": "...", "move": "L"}, ...].
+        // Игрок управляет только своей собакой, поэтому токен каждого элемента должен совпадать
+        // с токеном из Authorization. Каждое действие расходует лимит одиночного действия.
+        // Действия применяются, только если все элементы корректны и ни одно не превысило лимит
+        StringResponse MoveUnits(const StringRequest& req, const JsonResponseHandler& json_response);
+
         StringResponse TickRequest(const StringRequest& req, 
-                                   const JsonResponseHandler& json_response) const;
+                                   const JsonResponseHandler& json_response);
 
         StringResponse GetMapsRequest(const JsonResponseHandler& json_response) const;
-        StringResponse GetMapDetailsRequest(const JsonResponseHandler& json_response,
-                                            std::string_view map_id) const;
-        StringResponse GetPlayersRequest(const StringRequest& req, 
+        ResponseVariant GetMapDetailsRequest(const StringRequest& req, 
+                                             const JsonResponseHandler& json_response,
+                                             std::string_view map_id,
+                                             BodyEncoding encoding = BodyEncoding::JSON) const;
+        // Тело - общий буфер списка игроков сессии
+        ResponseVariant GetPlayersRequest(const StringRequest& req, 
+                                          const JsonResponseHandler& json_response) const;
+        // Тело - общий буфер состояния сессии, один на тик для всех игроков
+        ResponseVariant GetGameState(const StringRequest& req,
+                                     const JsonResponseHandler& json_response) const;
+        // Таблица рекордов: ?start=0&maxItems=100, maxItems не больше MAX_RECORDS_ITEMS
+        StringResponse GetRecordsRequest(const StringRequest& req,
                                          const JsonResponseHandler& json_response) const;
-        StringResponse GetGameState(const StringRequest& req,
-                                    const JsonResponseHandler& json_response) const;
 
     private:
 
@@ -127,7 +193,8 @@ namespace http_handler {
         StringResponse ExecuteAuthorized(Fn&& action, const StringRequest& req,
                                          const JsonResponseHandler& json_response);
 
-        bool IsValidAuthToken(std::string& auth_header) const;
+        // Разбирает заголовок Authorization, не выделяя память
+        std::optional<app::Token> ParseAuthToken(const StringRequest& req) const;
 
         std::optional<StringResponse> 
         TokenHandler(const StringRequest& req, const JsonResponseHandler& json_response) const;
@@ -135,32 +202,57 @@ namespace http_handler {
         std::optional<StringResponse> 
         TokenHandler(const StringRequest& req, 
                     const JsonResponseHandler& json_response,
-                    std::string& token) const;
+                    app::Token& token) const;
 
         std::optional<StringResponse> 
         IsAllowedMethod(const StringRequest& req, const JsonResponseHandler& json_response,
                         std::string message = {}) const;
 
+        // Поля запроса на вход в игру, ссылаются на разобранное тело запроса
+        struct JoinRequest {
+            std::string_view user_name;
+            std::string_view map_id;
+        };
+
         std::optional<StringResponse> 
         ParseJoinRequest(const StringRequest& req, const JsonResponseHandler& json_response,
-                         json::object& obj) const;
+                         JoinRequest& join);
 
         std::optional<StringResponse> 
         ParseContentType(const StringRequest& req, const JsonResponseHandler& json_response) const;
 
         std::optional<StringResponse> 
-        ParseMoveJson(const JsonResponseHandler& json_response, std::string data,
-                      std::string& direction) const;
+        ParseMoveJson(const JsonResponseHandler& json_response, std::string_view data,
+                      model::Move& move);
+
+        std::optional<StringResponse> 
+        ParseTickJson(const JsonResponseHandler& json_response, std::string_view data,
+                      uint64_t& milliseconds);
+
+        // Не больше стольких действий в одном пакете
+        static constexpr size_t MAX_BATCH_ACTIONS = 1000;
+        // Путь, по лимиту которого проходит каждое действие пакета
+        static constexpr std::string_view ACTION_PATH = "/api/v1/game/player/action"sv;
+
+        static constexpr size_t MAX_RECORDS_ITEMS = 100;
 
         std::optional<StringResponse> 
-        ParseTickJson(const JsonResponseHandler& json_response, std::string data,
-                      uint64_t& milliseconds) const;
+        ParseBatchJson(const JsonResponseHandler& json_response, std::string_view data);
 
         void SetupEndPoits();
 
         model::Game& game_;
         fs::path root_dir_;
         app::Application& app_;
+        RequestJsonParser json_parser_;
+        // Разобранный пакет действий, память переиспользуется между запросами
+        std::vector<std::pair<app::Token, model::Move>> batch_actions_;
+
+        // Карты не меняются, поэтому их тела строятся один раз. Обработчики вызываются на стренде API
+        using MapBodyKey = std::pair<model::Map::Handle, BodyEncoding>;
+        mutable std::unordered_map<MapBodyKey, SharedBuffer, boost::hash<MapBodyKey>> map_bodies_;
+        mutable ResponseCompressor compressor_;
+        RateLimiter* rate_limiter_;
 
         std::unique_ptr<router::Router> router_;
     };
@@ -177,21 +269,45 @@ namespace http_handler {
         fs::path root_dir_;
     };
 
+    struct ApiQueueSettings {
+        // Запросы сверх этого числа ожидающих стренда API получают 503 без постановки в очередь
+        size_t max_pending = 1024;
+        std::chrono::seconds retry_after{1};
+    };
+
     class RequestHandler : public std::enable_shared_from_this<RequestHandler> {
     public:
         using Strand = net::strand<net::io_context::executor_type>;
 
         RequestHandler(model::Game& game, Strand& api_strand, fs::path path, 
-                       app::Application& app);
+                       app::Application& app, CompressionSettings compression = {},
+                       ApiQueueSettings api_queue = {}, RateLimitConfig rate_limits = {});
                        
         RequestHandler(const RequestHandler&) = delete;
         RequestHandler& operator=(const RequestHandler&) = delete;
 
         template <typename Send, typename Handler>
-        void HandleRequest(StringRequest&& req, Send&& send, Handler json_response);
+        void HandleRequest(StringRequest&& req, const net::ip::address& remote, Send&& send, 
+                           Handler json_response);
 
         template <typename Body, typename Allocator, typename Send>
-        void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send);
+        void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, 
+                        const net::ip::address& remote, Send&& send);
+
+        // Читать можно только на стренде API или после его остановки
+        const CompressionStats& GetCompressionStats() const noexcept {
+            return api_handler_.GetCompressionStats();
+        }
+
+        // Число запросов API, отклонённых из-за переполнения очереди
+        uint64_t GetShedRequests() const noexcept {
+            return api_shed_.load(std::memory_order_relaxed);
+        }
+
+        // Число запросов API, получивших 429
+        uint64_t GetRateLimitedRequests() const noexcept {
+            return rate_limiter_.GetLimitedRequests();
+        }
 
     private:
         model::Game& game_;
@@ -199,8 +315,16 @@ namespace http_handler {
 
         app::Application& app_;
         FileRequestHandler file_handler_{game_, root_dir_};
-        ApiRequestHandler api_handler_{game_, root_dir_, app_};
+        // Создаётся раньше api_handler_, который ограничивает им действия из пакетов
+        RateLimiter rate_limiter_;
+        ApiRequestHandler api_handler_;
         Strand& api_strand_;
+        ApiQueueSettings api_queue_;
+        std::atomic<size_t> api_pending_{0};
+        std::atomic<uint64_t> api_shed_{0};
+
+        // Превышение лимита проверяется до постановки запроса в очередь стренда
+        std::chrono::seconds CheckRateLimit(const StringRequest& req, const net::ip::address& remote);
 
         void SetupEndPoits();
 
@@ -219,7 +343,8 @@ namespace http_handler {
             : request_handler_(handler) {};
 
         template <typename Body, typename Allocator, typename Send>
-        void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send);
+        void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, 
+                        const net::ip::address& remote, Send&& send);
 
     private:
         std::shared_ptr<SomeRequestHandler> request_handler_;
@@ -237,30 +362,31 @@ namespace http_handler {
 
     template <typename Body, typename Allocator, typename Send>
     void RequestHandler::operator()(http::request<Body, http::basic_fields<Allocator>>&& req, 
-                                                Send&& send) {
+                                    const net::ip::address& remote, Send&& send) {
         // ResponseVariant response = HandleRequest(std::move(req));
         auto ver = req.version();
         auto keep = req.keep_alive();
         auto json_response = 
-            [this, version = ver, keep_alive = keep]
+            [this, version = ver, keep_alive = keep, allocator = req.get_allocator()]
                 (http::status status, std::string body = {},
                  std::string_view content_type = ContentType::APP_JSON) {
             return HttpResponse::MakeStringResponse(status, body, version, 
-                                                    keep_alive, content_type);
+                                                    keep_alive, content_type, allocator);
         };
 
-        HandleRequest(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send), 
+        HandleRequest(std::forward<decltype(req)>(req), remote, std::forward<decltype(send)>(send), 
                       json_response);
     }
 
     template <class SomeRequestHandler> 
     template <typename Body, typename Allocator, typename Send>
     void LoggingRequestHandler<SomeRequestHandler>::operator()(
-                                http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send) {
+                                http::request<Body, http::basic_fields<Allocator>>&& req, 
+                                const net::ip::address& remote, Send&& send) {
         if (static_cast<std::string>(req.target()) != "/favicon.ico"){
             LogRequest(req);
             auto t1 = std::chrono::steady_clock::now();
-            request_handler_->operator()(std::move(req), [send = std::forward<Send>(send), this, t1]
+            request_handler_->operator()(std::move(req), remote, [send = std::forward<Send>(send), this, t1]
                 (ResponseVariant&& response) {
                 auto empty_body_response = this->CopyResponseWithoutBody(response);
                 std::visit([&send](auto&& result){
@@ -329,28 +455,56 @@ namespace http_handler {
     }
 
     template <typename Send, typename Handler>
-    void RequestHandler::HandleRequest(StringRequest&& req, Send&& send, Handler json_response) {
+    void RequestHandler::HandleRequest(StringRequest&& req, const net::ip::address& remote, Send&& send, 
+                                       Handler json_response) {
         if (req.target().starts_with("/api")) {
-            auto handle = [self = shared_from_this(), req = std::forward<decltype(req)>(req), send] {
-                try {
-                    // Этот assert не выстрелит, так как лямбда-функция будет выполняться 
-                    // внутри strand
-                    assert(self->api_strand_.running_in_this_thread());
-
-                    ResponseVariant result = self->api_handler_.RouteRequest(req);
-                    std::visit([&send](auto&& res){
+            if (const auto retry_after = CheckRateLimit(req, remote); retry_after.count() > 0) {
+                return send(ResponseVariant{
+                    ErrorHandler::MakeTooManyRequestsResponse(json_response, retry_after)});
+            }
+
+            // Очередь стренда ограничена, чтобы всплеск запросов не задерживал тики игры
+            if (api_pending_.fetch_add(1, std::memory_order_relaxed) >= api_queue_.max_pending) {
+                api_pending_.fetch_sub(1, std::memory_order_relaxed);
+                api_shed_.fetch_add(1, std::memory_order_relaxed);
+                return send(ResponseVariant{
+                    ErrorHandler::MakeServiceUnavailableResponse(json_response, api_queue_.retry_after)});
+            }
+
+            auto handle = [self = shared_from_this(), req = std::forward<decltype(req)>(req), send, 
+                           json_response]() mutable {
+                self->api_pending_.fetch_sub(1, std::memory_order_relaxed);
+
+                ResponseVariant result;
+                {
+                    // Запрос лежит в арене, которую сессия очищает после записи ответа,
+                    // поэтому он уничтожается до отправки
+                    const StringRequest request = std::move(req);
+                    try {
+                        // Этот assert не выстрелит, так как лямбда-функция будет выполняться 
+                        // внутри strand
+                        assert(self->api_strand_.running_in_this_thread());
+
+                        result = self->api_handler_.RouteRequest(request);
+                    } catch (const std::exception& e) {
+                        // Клиент всегда получает ответ, иначе соединение ждёт его до таймаута
+                        ServerErrorLog(500, e.what(), "api");
+                        result = ErrorHandler::MakeInternalServerErrorResponse(json_response);
+                    } catch (...) {
+                        ServerErrorLog(500, "unknown exception", "api");
+                        result = ErrorHandler::MakeInternalServerErrorResponse(json_response);
+                    }
+
+                    std::visit([](auto&& res){
                         res.set(http::field::cache_control, "no-cache");
                     }, result);
 
-                    req.method_string() == "HEAD" 
+                    request.method_string() == "HEAD" 
                         ? result = self->CopyResponseWithoutBody(result) 
                         : result;
-
-                    return send(std::forward<decltype(result)>(result));
-                } catch (...) {
-                    // ServerErrorLog(version, keep_alive));
-                    
                 }
+
+                return send(std::forward<decltype(result)>(result));
             };
 
             return net::dispatch(api_strand_, handle);            
@@ -2,209 +2,133 @@
 #include "request_handler.h"
 #include "handlers.h"
 
-namespace router {
-
-    TrieNode::TrieNode() : params(std::make_unique<ParamsSet>()) {}
-
-    std::string_view Trie::GetMethod() const {
-        return method_;
-    }
+#include <stdexcept>
 
-    Trie::Trie() : root_(std::make_unique<TrieNode>()) {}
-
-    Trie::Trie(std::string method) 
-        : root_(std::make_unique<TrieNode>())
-        , method_(method) {
-    }
+namespace router {
 
-    void Trie::AddRoute(const std::string& method, 
-                        const std::string& path, 
-                        HandlerPtr handler, 
-                        bool intermediate) {
-        TrieNode* node = root_.get();
-        auto segments = SplitPath(path);
-        for (const auto& segment : segments) {
-            node = AddSegmentNode(node, segment);
-        }
+    Router::Router() : nodes_(1) {}
 
-        if (intermediate) {
-            node->intermediateHandlers.push_back(std::move(handler));
-        } else {
-            node->handlers.push_back(std::move(handler));
+    uint32_t Router::AddSegmentNode(uint32_t node, std::string_view segment) {
+        if (segment.starts_with(':')) {
+            if (nodes_[node].param_child == NO_NODE) {
+                nodes_[node].param_child = static_cast<uint32_t>(nodes_.size());
+                nodes_.emplace_back();
+            }
+            return nodes_[node].param_child;
         }
-    }
 
-
-    TrieNode* AddParam(TrieNode* node, const std::string& segment) {
-        if (!node->children.count("param")) {
-            node->children["param"] = std::make_unique<TrieNode>();
-            node->children["param"]->is_param = true;
-            node->children["param"]->params->insert(segment.substr(1));
+        for (const auto& [name, child] : nodes_[node].children) {
+            if (name == segment) {
+                return child;
+            }
         }
 
-        node = node->children["param"].get();
-
-        return node;
+        const auto child = static_cast<uint32_t>(nodes_.size());
+        nodes_[node].children.emplace_back(std::string(segment), child);
+        nodes_.emplace_back();
+        return child;
     }
 
-    TrieNode* Trie::AddSegmentNode(TrieNode* node, const std::string& segment) {
-        segment.starts_with(':') ? node = AddParam(node, segment) : node = GetNode(node, segment);
-
-        return node;
-    }
+    void Router::AddRoute(const std::vector<std::string>& methods, 
+                          const std::string& path, 
+                          HandlerPtr handler, 
+                          bool intermediate) {
+        uint32_t node = ROOT;
+        size_t params_count = 0;
+        ForEachSegment(path, [&](std::string_view segment) {
+            if (segment.starts_with(':') && ++params_count > MAX_PARAMS) {
+                throw std::invalid_argument("Too many params in route " + path);
+            }
+            node = AddSegmentNode(node, segment);
+            return true;
+        });
 
-    std::vector<HandlerPtr>* Trie::GetHandlers(const std::string& path) {
-        TrieNode* node = root_.get();
-        auto segments = SplitPath(path);
-        for (const auto& segment : segments) {
-            node = GetNextNode(node, segment);
-            if (!node) {
-                return nullptr;
+        for (const auto& method : methods) {
+            const http::verb verb = http::string_to_verb(method);
+            if (verb == http::verb::unknown) {
+                throw std::invalid_argument("Unknown method " + method);
             }
-        }
 
-        if (!node->handlers.empty()) {
-            return &node->handlers;
-        } else if (!node->intermediateHandlers.empty()) {
-            return &node->intermediateHandlers;
+            // Первый добавленный обработчик имеет приоритет, промежуточный - только при отсутствии обычного
+            Handler& slot = nodes_[node].handlers[static_cast<size_t>(verb)];
+            if (!slot.handler) {
+                std::string& allow = nodes_[node].allow;
+                allow += allow.empty() ? method : ", " + method;
+            }
+            if (!slot.handler || (slot.intermediate && !intermediate)) {
+                slot = Handler{handler, intermediate};
+            }
         }
-        return nullptr;
     }
 
-    TrieNode* Trie::GetNode(TrieNode* node, const std::string& segment) {
-        if (node->children.find(segment) == node->children.end()) {
-            node->children[segment] = std::make_unique<TrieNode>();
+    uint32_t Router::GetNextNode(uint32_t node, std::string_view segment, Match& match) const {
+        for (const auto& [name, child] : nodes_[node].children) {
+            if (name == segment) {
+                return child;
+            }
         }
-        return node->children[segment].get();
-    }
 
-    
-    TrieNode* Trie::GetNextNode(TrieNode* node, const std::string& segment) {
-        if (node->children.find(segment) != node->children.end()) {
-            node = node->children[segment].get();
-        } else if (node->children.find("param") != node->children.end()) {
-            node = node->children["param"].get();
-            /* for (const auto& param : node->params) {
-                params[param.first] = segment;
-            } */
-        } else {
-            return nullptr;
+        const uint32_t param_child = nodes_[node].param_child;
+        if (param_child != NO_NODE) {
+            match.params[match.params_count++] = segment;
+        }
+        return param_child;
+    }
+
+    Router::Match Router::Find(http::verb method, std::string_view path) const {
+        Match match;
+        uint32_t node = ROOT;
+        const bool found = ForEachSegment(path, [&](std::string_view segment) {
+            node = GetNextNode(node, segment, match);
+            return node != NO_NODE;
+        });
+        if (!found) {
+            return match;
         }
 
-        return node;
-    }
-
-    std::vector<std::string> Trie::SplitPath(const std::string& path) const {
-        std::vector<std::string> segments;
-        std::istringstream stream(path);
-        std::string segment;
-        while (std::getline(stream, segment, '/')) {
-            if (!segment.empty()) {
-                segments.push_back(segment);
-            }
+        match.allow = nodes_[node].allow;
+        const auto verb_index = static_cast<size_t>(method);
+        if (verb_index < VERBS_COUNT) {
+            match.handler = nodes_[node].handlers[verb_index].handler.get();
         }
-        return segments;
+        return match;
     }
 
-    Router::Router() {}
-
-    void Router::AddRoute(const std::vector<std::string>& methods, 
-                          const std::string& path, 
-                          HandlerPtr handler, 
-                          bool intermediate) {
-        for (const auto& method : methods) {
-            if (!trie_.count(method)) {
-                trie_[method] = std::make_unique<Trie>();
-            }
-            trie_[method]->AddRoute(method, path, handler, intermediate);
-        }
-        
-        path_to_allowed_methods_[path] = methods;
+    bool Router::HasRoute(http::verb method, std::string_view path) const {
+        return Find(method, path).handler != nullptr;
     }
 
-    std::vector<std::string> Router::FindAllowedPaths(std::string_view path) {
-        if (path_to_allowed_methods_.count(path.data())) {
-            return path_to_allowed_methods_[path.data()];
-        } else {
-            std::string path_with_param = std::string(path.substr(0, path.find_last_of('/')));
-            path_with_param.append("/:");
-
-            if (path_to_allowed_methods_.count(path_with_param)) {
-                return path_to_allowed_methods_[path_with_param];
-            } 
-                
-            return {};
-        }
+    std::string_view Router::FindAllowedMethods(std::string_view path) const {
+        return Find(http::verb::unknown, path).allow;
     }
 
-    http_handler::StringResponse Router::Route(const http_handler::StringRequest& req) {
+    http_handler::ResponseVariant Router::Route(const http_handler::StringRequest& req) const {
         auto ver = req.version();
         auto keep = req.keep_alive();
         auto json_response = 
-            [this, version = ver, keep_alive = keep](http::status status, std::string body = {}, 
-                                                     std::string_view content_type = 
-                                                        http_handler::ContentType::APP_JSON) {
+            [version = ver, keep_alive = keep, allocator = req.get_allocator()]
+                (http::status status, std::string body = {}, 
+                 std::string_view content_type = http_handler::ContentType::APP_JSON) {
             return http_handler::HttpResponse::MakeStringResponse(status, body, version, 
-                                                                  keep_alive, content_type);
+                                                                  keep_alive, content_type, allocator);
         };
 
-        auto method = std::string(req.method_string());
-        auto path = util::UrlDecode(std::string(req.target()));
-
-        if (trie_.find(method) != trie_.end()) {
-            auto handlers = trie_[method]->GetHandlers(path);
-            if (handlers) {
-                for (auto& handler : *handlers) {
-                    return handler->Invoke(req, json_response);
-                }
-            } else {
-                return http_handler::ErrorHandler::
-                    MakeNotAllowedResponse(json_response, FindAllowedPaths(path),
-                                            "invalidMethod","Invalid method");
-            } 
-        } else {
-            return http_handler::ErrorHandler::
-                MakeNotAllowedResponse(json_response, FindAllowedPaths(path),
-                                       "invalidMethod", "Invalid method");
+        // Маршрут выбирается по пути без параметров запроса, их разбирают обработчики.
+        // Раскодированная копия нужна только запросам с экранированными символами
+        const std::string_view target = req.target().substr(0, req.target().find('?'));
+        std::string decoded_target;
+        std::string_view path = target;
+        if (target.find_first_of("%+") != std::string_view::npos) {
+            decoded_target = util::UrlDecode(std::string(target));
+            path = decoded_target;
         }
 
-        return http_handler::ErrorHandler::MakeBadRequestResponse(json_response);
-    }
-
-    bool Trie::HasRoute(const std::string& method, const std::string& path) {
-        bool has_route = false;
-        auto path_components = SplitPath(path);
-
-        TrieNode* node = root_.get();
-        for (const auto& segment: path_components) {
-            node = GetNextNode(node, segment);
-
-            if (!node) { return false; }
+        const Match match = Find(req.method(), path);
+        if (match.handler) {
+            return match.handler->Invoke(req, match.GetParams(), json_response);
         }
 
-        return true;
-    }
-
-    bool Router::HasRoute(const std::string& method, const std::string& path) {
-        if (trie_.count(method)) {
-            return trie_[method]->HasRoute(method, path);
-        } 
-
-        return false;
-    }
-
-    std::vector<std::string> Router::FindPath(const std::string& method, const std::string& path) {
-        std::vector<std::string> relevant_methods;
-        for (const auto& [method, trie]: trie_) {
-            if (trie_[method]->HasRoute(method, path)) {
-                relevant_methods.push_back(method);
-            }
-        }
-
-        return relevant_methods;
-    }
-
-    bool Router::IsAllowedMethod(const std::string& method, const std::string& path) {
-        return FindPath(method, path).size() > 0;
+        return http_handler::ErrorHandler::
+            MakeNotAllowedResponse(json_response, match.allow, "invalidMethod", "Invalid method");
     }
 }
@@ -5,88 +5,93 @@
 #include "handlers.h"
 
 #include <boost/beast/http.hpp>
-#include <unordered_map>
-#include <unordered_set>
+#include <array>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <vector>
 #include <string>
-#include <functional>
-#include <variant>
-#include <sstream>
-#include <memory>
+#include <string_view>
+#include <utility>
 
 namespace router {
 
     using namespace http_handler;
 
     using HandlerPtr = std::shared_ptr<HandlerBase>;
-    using ParamsSet = std::unordered_set<std::string>;
-
-    class TrieNode {
-    public:
-        TrieNode();
-        
-        std::unordered_map<std::string, std::unique_ptr<TrieNode>> children;
-        std::unique_ptr<ParamsSet> params;
-        std::vector<HandlerPtr> handlers;
-        std::vector<HandlerPtr> intermediateHandlers;
-        HandlerPtr default_handler;
-        bool is_param = false;
-
-    };
 
-    class Trie {
+    // Маршруты компилируются при добавлении в плоское дерево сегментов: узлы лежат в одном векторе,
+    // обработчики узла индексируются http::verb, заголовок Allow узла собирается заранее.
+    // Сопоставление запроса идёт по string_view на цель запроса и не выделяет память
+    class Router {
     public:
-        Trie();
-
-        explicit Trie(std::string method);
+        static constexpr size_t MAX_PARAMS = 4;
 
-        void AddRoute(const std::string& method, 
-                      const std::string& path, 
-                      HandlerPtr handler, 
-                      bool intermediate = false);
-        
-        std::vector<HandlerPtr>* GetHandlers(const std::string& path);
-                                             
-        std::vector<std::string> SplitPath(const std::string& path) const;
+        struct Match {
+            HandlerBase* handler = nullptr;
+            // Пустой, если путь не найден
+            std::string_view allow;
+            std::array<std::string_view, MAX_PARAMS> params;
+            size_t params_count = 0;
 
-        bool HasRoute(const std::string& method, const std::string& path);
+            RouteParams GetParams() const noexcept {
+                return {params.data(), params_count};
+            }
+        };
 
-    private:
-        std::unique_ptr<TrieNode> root_;
-        std::string method_;
-
-
-        std::string_view GetMethod() const;
-
-        TrieNode* GetNode(TrieNode* node, const std::string& segment);
-        TrieNode* GetNextNode(TrieNode* node, const std::string& segment);
-        TrieNode* AddSegmentNode(TrieNode* node, const std::string& segment);
-
-    };
-
-    class Router {
-    public:
         Router();
 
+        // Сегмент пути, начинающийся с ':', совпадает с любым значением и передаётся обработчику как параметр
         void AddRoute(const std::vector<std::string>& methods, 
                       const std::string& path, 
                       HandlerPtr handler, 
                       bool intermediate = false);
 
-        StringResponse Route(const StringRequest& req);
+        ResponseVariant Route(const StringRequest& req) const;
 
-        std::vector<std::string> FindPath(const std::string& method, const std::string& path);
+        // Параметры в результате ссылаются на path
+        Match Find(http::verb method, std::string_view path) const;
 
-        bool HasRoute(const std::string& method, const std::string& path);
-        bool IsAllowedMethod(const std::string& method, const std::string& path);
+        bool HasRoute(http::verb method, std::string_view path) const;
 
-        std::vector<std::string> FindAllowedPaths(std::string_view path);
+        std::string_view FindAllowedMethods(std::string_view path) const;
 
     private:
-        std::unordered_map<std::string, std::unique_ptr<Trie>> trie_;
-        std::unordered_map<std::string, 
-            std::vector<std::string>> path_to_allowed_methods_;
+        static constexpr uint32_t ROOT = 0;
+        static constexpr uint32_t NO_NODE = std::numeric_limits<uint32_t>::max();
+        static constexpr size_t VERBS_COUNT = static_cast<size_t>(http::verb::unlink) + 1;
+
+        struct Handler {
+            HandlerPtr handler;
+            bool intermediate = false;
+        };
+
+        struct Node {
+            std::vector<std::pair<std::string, uint32_t>> children;
+            uint32_t param_child = NO_NODE;
+            std::array<Handler, VERBS_COUNT> handlers;
+            std::string allow;
+        };
+
+        uint32_t AddSegmentNode(uint32_t node, std::string_view segment);
+        uint32_t GetNextNode(uint32_t node, std::string_view segment, Match& match) const;
+
+        // Вызывает fn для каждого непустого сегмента пути, пока fn возвращает true
+        template <typename Fn>
+        static bool ForEachSegment(std::string_view path, Fn&& fn) {
+            while (!path.empty()) {
+                const size_t delim_pos = path.find('/');
+                const std::string_view segment = path.substr(0, delim_pos);
+                path.remove_prefix(delim_pos == std::string_view::npos ? path.size() : delim_pos + 1);
+
+                if (!segment.empty() && !fn(segment)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::vector<Node> nodes_;
     };
 
 }
@@ -1,63 +1,231 @@
 #include "serializing_listener.h"
+#include "log.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
+#include <system_error>
 
 namespace serialization {
 
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Сбрасывает на диск содержимое файла или каталога
+void SyncPath(const std::filesystem::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open " + path.string());
+    }
+
+    const int result = ::fsync(fd);
+    const int error = errno;
+    ::close(fd);
+
+    if (result != 0) {
+        throw std::system_error(error, std::generic_category(), "Failed to sync " + path.string());
+    }
+}
+
+}  // namespace
+
 SerializingListener::SerializingListener(app::Application& app, 
                                          const std::string& state_file, 
                                          milliseconds save_period)
-    : app_(app), state_file_(state_file), save_period_(save_period) {}
+    : app_(app), state_file_(state_file), save_period_(save_period)
+    , writer_([this](std::stop_token stop) { WriteLoop(stop); }) {}
 
 void SerializingListener::OnTick(milliseconds delta) {
+    // Сессии, загруженные из снимка лениво, понемногу наполняются и без обращений к ним
+    app_.GetGame().GetSessionService().MaterializeNext();
+
+    // Без периода состояние сохраняется только при завершении сервера
+    if (save_period_ == milliseconds{0}) {
+        return;
+    }
+
     time_since_last_save_ += delta;
 
-    if (time_since_last_save_ >= save_period_) {
-        SaveStateToFile();
+    // Пока пишется предыдущий снимок, новый не снимается: сохранение повторяется на следующем тике
+    if (time_since_last_save_ >= save_period_ && RequestSave()) {
         time_since_last_save_ = milliseconds{0};
     }
 }
 
+bool SerializingListener::RequestSave() {
+    {
+        std::lock_guard lock(mutex_);
+        if (writing_ || pending_) {
+            ++skipped_;
+            return false;
+        }
+    }
+
+    std::chrono::microseconds capture_time{0};
+    GameStateRepr state = Capture(capture_time);
+
+    {
+        std::lock_guard lock(mutex_);
+        pending_ = std::move(state);
+        pending_capture_time_ = capture_time;
+    }
+    cv_.notify_all();
+
+    return true;
+}
+
+void SerializingListener::WriteLoop(std::stop_token stop) {
+    while (true) {
+        std::unique_lock lock(mutex_);
+        if (!cv_.wait(lock, stop, [this] { return pending_.has_value(); })) {
+            return;
+        }
+
+        GameStateRepr state = std::move(*pending_);
+        const auto capture_time = pending_capture_time_;
+        pending_.reset();
+        writing_ = true;
+        lock.unlock();
+
+        WriteStateToFile(state, capture_time);
+
+        lock.lock();
+        writing_ = false;
+        lock.unlock();
+        cv_.notify_all();
+    }
+}
+
+GameStateRepr SerializingListener::Capture(std::chrono::microseconds& capture_time) {
+    const auto start = Clock::now();
+    GameStateRepr state = CaptureState(app_);
+
+    // Ненаполненные сессии переносятся из загруженного снимка как есть
+    const bool has_cold = std::any_of(state.sessions.begin(), state.sessions.end(),
+                                      [](const SessionRepr& session) { return session.cold; });
+    if (!has_cold) {
+        loaded_snapshot_.reset();
+    }
+    state.cold_source = loaded_snapshot_;
+
+    if (wal_) {
+        state.wal_generation = wal_->Rotate();
+    }
+    capture_time = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+
+    return state;
+}
+
 void SerializingListener::SaveStateToFile() {
+    std::chrono::microseconds capture_time{0};
+    GameStateRepr state = Capture(capture_time);
+
+    {
+        // Отложенный снимок устарел, а начатая запись должна закончиться до нашей
+        std::unique_lock lock(mutex_);
+        pending_.reset();
+        cv_.wait(lock, [this] { return !writing_; });
+        writing_ = true;
+    }
+
+    WriteStateToFile(state, capture_time);
+
+    {
+        std::lock_guard lock(mutex_);
+        writing_ = false;
+    }
+    cv_.notify_all();
+}
+
+void SerializingListener::WriteStateToFile(const GameStateRepr& state, std::chrono::microseconds capture_time) {
     try {
-        boost::json::object state_json = app_.SerializeState();
+        const auto start = Clock::now();
 
         std::string temp_file = state_file_ + ".tmp";
-        std::ofstream ofs(temp_file);
+        std::ofstream ofs(temp_file, std::ios::binary | std::ios::trunc);
         if (!ofs) {
             throw std::runtime_error("Failed to open temporary state file for writing.");
         }
 
-        ofs << boost::json::serialize(state_json);
+        WriteMappedState(state, ofs);
         ofs.close();
+        if (!ofs) {
+            throw std::runtime_error("Failed to close temporary state file.");
+        }
 
+        // Данные должны оказаться на диске до того, как файл заменит предыдущий снимок
+        SyncPath(temp_file);
         std::filesystem::rename(temp_file, state_file_);
-        std::cout << "Game state saved to " << state_file_ << std::endl;
+
+        auto dir = std::filesystem::path(state_file_).parent_path();
+        SyncPath(dir.empty() ? std::filesystem::path(".") : dir);
+
+        if (wal_) {
+            wal_->RemoveSegmentsBefore(state.wal_generation);
+        }
+
+        const auto write_time = std::chrono::duration_cast<milliseconds>(Clock::now() - start);
+        const auto bytes = std::filesystem::file_size(state_file_);
+
+        uint64_t skipped = 0;
+        {
+            std::lock_guard lock(mutex_);
+            skipped = skipped_;
+        }
+
+        StateSavedLog(state_file_, capture_time.count(), write_time.count(), bytes, skipped);
+    } catch (const std::system_error& e) {
+        ServerErrorLog(e.code().value(), e.what(), "save_state");
     } catch (const std::exception& e) {
-        std::cerr << "Error saving game state: " << e.what() << std::endl;
+        ServerErrorLog(0, e.what(), "save_state");
     }
 }
 
 void SerializingListener::LoadStateFromFile() {
-    if (!std::filesystem::exists(state_file_)) {
-        std::cout << "No previous state file found. Starting fresh." << std::endl;
-        return;
-    }
-
     try {
-        std::ifstream ifs(state_file_);
-        if (!ifs) {
-            throw std::runtime_error("Failed to open state file for reading.");
-        }
+        const auto start = Clock::now();
+        uint64_t wal_generation = 0;
 
-        std::stringstream buffer;
-        buffer << ifs.rdbuf();
-        ifs.close();
+        if (std::filesystem::exists(state_file_)) {
+            if (MappedSnapshot::IsMappedSnapshot(state_file_)) {
+                // Сессии наполняются при первом обращении, сервер может сразу принимать запросы
+                loaded_snapshot_ = MappedSnapshot::Open(state_file_);
+                wal_generation = LoadMappedState(app_, loaded_snapshot_);
+            } else if (IsJsonState(state_file_)) {
+                // Файл старого сервера. Следующее сохранение перепишет его бинарным снимком
+                std::ifstream ifs(state_file_, std::ios::binary);
+                if (!ifs) {
+                    throw std::runtime_error("Failed to open state file for reading.");
+                }
 
-        boost::json::value state_json = boost::json::parse(buffer.str());
-        app_.DeserializeState(state_json.as_object());
+                wal_generation = LoadJsonState(app_, ifs);
+                std::cout << "Legacy JSON state found in " << state_file_
+                          << ", it will be rewritten in the binary format on the next save" << std::endl;
+            } else {
+                std::ifstream ifs(state_file_, std::ios::binary);
+                if (!ifs) {
+                    throw std::runtime_error("Failed to open state file for reading.");
+                }
 
-        std::cout << "Game state restored from " << state_file_ << std::endl;
+                wal_generation = LoadState(app_, ifs);
+            }
+
+            const auto elapsed = std::chrono::duration_cast<milliseconds>(Clock::now() - start);
+            std::cout << "Game state restored from " << state_file_ << " in " << elapsed.count() << " ms" << std::endl;
+        } else {
+            std::cout << "No previous state file found. Starting fresh." << std::endl;
+        }
+
+        if (wal_) {
+            const auto stats = wal_->Recover(app_, wal_generation);
+            const auto elapsed = std::chrono::duration_cast<milliseconds>(Clock::now() - start);
+            std::cout << "Replayed " << stats.records << " WAL records (" << stats.ticks << " ticks), "
+                      << "recovery took " << elapsed.count() << " ms" << std::endl;
+        }
     } catch (const std::exception& e) {
         std::cerr << "Error loading game state: " << e.what() << std::endl;
         exit(EXIT_FAILURE);
@@ -65,4 +233,3 @@ void SerializingListener::LoadStateFromFile() {
 }
 
 } // namespace serialization
-
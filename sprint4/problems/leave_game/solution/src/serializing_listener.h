@@ -1,30 +1,69 @@
 #pragma once
 
 #include "application.h"
+#include "infrastructure.h"
+#include "mapped_snapshot.h"
+#include "model_serialization.h"
+#include "write_ahead_log.h"
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <filesystem>
-#include <fstream>
-#include <boost/json.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
 
-namespace sezialization {
+namespace serialization {
 
 using milliseconds = std::chrono::milliseconds;
 
-class SerializingListener {
+// Периодически сохраняет снимок состояния игры в формате для mmap (см. mapped_snapshot.h).
+// На тике состояние только копируется, кодирование и запись на диск выполняются в отдельном потоке.
+// Загружать умеет и потоковый формат из model_serialization.h.
+class SerializingListener : public ApplicationListener {
 public:
     SerializingListener(app::Application& app, const std::string& state_file, milliseconds save_period);
 
-    void OnTick(milliseconds delta);
+    void OnTick(milliseconds delta) override;
 
+    // Синхронно сохраняет текущее состояние, дождавшись окончания фоновой записи
     void SaveStateToFile();
+    // При подключённом журнале упреждающей записи воспроизводит его поверх загруженного снимка
     void LoadStateFromFile();
 
+    // После каждого сохранённого снимка журнал усекается до изменений, не вошедших в снимок
+    void SetWriteAheadLog(journal::WriteAheadLog& wal) { wal_ = &wal; }
+
 private:
+    // Копирует состояние и начинает новое поколение журнала; выполняется на стренде игры
+    GameStateRepr Capture(std::chrono::microseconds& capture_time);
+
+    // Возвращает false, если предыдущий снимок ещё пишется
+    bool RequestSave();
+
+    void WriteLoop(std::stop_token stop);
+    void WriteStateToFile(const GameStateRepr& state, std::chrono::microseconds capture_time);
+
     app::Application& app_;
     std::string state_file_;
     milliseconds save_period_;
     milliseconds time_since_last_save_{0};
+    journal::WriteAheadLog* wal_ = nullptr;
+    // Источник блоков сессий, не наполненных с момента загрузки
+    std::shared_ptr<const MappedSnapshot> loaded_snapshot_;
+
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::optional<GameStateRepr> pending_;
+    std::chrono::microseconds pending_capture_time_{0};
+    bool writing_ = false;
+    // Число тиков, на которых сохранение было отложено из-за незавершённой записи
+    uint64_t skipped_ = 0;
+
+    // Объявлен последним: поток останавливается и присоединяется до разрушения остальных полей
+    std::jthread writer_;
 };
 
 } // namespace serialization
-
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "sdk.h"
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace http_handler {
+
+    // Неизменяемый буфер, которым владеют кэш и все ответы, которые его отправляют
+    using SharedBuffer = std::shared_ptr<const std::string>;
+
+    inline SharedBuffer MakeSharedBuffer(std::string data) {
+        return std::make_shared<const std::string>(std::move(data));
+    }
+
+    // Тело ответа - общий неизменяемый буфер. Ответ держит его, пока запись не завершится,
+    // поэтому кэш может заменить свой буфер новым, не дожидаясь отправки старого.
+    // Тело только отправляется, читать его из сокета нельзя
+    struct SharedStringBody {
+        using value_type = SharedBuffer;
+
+        static std::uint64_t size(const value_type& body) noexcept {
+            return body ? body->size() : 0;
+        }
+
+        class writer {
+        public:
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool isRequest, typename Fields>
+            writer(const boost::beast::http::header<isRequest, Fields>&, const value_type& body)
+                : body_(body) {
+            }
+
+            void init(boost::beast::error_code& ec) {
+                ec = {};
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code& ec) {
+                ec = {};
+                if (!body_ || body_->empty()) {
+                    return boost::none;
+                }
+                return {{const_buffers_type(body_->data(), body_->size()), false}};
+            }
+
+        private:
+            const value_type& body_;
+        };
+    };
+
+}  // namespace http_handler
@@ -0,0 +1,195 @@
+#include "timing_wheel.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace util {
+
+    TimingWheel::TimingWheel(std::chrono::milliseconds resolution)
+        : resolution_(std::max(resolution, std::chrono::milliseconds{1})) {
+        heads_.fill(NIL);
+    }
+
+    void TimingWheel::Schedule(Key key, std::chrono::milliseconds delay) {
+        // Накопленный остаток уже отсчитан от следующего шага, таймер не должен сработать раньше delay
+        const auto total = std::max(delay, std::chrono::milliseconds{0}) + carry_;
+        const auto steps = std::max<int64_t>(1, (total.count() + resolution_.count() - 1) / resolution_.count());
+
+        auto [it, inserted] = key_to_node_.try_emplace(key, NIL);
+        if (inserted) {
+            if (free_nodes_.empty()) {
+                it->second = static_cast<uint32_t>(nodes_.size());
+                nodes_.emplace_back();
+            } else {
+                it->second = free_nodes_.back();
+                free_nodes_.pop_back();
+            }
+        } else {
+            Unlink(it->second);
+        }
+
+        Node& node = nodes_[it->second];
+        node.key = key;
+        node.expires = now_ + static_cast<uint64_t>(steps);
+        Place(it->second);
+    }
+
+    bool TimingWheel::Cancel(Key key) {
+        auto it = key_to_node_.find(key);
+        if (it == key_to_node_.end()) {
+            return false;
+        }
+
+        Unlink(it->second);
+        Release(it->second);
+        key_to_node_.erase(it);
+        return true;
+    }
+
+    std::optional<std::chrono::milliseconds> TimingWheel::Remaining(Key key) const {
+        auto it = key_to_node_.find(key);
+        if (it == key_to_node_.end()) {
+            return std::nullopt;
+        }
+
+        return resolution_ * static_cast<int64_t>(nodes_[it->second].expires - now_) - carry_;
+    }
+
+    void TimingWheel::Advance(std::chrono::milliseconds delta, std::vector<Key>& expired) {
+        const auto total = carry_ + std::max(delta, std::chrono::milliseconds{0});
+        const uint64_t target = now_ + static_cast<uint64_t>(total / resolution_);
+        carry_ = total % resolution_;
+
+        // Шаги между событиями ничего не меняют в ячейках, время сдвигается через них сразу
+        while (now_ < target) {
+            const auto next = NextEvent();
+            if (!next || *next > target) {
+                now_ = target;
+                break;
+            }
+
+            now_ = *next - 1;
+            Step(expired);
+        }
+    }
+
+    std::optional<uint64_t> TimingWheel::NextEvent() const {
+        std::optional<uint64_t> result;
+        auto consider = [&result](uint64_t step) {
+            if (!result || step < *result) {
+                result = step;
+            }
+        };
+
+        // Ячейки уровня не раньше текущей уже разобраны, поэтому ищется ближайшая занятая после неё.
+        // Ячейка уровня срабатывает, когда этот разряд времени становится её номером, а младшие - нулями
+        for (unsigned level = 0; level < LEVELS; ++level) {
+            const unsigned shift = BITS * level;
+            const uint64_t current = (now_ >> shift) & SLOT_MASK;
+            const uint64_t later = current == SLOT_MASK ? 0 : occupied_[level] & (~uint64_t{0} << (current + 1));
+            if (later != 0) {
+                const uint64_t slot = static_cast<uint64_t>(std::countr_zero(later));
+                const uint64_t upper = (now_ >> (shift + BITS)) << (shift + BITS);
+                consider(upper | (slot << shift));
+            }
+        }
+
+        if (heads_[OVERFLOW_BUCKET] != NIL) {
+            constexpr unsigned shift = BITS * LEVELS;
+            consider(((now_ >> shift) + 1) << shift);
+        }
+
+        return result;
+    }
+
+    void TimingWheel::Step(std::vector<Key>& expired) {
+        ++now_;
+
+        // Старший уровень, все разряды ниже которого только что обнулились
+        unsigned top = 0;
+        while (top + 1 < LEVELS && (now_ & ((uint64_t{1} << (BITS * (top + 1))) - 1)) == 0) {
+            ++top;
+        }
+
+        // Сверху вниз: таймеры старшего уровня могут попасть в ячейку младшего, которую ещё предстоит разобрать
+        if ((now_ & ((uint64_t{1} << (BITS * LEVELS)) - 1)) == 0) {
+            Cascade(OVERFLOW_BUCKET);
+        }
+        for (unsigned level = top; level > 0; --level) {
+            Cascade(level * SLOTS + ((now_ >> (BITS * level)) & SLOT_MASK));
+        }
+
+        const size_t bucket = now_ & SLOT_MASK;
+        for (uint32_t index = heads_[bucket]; index != NIL;) {
+            const uint32_t next = nodes_[index].next;
+            expired.push_back(nodes_[index].key);
+            key_to_node_.erase(nodes_[index].key);
+            Release(index);
+            index = next;
+        }
+        heads_[bucket] = NIL;
+        occupied_[0] &= ~(uint64_t{1} << bucket);
+    }
+
+    void TimingWheel::Place(uint32_t index) {
+        const uint64_t expires = std::max(nodes_[index].expires, now_);
+        const uint64_t diff = expires ^ now_;
+
+        unsigned level = 0;
+        while (level < LEVELS && (diff >> (BITS * (level + 1))) != 0) {
+            ++level;
+        }
+
+        Link(index, level == LEVELS ? OVERFLOW_BUCKET : level * SLOTS + ((expires >> (BITS * level)) & SLOT_MASK));
+    }
+
+    void TimingWheel::Link(uint32_t index, size_t bucket) {
+        Node& node = nodes_[index];
+        node.bucket = static_cast<uint32_t>(bucket);
+        node.prev = NIL;
+        node.next = heads_[bucket];
+        if (node.next != NIL) {
+            nodes_[node.next].prev = index;
+        }
+        heads_[bucket] = index;
+        if (bucket != OVERFLOW_BUCKET) {
+            occupied_[bucket / SLOTS] |= uint64_t{1} << (bucket % SLOTS);
+        }
+    }
+
+    void TimingWheel::Unlink(uint32_t index) {
+        Node& node = nodes_[index];
+        if (node.prev != NIL) {
+            nodes_[node.prev].next = node.next;
+        } else {
+            heads_[node.bucket] = node.next;
+            if (node.next == NIL && node.bucket != OVERFLOW_BUCKET) {
+                occupied_[node.bucket / SLOTS] &= ~(uint64_t{1} << (node.bucket % SLOTS));
+            }
+        }
+        if (node.next != NIL) {
+            nodes_[node.next].prev = node.prev;
+        }
+        node.prev = node.next = NIL;
+    }
+
+    void TimingWheel::Cascade(size_t bucket) {
+        uint32_t index = heads_[bucket];
+        heads_[bucket] = NIL;
+        if (bucket != OVERFLOW_BUCKET) {
+            occupied_[bucket / SLOTS] &= ~(uint64_t{1} << (bucket % SLOTS));
+        }
+
+        while (index != NIL) {
+            const uint32_t next = nodes_[index].next;
+            Place(index);
+            index = next;
+        }
+    }
+
+    void TimingWheel::Release(uint32_t index) {
+        nodes_[index].prev = nodes_[index].next = NIL;
+        free_nodes_.push_back(index);
+    }
+
+}  // namespace util
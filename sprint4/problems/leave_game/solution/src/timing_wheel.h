@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace util {
+
+    // Иерархическое колесо таймеров. Время измеряется шагами по resolution, каждый уровень
+    // содержит SLOTS ячеек и отвечает за очередной разряд момента срабатывания в системе
+    // счисления по основанию SLOTS. Таймер лежит на уровне старшего разряда, в котором его момент
+    // отличается от текущего времени, и спускается на нижние уровни, когда время доходит до его ячейки.
+    // Установка и отмена выполняются за O(1). Advance по битовым картам занятых ячеек уровней
+    // переходит сразу к ближайшему шагу, на котором ячейка срабатывает или переносится, поэтому
+    // его стоимость зависит от числа срабатываний и переносов, а не от длины интервала
+    class TimingWheel {
+    public:
+        using Key = uint64_t;
+
+        explicit TimingWheel(std::chrono::milliseconds resolution = std::chrono::milliseconds{1});
+
+        // Переустанавливает таймер, если он уже есть. Задержка округляется вверх до шага, но не меньше одного шага
+        void Schedule(Key key, std::chrono::milliseconds delay);
+
+        // Возвращает false, если таймера не было
+        bool Cancel(Key key);
+
+        bool Contains(Key key) const { return key_to_node_.contains(key); }
+
+        // Время до срабатывания таймера или nullopt, если таймера нет
+        std::optional<std::chrono::milliseconds> Remaining(Key key) const;
+
+        size_t Size() const noexcept { return key_to_node_.size(); }
+
+        // Сдвигает время на delta и дописывает в expired ключи сработавших таймеров.
+        // Остаток меньше шага накапливается до следующего вызова
+        void Advance(std::chrono::milliseconds delta, std::vector<Key>& expired);
+
+    private:
+        static constexpr unsigned BITS = 6;
+        static constexpr size_t SLOTS = size_t{1} << BITS;
+        static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+        static constexpr unsigned LEVELS = 6;
+        // Таймеры дальше 2^(BITS * LEVELS) шагов ждут в отдельном списке до оборота старшего уровня
+        static constexpr size_t OVERFLOW_BUCKET = SLOTS * LEVELS;
+        static constexpr uint32_t NIL = std::numeric_limits<uint32_t>::max();
+
+        struct Node {
+            Key key = 0;
+            uint64_t expires = 0;
+            uint32_t bucket = 0;
+            uint32_t prev = NIL;
+            uint32_t next = NIL;
+        };
+
+        // Ближайший шаг, на котором срабатывает или переносится непустая ячейка
+        std::optional<uint64_t> NextEvent() const;
+        void Step(std::vector<Key>& expired);
+        void Place(uint32_t index);
+        void Link(uint32_t index, size_t bucket);
+        void Unlink(uint32_t index);
+        // Снимает все таймеры ячейки и раскладывает их заново относительно текущего времени
+        void Cascade(size_t bucket);
+        void Release(uint32_t index);
+
+        std::chrono::milliseconds resolution_;
+        std::chrono::milliseconds carry_{0};
+        uint64_t now_ = 0;
+
+        std::array<uint32_t, OVERFLOW_BUCKET + 1> heads_;
+        // Бит ячейки уровня установлен, если в ней есть таймеры
+        std::array<uint64_t, LEVELS> occupied_{};
+        std::vector<Node> nodes_;
+        std::vector<uint32_t> free_nodes_;
+        std::unordered_map<Key, uint32_t> key_to_node_;
+    };
+
+}  // namespace util
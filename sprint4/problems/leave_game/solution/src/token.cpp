@@ -0,0 +1,183 @@
+#include "token.h"
+
+#include <array>
+#include <mutex>
+#include <stdexcept>
+
+namespace app {
+    using namespace std::literals;
+
+    namespace {
+        constexpr size_t INITIAL_CAPACITY = 16;
+        constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+        constexpr std::array<int8_t, 256> MakeHexTable() {
+            std::array<int8_t, 256> table{};
+            for (auto& value : table) {
+                value = -1;
+            }
+            for (int c = '0'; c <= '9'; ++c) {
+                table[c] = static_cast<int8_t>(c - '0');
+            }
+            for (int c = 'a'; c <= 'f'; ++c) {
+                table[c] = static_cast<int8_t>(c - 'a' + 10);
+                table[c - 'a' + 'A'] = static_cast<int8_t>(c - 'a' + 10);
+            }
+            return table;
+        }
+
+        constexpr auto HEX_TABLE = MakeHexTable();
+
+        bool DecodeHalf(const char* hex, uint64_t& out) noexcept {
+            uint64_t value = 0;
+            for (size_t i = 0; i < Token::HEX_SIZE / 2; ++i) {
+                const int8_t digit = HEX_TABLE[static_cast<unsigned char>(hex[i])];
+                if (digit < 0) {
+                    return false;
+                }
+                value = (value << 4) | static_cast<uint64_t>(digit);
+            }
+            out = value;
+            return true;
+        }
+
+        void EncodeHalf(uint64_t value, char* out) noexcept {
+            for (size_t i = Token::HEX_SIZE / 2; i-- > 0;) {
+                out[i] = HEX_DIGITS[value & 0xF];
+                value >>= 4;
+            }
+        }
+    }
+
+    std::optional<Token> Token::FromHex(std::string_view hex) noexcept {
+        Token token;
+        if (hex.size() != HEX_SIZE
+            || !DecodeHalf(hex.data(), token.hi)
+            || !DecodeHalf(hex.data() + HEX_SIZE / 2, token.lo)) {
+            return std::nullopt;
+        }
+        return token;
+    }
+
+    Token Token::Parse(std::string_view hex) {
+        if (auto token = FromHex(hex)) {
+            return *token;
+        }
+        throw std::invalid_argument("Invalid token: "s + std::string(hex));
+    }
+
+    void Token::WriteHex(char* out) const noexcept {
+        EncodeHalf(hi, out);
+        EncodeHalf(lo, out + HEX_SIZE / 2);
+    }
+
+    std::string Token::ToHex() const {
+        std::string hex(HEX_SIZE, '\0');
+        WriteHex(hex.data());
+        return hex;
+    }
+
+    TokenTable::TokenTable()
+        : slots_(INITIAL_CAPACITY)
+        , mask_(INITIAL_CAPACITY - 1) {
+    }
+
+    size_t TokenTable::IdealIndex(const Token& token) const noexcept {
+        uint64_t hash = (token.hi ^ token.lo) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 32;
+        return static_cast<size_t>(hash) & mask_;
+    }
+
+    size_t TokenTable::FindIndex(const Token& token) const noexcept {
+        // Таблица заполнена не больше чем наполовину, поэтому свободная ячейка всегда найдётся
+        size_t index = IdealIndex(token);
+        while (slots_[index].value != EMPTY && !(slots_[index].token == token)) {
+            index = (index + 1) & mask_;
+        }
+        return index;
+    }
+
+    const TokenTable::Value* TokenTable::Find(const Token& token) const noexcept {
+        const Slot& slot = slots_[FindIndex(token)];
+        return slot.value != EMPTY ? &slot.value : nullptr;
+    }
+
+    TokenTable::Value* TokenTable::Find(const Token& token) noexcept {
+        Slot& slot = slots_[FindIndex(token)];
+        return slot.value != EMPTY ? &slot.value : nullptr;
+    }
+
+    bool TokenTable::Insert(const Token& token, Value value) {
+        if (value == EMPTY) {
+            throw std::invalid_argument("Token table value is out of range");
+        }
+
+        if ((size_ + 1) * 2 > slots_.size()) {
+            Grow();
+        }
+
+        Slot& slot = slots_[FindIndex(token)];
+        if (slot.value != EMPTY) {
+            return false;
+        }
+
+        slot.token = token;
+        slot.value = value;
+        ++size_;
+        return true;
+    }
+
+    bool TokenTable::Erase(const Token& token) {
+        size_t hole = FindIndex(token);
+        if (slots_[hole].value == EMPTY) {
+            return false;
+        }
+
+        // Сдвигаем назад следующие записи цепочки, чтобы поиск не обрывался на дыре
+        for (size_t next = (hole + 1) & mask_; slots_[next].value != EMPTY; next = (next + 1) & mask_) {
+            const size_t ideal = IdealIndex(slots_[next].token);
+            const bool stays = hole <= next ? (hole < ideal && ideal <= next)
+                                            : (hole < ideal || ideal <= next);
+            if (!stays) {
+                slots_[hole] = slots_[next];
+                slots_[next] = Slot{};
+                hole = next;
+            }
+        }
+
+        slots_[hole] = Slot{};
+        --size_;
+        return true;
+    }
+
+    void TokenTable::Grow() {
+        std::vector<Slot> old = std::move(slots_);
+        slots_ = std::vector<Slot>(old.size() * 2);
+        mask_ = slots_.size() - 1;
+
+        for (const auto& slot : old) {
+            if (slot.value != EMPTY) {
+                slots_[FindIndex(slot.token)] = slot;
+            }
+        }
+    }
+
+    void KnownTokens::Insert(const Token& token) {
+        Shard& shard = GetShard(token);
+        std::unique_lock lock{shard.mutex};
+        shard.tokens.Insert(token, 0);
+    }
+
+    void KnownTokens::Erase(const Token& token) {
+        Shard& shard = GetShard(token);
+        std::unique_lock lock{shard.mutex};
+        shard.tokens.Erase(token);
+    }
+
+    bool KnownTokens::Contains(const Token& token) const {
+        const Shard& shard = GetShard(token);
+        std::shared_lock lock{shard.mutex};
+        return shard.tokens.Find(token) != nullptr;
+    }
+
+}  // namespace app
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "sdk.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace app {
+
+    // Токен авторизации: 128 случайных бит. Клиенты получают и присылают его
+    // 32 шестнадцатеричными цифрами, внутри сервера он хранится двумя числами
+    struct Token {
+        static constexpr size_t HEX_SIZE = 32;
+
+        uint64_t hi = 0;
+        uint64_t lo = 0;
+
+        // Разбирает ровно HEX_SIZE шестнадцатеричных цифр в любом регистре, не выделяя память
+        static std::optional<Token> FromHex(std::string_view hex) noexcept;
+
+        // То же для токенов из сохранённых файлов: бросает std::invalid_argument
+        static Token Parse(std::string_view hex);
+
+        // Пишет HEX_SIZE цифр в нижнем регистре
+        void WriteHex(char* out) const noexcept;
+        std::string ToHex() const;
+
+        bool operator==(const Token&) const = default;
+    };
+
+    // Индекс токен -> номер записи: открытая адресация с линейным пробированием.
+    // Токены случайны, поэтому хэшем служат их перемешанные биты
+    class TokenTable {
+    public:
+        using Value = uint32_t;
+
+        TokenTable();
+
+        // Возвращает nullptr, если токена нет
+        const Value* Find(const Token& token) const noexcept;
+        Value* Find(const Token& token) noexcept;
+
+        // Возвращает false, если такой токен уже есть
+        bool Insert(const Token& token, Value value);
+
+        bool Erase(const Token& token);
+
+        size_t Size() const noexcept { return size_; }
+
+        template <typename Fn>
+        void ForEach(Fn&& fn) const {
+            for (const auto& slot : slots_) {
+                if (slot.value != EMPTY) {
+                    fn(slot.token, slot.value);
+                }
+            }
+        }
+
+    private:
+        static constexpr Value EMPTY = std::numeric_limits<Value>::max();
+
+        struct Slot {
+            Token token;
+            Value value = EMPTY;
+        };
+
+        size_t IdealIndex(const Token& token) const noexcept;
+        size_t FindIndex(const Token& token) const noexcept;
+        void Grow();
+
+        std::vector<Slot> slots_;
+        size_t mask_;
+        size_t size_ = 0;
+    };
+
+    // Выданные токены, которые можно проверять из любого потока, в том числе до отправки
+    // запроса на стренд API. Таблица разбита на шарды со своими мьютексами
+    class KnownTokens {
+    public:
+        void Insert(const Token& token);
+        void Erase(const Token& token);
+        bool Contains(const Token& token) const;
+
+    private:
+        static constexpr size_t SHARDS_COUNT = 64;
+
+        struct alignas(64) Shard {
+            mutable std::shared_mutex mutex;
+            TokenTable tokens;
+        };
+
+        Shard& GetShard(const Token& token) const noexcept {
+            return shards_[(token.hi ^ token.lo) % SHARDS_COUNT];
+        }
+
+        mutable std::array<Shard, SHARDS_COUNT> shards_;
+    };
+
+}  // namespace app
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "sdk.h"
+#include "request_arena.h"
+#include "shared_body.h"
 
 #include <variant>
 #include <boost/beast/http.hpp>
@@ -11,15 +13,25 @@ namespace beast = boost::beast;
 namespace http = beast::http;
 
 namespace http_handler {
+    // Заголовки и строковые тела сообщений размещаются в арене запроса,
+    // которую сессия передаёт в разборщик, а обработчик - в ответ
+    using Fields = http::basic_fields<ArenaAllocator<char>>;
+    using StringBody = http::basic_string_body<char, std::char_traits<char>, ArenaAllocator<char>>;
+
     // Запрос, тело которого представлено в виде строки
-    using StringRequest = http::request<http::string_body>;
+    using StringRequest = http::request<StringBody, Fields>;
     // Ответ, тело которого представлено в виде строки
-    using StringResponse = http::response<http::string_body>;
-    using EmptyResponse = http::response<http::empty_body>;
+    using StringResponse = http::response<StringBody, Fields>;
+    using EmptyResponse = http::response<http::empty_body, Fields>;
 
-    using FileResponse = http::response<http::file_body>;
-    using ResponseVariant = std::variant<EmptyResponse, StringResponse, FileResponse>;
+    using FileResponse = http::response<http::file_body, Fields>;
+    // Ответ с общим неизменяемым телом из кэша, тело не копируется
+    using SharedResponse = http::response<SharedStringBody, Fields>;
+    using ResponseVariant = std::variant<EmptyResponse, StringResponse, FileResponse, SharedResponse>;
 
     using JsonResponseHandler = 
             std::function<StringResponse(http::status, std::string, std::string_view)>;
+
+    // Представление тела ответа, выбранное по заголовку Accept
+    enum class BodyEncoding { JSON, MSGPACK };
 }
\ No newline at end of file
@@ -126,8 +126,10 @@ namespace util {
         return content;
     }
 
-    http::response<http::file_body> ReadStaticFile(const std::filesystem::path& file_path) {
-        http::response<http::file_body> res;
+    http_handler::FileResponse ReadStaticFile(const std::filesystem::path& file_path,
+                                              const http_handler::ArenaAllocator<char>& allocator) {
+        http_handler::FileResponse res(std::piecewise_construct, std::make_tuple(), 
+                                       std::make_tuple(allocator));
         res.version(11);  // HTTP/1.1
         res.result(http::status::ok);
         const std::string_view content_type = MimeType(ExtractFileExtension(file_path));
@@ -155,38 +157,51 @@ namespace util {
         return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
     }
 
-    std::string ExtractToken(const std::string& auth_header) {
-        auto copy = auth_header;
-        copy.erase(std::remove(copy.begin(), copy.end(), '\r'), copy.end());
-        copy.erase(std::remove(copy.begin(), copy.end(), '\n'), copy.end());
-        
-        auto auth_header_sv = std::string_view(copy);
-        std::string prefix = "Bearer";
+    std::string_view ExtractToken(std::string_view auth_header) {
+        constexpr std::string_view prefix = "Bearer";
         if (auth_header.starts_with(prefix)) {
-            auth_header_sv.remove_prefix(prefix.size());
+            auth_header.remove_prefix(prefix.size());
         }
 
-        if (auth_header_sv.size() < 32) {
-            return "";
+        if (auth_header.size() < 32) {
+            return {};
         }
 
+        auto is_token_char = [](char c) {
+            return IsLetter(c) || IsDigit(c);
+        };
+
         // clear ...{token}
-        int i = 0;
-        while (auth_header_sv.size() > 0 && 
-            !(IsLetter(auth_header_sv[i]) || IsDigit(auth_header_sv[i]))) {
-            auth_header_sv.remove_prefix(1);
+        while (!auth_header.empty() && !is_token_char(auth_header.front())) {
+            auth_header.remove_prefix(1);
         }
 
         // clear {token}...
-        int j = auth_header_sv.size() - 1;
-        while (auth_header_sv.size() > 0 && 
-            !(IsLetter(auth_header_sv[j]) || IsDigit(auth_header_sv[j]))) {
-            auth_header_sv.remove_suffix(1);
-            j = auth_header_sv.size() - 1;
+        while (!auth_header.empty() && !is_token_char(auth_header.back())) {
+            auth_header.remove_suffix(1);
+        }
+
+        return auth_header;
+    }
+
+    std::optional<std::string_view> FindQueryParam(std::string_view target, std::string_view name) {
+        const size_t query_start = target.find('?');
+        if (query_start == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        std::string_view query = target.substr(query_start + 1);
+        while (!query.empty()) {
+            const size_t delim_pos = query.find('&');
+            const std::string_view param = query.substr(0, delim_pos);
+            query.remove_prefix(delim_pos == std::string_view::npos ? query.size() : delim_pos + 1);
+
+            const size_t eq_pos = param.find('=');
+            if (param.substr(0, eq_pos) == name) {
+                return eq_pos == std::string_view::npos ? std::string_view{} : param.substr(eq_pos + 1);
+            }
         }
 
-        std::string token = std::string(auth_header_sv);
-            
-        return token;
+        return std::nullopt;
     }
 }
\ No newline at end of file
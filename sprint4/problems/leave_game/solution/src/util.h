@@ -5,6 +5,8 @@
 #include <boost/beast.hpp>
 #include <filesystem>
 #include <fstream>
+#include <optional>
+#include <string_view>
 
 const int BUFF_SIZE = 1024;
 
@@ -23,7 +25,12 @@ namespace util {
 
     std::string ExtractFileExtension(const std::filesystem::path& path);
 
-    http::response<http::file_body> ReadStaticFile(const std::filesystem::path& file_path);
+    http_handler::FileResponse ReadStaticFile(const std::filesystem::path& file_path,
+                                              const http_handler::ArenaAllocator<char>& allocator = {});
 
-    std::string ExtractToken(const std::string& auth_header);
+    // Возвращает часть заголовка без префикса Bearer и обрамляющих символов. Не копирует строку
+    std::string_view ExtractToken(std::string_view auth_header);
+
+    // Значение параметра из строки запроса цели ("/path?a=1&b=2") без раскодирования
+    std::optional<std::string_view> FindQueryParam(std::string_view target, std::string_view name);
 }
\ No newline at end of file
@@ -0,0 +1,353 @@
+#include "write_ahead_log.h"
+#include "log.h"
+#include "util.h"
+
+#include <boost/crc.hpp>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <stdexcept>
+#include <system_error>
+
+namespace journal {
+    using namespace std::literals;
+
+    namespace {
+        // Длина и контрольная сумма кадра
+        constexpr size_t FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+        void PutUint32(std::string& out, uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                out.push_back(static_cast<char>(value >> (i * 8)));
+            }
+        }
+
+        uint32_t GetUint32(std::string_view data, size_t pos) {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                value |= static_cast<uint32_t>(static_cast<unsigned char>(data[pos + i])) << (i * 8);
+            }
+            return value;
+        }
+
+        uint32_t Checksum(std::string_view data) {
+            boost::crc_32_type crc;
+            crc.process_bytes(data.data(), data.size());
+            return crc.checksum();
+        }
+
+        void WriteAll(int fd, std::string_view data) {
+            while (!data.empty()) {
+                const ssize_t written = ::write(fd, data.data(), data.size());
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::system_error(errno, std::generic_category(), "Failed to write WAL");
+                }
+                data.remove_prefix(static_cast<size_t>(written));
+            }
+        }
+
+        void SyncDirectory(const fs::path& dir) {
+            const int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+            if (fd >= 0) {
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+
+        // Дописывает в out записи из целых кадров сегмента. Оборванный хвост отбрасывается
+        // Записи прежних версий журнала читаются и в текущей: версии только добавляют типы записей
+        void ReadFrames(std::string_view segment, std::string& out) {
+            if (!JournalReader::HasHeader(segment)) {
+                throw std::runtime_error("Not a WAL segment or unsupported version");
+            }
+
+            size_t pos = EncodeHeader().size();
+            while (segment.size() - pos >= FRAME_HEADER_SIZE) {
+                const uint32_t size = GetUint32(segment, pos);
+                const uint32_t checksum = GetUint32(segment, pos + sizeof(uint32_t));
+                if (segment.size() - pos - FRAME_HEADER_SIZE < size) {
+                    break;
+                }
+
+                const auto payload = segment.substr(pos + FRAME_HEADER_SIZE, size);
+                if (Checksum(payload) != checksum) {
+                    break;
+                }
+
+                out.append(payload);
+                pos += FRAME_HEADER_SIZE + size;
+            }
+        }
+    }
+
+    WriteAheadLog::WriteAheadLog(model::Game& game, fs::path base_path)
+        : base_path_(std::move(base_path)) {
+        // Новые записи никогда не дописываются в сегменты прошлого запуска:
+        // их хвост мог оборваться при сбое
+        const auto generations = ListGenerations();
+        if (!generations.empty()) {
+            generation_ = generations.back() + 1;
+        }
+
+        game.GetLootService().AddSpawnListener(
+            [this](const model::GameSession& session, int count, uint64_t seed) {
+                pending_spawns_.push_back({*session.GetMapId(), session.GetSessionId(), count, seed});
+            });
+        // Наполнение сессии при восстановлении уже записано в воспроизводимом журнале
+        game.GetSessionService().AddMaterializeListener(
+            [this](const model::GameSession& session) {
+                if (!recovering_) {
+                    Append(MaterializeRecord{session.GetSessionId()});
+                }
+            });
+
+        flusher_ = std::jthread([this](std::stop_token stop) { FlushLoop(stop); });
+    }
+
+    WriteAheadLog::~WriteAheadLog() {
+        // Действия после последнего тика тоже сохраняются, остальное дописывает фоновый поток
+        SubmitBatch();
+    }
+
+    fs::path WriteAheadLog::SegmentPath(uint64_t generation) const {
+        fs::path path = base_path_;
+        path += "." + std::to_string(generation);
+        return path;
+    }
+
+    std::vector<uint64_t> WriteAheadLog::ListGenerations() const {
+        std::vector<uint64_t> generations;
+
+        const fs::path dir = base_path_.has_parent_path() ? base_path_.parent_path() : fs::path(".");
+        const std::string prefix = base_path_.filename().string() + ".";
+
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(dir, ec)) {
+            const std::string name = entry.path().filename().string();
+            if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) {
+                continue;
+            }
+
+            uint64_t generation = 0;
+            const char* begin = name.data() + prefix.size();
+            const char* end = name.data() + name.size();
+            if (auto [ptr, err] = std::from_chars(begin, end, generation); err == std::errc{} && ptr == end) {
+                generations.push_back(generation);
+            }
+        }
+
+        std::sort(generations.begin(), generations.end());
+        return generations;
+    }
+
+    void WriteAheadLog::OnJoin(const model::Dog& dog, const model::GameSession& session, std::string_view token) {
+        Append(JoinRecord{*session.GetMapId(), session.GetSessionId(), dog.GetId(), dog.GetName(), 
+                          dog.GetPosition(), std::string(token)});
+    }
+
+    void WriteAheadLog::OnLeave(model::Dog::Id dog_id, [[maybe_unused]] const model::GameSession& session) {
+        Append(LeaveRecord{dog_id});
+    }
+
+    void WriteAheadLog::OnAction(model::Dog::Id dog_id, model::Move move) {
+        Append(ActionRecord{dog_id, std::string(model::MoveToString(move))});
+    }
+
+    void WriteAheadLog::OnTick(std::chrono::milliseconds delta) {
+        Append(TickRecord{delta});
+
+        for (const auto& spawn : pending_spawns_) {
+            Append(spawn);
+        }
+        pending_spawns_.clear();
+
+        SubmitBatch();
+        ThrowIfFailed();
+    }
+
+    void WriteAheadLog::Append(const Record& record) {
+        EncodeRecord(record, batch_);
+    }
+
+    void WriteAheadLog::SubmitBatch() {
+        if (batch_.empty()) {
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex_);
+            // После ошибки изменения сохраняются только следующим снимком
+            if (!error_) {
+                queue_.push_back(Chunk{generation_, std::move(batch_)});
+                ++submitted_;
+            }
+        }
+        cv_.notify_all();
+
+        batch_.clear();
+    }
+
+    void WriteAheadLog::ThrowIfFailed() const {
+        std::lock_guard lock(mutex_);
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+    uint64_t WriteAheadLog::Rotate() {
+        SubmitBatch();
+        return ++generation_;
+    }
+
+    void WriteAheadLog::RemoveSegmentsBefore(uint64_t generation) {
+        for (uint64_t old : ListGenerations()) {
+            if (old >= generation) {
+                break;
+            }
+
+            std::error_code ec;
+            fs::remove(SegmentPath(old), ec);
+        }
+    }
+
+    ReplayStats WriteAheadLog::Recover(app::Application& app, uint64_t generation) {
+        std::string data = EncodeHeader();
+        for (uint64_t segment : ListGenerations()) {
+            if (segment >= generation) {
+                ReadFrames(util::ReadFromFileIntoString(SegmentPath(segment)), data);
+            }
+        }
+
+        // Снимок мог быть сохранён позже последнего сегмента: новые записи должны быть не старше него
+        generation_ = std::max(generation_, generation);
+
+        JournalReader reader(std::move(data));
+        recovering_ = true;
+        auto stats = Replayer(app).Replay(reader);
+        recovering_ = false;
+
+        return stats;
+    }
+
+    void WriteAheadLog::Sync() {
+        std::unique_lock lock(mutex_);
+        const uint64_t target = submitted_;
+        cv_.wait(lock, [this, target] { return synced_ >= target || error_; });
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+    WalStats WriteAheadLog::GetStats() const {
+        std::lock_guard lock(mutex_);
+        return WalStats{submitted_, bytes_written_.load(), syncs_.load()};
+    }
+
+    void WriteAheadLog::FlushLoop(std::stop_token stop) {
+        while (true) {
+            std::vector<Chunk> chunks;
+            {
+                std::unique_lock lock(mutex_);
+                // При остановке очередь дописывается до конца
+                cv_.wait(lock, stop, [this] { return !queue_.empty(); });
+                if (queue_.empty()) {
+                    break;
+                }
+                chunks.swap(queue_);
+            }
+
+            std::exception_ptr error;
+            try {
+                WriteChunks(chunks);
+            } catch (const std::system_error& e) {
+                ServerErrorLog(e.code().value(), e.what(), "wal");
+                error = std::current_exception();
+            } catch (const std::exception& e) {
+                ServerErrorLog(0, e.what(), "wal");
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard lock(mutex_);
+                if (error) {
+                    error_ = error;
+                    queue_.clear();
+                } else {
+                    synced_ += chunks.size();
+                }
+            }
+            cv_.notify_all();
+
+            if (error) {
+                break;
+            }
+        }
+
+        CloseSegment();
+    }
+
+    void WriteAheadLog::WriteChunks(std::vector<Chunk>& chunks) {
+        std::string frames;
+
+        auto flush = [this, &frames] {
+            if (frames.empty()) {
+                return;
+            }
+
+            WriteAll(fd_, frames);
+            if (::fdatasync(fd_) != 0) {
+                throw std::system_error(errno, std::generic_category(), "Failed to sync WAL");
+            }
+
+            bytes_written_ += frames.size();
+            ++syncs_;
+            frames.clear();
+        };
+
+        // Пакеты одного поколения уходят на диск одной записью
+        for (auto& chunk : chunks) {
+            if (fd_ < 0 || chunk.generation != fd_generation_) {
+                flush();
+                OpenSegment(chunk.generation);
+            }
+
+            PutUint32(frames, static_cast<uint32_t>(chunk.data.size()));
+            PutUint32(frames, Checksum(chunk.data));
+            frames.append(chunk.data);
+        }
+
+        flush();
+    }
+
+    void WriteAheadLog::OpenSegment(uint64_t generation) {
+        CloseSegment();
+
+        const fs::path path = SegmentPath(generation);
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to open "s + path.string());
+        }
+        fd_generation_ = generation;
+
+        struct stat st{};
+        if (::fstat(fd_, &st) == 0 && st.st_size == 0) {
+            WriteAll(fd_, EncodeHeader());
+            SyncDirectory(path.parent_path());
+        }
+    }
+
+    void WriteAheadLog::CloseSegment() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+}  // namespace journal
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "sdk.h"
+#include "application.h"
+#include "infrastructure.h"
+#include "journal.h"
+#include "model.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * Журнал упреждающей записи (write-ahead log) для восстановления после сбоя между снимками.
+ *
+ * Изменения модели кодируются записями журнала (journal.h) и копятся в пакет текущего тика.
+ * На тике пакет передаётся фоновому потоку, который дописывает накопившиеся пакеты в сегмент
+ * одним вызовом write и одним fdatasync (групповая фиксация).
+ *
+ * Журнал разбит на сегменты <base>.<generation>. Снимок состояния запоминает поколение,
+ * начатое в момент его снятия (Rotate), и после успешной записи снимка более старые сегменты удаляются.
+ * Восстановление: загрузка снимка и воспроизведение сегментов, начиная с запомненного поколения.
+ *
+ * Сегмент: заголовок журнала, затем кадры [длина u32][CRC32 u32][записи]. Кадр всегда заканчивается
+ * на границе тика, а оборванный при сбое последний кадр при восстановлении отбрасывается.
+ *
+ * Если запись или fdatasync не удались, журнал перестаёт писать (дальнейшие кадры шли бы после дыры):
+ * ошибка попадает в лог, а OnTick и Sync бросают её. Изменения после ошибки сохраняются только снимком.
+ */
+namespace journal {
+
+    struct WalStats {
+        uint64_t batches = 0;
+        uint64_t bytes = 0;
+        uint64_t syncs = 0;
+    };
+
+    class WriteAheadLog : public ApplicationListener {
+    public:
+        WriteAheadLog(model::Game& game, fs::path base_path);
+        ~WriteAheadLog();
+
+        WriteAheadLog(const WriteAheadLog&) = delete;
+        WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+        // Должен быть зарегистрирован в приложении раньше SerializingListener,
+        // чтобы запись тика попадала в сегмент, покрытый снимком этого же тика
+        void OnJoin(const model::Dog& dog, const model::GameSession& session,
+                    std::string_view token) override;
+        void OnLeave(model::Dog::Id dog_id, const model::GameSession& session) override;
+        void OnAction(model::Dog::Id dog_id, model::Move move) override;
+        // Бросает ошибку фонового потока, если пакеты перестали попадать на диск
+        void OnTick(std::chrono::milliseconds delta) override;
+
+        // Начинает новое поколение сегментов и возвращает его номер.
+        // Вызывается на стренде игры в момент снятия снимка
+        uint64_t Rotate();
+
+        // Удаляет сегменты, целиком покрытые сохранённым снимком. Может вызываться из любого потока
+        void RemoveSegmentsBefore(uint64_t generation);
+
+        // Воспроизводит сегменты начиная с generation поверх загруженного снимка.
+        // Вызывается при старте, до регистрации журнала слушателем приложения.
+        // Ненаполненные сессии снимка наполняются там же, где и до сбоя (запись MATERIALIZE)
+        ReplayStats Recover(app::Application& app, uint64_t generation);
+
+        // Дожидается, пока все переданные фоновому потоку пакеты окажутся на диске.
+        // Бросает ошибку записи, если какой-то из них на диск не попал
+        void Sync();
+
+        WalStats GetStats() const;
+
+    private:
+        struct Chunk {
+            uint64_t generation;
+            std::string data;
+        };
+
+        fs::path SegmentPath(uint64_t generation) const;
+        std::vector<uint64_t> ListGenerations() const;
+
+        void Append(const Record& record);
+        void SubmitBatch();
+        void ThrowIfFailed() const;
+
+        void FlushLoop(std::stop_token stop);
+        void WriteChunks(std::vector<Chunk>& chunks);
+        void OpenSegment(uint64_t generation);
+        void CloseSegment();
+
+        fs::path base_path_;
+
+        // Используются только на стренде игры
+        std::string batch_;
+        std::vector<LootSpawnRecord> pending_spawns_;
+        uint64_t generation_ = 0;
+        bool recovering_ = false;
+
+        mutable std::mutex mutex_;
+        std::condition_variable_any cv_;
+        std::vector<Chunk> queue_;
+        uint64_t submitted_ = 0;
+        uint64_t synced_ = 0;
+        // Первая ошибка фонового потока. После неё пакеты не пишутся и synced_ не растёт
+        std::exception_ptr error_;
+
+        // Используются только фоновым потоком
+        int fd_ = -1;
+        uint64_t fd_generation_ = 0;
+
+        std::atomic<uint64_t> bytes_written_{0};
+        std::atomic<uint64_t> syncs_{0};
+
+        std::jthread flusher_;
+    };
+
+}  // namespace journal
@@ -0,0 +1,182 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/journal.h"
+#include "../src/json_loader.h"
+#include "temp_dir.h"
+#include "test_game.h"
+
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+using tests::GameFixture;
+using tests::PlayScript;
+
+namespace {
+
+// Считает события приложения, которые дошли до слушателя
+struct CountingListener : public ApplicationListener {
+    void OnJoin(const model::Dog&, const model::GameSession&, std::string_view) override { ++joins; }
+    void OnLeave(model::Dog::Id, const model::GameSession&) override { ++leaves; }
+    void OnAction(model::Dog::Id, model::Move) override { ++actions; }
+    void OnTick(std::chrono::milliseconds) override { ++ticks; }
+
+    int joins = 0;
+    int leaves = 0;
+    int actions = 0;
+    int ticks = 0;
+};
+
+}  // namespace
+
+SCENARIO("Journal records round trip") {
+    GIVEN("records of every type") {
+        const std::vector<journal::Record> records{
+            journal::JoinRecord{"town", 7, 42, "Pluto", {1.5, -2.25}, "6516861d89ebfff147bf2eb2b5153ae1"},
+            journal::ActionRecord{42, "L"},
+            journal::TickRecord{123456ms},
+            journal::LootSpawnRecord{"town", 7, 3, 0xfedcba9876543210ull},
+            journal::LeaveRecord{42},
+            journal::MaterializeRecord{7},
+        };
+
+        WHEN("they are encoded after the header") {
+            std::string data = journal::EncodeHeader();
+            for (const auto& record : records) {
+                journal::EncodeRecord(record, data);
+            }
+
+            THEN("the reader returns the same records") {
+                journal::JournalReader reader(data);
+
+                auto join = reader.Next();
+                REQUIRE(join);
+                const auto& join_record = std::get<journal::JoinRecord>(*join);
+                CHECK(join_record.map_id == "town");
+                CHECK(join_record.session_id == 7u);
+                CHECK(join_record.dog_id == 42u);
+                CHECK(join_record.name == "Pluto");
+                CHECK(join_record.position.x == 1.5);
+                CHECK(join_record.position.y == -2.25);
+                CHECK(join_record.token == "6516861d89ebfff147bf2eb2b5153ae1");
+
+                auto action = reader.Next();
+                REQUIRE(action);
+                CHECK(std::get<journal::ActionRecord>(*action).dog_id == 42u);
+                CHECK(std::get<journal::ActionRecord>(*action).direction == "L");
+
+                auto tick = reader.Next();
+                REQUIRE(tick);
+                CHECK(std::get<journal::TickRecord>(*tick).delta == 123456ms);
+
+                auto spawn = reader.Next();
+                REQUIRE(spawn);
+                const auto& spawn_record = std::get<journal::LootSpawnRecord>(*spawn);
+                CHECK(spawn_record.map_id == "town");
+                CHECK(spawn_record.session_id == 7u);
+                CHECK(spawn_record.count == 3);
+                CHECK(spawn_record.seed == 0xfedcba9876543210ull);
+
+                auto leave = reader.Next();
+                REQUIRE(leave);
+                CHECK(std::get<journal::LeaveRecord>(*leave).dog_id == 42u);
+
+                auto materialize = reader.Next();
+                REQUIRE(materialize);
+                CHECK(std::get<journal::MaterializeRecord>(*materialize).session_id == 7u);
+
+                CHECK_FALSE(reader.Next());
+            }
+        }
+
+        WHEN("the data is cut in the middle of a record") {
+            std::string data = journal::EncodeHeader();
+            journal::EncodeRecord(records.front(), data);
+            data.resize(data.size() - 3);
+
+            THEN("reading fails") {
+                journal::JournalReader reader(data);
+                CHECK_THROWS_AS(reader.Next(), std::runtime_error);
+            }
+        }
+    }
+
+    GIVEN("a version 2 journal without session ids") {
+        std::string data = "GSJ"s;
+        data.push_back(2);
+        data.push_back(static_cast<char>(journal::RecordType::LOOT_SPAWN));
+        data.push_back(4);
+        data += "town"s;
+        data.push_back(2);
+        data.push_back(9);
+
+        THEN("its records refer to no session") {
+            journal::JournalReader reader(data);
+            auto spawn = reader.Next();
+            REQUIRE(spawn);
+            const auto& spawn_record = std::get<journal::LootSpawnRecord>(*spawn);
+            CHECK(spawn_record.map_id == "town");
+            CHECK_FALSE(spawn_record.session_id);
+            CHECK(spawn_record.count == 2);
+            CHECK(spawn_record.seed == 9u);
+        }
+    }
+
+    GIVEN("data that is not a journal") {
+        THEN("the reader rejects it") {
+            CHECK_THROWS_AS(journal::JournalReader("GSN\3"s), std::runtime_error);
+            CHECK_THROWS_AS(journal::JournalReader("GSJ\x7f"s), std::runtime_error);
+        }
+    }
+}
+
+SCENARIO("Recorded game replays into the same state") {
+    GIVEN("a game played with a recorder") {
+        const tests::TempDir dir("game_server_tests_journal");
+        const auto journal_path = dir.GetPath() / "journal";
+
+        GameFixture recorded;
+        {
+            journal::Recorder recorder(recorded.game, journal_path);
+            recorded.app.AddApplicationListener(recorder);
+            PlayScript(recorded.app);
+        }
+        const uint64_t expected = journal::StateDigest(recorded.game);
+
+        WHEN("the journal is replayed on a fresh game") {
+            model::Game replayed = json_loader::LoadGame(GAME_TESTS_CONFIG);
+            const auto stats = journal::Replayer(replayed).Replay(journal_path);
+
+            THEN("every tick is applied and the state matches") {
+                CHECK(stats.ticks == 200);
+                CHECK(journal::StateDigest(replayed) == expected);
+            }
+        }
+
+        WHEN("the journal is replayed into an application") {
+            GameFixture replayed;
+            journal::Replayer(replayed.app).Replay(journal_path);
+
+            THEN("the state matches and players keep their tokens") {
+                CHECK(journal::StateDigest(replayed.game) == expected);
+                CHECK(tests::SamePlayers(recorded.app, replayed.app));
+            }
+        }
+
+        WHEN("the journal is replayed into an application with a listener") {
+            GameFixture replayed;
+            CountingListener listener;
+            replayed.app.AddApplicationListener(listener);
+            journal::Replayer(replayed.app).Replay(journal_path);
+
+            THEN("neither joins nor leaves reach the listener") {
+                CHECK(listener.joins == 0);
+                CHECK(listener.leaves == 0);
+                CHECK(listener.actions == 0);
+                CHECK(listener.ticks == 0);
+                CHECK(journal::StateDigest(replayed.game) == expected);
+            }
+        }
+    }
+}
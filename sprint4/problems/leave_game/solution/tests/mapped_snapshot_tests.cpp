@@ -0,0 +1,140 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/journal.h"
+#include "../src/mapped_snapshot.h"
+#include "../src/write_ahead_log.h"
+#include "temp_dir.h"
+#include "test_game.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+using namespace std::literals;
+
+using tests::GameFixture;
+using tests::PlayScript;
+
+namespace {
+
+void WriteSnapshot(const serialization::GameStateRepr& state, const std::filesystem::path& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    serialization::WriteMappedState(state, out);
+}
+
+size_t CountColdSessions(model::Game& game) {
+    const auto& session_service = game.GetSessionService();
+    const auto& sessions = session_service.GetSessions();
+    return std::count_if(sessions.begin(), sessions.end(), [&session_service](const auto& session) {
+        return session_service.IsColdSession(session->GetSessionId());
+    });
+}
+
+}  // namespace
+
+SCENARIO("Mapped snapshot keeps cold sessions cold") {
+    GIVEN("a snapshot of a game split into several sessions") {
+        const tests::TempDir dir("game_server_tests_mapped");
+        const auto snapshot_path = dir.GetPath() / "state.bin";
+
+        GameFixture played;
+        played.game.GetSessionService().SetMaxPlayersPerSession(2);
+        PlayScript(played.app, 50);
+        WriteSnapshot(serialization::CaptureState(played.app), snapshot_path);
+        const auto source = serialization::MappedSnapshot::Open(snapshot_path);
+
+        const size_t sessions_count = played.game.GetSessionService().GetSessions().size();
+        REQUIRE(sessions_count >= 2);
+
+        WHEN("it is loaded") {
+            GameFixture loaded;
+            serialization::LoadMappedState(loaded.app, source);
+
+            THEN("sessions stay empty until materialized") {
+                CHECK(CountColdSessions(loaded.game) == sessions_count);
+                CHECK(loaded.app.GetPlayers().Size() == 0);
+
+                bool tokens_known = true;
+                played.app.GetPlayers().ForEachPlayer([&loaded, &tokens_known](const app::Token& token, const auto&) {
+                    tokens_known = tokens_known && loaded.app.IsKnownToken(token);
+                });
+                CHECK(tokens_known);
+                CHECK_FALSE(loaded.app.IsKnownToken(app::Token{1, 2}));
+
+                loaded.game.GetSessionService().MaterializeAll();
+                CHECK(journal::StateDigest(loaded.game) == journal::StateDigest(played.game));
+                CHECK(tests::SamePlayers(played.app, loaded.app));
+            }
+        }
+
+        WHEN("a partly materialized game is saved again") {
+            GameFixture loaded;
+            serialization::LoadMappedState(loaded.app, source);
+            loaded.game.GetSessionService().MaterializeNext();
+
+            auto state = serialization::CaptureState(loaded.app);
+            state.cold_source = source;
+            const auto copy_path = dir.GetPath() / "copy.bin";
+            WriteSnapshot(state, copy_path);
+            const auto copy = serialization::MappedSnapshot::Open(copy_path);
+
+            THEN("blocks of cold sessions are copied byte for byte") {
+                size_t copied = 0;
+                for (const auto& session : loaded.game.GetSessionService().GetSessions()) {
+                    const auto id = session->GetSessionId();
+                    if (loaded.game.GetSessionService().IsColdSession(id)) {
+                        CHECK(copy->GetBlock(*copy->FindSession(id)) == source->GetBlock(*source->FindSession(id)));
+                        ++copied;
+                    }
+                }
+                CHECK(copied == sessions_count - 1);
+                CHECK(copy->GetHeader().token_count == source->GetHeader().token_count);
+            }
+
+            THEN("the copy restores the same game") {
+                GameFixture reloaded;
+                serialization::LoadMappedState(reloaded.app, copy);
+                reloaded.game.GetSessionService().MaterializeAll();
+                CHECK(journal::StateDigest(reloaded.game) == journal::StateDigest(played.game));
+                CHECK(tests::SamePlayers(played.app, reloaded.app));
+            }
+
+            THEN("a copy without its source cannot be written") {
+                state.cold_source.reset();
+                CHECK_THROWS_AS(WriteSnapshot(state, copy_path), std::runtime_error);
+            }
+        }
+
+        WHEN("a game loaded from it is logged while one session is materialized") {
+            const auto wal_path = dir.GetPath() / "wal";
+
+            GameFixture live;
+            serialization::LoadMappedState(live.app, source);
+            // Журнал подписан на события игры и должен жить не меньше неё
+            journal::WriteAheadLog live_wal(live.game, wal_path);
+            live.app.AddApplicationListener(live_wal);
+            for (int tick = 0; tick < 50; ++tick) {
+                if (tick == 10) {
+                    live.game.GetSessionService().MaterializeNext();
+                }
+                live.app.Tick(100ms);
+            }
+            live_wal.Sync();
+
+            THEN("recovery materializes only that session at the same point") {
+                GameFixture recovered;
+                serialization::LoadMappedState(recovered.app, source);
+                journal::WriteAheadLog wal(recovered.game, wal_path);
+                wal.Recover(recovered.app, 0);
+
+                CHECK(CountColdSessions(recovered.game) == sessions_count - 1);
+                CHECK(journal::StateDigest(recovered.game) == journal::StateDigest(live.game));
+
+                recovered.game.GetSessionService().MaterializeAll();
+                live.game.GetSessionService().MaterializeAll();
+                CHECK(journal::StateDigest(recovered.game) == journal::StateDigest(live.game));
+                CHECK(tests::SamePlayers(live.app, recovered.app));
+            }
+        }
+    }
+}
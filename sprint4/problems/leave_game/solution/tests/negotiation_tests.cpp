@@ -0,0 +1,120 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/compression.h"
+#include "../src/negotiation.h"
+
+using namespace std::literals;
+
+using http_handler::AcceptsGzip;
+using http_handler::BodyEncoding;
+using http_handler::NegotiateEncoding;
+using http_handler::ParseWeightedValue;
+
+SCENARIO("Weighted list items") {
+    WHEN("an item has no q parameter") {
+        const auto item = ParseWeightedValue(" application/json; charset=utf-8 ");
+
+        THEN("its weight is 1") {
+            CHECK(item.value == "application/json"sv);
+            CHECK(item.quality == 1.);
+        }
+    }
+
+    WHEN("an item has a q parameter among others") {
+        const auto item = ParseWeightedValue("text/html;level=1; Q=0.25");
+
+        THEN("the weight is parsed") {
+            CHECK(item.value == "text/html"sv);
+            CHECK(item.quality == 0.25);
+        }
+    }
+
+    WHEN("the weight is zero in any spelling") {
+        THEN("the item is refused") {
+            CHECK(ParseWeightedValue("gzip;q=0").quality == 0.);
+            CHECK(ParseWeightedValue("gzip;q=0.000").quality == 0.);
+        }
+    }
+}
+
+SCENARIO("Accept negotiation") {
+    WHEN("the client asks for MessagePack only") {
+        THEN("MessagePack is chosen") {
+            CHECK(NegotiateEncoding("application/msgpack"sv) == BodyEncoding::MSGPACK);
+            CHECK(NegotiateEncoding("Application/MsgPack"sv) == BodyEncoding::MSGPACK);
+        }
+    }
+
+    WHEN("MessagePack is refused with q=0") {
+        THEN("JSON is chosen") {
+            CHECK(NegotiateEncoding("application/msgpack;q=0"sv) == BodyEncoding::JSON);
+            CHECK(NegotiateEncoding("application/msgpack;q=0, */*"sv) == BodyEncoding::JSON);
+        }
+    }
+
+    WHEN("both types are listed with weights") {
+        THEN("the heavier one is chosen") {
+            CHECK(NegotiateEncoding("application/json;q=0.9, application/msgpack;q=0.5"sv) == BodyEncoding::JSON);
+            CHECK(NegotiateEncoding("application/json;q=0.5, application/msgpack;q=0.9"sv) == BodyEncoding::MSGPACK);
+            CHECK(NegotiateEncoding("application/msgpack, application/json;q=0.8"sv) == BodyEncoding::MSGPACK);
+        }
+    }
+
+    WHEN("JSON is weighted through a wildcard") {
+        THEN("the most specific range decides") {
+            CHECK(NegotiateEncoding("application/msgpack;q=0.5, application/*"sv) == BodyEncoding::JSON);
+            CHECK(NegotiateEncoding("application/msgpack, */*;q=0.1"sv) == BodyEncoding::MSGPACK);
+            CHECK(NegotiateEncoding("application/msgpack;q=0.5, application/json;q=0.1, */*"sv) 
+                  == BodyEncoding::MSGPACK);
+        }
+    }
+
+    WHEN("MessagePack is not named explicitly") {
+        THEN("JSON is chosen") {
+            CHECK(NegotiateEncoding(""sv) == BodyEncoding::JSON);
+            CHECK(NegotiateEncoding("*/*"sv) == BodyEncoding::JSON);
+            CHECK(NegotiateEncoding("application/*"sv) == BodyEncoding::JSON);
+            CHECK(NegotiateEncoding("text/html, application/xhtml+xml"sv) == BodyEncoding::JSON);
+        }
+    }
+}
+
+SCENARIO("Accept-Encoding negotiation") {
+    WHEN("gzip is listed without a weight or with a non-zero one") {
+        THEN("gzip is accepted") {
+            CHECK(AcceptsGzip("gzip"sv));
+            CHECK(AcceptsGzip("deflate, GZIP;q=0.5"sv));
+            CHECK(AcceptsGzip("*"sv));
+        }
+    }
+
+    WHEN("gzip is refused explicitly") {
+        THEN("it is not accepted") {
+            CHECK_FALSE(AcceptsGzip("gzip;q=0"sv));
+            CHECK_FALSE(AcceptsGzip("gzip;q=0.000, deflate"sv));
+        }
+    }
+
+    WHEN("the wildcard is refused") {
+        THEN("gzip is accepted only if it is listed itself") {
+            CHECK_FALSE(AcceptsGzip("*;q=0"sv));
+            CHECK(AcceptsGzip("*;q=0, gzip"sv));
+            CHECK(AcceptsGzip("gzip, *;q=0"sv));
+        }
+    }
+
+    WHEN("the wildcard is allowed but gzip is refused") {
+        THEN("the explicit entry wins in any order") {
+            CHECK_FALSE(AcceptsGzip("*, gzip;q=0"sv));
+            CHECK_FALSE(AcceptsGzip("gzip;q=0, *"sv));
+        }
+    }
+
+    WHEN("gzip is not mentioned") {
+        THEN("it is not accepted") {
+            CHECK_FALSE(AcceptsGzip(""sv));
+            CHECK_FALSE(AcceptsGzip("deflate, br"sv));
+            CHECK_FALSE(AcceptsGzip("identity"sv));
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/order_statistics_tree.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using Tree = util::OrderStatisticsTree<int, std::less<int>>;
+
+namespace {
+
+// Значения 0..size-1: значение совпадает со своей позицией
+std::vector<int> MakeValues(size_t size) {
+    std::vector<int> values(size);
+    std::iota(values.begin(), values.end(), 0);
+    return values;
+}
+
+std::vector<int> Collect(const Tree& tree, size_t start, size_t count) {
+    std::vector<int> result;
+    tree.ForEach(start, count, [&result](int value) {
+        result.push_back(value);
+    });
+    return result;
+}
+
+// Выборки, начинающиеся и заканчивающиеся на границах листьев (64 значения)
+// и поддеревьев второго уровня (64 * 64 значения) и рядом с ними
+bool PagesMatch(const Tree& tree, size_t size) {
+    const std::vector<int> expected = MakeValues(size);
+    const std::vector<size_t> starts{0, 1, 63, 64, 65, 127, 128, 4095, 4096, 4097, size - 1, size};
+    const std::vector<size_t> counts{0, 1, 63, 64, 65, 200, 5000};
+
+    for (size_t start : starts) {
+        for (size_t count : counts) {
+            const size_t end = std::min(size, start + count);
+            const std::vector<int> page(expected.begin() + std::min(start, size), expected.begin() + end);
+            if (Collect(tree, start, count) != page) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+SCENARIO("Order statistics tree") {
+    // Больше 64 * 64 значений: у дерева три уровня
+    constexpr size_t size = 64 * 64 + 100;
+
+    GIVEN("a tree built from sorted values") {
+        Tree tree;
+        tree.Assign(MakeValues(size));
+
+        THEN("pages across leaf and subtree boundaries are selected in order") {
+            CHECK(tree.Size() == size);
+            CHECK(PagesMatch(tree, size));
+        }
+
+        WHEN("values are inserted into full leaves") {
+            Tree grown;
+            std::vector<int> values = MakeValues(size);
+            std::vector<int> evens;
+            std::vector<int> odds;
+            for (int value : values) {
+                (value % 2 == 0 ? evens : odds).push_back(value);
+            }
+            grown.Assign(std::move(evens));
+            for (int value : odds) {
+                grown.Insert(value);
+            }
+
+            THEN("the split leaves keep the order") {
+                CHECK(grown.Size() == size);
+                CHECK(PagesMatch(grown, size));
+            }
+        }
+    }
+
+    GIVEN("a tree built by inserts in random order") {
+        std::vector<int> values = MakeValues(size);
+        std::shuffle(values.begin(), values.end(), std::mt19937{42});
+        Tree tree;
+        for (int value : values) {
+            tree.Insert(value);
+        }
+
+        THEN("pages across leaf and subtree boundaries are selected in order") {
+            CHECK(tree.Size() == size);
+            CHECK(PagesMatch(tree, size));
+        }
+    }
+
+    GIVEN("an empty tree") {
+        Tree tree;
+
+        THEN("no values are selected") {
+            CHECK(Collect(tree, 0, 10).empty());
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/json_loader.h"
+#include "../src/rate_limiter.h"
+#include "temp_dir.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+using namespace std::literals;
+
+using http_handler::RateLimit;
+using http_handler::RateLimitConfig;
+using http_handler::RateLimiter;
+
+SCENARIO("Rate limiter") {
+    GIVEN("a limit of 2 requests per second with a burst of 2") {
+        RateLimiter limiter{RateLimitConfig{std::nullopt, {{"/api/v1/game/state"s, RateLimit{2., 2.}}}}};
+        const auto now = RateLimiter::Clock::now();
+
+        WHEN("a client makes a burst of requests") {
+            const auto first = limiter.Check("/api/v1/game/state?x=1", "a", now);
+            const auto second = limiter.Check("/api/v1/game/state", "a", now);
+            const auto third = limiter.Check("/api/v1/game/state", "a", now);
+
+            THEN("requests above the burst are limited until the bucket refills") {
+                CHECK(first.count() == 0);
+                CHECK(second.count() == 0);
+                CHECK(third.count() == 1);
+                CHECK(limiter.GetLimitedRequests() == 1);
+                CHECK(limiter.Check("/api/v1/game/state", "a", now + 500ms).count() == 0);
+            }
+
+            THEN("other clients and paths without a limit are not affected") {
+                CHECK(limiter.Check("/api/v1/game/state", "b", now).count() == 0);
+                CHECK(limiter.Check("/api/v1/maps", "a", now).count() == 0);
+            }
+        }
+
+        WHEN("one token is sent spelled in different letter cases") {
+            const auto lower = app::Token::FromHex("21bcec4d2fe13ab845d72a5f19fa57b1"sv);
+            const auto upper = app::Token::FromHex("21BCEC4D2FE13AB845D72A5F19FA57B1"sv);
+            const auto mixed = app::Token::FromHex("21bCeC4d2Fe13aB845D72a5f19Fa57B1"sv);
+            REQUIRE(lower);
+            REQUIRE(upper);
+            REQUIRE(mixed);
+
+            const auto first = limiter.Check("/api/v1/game/state", *lower, now);
+            const auto second = limiter.Check("/api/v1/game/state", *upper, now);
+            const auto third = limiter.Check("/api/v1/game/state", *mixed, now);
+
+            THEN("all spellings share one bucket") {
+                CHECK(first.count() == 0);
+                CHECK(second.count() == 0);
+                CHECK(third.count() == 1);
+                CHECK(limiter.GetBucketsCount() == 1);
+            }
+        }
+
+        WHEN("more clients than the table holds make requests at once") {
+            const size_t clients = RateLimiter::MAX_BUCKETS + RateLimiter::MAX_BUCKETS / 2;
+            for (size_t i = 0; i < clients; ++i) {
+                limiter.Check("/api/v1/game/state", std::to_string(i), now);
+            }
+
+            THEN("the table does not grow above its limit") {
+                CHECK(limiter.GetBucketsCount() <= RateLimiter::MAX_BUCKETS);
+            }
+        }
+    }
+}
+
+SCENARIO("Server settings are part of the game config") {
+    GIVEN("a config file with rate limits and a retirement time") {
+        const tests::TempDir dir("game_server_tests_config_settings");
+        const auto config_path = dir.GetPath() / "config.json";
+        std::ofstream(config_path) << R"({
+            "maps": [],
+            "dogRetirementTime": 15.5,
+            "rateLimits": {
+                "default": {"rate": 50, "burst": 100},
+                "routes": {"/api/v1/game/join": {"rate": 1, "burst": 5}}
+            }
+        })";
+        const auto cache_path = dir.GetPath() / "maps.cache";
+
+        WHEN("the config is loaded, then loaded again from the map cache") {
+            const auto parsed = json_loader::LoadGameConfig(config_path, cache_path);
+            REQUIRE(std::filesystem::exists(cache_path));
+            const auto cached = json_loader::LoadGameConfig(config_path, cache_path);
+
+            THEN("both carry the same settings") {
+                for (const auto* config : {&parsed, &cached}) {
+                    CHECK(config->dog_retirement_time == 15'500ms);
+
+                    const auto& limits = config->rate_limits;
+                    REQUIRE(limits.default_limit);
+                    CHECK(limits.default_limit->rate == 50.);
+                    CHECK(limits.default_limit->burst == 100.);
+                    REQUIRE(limits.routes.size() == 1);
+                    CHECK(limits.routes[0].first == "/api/v1/game/join");
+                    CHECK(limits.routes[0].second.rate == 1.);
+                    CHECK(limits.routes[0].second.burst == 5.);
+                }
+            }
+        }
+    }
+
+    GIVEN("a config file without server settings") {
+        const tests::TempDir dir("game_server_tests_default_settings");
+        const auto config_path = dir.GetPath() / "config.json";
+        std::ofstream(config_path) << R"({"maps": []})";
+
+        WHEN("the config is loaded") {
+            const auto config = json_loader::LoadGameConfig(config_path);
+
+            THEN("requests are not limited and players retire after the default time") {
+                CHECK(config.rate_limits.IsEmpty());
+                CHECK(config.dog_retirement_time == json_loader::DEFAULT_DOG_RETIREMENT_TIME);
+            }
+        }
+    }
+}
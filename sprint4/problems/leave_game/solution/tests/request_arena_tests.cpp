@@ -0,0 +1,67 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/type_declarations.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using namespace std::literals;
+
+using http_handler::ArenaAllocator;
+using http_handler::RequestArena;
+
+SCENARIO("Request arena") {
+    GIVEN("an arena with a response allocated from it") {
+        RequestArena arena;
+        const ArenaAllocator<char> allocator(&arena);
+        const std::string body(4000, 'x');
+
+        auto make_response = [&] {
+            http_handler::StringResponse response(http::status::ok, 11, allocator, allocator);
+            response.set(http::field::content_type, "application/json"sv);
+            response.body().assign(body);
+            response.prepare_payload();
+            return response;
+        };
+        make_response();
+
+        WHEN("the arena is reset") {
+            arena.Reset();
+
+            THEN("the block grows to fit everything allocated before") {
+                CHECK(arena.Capacity() >= body.size());
+            }
+
+            THEN("the same response fits into the block") {
+                const size_t capacity = arena.Capacity();
+                auto response = make_response();
+                CHECK(std::string_view(response.body()) == body);
+                CHECK(response[http::field::content_length] == std::to_string(body.size()));
+
+                arena.Reset();
+                CHECK(arena.Capacity() == capacity);
+            }
+        }
+    }
+
+    GIVEN("an allocator without an arena") {
+        const ArenaAllocator<char> allocator;
+
+        THEN("messages use the heap and compare equal") {
+            http_handler::StringResponse response(http::status::ok, 11, allocator, allocator);
+            response.body().assign(100, 'x');
+            CHECK(response.body().size() == 100);
+            CHECK(allocator == ArenaAllocator<uint64_t>{});
+        }
+    }
+
+    GIVEN("allocators of different arenas") {
+        RequestArena first;
+        RequestArena second;
+
+        THEN("they compare unequal") {
+            CHECK_FALSE(ArenaAllocator<char>(&first) == ArenaAllocator<char>(&second));
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/http_server.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+using namespace std::literals;
+
+namespace {
+
+    // Выделения памяти считаются только в потоке сервера
+    thread_local bool count_allocations = false;
+    std::atomic<uint64_t> allocations_count{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+    if (count_allocations) {
+        allocations_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+namespace {
+
+    namespace net = boost::asio;
+    namespace http = boost::beast::http;
+
+    // Выделения памяти в потоке сервера на один запрос keep-alive соединения после прогрева.
+    // Сервер отвечает сразу, как ответил бы обработчик файлов или ошибок
+    template <template <typename> class SessionType>
+    double AllocationsPerRequest(int requests) {
+        using tcp = net::ip::tcp;
+
+        net::io_context ioc;
+        tcp::acceptor acceptor(ioc, {net::ip::make_address("127.0.0.1"), 0});
+        tcp::socket client(ioc);
+        client.connect(acceptor.local_endpoint());
+
+        auto handler = [](http_handler::StringRequest&& req, const net::ip::address&, auto&& send) {
+            // Ответ размещается в арене запроса, как у обработчиков сервера
+            http_handler::StringResponse response(http::status::ok, req.version(), 
+                                                  req.get_allocator(), req.get_allocator());
+            response.body() = "{}"s;
+            response.keep_alive(req.keep_alive());
+            response.prepare_payload();
+            send(std::move(response));
+        };
+        auto limiter = std::make_shared<http_server::ConnectionLimiter>();
+        limiter->TryAcquire();
+        std::make_shared<SessionType<decltype(handler)>>(acceptor.accept(), limiter, handler)->Run();
+
+        auto work = net::make_work_guard(ioc);
+        std::thread server([&ioc] {
+            count_allocations = true;
+            ioc.run();
+        });
+
+        const std::string request = "GET /api/v1/game/state HTTP/1.1\r\nHost: localhost\r\n\r\n"s;
+        boost::beast::flat_buffer buffer;
+        auto round_trip = [&] {
+            net::write(client, net::buffer(request));
+            http::response<http::string_body> response;
+            http::read(client, buffer, response);
+        };
+
+        // Первые запросы заполняют пулы памяти сессии и Asio
+        for (int i = 0; i < 100; ++i) {
+            round_trip();
+        }
+
+        const uint64_t before = allocations_count.load();
+        for (int i = 0; i < requests; ++i) {
+            round_trip();
+        }
+        const uint64_t allocations = allocations_count.load() - before;
+
+        client.close();
+        work.reset();
+        server.join();
+
+        return static_cast<double>(allocations) / requests;
+    }
+
+}  // namespace
+
+// Память сессии (HandlerMemory) покрывает асинхронные операции, передачу ответа и сторожевой
+// таймер, а заголовки и тела запроса и ответа лежат в арене запроса. Любое выделение - регрессия
+SCENARIO("Heap allocations per request of a keep-alive session") {
+    GIVEN("the callback session") {
+        THEN("a request makes no allocations") {
+            CHECK(AllocationsPerRequest<http_server::Session>(1000) == 0.);
+        }
+    }
+
+    // Кадры циклов сопрограммы создаются один раз на соединение, а её операции используют
+    // ту же память сессии
+    GIVEN("the coroutine session") {
+        THEN("a request makes no allocations") {
+            CHECK(AllocationsPerRequest<http_server::CoroutineSession>(1000) == 0.);
+        }
+    }
+}
@@ -0,0 +1,260 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/request_handler.h"
+#include "test_game.h"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+using tests::GameFixture;
+
+namespace {
+
+// Игрок входит так же, как через API, и сразу уходит
+void JoinAndLeave(app::Application& app) {
+    auto& session_service = app.GetGame().GetSessionService();
+    const app::Token token = app.AddPlayer(std::make_shared<model::Dog>("dog"s),
+                                           session_service.FindGameSession(tests::MAP_ID));
+    auto player = app.GetPlayers().GetPlayerByToken(token);
+    app.RemovePlayer(player->GetDogId(), player->GetGameSession());
+}
+
+// Запрос входа в игру, как его присылает клиент
+http_handler::StringResponse Join(http_handler::ApiRequestHandler& handler, const std::string& body) {
+    http_handler::StringRequest req{boost::beast::http::verb::post, "/api/v1/game/join", 11};
+    req.body() = body;
+    req.prepare_payload();
+    return std::get<http_handler::StringResponse>(handler.RouteRequest(req));
+}
+
+std::string JoinToken(http_handler::ApiRequestHandler& handler) {
+    const auto response = Join(handler, R"({"userName": "dog", "mapId": "town"})"s);
+    return std::string(boost::json::parse(response.body()).as_object().at("authToken").as_string());
+}
+
+http_handler::ResponseVariant Get(http_handler::ApiRequestHandler& handler, std::string_view target,
+                                  const std::string& token, std::string_view accept_encoding = {}) {
+    http_handler::StringRequest req{boost::beast::http::verb::get, target, 11};
+    req.set(boost::beast::http::field::authorization, "Bearer " + token);
+    if (!accept_encoding.empty()) {
+        req.set(boost::beast::http::field::accept_encoding, accept_encoding);
+    }
+    return handler.RouteRequest(req);
+}
+
+http_handler::StringResponse PostActions(http_handler::ApiRequestHandler& handler, const std::string& sender,
+                                         const std::vector<std::string>& tokens) {
+    std::string body = "[";
+    for (const auto& token : tokens) {
+        body += (body.size() > 1 ? ", " : "") + R"({"token": ")"s + token + R"(", "move": "L"})";
+    }
+    body += "]";
+
+    http_handler::StringRequest req{boost::beast::http::verb::post, "/api/v1/game/player/actions", 11};
+    req.set(boost::beast::http::field::authorization, "Bearer " + sender);
+    req.set(boost::beast::http::field::content_type, "application/json");
+    req.body() = std::move(body);
+    req.prepare_payload();
+    return std::get<http_handler::StringResponse>(handler.RouteRequest(req));
+}
+
+const http_handler::SharedBuffer& SharedBody(const http_handler::ResponseVariant& response) {
+    return std::get<http_handler::SharedResponse>(response).body();
+}
+
+// Читает тела ответов сессии, в которую вошёл игрок, и прерывает вход
+struct FailingJoinListener : public ApplicationListener {
+    explicit FailingJoinListener(app::Application& app)
+        : app(app) {
+    }
+
+    void OnJoin(const model::Dog&, const model::GameSession& session, std::string_view token) override {
+        const auto parsed = app::Token::FromHex(token);
+        app.GetSerializedPlayersList(*parsed);
+        app.GetSerializedGameState(*parsed);
+        session_id = session.GetSessionId();
+        throw std::runtime_error("join is not recorded");
+    }
+
+    void OnTick(std::chrono::milliseconds) override {}
+
+    app::Application& app;
+    model::GameSession::Id session_id{};
+};
+
+}  // namespace
+
+SCENARIO("Empty sessions are reclaimed") {
+    GIVEN("a game without a session capacity") {
+        GameFixture game;
+        auto& session_service = game.game.GetSessionService();
+
+        WHEN("the last player leaves the map") {
+            JoinAndLeave(game.app);
+
+            THEN("the only session of the map is kept") {
+                CHECK(session_service.GetSessions().size() == 1);
+            }
+        }
+    }
+
+    GIVEN("a game with a session capacity") {
+        GameFixture game;
+        auto& session_service = game.game.GetSessionService();
+        session_service.SetMaxPlayersPerSession(2);
+
+        WHEN("the last player leaves the session") {
+            JoinAndLeave(game.app);
+
+            THEN("the session is removed") {
+                CHECK(session_service.GetSessions().empty());
+            }
+        }
+    }
+}
+
+SCENARIO("Failed joins are rolled back") {
+    GIVEN("a game with a session capacity and a listener that fails on join") {
+        GameFixture game;
+        auto& session_service = game.game.GetSessionService();
+        session_service.SetMaxPlayersPerSession(2);
+        FailingJoinListener listener(game.app);
+        game.app.AddApplicationListener(listener);
+
+        WHEN("a player joins") {
+            CHECK_THROWS_AS(game.app.AddPlayer(std::make_shared<model::Dog>("dog"s),
+                                               session_service.FindGameSession(tests::MAP_ID)),
+                            std::runtime_error);
+
+            THEN("the player, the opened session and its cached bodies are removed") {
+                CHECK(game.app.GetPlayers().Size() == 0);
+                CHECK(session_service.GetSessions().empty());
+                CHECK_FALSE(game.app.HasSerializedBodies(listener.session_id));
+            }
+        }
+    }
+}
+
+SCENARIO("Rejected joins do not open sessions") {
+    GIVEN("a map whose sessions are full") {
+        GameFixture game;
+        auto& session_service = game.game.GetSessionService();
+        session_service.SetMaxPlayersPerSession(2);
+        http_handler::ApiRequestHandler handler(game.game, GAME_TESTS_CONFIG, game.app);
+
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(Join(handler, R"({"userName": "dog", "mapId": "town"})"s).result()
+                    == boost::beast::http::status::ok);
+        }
+        const size_t sessions_count = session_service.GetSessions().size();
+        REQUIRE(sessions_count == 2);
+
+        WHEN("players try to join with invalid requests") {
+            for (int i = 0; i < 100; ++i) {
+                CHECK(Join(handler, R"({"userName": "", "mapId": "town"})"s).result()
+                      == boost::beast::http::status::bad_request);
+                CHECK(Join(handler, R"({"mapId": "town"})"s).result()
+                      == boost::beast::http::status::bad_request);
+                CHECK(Join(handler, R"({"userName": "dog"})"s).result()
+                      == boost::beast::http::status::bad_request);
+            }
+
+            THEN("no session is opened for them") {
+                CHECK(session_service.GetSessions().size() == sessions_count);
+            }
+        }
+    }
+}
+
+SCENARIO("Players of a session share cached response bodies") {
+    GIVEN("two players in one session") {
+        GameFixture game;
+        http_handler::ApiRequestHandler handler(game.game, GAME_TESTS_CONFIG, game.app);
+        const std::string first = JoinToken(handler);
+        const std::string second = JoinToken(handler);
+
+        WHEN("both request the players list") {
+            const auto first_response = Get(handler, "/api/v1/game/players"sv, first);
+            const auto second_response = Get(handler, "/api/v1/game/players"sv, second);
+
+            THEN("both responses send the same cached buffer") {
+                REQUIRE(SharedBody(first_response));
+                CHECK(SharedBody(first_response) == SharedBody(second_response));
+                CHECK(SharedBody(first_response)->find("dog") != std::string::npos);
+            }
+        }
+
+        WHEN("both poll the game state") {
+            const auto first_response = Get(handler, "/api/v1/game/state"sv, first);
+            const auto second_response = Get(handler, "/api/v1/game/state"sv, second);
+
+            THEN("both responses send the same serialized state") {
+                REQUIRE(SharedBody(first_response));
+                CHECK(SharedBody(first_response) == SharedBody(second_response));
+            }
+        }
+    }
+
+    GIVEN("a session whose state is large enough to be compressed") {
+        GameFixture game;
+        http_handler::ApiRequestHandler handler(game.game, GAME_TESTS_CONFIG, game.app);
+        std::vector<std::string> tokens;
+        for (int i = 0; i < 50; ++i) {
+            tokens.push_back(JoinToken(handler));
+        }
+
+        WHEN("players poll the state with gzip") {
+            const auto first_response = Get(handler, "/api/v1/game/state"sv, tokens.front(), "gzip"sv);
+            const auto second_response = Get(handler, "/api/v1/game/state"sv, tokens.back(), "gzip"sv);
+
+            THEN("both responses send the same compressed buffer") {
+                const auto& first = std::get<http_handler::SharedResponse>(first_response);
+                REQUIRE(first[boost::beast::http::field::content_encoding] == "gzip");
+                CHECK(SharedBody(first_response) == SharedBody(second_response));
+                CHECK(handler.GetCompressionStats().compressed == 1);
+                CHECK(handler.GetCompressionStats().cache_hits == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("Batch actions") {
+    GIVEN("two players and a limit of 2 single actions per player") {
+        GameFixture game;
+        http_handler::RateLimiter limiter{http_handler::RateLimitConfig{
+            std::nullopt, {{"/api/v1/game/player/action"s, http_handler::RateLimit{1., 2.}}}}};
+        http_handler::ApiRequestHandler handler(game.game, GAME_TESTS_CONFIG, game.app, {}, &limiter);
+        const std::string first = JoinToken(handler);
+        const std::string second = JoinToken(handler);
+
+        WHEN("a player sends actions for its own dog within the limit") {
+            const auto response = PostActions(handler, first, {first, first});
+
+            THEN("they are applied") {
+                CHECK(response.result() == boost::beast::http::status::ok);
+            }
+        }
+
+        WHEN("a player sends an action for another player's dog") {
+            const auto response = PostActions(handler, first, {first, second});
+
+            THEN("the batch is rejected as unauthorized") {
+                CHECK(response.result() == boost::beast::http::status::unauthorized);
+            }
+        }
+
+        WHEN("a batch holds more actions than the single action limit allows") {
+            const auto response = PostActions(handler, first, {first, first, first});
+
+            THEN("the batch is rejected as too many requests") {
+                CHECK(response.result() == boost::beast::http::status::too_many_requests);
+                CHECK(response[boost::beast::http::field::retry_after] == "1");
+            }
+        }
+    }
+}
@@ -0,0 +1,238 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/http_server.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+    namespace net = boost::asio;
+    namespace http = boost::beast::http;
+    using tcp = net::ip::tcp;
+
+    // Отвечает сразу, в теле ответа - цель запроса
+    struct EchoHandler {
+        template <typename Send>
+        void operator()(http_handler::StringRequest&& req, const net::ip::address&, Send&& send) const {
+            send(MakeResponse(req));
+        }
+
+        static http_handler::StringResponse MakeResponse(const http_handler::StringRequest& req) {
+            http_handler::StringResponse response(http::status::ok, req.version(),
+                                                  req.get_allocator(), req.get_allocator());
+            response.body().assign(req.target());
+            response.keep_alive(req.keep_alive());
+            response.prepare_payload();
+            return response;
+        }
+    };
+
+    // Копит запросы и отвечает на них в обратном порядке, когда их набирается batch
+    struct ReversingHandler {
+        size_t batch = 3;
+        std::shared_ptr<std::vector<std::function<void()>>> pending
+            = std::make_shared<std::vector<std::function<void()>>>();
+
+        template <typename Send>
+        void operator()(http_handler::StringRequest&& req, const net::ip::address&, Send&& send) const {
+            pending->push_back([send, response = EchoHandler::MakeResponse(req)]() mutable {
+                send(std::move(response));
+            });
+            if (pending->size() == batch) {
+                for (auto it = pending->rbegin(); it != pending->rend(); ++it) {
+                    (*it)();
+                }
+                pending->clear();
+            }
+        }
+    };
+
+    // Сессия в отдельном потоке и подключённый к ней клиент
+    template <template <typename> class SessionType, typename Handler = EchoHandler>
+    class SessionFixture {
+    public:
+        explicit SessionFixture(http_server::ServerLimits limits = {}, Handler handler = {})
+            : acceptor_(ioc_, {net::ip::make_address("127.0.0.1"), 0})
+            , client_(ioc_)
+            , limiter_(std::make_shared<http_server::ConnectionLimiter>(limits)) {
+            client_.connect(acceptor_.local_endpoint());
+
+            limiter_->TryAcquire();
+            std::make_shared<SessionType<Handler>>(acceptor_.accept(), limiter_, std::move(handler))->Run();
+            server_ = std::thread([this] { ioc_.run(); });
+        }
+
+        ~SessionFixture() {
+            boost::system::error_code ec;
+            client_.close(ec);
+            work_.reset();
+            server_.join();
+        }
+
+        void Send(std::string_view data) {
+            net::write(client_, net::buffer(data));
+        }
+
+        static std::string Request(std::string_view target) {
+            return "GET "s.append(target).append(" HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        }
+
+        // Тело ответа или пустая строка, если ответа нет
+        std::string Receive() {
+            http::response<http::string_body> response;
+            boost::system::error_code ec;
+            http::read(client_, buffer_, response, ec);
+            return ec ? ""s : response.body();
+        }
+
+        bool RoundTrip() {
+            Send(Request("/api/v1/game/state"sv));
+            return Receive() == "/api/v1/game/state"sv;
+        }
+
+        // Ждёт, пока сервер закроет соединение, и возвращает прошедшее время
+        std::chrono::milliseconds WaitClosed() {
+            const auto start = std::chrono::steady_clock::now();
+            char byte;
+            boost::system::error_code ec;
+            while (!ec) {
+                client_.read_some(net::buffer(&byte, 1), ec);
+            }
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+        }
+
+        uint64_t Timeouts() const {
+            return limiter_->GetStats().timeouts;
+        }
+
+    private:
+        net::io_context ioc_;
+        net::executor_work_guard<net::io_context::executor_type> work_ = net::make_work_guard(ioc_);
+        tcp::acceptor acceptor_;
+        tcp::socket client_;
+        boost::beast::flat_buffer buffer_;
+        std::shared_ptr<http_server::ConnectionLimiter> limiter_;
+        std::thread server_;
+    };
+
+    http_server::ServerLimits ShortLimits() {
+        http_server::ServerLimits limits;
+        limits.header_timeout = 100ms;
+        limits.body_timeout = 100ms;
+        limits.idle_timeout = 300ms;
+        return limits;
+    }
+
+    template <template <typename> class SessionType>
+    void CheckTimeouts() {
+        SessionFixture<SessionType> session(ShortLimits());
+
+        WHEN("the client sends nothing") {
+            THEN("the connection is closed after the header timeout") {
+                CHECK(session.WaitClosed() >= 90ms);
+                CHECK(session.Timeouts() == 1);
+            }
+        }
+
+        WHEN("the request body does not arrive") {
+            session.Send("POST /api/v1/game/tick HTTP/1.1\r\nHost: localhost\r\n"
+                         "Content-Length: 10\r\n\r\n{\""sv);
+
+            THEN("the connection is closed after the body timeout") {
+                CHECK(session.WaitClosed() >= 90ms);
+                CHECK(session.Timeouts() == 1);
+            }
+        }
+
+        WHEN("requests come more rarely than the write timeout but within the idle timeout") {
+            THEN("the connection stays open") {
+                for (int i = 0; i < 3; ++i) {
+                    REQUIRE(session.RoundTrip());
+                    std::this_thread::sleep_for(200ms);
+                }
+                CHECK(session.RoundTrip());
+                CHECK(session.Timeouts() == 0);
+
+                AND_THEN("it is closed after the idle timeout") {
+                    CHECK(session.WaitClosed() >= 290ms);
+                    CHECK(session.Timeouts() == 1);
+                }
+            }
+        }
+    }
+
+    template <template <typename> class SessionType>
+    void CheckPipelining() {
+        WHEN("responses to pipelined requests are ready in reverse order") {
+            SessionFixture<SessionType, ReversingHandler> session;
+            std::string requests;
+            for (std::string_view target : {"/1"sv, "/2"sv, "/3"sv, "/4"sv, "/5"sv, "/6"sv}) {
+                requests += session.Request(target);
+            }
+            session.Send(requests);
+
+            THEN("they are sent in the order of requests") {
+                for (std::string_view target : {"/1"sv, "/2"sv, "/3"sv, "/4"sv, "/5"sv, "/6"sv}) {
+                    CHECK(session.Receive() == target);
+                }
+            }
+        }
+
+        WHEN("more requests are pipelined than the session reads ahead") {
+            SessionFixture<SessionType> session;
+            std::string requests;
+            for (int i = 0; i < 50; ++i) {
+                requests += session.Request("/" + std::to_string(i));
+            }
+            session.Send(requests);
+
+            THEN("every request is answered in order") {
+                for (int i = 0; i < 50; ++i) {
+                    CHECK(session.Receive() == "/" + std::to_string(i));
+                }
+            }
+        }
+
+        WHEN("the last pipelined request asks to close the connection") {
+            SessionFixture<SessionType> session;
+            session.Send(session.Request("/1"sv)
+                         + "GET /2 HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"
+                         + session.Request("/3"sv));
+
+            THEN("the connection is closed after its response") {
+                CHECK(session.Receive() == "/1"sv);
+                CHECK(session.Receive() == "/2"sv);
+                CHECK(session.Receive().empty());
+            }
+        }
+    }
+
+}  // namespace
+
+SCENARIO("Session timeouts") {
+    GIVEN("the callback session") {
+        CheckTimeouts<http_server::Session>();
+    }
+
+    GIVEN("the coroutine session") {
+        CheckTimeouts<http_server::CoroutineSession>();
+    }
+}
+
+SCENARIO("Pipelined requests") {
+    GIVEN("the callback session") {
+        CheckPipelining<http_server::Session>();
+    }
+
+    GIVEN("the coroutine session") {
+        CheckPipelining<http_server::CoroutineSession>();
+    }
+}
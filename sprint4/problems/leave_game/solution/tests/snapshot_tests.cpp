@@ -0,0 +1,142 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/journal.h"
+#include "../src/model_serialization.h"
+#include "temp_dir.h"
+#include "test_game.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace std::literals;
+
+using tests::GameFixture;
+using tests::PlayScript;
+
+SCENARIO("State snapshot round trip") {
+    GIVEN("a played game saved to a snapshot") {
+        GameFixture saved;
+        PlayScript(saved.app);
+        const uint64_t expected = journal::StateDigest(saved.game);
+
+        std::ostringstream out;
+        serialization::SaveState(saved.app, out);
+        std::string data = out.str();
+
+        WHEN("the snapshot is loaded into a fresh game") {
+            GameFixture loaded;
+            std::istringstream in(data);
+            serialization::LoadState(loaded.app, in);
+
+            THEN("sessions and players are restored") {
+                CHECK(journal::StateDigest(loaded.game) == expected);
+                CHECK(tests::SamePlayers(saved.app, loaded.app));
+            }
+
+            THEN("the loaded game saves to the same snapshot") {
+                std::ostringstream again;
+                serialization::SaveState(loaded.app, again);
+                CHECK(again.str() == data);
+            }
+        }
+
+        WHEN("a byte of the snapshot is damaged") {
+            data[data.size() / 2] ^= 0x5a;
+
+            THEN("loading fails") {
+                GameFixture loaded;
+                std::istringstream in(data);
+                CHECK_THROWS_AS(serialization::LoadState(loaded.app, in), std::runtime_error);
+            }
+        }
+
+        WHEN("the snapshot is truncated") {
+            data.resize(data.size() - 5);
+
+            THEN("loading fails") {
+                GameFixture loaded;
+                std::istringstream in(data);
+                CHECK_THROWS_AS(serialization::LoadState(loaded.app, in), std::runtime_error);
+            }
+        }
+
+        WHEN("the snapshot has an unknown version") {
+            // Версия следует за длиной и символами MAGIC
+            data[sizeof(uint64_t) + serialization::SNAPSHOT_MAGIC.size()] = 0x7f;
+
+            THEN("loading fails") {
+                GameFixture loaded;
+                std::istringstream in(data);
+                CHECK_THROWS_AS(serialization::LoadState(loaded.app, in), std::runtime_error);
+            }
+        }
+    }
+}
+
+SCENARIO("Legacy JSON state") {
+    GIVEN("a state file written by a server before the binary snapshot") {
+        const std::string legacy = R"({
+            "sessions": [{"mapId": "town", "id": 7,
+                          "dogs": [{"id": 41, "name": "Rex", "pos": [1.5, 0], "speed": [0, 2.5], "dir": "D",
+                                    "score": 30, "bag": [{"id": 3, "type": 1}]}],
+                          "lostObjects": [{"id": 9, "type": 0, "pos": [2, 0.5]}]}],
+            "players": [{"token": "21bcec4d2fe13ab845d72a5f19fa57b1", "sessionId": 7, "dogId": 41}]
+        })";
+
+        tests::TempDir dir("game_server_tests_legacy_state");
+        const auto path = dir.GetPath() / "state.json";
+        std::ofstream(path) << "\n  " << legacy;
+
+        THEN("it is recognized as JSON and a binary snapshot is not") {
+            CHECK(serialization::IsJsonState(path));
+
+            GameFixture saved;
+            std::ofstream out(dir.GetPath() / "state.bin", std::ios::binary);
+            serialization::SaveState(saved.app, out);
+            out.close();
+            CHECK_FALSE(serialization::IsJsonState(dir.GetPath() / "state.bin"));
+        }
+
+        WHEN("it is loaded into a fresh game") {
+            GameFixture loaded;
+            std::ifstream in(path);
+            CHECK(serialization::LoadJsonState(loaded.app, in) == 0);
+
+            THEN("sessions, dogs, loot and players are restored") {
+                auto player = loaded.app.GetPlayers().GetPlayerByToken(
+                    app::Token::Parse("21bcec4d2fe13ab845d72a5f19fa57b1"sv));
+                REQUIRE(player);
+                CHECK(player->GetDogId() == 41);
+
+                auto session = player->GetGameSession();
+                CHECK(session->GetSessionId() == 7);
+                const auto& dog = *session->GetDogs().at(41);
+                CHECK(dog.GetName() == "Rex"s);
+                CHECK(dog.GetPosition().x == 1.5);
+                CHECK(dog.GetSpeed().y == 2.5);
+                CHECK(dog.GetDirection() == model::Direction::SOUTH);
+                CHECK(dog.GetState().score == 30);
+                CHECK(dog.GetBag() == std::vector<std::pair<int, int>>{{3, 1}});
+                REQUIRE(session->GetLostObjects().size() == 1);
+                CHECK(session->GetLostObjects()[0].id == 9);
+            }
+
+            THEN("new ids are issued after the loaded ones") {
+                CHECK(model::Dog::GetNextId() > 41);
+                CHECK(model::GameSession::GetNextId() > 7);
+                CHECK(model::GameSession::GetNextLostObjectId() > 9);
+            }
+
+            THEN("the state saves and loads back as a binary snapshot") {
+                std::ostringstream out;
+                serialization::SaveState(loaded.app, out);
+
+                GameFixture reloaded;
+                std::istringstream in_binary(out.str());
+                serialization::LoadState(reloaded.app, in_binary);
+                CHECK(journal::StateDigest(reloaded.game) == journal::StateDigest(loaded.game));
+            }
+        }
+    }
+}
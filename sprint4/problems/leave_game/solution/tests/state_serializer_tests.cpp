@@ -0,0 +1,109 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/json_loader.h"
+#include "test_game.h"
+
+#include <boost/json.hpp>
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+using json_loader::StateSerializer;
+using tests::GameFixture;
+using tests::PlayScript;
+
+namespace {
+
+namespace json = boost::json;
+
+// Прежний путь сериализации состояния: json::object на каждую собаку и json::serialize.
+// Прямая запись в строку должна совпадать с ним побайтно
+double ReferenceRound(double value) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(9) << value;
+    return std::stod(oss.str());
+}
+
+std::string_view ReferenceDirection(model::Direction direction) {
+    switch (direction) {
+        case model::Direction::SOUTH:
+            return "D";
+        case model::Direction::WEST:
+            return "L";
+        case model::Direction::EAST:
+            return "R";
+        default:
+            return "U";
+    }
+}
+
+std::string ReferenceSerialize(const std::vector<model::State>& states,
+                               const model::GameSession::LostObjects& lost_objects) {
+    json::object players;
+    for (const auto& state : states) {
+        json::array bag;
+        for (const auto& [id, type] : state.bag) {
+            bag.push_back(json::object{{"id", id}, {"type", type}});
+        }
+
+        json::object player;
+        player["pos"] = json::array{ReferenceRound(state.position.x), ReferenceRound(state.position.y)};
+        player["speed"] = json::array{state.speed.x, state.speed.y};
+        player["dir"] = ReferenceDirection(state.direction);
+        player["score"] = state.score;
+        player["bag"] = std::move(bag);
+        players[std::to_string(state.id)] = std::move(player);
+    }
+
+    json::object loot;
+    int i = 0;
+    for (const auto& lost_object : lost_objects) {
+        loot[std::to_string(i++)] = json::object{
+            {"type", lost_object.type},
+            {"pos", json::array{ReferenceRound(lost_object.position.x), ReferenceRound(lost_object.position.y)}}};
+    }
+
+    return json::serialize(json::object{{"players", std::move(players)}, {"lostObjects", std::move(loot)}});
+}
+
+}  // namespace
+
+SCENARIO("Direct state serializer matches json::serialize") {
+    GIVEN("hand-made states with fractional coordinates and bags") {
+        std::vector<model::State> states(4);
+        states[0] = {{1.5, 2.25}, {0, -3.5}, model::Direction::SOUTH, {{1, 0}, {7, 2}}, 40, 3};
+        states[1] = {{0.1 + 0.2, 1e-10}, {1.0 / 3, 0}, model::Direction::WEST, {}, 0, 11};
+        states[2] = {{123456.123456789123, -0.0}, {-0.0, 2e-7}, model::Direction::DEFAULT, {{2, 1}}, -5, 0};
+        states[3] = {{39.999999999999, 1e21}, {1e-300, 6.02214076e23}, model::Direction::EAST, {}, 1 << 30, 42};
+
+        const model::GameSession::LostObjects lost_objects{{5, 0, {10.4999999999, 0.5}}, {6, 3, {0, 3.3333333333}}};
+
+        THEN("both paths produce the same bytes") {
+            CHECK(StateSerializer::SerializeStates(states, lost_objects) == ReferenceSerialize(states, lost_objects));
+        }
+    }
+
+    GIVEN("an empty session") {
+        THEN("both paths produce the same bytes") {
+            CHECK(StateSerializer::SerializeStates({}, {}) == ReferenceSerialize({}, {}));
+        }
+    }
+
+    GIVEN("sessions of a played game where a player has left") {
+        GameFixture fixture;
+        PlayScript(fixture.app);
+
+        THEN("every session serializes to the same bytes") {
+            for (const auto& session : fixture.game.GetSessionService().GetSessions()) {
+                const auto states = session->GetPlayersUnitStates();
+                const auto& lost_objects = session->GetLostObjects();
+                CHECK(StateSerializer::SerializeStates(states, lost_objects)
+                      == ReferenceSerialize(states, lost_objects));
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../src/application.h"
+#include "../src/json_loader.h"
+#include "../src/model.h"
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tests {
+
+using namespace std::literals;
+
+inline const model::Map::Id MAP_ID{"town"s};
+
+// Игра по data/config.json и приложение над ней. Game нельзя перемещать, поэтому она создаётся на месте.
+// Пенсия включена, чтобы учёт времени игроков сохранялся и восстанавливался, но за сценарий никто не уходит
+struct GameFixture {
+    GameFixture() {
+        app.SetRetirement(1h);
+    }
+
+    model::Game game = json_loader::LoadGame(GAME_TESTS_CONFIG);
+    app::Application app{game};
+};
+
+// Несколько игроков ходят в разные стороны, один уходит из игры.
+// Тиков достаточно, чтобы на карте появились трофеи
+inline void PlayScript(app::Application& app, int ticks = 200) {
+    auto& session_service = app.GetGame().GetSessionService();
+
+    // Игроки входят так же, как через API: при ограничении вместимости они попадают в разные сессии
+    std::vector<app::Token> tokens;
+    for (int i = 0; i < 5; ++i) {
+        tokens.push_back(app.AddPlayer(std::make_shared<model::Dog>("dog_"s + std::to_string(i)),
+                                       session_service.FindGameSession(MAP_ID)));
+    }
+
+    static const std::array<model::Move, 5> moves{model::Move::LEFT, model::Move::RIGHT, model::Move::UP,
+                                                  model::Move::DOWN, model::Move::STOP};
+    for (int tick = 0; tick < ticks; ++tick) {
+        if (tick % 20 == 0) {
+            for (size_t i = 0; i < tokens.size(); ++i) {
+                app.MovePlayer(tokens[i], moves[(i + tick / 20) % moves.size()]);
+            }
+        }
+        if (tick == ticks * 3 / 4) {
+            auto player = app.GetPlayers().GetPlayerByToken(tokens.back());
+            app.RemovePlayer(player->GetDogId(), player->GetGameSession());
+            tokens.pop_back();
+        }
+        app.Tick(100ms);
+    }
+}
+
+inline bool SameActivity(const app::PlayerActivity& lhs, const app::PlayerActivity& rhs) {
+    return lhs.play_time == rhs.play_time && lhs.idle_left == rhs.idle_left;
+}
+
+// Игроки обеих игр совпадают по токенам, собакам и учёту времени для пенсии
+inline bool SamePlayers(const app::Application& lhs, const app::Application& rhs) {
+    if (lhs.GetPlayers().Size() != rhs.GetPlayers().Size()) {
+        return false;
+    }
+
+    bool same = true;
+    lhs.GetPlayers().ForEachPlayer([&lhs, &rhs, &same](const app::Token& token, const Player::Player& player) {
+        auto other = rhs.GetPlayers().GetPlayerByToken(token);
+        same = same && other && other->GetDogId() == player.GetDogId()
+            && other->GetGameSession()->GetSessionId() == player.GetGameSession()->GetSessionId()
+            && SameActivity(lhs.GetPlayerActivity(player.GetDogId()), rhs.GetPlayerActivity(player.GetDogId()));
+    });
+    return same;
+}
+
+}  // namespace tests
@@ -0,0 +1,154 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/timing_wheel.h"
+
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::literals;
+
+using util::TimingWheel;
+
+namespace {
+
+// Момент срабатывания каждого таймера, если сдвигать время на delta до момента until
+std::unordered_map<TimingWheel::Key, std::chrono::milliseconds>
+RunWheel(TimingWheel& wheel, std::chrono::milliseconds delta, std::chrono::milliseconds until) {
+    std::unordered_map<TimingWheel::Key, std::chrono::milliseconds> fired;
+    std::vector<TimingWheel::Key> expired;
+    for (auto now = 0ms; now < until;) {
+        now += delta;
+        expired.clear();
+        wheel.Advance(delta, expired);
+        for (auto key : expired) {
+            fired.emplace(key, now);
+        }
+    }
+    return fired;
+}
+
+}  // namespace
+
+SCENARIO("Timing wheel") {
+    // Задержки на границах ячеек первых трёх уровней: 64 и 4096 шагов
+    const std::vector<std::chrono::milliseconds> delays{
+        1ms, 2ms, 63ms, 64ms, 65ms, 127ms, 128ms, 1000ms,
+        4095ms, 4096ms, 4097ms, 8191ms, 8192ms, 262143ms, 262144ms, 262145ms, 300001ms};
+
+    GIVEN("timers spread across the levels") {
+        TimingWheel wheel;
+        for (size_t i = 0; i < delays.size(); ++i) {
+            wheel.Schedule(i, delays[i]);
+        }
+
+        WHEN("the time is advanced step by step") {
+            const auto fired = RunWheel(wheel, 1ms, 300001ms);
+
+            THEN("every timer fires exactly at its delay after cascading down") {
+                REQUIRE(fired.size() == delays.size());
+                bool exact = true;
+                for (size_t i = 0; i < delays.size(); ++i) {
+                    exact = exact && fired.at(i) == delays[i];
+                }
+                CHECK(exact);
+                CHECK(wheel.Size() == 0);
+            }
+        }
+
+        WHEN("the time is advanced in long jumps") {
+            const auto fired = RunWheel(wheel, 777ms, 300001ms);
+
+            THEN("every timer fires on the jump that covers its delay") {
+                REQUIRE(fired.size() == delays.size());
+                bool covered = true;
+                for (size_t i = 0; i < delays.size(); ++i) {
+                    covered = covered && fired.at(i) >= delays[i] && fired.at(i) - 777ms < delays[i];
+                }
+                CHECK(covered);
+            }
+        }
+
+        WHEN("the time is advanced past all timers at once") {
+            std::vector<TimingWheel::Key> expired;
+            wheel.Advance(1h, expired);
+
+            THEN("all timers fire in one call") {
+                CHECK(expired.size() == delays.size());
+                CHECK(wheel.Size() == 0);
+            }
+        }
+
+        WHEN("a timer is cancelled or rescheduled") {
+            CHECK(wheel.Cancel(3));
+            CHECK_FALSE(wheel.Cancel(3));
+            wheel.Schedule(10, 10ms);
+            const auto fired = RunWheel(wheel, 1ms, 300001ms);
+
+            THEN("the cancelled one does not fire and the other fires at its new delay") {
+                CHECK_FALSE(fired.contains(3));
+                CHECK(fired.at(10) == 10ms);
+                CHECK(fired.size() == delays.size() - 1);
+            }
+        }
+    }
+
+    GIVEN("a timer further than the top level reaches") {
+        // 2^36 шагов - полный оборот всех шести уровней
+        const auto horizon = std::chrono::milliseconds{int64_t{1} << 36};
+        TimingWheel wheel;
+        wheel.Schedule(1, horizon + 5ms);
+        wheel.Schedule(2, 5ms);
+
+        WHEN("the time reaches the end of the top level") {
+            std::vector<TimingWheel::Key> expired;
+            wheel.Advance(horizon, expired);
+
+            THEN("the overflow timer waits while the near one has fired") {
+                CHECK(expired == std::vector<TimingWheel::Key>{2});
+                CHECK(wheel.Remaining(1) == 5ms);
+            }
+
+            AND_WHEN("the rest of its delay passes") {
+                expired.clear();
+                wheel.Advance(4ms, expired);
+                const bool early = !expired.empty();
+                wheel.Advance(1ms, expired);
+
+                THEN("it fires on time") {
+                    CHECK_FALSE(early);
+                    CHECK(expired == std::vector<TimingWheel::Key>{1});
+                }
+            }
+        }
+    }
+
+    GIVEN("a wheel with 100 ms resolution") {
+        TimingWheel wheel{100ms};
+
+        WHEN("a timer is scheduled between steps") {
+            std::vector<TimingWheel::Key> expired;
+            wheel.Advance(30ms, expired);
+            wheel.Schedule(1, 250ms);
+
+            THEN("its remaining time is rounded up to the step") {
+                CHECK(wheel.Remaining(1) == 270ms);
+                CHECK_FALSE(wheel.Remaining(2));
+            }
+
+            AND_WHEN("the time is advanced in parts smaller than the step") {
+                for (int i = 0; i < 26; ++i) {
+                    wheel.Advance(10ms, expired);
+                }
+                const bool early = !expired.empty();
+                wheel.Advance(10ms, expired);
+
+                THEN("the parts accumulate and the timer fires at the end of its step") {
+                    CHECK_FALSE(early);
+                    CHECK(expired == std::vector<TimingWheel::Key>{1});
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,178 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/token.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+// Хэш таблицы зависит только от hi ^ lo, поэтому такие токены претендуют на одну ячейку
+app::Token Colliding(uint64_t key, uint64_t i) {
+    return app::Token{i, i ^ key};
+}
+
+// Значения в порядке ячеек таблицы
+std::vector<app::TokenTable::Value> ValuesInSlotOrder(const app::TokenTable& table) {
+    std::vector<app::TokenTable::Value> values;
+    table.ForEach([&values](const app::Token&, app::TokenTable::Value value) {
+        values.push_back(value);
+    });
+    return values;
+}
+
+// Ключ, цепочка которого из count токенов переходит через конец таблицы:
+// значения, вставленные по порядку, оказываются в ячейках не по порядку
+uint64_t FindWrappingKey(size_t count) {
+    for (uint64_t key = 1;; ++key) {
+        app::TokenTable table;
+        for (uint64_t i = 0; i < count; ++i) {
+            table.Insert(Colliding(key, i), static_cast<app::TokenTable::Value>(i));
+        }
+
+        const auto values = ValuesInSlotOrder(table);
+        if (!std::is_sorted(values.begin(), values.end())) {
+            return key;
+        }
+    }
+}
+
+}  // namespace
+
+SCENARIO("Token table deletes with backward shift") {
+    // Начальная ёмкость - 16 ячеек, таблица растёт при заполнении больше чем наполовину
+    constexpr uint64_t CHAIN = 7;
+
+    GIVEN("a chain of colliding tokens that wraps around the end of the table") {
+        const uint64_t key = FindWrappingKey(CHAIN);
+
+        app::TokenTable table;
+        for (uint64_t i = 0; i < CHAIN; ++i) {
+            REQUIRE(table.Insert(Colliding(key, i), static_cast<app::TokenTable::Value>(i)));
+        }
+
+        THEN("every token is found") {
+            for (uint64_t i = 0; i < CHAIN; ++i) {
+                const auto* value = table.Find(Colliding(key, i));
+                REQUIRE(value);
+                CHECK(*value == i);
+            }
+            CHECK_FALSE(table.Insert(Colliding(key, 3), 100));
+        }
+
+        WHEN("tokens are erased one by one from the head of the chain") {
+            THEN("the rest of the chain shifts back across the end and stays reachable") {
+                for (uint64_t erased = 0; erased < CHAIN; ++erased) {
+                    REQUIRE(table.Erase(Colliding(key, erased)));
+                    CHECK(table.Size() == CHAIN - erased - 1);
+                    CHECK_FALSE(table.Find(Colliding(key, erased)));
+                    for (uint64_t i = erased + 1; i < CHAIN; ++i) {
+                        const auto* value = table.Find(Colliding(key, i));
+                        REQUIRE(value);
+                        CHECK(*value == i);
+                    }
+                }
+                CHECK(ValuesInSlotOrder(table).empty());
+            }
+        }
+
+        WHEN("a token in the middle of the chain is erased") {
+            REQUIRE(table.Erase(Colliding(key, 3)));
+            CHECK_FALSE(table.Erase(Colliding(key, 3)));
+
+            THEN("the other tokens stay reachable") {
+                const auto values = ValuesInSlotOrder(table);
+                CHECK(values.size() == CHAIN - 1);
+                CHECK(std::find(values.begin(), values.end(), 3) == values.end());
+                for (uint64_t i = 0; i < CHAIN; ++i) {
+                    CHECK((table.Find(Colliding(key, i)) != nullptr) == (i != 3));
+                }
+            }
+
+            THEN("the freed slot is reused") {
+                REQUIRE(table.Insert(Colliding(key, 3), 30));
+                CHECK(*table.Find(Colliding(key, 3)) == 30);
+                CHECK(table.Size() == CHAIN);
+            }
+        }
+    }
+
+    GIVEN("random inserts and erases with many collisions") {
+        app::TokenTable table;
+        std::map<std::pair<uint64_t, uint64_t>, app::TokenTable::Value> expected;
+        std::mt19937_64 random{42};
+
+        for (app::TokenTable::Value step = 0; step < 20000; ++step) {
+            // Четыре семейства совпадающих хэшей и небольшой диапазон, чтобы токены повторялись
+            const app::Token token = Colliding(random() % 4 + 1, random() % 64);
+            const auto key = std::make_pair(token.hi, token.lo);
+
+            if (random() % 3 == 0) {
+                CHECK(table.Erase(token) == (expected.erase(key) == 1));
+            } else {
+                CHECK(table.Insert(token, step) == expected.emplace(key, step).second);
+            }
+        }
+
+        THEN("the table matches a reference map") {
+            CHECK(table.Size() == expected.size());
+            for (const auto& [key, value] : expected) {
+                const auto* found = table.Find(app::Token{key.first, key.second});
+                REQUIRE(found);
+                CHECK(*found == value);
+            }
+
+            size_t visited = 0;
+            table.ForEach([&expected, &visited](const app::Token& token, app::TokenTable::Value value) {
+                CHECK(expected.at({token.hi, token.lo}) == value);
+                ++visited;
+            });
+            CHECK(visited == expected.size());
+        }
+    }
+}
+
+SCENARIO("Token hex round trip") {
+    GIVEN("tokens with edge and random values") {
+        std::vector<app::Token> tokens{{0, 0}, {~0ull, ~0ull}, {0x0123456789abcdefull, 0xfedcba9876543210ull}};
+        std::mt19937_64 random{7};
+        for (int i = 0; i < 100; ++i) {
+            tokens.push_back(app::Token{random(), random()});
+        }
+
+        THEN("they are written as 32 lowercase digits and parsed back") {
+            for (const auto& token : tokens) {
+                const std::string hex = token.ToHex();
+                CHECK(hex.size() == app::Token::HEX_SIZE);
+                CHECK(hex.find_first_not_of("0123456789abcdef") == std::string::npos);
+                CHECK(app::Token::FromHex(hex) == token);
+                CHECK(app::Token::Parse(hex) == token);
+            }
+            CHECK(tokens[2].ToHex() == "0123456789abcdeffedcba9876543210");
+        }
+    }
+
+    GIVEN("upper case digits") {
+        THEN("they are accepted") {
+            CHECK(app::Token::FromHex("0123456789ABCDEFFEDCBA9876543210")
+                  == app::Token{0x0123456789abcdefull, 0xfedcba9876543210ull});
+        }
+    }
+
+    GIVEN("malformed strings") {
+        THEN("they are rejected") {
+            CHECK_FALSE(app::Token::FromHex(""));
+            CHECK_FALSE(app::Token::FromHex("0123456789abcdeffedcba987654321"));
+            CHECK_FALSE(app::Token::FromHex("0123456789abcdeffedcba98765432100"));
+            CHECK_FALSE(app::Token::FromHex("0123456789abcdeg fedcba987654321"));
+            CHECK_FALSE(app::Token::FromHex("0123456789abcdeffedcba987654321x"));
+            CHECK_THROWS_AS(app::Token::Parse("not a token"), std::invalid_argument);
+        }
+    }
+}
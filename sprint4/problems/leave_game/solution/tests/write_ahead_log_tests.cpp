@@ -0,0 +1,135 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/journal.h"
+#include "../src/model_serialization.h"
+#include "../src/write_ahead_log.h"
+#include "temp_dir.h"
+#include "test_game.h"
+
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+using namespace std::literals;
+
+using tests::GameFixture;
+using tests::PlayScript;
+
+namespace {
+
+std::filesystem::path SegmentPath(const std::filesystem::path& base, uint64_t generation) {
+    auto path = base;
+    path += "." + std::to_string(generation);
+    return path;
+}
+
+}  // namespace
+
+SCENARIO("Write-ahead log recovery") {
+    GIVEN("a game played with a write-ahead log") {
+        const tests::TempDir dir("game_server_tests_wal");
+        const auto wal_path = dir.GetPath() / "wal";
+
+        GameFixture played;
+        {
+            journal::WriteAheadLog wal(played.game, wal_path);
+            played.app.AddApplicationListener(wal);
+            PlayScript(played.app);
+            wal.Sync();
+            CHECK(wal.GetStats().syncs > 0);
+        }
+        const uint64_t expected = journal::StateDigest(played.game);
+
+        WHEN("the log is recovered into a fresh game") {
+            GameFixture recovered;
+            journal::WriteAheadLog wal(recovered.game, wal_path);
+            const auto stats = wal.Recover(recovered.app, 0);
+
+            THEN("the state and the players match") {
+                CHECK(stats.ticks == 200);
+                CHECK(journal::StateDigest(recovered.game) == expected);
+                CHECK(tests::SamePlayers(played.app, recovered.app));
+            }
+        }
+
+        WHEN("the last frame is torn") {
+            const auto segment = SegmentPath(wal_path, 0);
+            std::filesystem::resize_file(segment, std::filesystem::file_size(segment) - 3);
+
+            THEN("only the torn tick is lost") {
+                GameFixture recovered;
+                journal::WriteAheadLog wal(recovered.game, wal_path);
+                CHECK(wal.Recover(recovered.app, 0).ticks == 199);
+            }
+        }
+    }
+
+    GIVEN("a snapshot taken in the middle of a logged game") {
+        const tests::TempDir dir("game_server_tests_wal_snapshot");
+        const auto wal_path = dir.GetPath() / "wal";
+
+        GameFixture played;
+        std::string snapshot;
+        uint64_t generation = 0;
+        {
+            journal::WriteAheadLog wal(played.game, wal_path);
+            played.app.AddApplicationListener(wal);
+            PlayScript(played.app, 100);
+
+            auto state = serialization::CaptureState(played.app);
+            generation = state.wal_generation = wal.Rotate();
+            std::ostringstream out;
+            serialization::WriteState(state, out);
+            snapshot = out.str();
+
+            PlayScript(played.app, 100);
+            wal.Sync();
+        }
+        const uint64_t expected = journal::StateDigest(played.game);
+
+        WHEN("the snapshot is loaded and the log after it is replayed") {
+            GameFixture recovered;
+            std::istringstream in(snapshot);
+            const uint64_t from = serialization::LoadState(recovered.app, in);
+
+            journal::WriteAheadLog wal(recovered.game, wal_path);
+            const auto stats = wal.Recover(recovered.app, from);
+
+            THEN("only the ticks after the snapshot are replayed") {
+                CHECK(from == generation);
+                CHECK(stats.ticks == 100);
+                CHECK(journal::StateDigest(recovered.game) == expected);
+                CHECK(tests::SamePlayers(played.app, recovered.app));
+            }
+        }
+
+        WHEN("segments covered by the snapshot are removed") {
+            journal::WriteAheadLog wal(played.game, wal_path);
+            wal.RemoveSegmentsBefore(generation);
+
+            THEN("the newer segment is kept") {
+                CHECK_FALSE(std::filesystem::exists(SegmentPath(wal_path, generation - 1)));
+                CHECK(std::filesystem::exists(SegmentPath(wal_path, generation)));
+            }
+        }
+    }
+
+    GIVEN("a log whose segments cannot be written") {
+        const tests::TempDir dir("game_server_tests_wal_failure");
+        GameFixture game;
+        journal::WriteAheadLog wal(game.game, dir.GetPath() / "missing" / "wal");
+        game.app.AddApplicationListener(wal);
+
+        WHEN("a batch is submitted") {
+            // Rotate передаёт пакет фоновому потоку, не проверяя его ошибки
+            wal.OnAction(1, model::Move::LEFT);
+            wal.Rotate();
+
+            THEN("the error is raised by Sync and by the following ticks") {
+                CHECK_THROWS_AS(wal.Sync(), std::system_error);
+                CHECK_THROWS_AS(game.app.Tick(100ms), std::system_error);
+                CHECK(wal.GetStats().syncs == 0);
+            }
+        }
+    }
+}